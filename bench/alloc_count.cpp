@@ -0,0 +1,42 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 19:20:53
+ * @ Modified Time: 2026-10-19 19:20:53
+ * @ Description  : 统计当前线程的堆分配次数，转发给glibc的实现
+ */
+
+#include <cstddef>
+#include "alloc_count.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+}
+
+/* 可执行文件中的线程局部变量采用静态TLS，访问时不会触发分配 */
+static thread_local uint64_t allocs = 0;
+
+uint64_t alloc_count() {
+    return allocs;
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+    ++allocs;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    ++allocs;
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    ++allocs;
+    return __libc_realloc(ptr, size);
+}
+
+}
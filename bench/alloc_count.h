@@ -0,0 +1,19 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 19:20:53
+ * @ Modified Time: 2026-10-19 19:20:53
+ * @ Description  : 统计当前线程的堆分配次数 头文件
+ */
+
+#ifndef BENCH_ALLOC_COUNT_H
+#define BENCH_ALLOC_COUNT_H
+
+#include <cstdint>
+
+/* webserver_bench替换了malloc/calloc/realloc（见alloc_count.cpp），
+ * 返回当前线程累计的分配次数，operator new也经过malloc，同样被统计
+ */
+uint64_t alloc_count();
+
+#endif
@@ -0,0 +1,74 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-20 09:12:40
+ * @ Modified Time: 2026-10-20 09:12:40
+ * @ Description  : 基准测试与测试共用的临时网站根目录
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <ftw.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "bench_conn.h"
+#include "dir_index.h"
+#include "config.h"
+
+using std::string;
+
+static void write_file(const string& path, size_t size) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        return;
+    }
+    string data(size, 'x');
+    if(::write(fd, data.data(), data.size()) < 0) {
+        perror("write");
+    }
+    close(fd);
+}
+
+static string root;
+
+static int remove_entry(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+}
+
+void remove_bench_doc_root() {
+    if(root.empty()) {
+        return;
+    }
+    nftw(root.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    root.clear();
+    delete dir_index_;
+    dir_index_ = nullptr;
+}
+
+const string& bench_doc_root() {
+    if(! root.empty()) {
+        return root;
+    }
+    char tmpl[] = "/tmp/webserver_bench_XXXXXX";
+    if(! mkdtemp(tmpl)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    static bool registered = false;
+    if(! registered) {
+        atexit(remove_bench_doc_root);
+        registered = true;
+    }
+    root = tmpl;
+    mkdir((root + "/images").c_str(), 0755);
+    write_file(root + "/index.html", 1024);
+    write_file(root + "/app.js", 16 * 1024);
+    write_file(root + "/中文文件.txt", 256);
+    write_file(root + "/images/logo.png", 4 * 1024);
+    config_->doc_root = root;
+    dir_index_ = new dir_index(config_->index_files, config_->autoindex);
+    return root;
+}
@@ -0,0 +1,77 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 10:40:17
+ * @ Modified Time: 2026-10-19 10:40:17
+ * @ Description  : 基准测试用的http_conn，不依赖socket
+ */
+
+#ifndef BENCH_CONN_H
+#define BENCH_CONN_H
+
+#include <string>
+#include "http_conn.h"
+
+/* 暴露http_conn的解析与应答接口，直接操作读写缓冲区 */
+class bench_conn : public http_conn{
+public:
+    bench_conn() { m_sockfd = -1; m_requests = 0; init(); }
+    ~bench_conn() { unmap(); }
+
+    /* 在新连接上开始一个请求：只重置解析位置，不清零缓冲区 */
+    void load(const char* request) {
+        unmap();
+        m_requests = 0;
+        m_read_idx = 0;
+        m_checked_idx = 0;
+        m_start_line = 0;
+        m_write_idx = 0;
+        m_content_length = 0;
+        m_linger = false;
+        m_check_state = CHECK_STATE_REQUESTLINE;
+        m_arena.reset();
+        feed(request, strlen(request));
+    }
+    /* 与长连接上处理完一个请求后相同：init()后读入下一个请求 */
+    void next_request(const char* request) {
+        unmap();
+        init();
+        feed(request, strlen(request));
+    }
+    void reset_write() { m_write_idx = 0; }
+    /* 之后的读取（如上传的消息体）及发送经过fd */
+    void attach(int fd) { m_sockfd = fd; }
+    /* 以处理结果ret填充应答，之后由send_response经fd发送 */
+    bool start_response(int fd, HTTP_CODE ret) {
+        m_sockfd = fd;
+        m_write_idx = 0;
+        m_bytes_have_send = 0;
+        return process_write(ret);
+    }
+    /* 在当前请求上以producer生成分块应答，经fd发送 */
+    bool start_stream(int fd, body_producer* producer) {
+        return start_response(fd, stream(producer));
+    }
+    int write_size() const { return m_write_idx; }
+    /* process_write填充的应答：写缓冲及之后要发送的消息体的长度 */
+    std::string response() const { return std::string(m_write_buf, m_write_idx); }
+    long body_size() const { return m_bytes_to_send - m_write_idx; }
+    bool linger() const { return m_linger; }
+
+    using http_conn::init;
+    using http_conn::parse_line;
+    using http_conn::process_read;
+    using http_conn::finish_request;
+    using http_conn::process_write;
+    using http_conn::add_headers;
+    using http_conn::unmap;
+    using http_conn::send_response;
+    using http_conn::close_upload;
+};
+
+/* 创建临时网站根目录，并让http_conn使用它，返回目录路径；进程退出时删除 */
+const std::string& bench_doc_root();
+/* 立即删除临时网站根目录，之后的bench_doc_root()重新创建 */
+void remove_bench_doc_root();
+
+#endif
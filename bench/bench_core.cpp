@@ -0,0 +1,238 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 11:02:48
+ * @ Modified Time: 2026-10-19 11:02:48
+ * @ Description  : 基准测试：线程池、时间堆、日志系统、文件缓存
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <sched.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <benchmark/benchmark.h>
+
+#include "alloc_count.h"
+#include "threadpool.h"
+#include "timer.h"
+#include "log.h"
+#include "file_cache.h"
+#include "ratelimit.h"
+#include "conn_table.h"
+
+/* 空任务，只记录被执行的次数 */
+struct bench_task{
+    std::atomic<long> done{0};
+    void process() { done.fetch_add(1, std::memory_order_relaxed); }
+    void reject() { process(); }
+};
+
+/* 线程池的工作线程是分离的，无法安全销毁，因此每种线程数及自旋时间只创建一次 */
+static threadpool<bench_task>* get_pool(int threads, int spin_us) {
+    static std::map<std::pair<int, int>, threadpool<bench_task>*> pools;
+    auto it = pools.find(std::make_pair(threads, spin_us));
+    if(it != pools.end()) {
+        return it->second;
+    }
+    threadpool<bench_task>* pool = new threadpool<bench_task>(threads, 10000, "worker", NULL,
+        NULL, 0, (uint64_t)spin_us * 1000);
+    pools[std::make_pair(threads, spin_us)] = pool;
+    return pool;
+}
+
+/* 每轮向线程池提交一批任务，并等待全部执行完毕；第二个参数为--spin-us */
+static void BM_threadpool_append(benchmark::State& state) {
+    const int batch = 1024;
+    threadpool<bench_task>* pool = get_pool(state.range(0), state.range(1));
+    bench_task task;
+    long expect = 0;
+    uint64_t allocs = 0;
+    for(auto _ : state) {
+        uint64_t before = alloc_count();
+        for(int i = 0; i < batch; ++i) {
+            while(! pool->append(&task)) {
+                sched_yield();
+            }
+        }
+        allocs += alloc_count() - before;
+        expect += batch;
+        while(task.done.load(std::memory_order_relaxed) < expect) {
+            sched_yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+    state.counters["allocs_per_append"] = benchmark::Counter((double)allocs / (state.iterations() * batch));
+}
+BENCHMARK(BM_threadpool_append)->Args({1, 0})->Args({2, 0})->Args({4, 0})->Args({8, 0})
+    ->Args({1, 50})->Args({4, 50})->UseRealTime();
+
+/* 向时间堆中依次添加n个定时器 */
+static void BM_timer_heap_add_timer(benchmark::State& state) {
+    const int n = state.range(0);
+    for(auto _ : state) {
+        timer_heap heap;
+        for(int i = 0; i < n; ++i) {
+            heap.add_timer(new my_timer(i % 97));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_timer_heap_add_timer)->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_log(benchmark::State& state) {
+    static LOG* bench_log = new LOG("./bench_log.txt");
+    const string this_file = "bench_core.cpp";
+    long n = 0;
+    for(auto _ : state) {
+        bench_log->log("msg", this_file, __LINE__, "visit file or dir: [ /var/www/index.html ] [ ok ]");
+        if((++n & 4095) == 0) {
+            /* 定期写入文件，避免缓冲区无限增长 */
+            state.PauseTiming();
+            bench_log->save();
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_log);
+
+static string cache_root;
+
+static int remove_entry(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+}
+
+static void remove_cache_root() {
+    nftw(cache_root.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/* 在临时目录中创建n个size字节的文件，返回其路径；目录在进程退出时删除 */
+static std::vector<string> make_files(const char* prefix, int n, size_t size) {
+    string& root = cache_root;
+    if(root.empty()) {
+        char tmpl[] = "/tmp/webserver_cache_XXXXXX";
+        if(! mkdtemp(tmpl)) {
+            perror("mkdtemp");
+            exit(1);
+        }
+        root = tmpl;
+        atexit(remove_cache_root);
+    }
+    std::vector<string> files;
+    string data(size, 'x');
+    for(int i = 0; i < n; ++i) {
+        string path = root + "/" + prefix + std::to_string(i);
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd >= 0 && ::write(fd, data.data(), data.size()) < 0) {
+            perror("write");
+        }
+        close(fd);
+        files.push_back(path);
+    }
+    return files;
+}
+
+/* 模拟do_request：先查缓存，未命中时stat并读入 */
+static bool cache_request(file_cache& cache, const string& path) {
+    cache_entry_ptr entry;
+    if(cache.get(path.c_str(), entry)) {
+        return true;
+    }
+    struct stat st;
+    if(stat(path.c_str(), &st) == 0) {
+        cache.load(path.c_str(), st, "text/plain", entry);
+    }
+    return false;
+}
+
+/* 命中路径，多线程同时访问时分片锁的效果 */
+static void BM_file_cache_hit(benchmark::State& state) {
+    static std::vector<string> files = make_files("hit", 1024, 1024);
+    static file_cache* cache = nullptr;
+    if(state.thread_index() == 0 && ! cache) {
+        cache = new file_cache(64 << 20, 64 << 10);
+        for(const string& f : files) {
+            cache_request(*cache, f);
+        }
+    }
+    cache_entry_ptr entry;
+    size_t i = state.thread_index() * 7919;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(cache->get(files[i++ & 1023].c_str(), entry));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_file_cache_hit)->Threads(1)->Threads(4)->UseRealTime();
+
+/* Zipf分布的热点文件中夹杂着对大量冷文件的一次性扫描，容量只够放下部分热点文件；
+ * 报告热点文件的命中率，扫描不应把热点文件挤出缓存
+ */
+static void BM_file_cache_hit_ratio(benchmark::State& state) {
+    static std::vector<string> hot = make_files("hot", 1000, 4096);
+    static std::vector<string> cold = make_files("cold", 5000, 4096);
+    std::vector<double> cdf(hot.size());
+    double sum = 0;
+    for(size_t i = 0; i < hot.size(); ++i) {
+        sum += 1.0 / (i + 1);
+        cdf[i] = sum;
+    }
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> uniform(0, sum);
+    file_cache cache(2 << 20, 64 << 10);    /* 约500个文件 */
+    uint64_t hits = 0, lookups = 0;
+    size_t scan = 0;
+    for(auto _ : state) {
+        size_t k = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+        hits += cache_request(cache, hot[k]);
+        ++lookups;
+        /* 每个热点请求之后跟一个扫描请求 */
+        cache_request(cache, cold[scan++ % cold.size()]);
+    }
+    state.counters["hot_hit_ratio"] = benchmark::Counter((double)hits / lookups);
+}
+BENCHMARK(BM_file_cache_hit_ratio)->Iterations(200000);
+
+/* 限流：arg为0时测每个请求的allow()（一次CAS更新GCRA的tat），
+ * 为1时测accept时的admit()+detach()，在1024个IP之间轮换；都应远小于1us
+ */
+static void BM_rate_limit(benchmark::State& state) {
+    rate_limiter limiter(1000000, 1000000000, 1000000000);
+    limit_slot* slot = nullptr;
+    limiter.admit(0x0100000a, slot);
+    uint32_t ip = 0;
+    for(auto _ : state) {
+        if(state.range(0) == 0) {
+            benchmark::DoNotOptimize(limiter.allow(slot));
+        }
+        else {
+            limit_slot* s = nullptr;
+            if(limiter.admit(0x0a000000 + (ip++ & 1023), s) == rate_limiter::ADMIT_OK) {
+                limiter.detach(s);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_rate_limit)->Arg(0)->Arg(1);
+
+/* 连接表：accept时取出连接、分发事件时由data找回连接、关闭时放回 */
+static void BM_conn_table(benchmark::State& state) {
+    conn_table table(-1);
+    table.release(table.acquire());
+    for(auto _ : state) {
+        http_conn* conn = table.acquire();
+        benchmark::DoNotOptimize(conn_table::resolve(conn_table::key(conn) | conn_table::UPSTREAM_TAG));
+        table.release(conn);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_conn_table);
@@ -0,0 +1,290 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 10:40:17
+ * @ Modified Time: 2026-10-19 10:40:17
+ * @ Description  : 基准测试：请求解析、应答填充、url解码、文件类型查找
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <benchmark/benchmark.h>
+
+#include "alloc_count.h"
+#include "bench_conn.h"
+#include "corpus.h"
+#include "http_content_type.h"
+#include "hpack.h"
+#include "proxy.h"
+#include "router.h"
+#include "config.h"
+#include "log.h"
+
+using std::string;
+
+/* 从状态机：只切分请求中的各行 */
+static void BM_parse_line(benchmark::State& state) {
+    const corpus_entry& entry = request_corpus[state.range(0)];
+    bench_conn conn;
+    int lines = 0;
+    for(auto _ : state) {
+        conn.load(entry.data);
+        while(conn.parse_line() == http_conn::LINE_OK) {
+            ++lines;
+        }
+    }
+    state.SetLabel(entry.name);
+    state.SetBytesProcessed(state.iterations() * strlen(entry.data));
+    benchmark::DoNotOptimize(lines);
+}
+BENCHMARK(BM_parse_line)->DenseRange(0, request_corpus_size - 1);
+
+/* 主状态机：完整解析请求并执行do_request（stat + mmap） */
+static void BM_process_read(benchmark::State& state) {
+    const corpus_entry& entry = request_corpus[state.range(0)];
+    bench_doc_root();
+    bench_conn conn;
+    for(auto _ : state) {
+        conn.load(entry.data);
+        benchmark::DoNotOptimize(conn.process_read());
+        conn.unmap();
+    }
+    state.SetLabel(entry.name);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_process_read)->DenseRange(0, request_corpus_size - 1);
+
+static void BM_add_headers(benchmark::State& state) {
+    bench_doc_root();
+    bench_conn conn;
+    conn.load(request_corpus[0].data);
+    conn.process_read();
+    for(auto _ : state) {
+        conn.reset_write();
+        conn.add_headers(1024);
+    }
+    state.SetBytesProcessed(state.iterations() * conn.write_size());
+}
+BENCHMARK(BM_add_headers);
+
+/* 应答填充，参数为服务器处理请求的结果 */
+static void BM_process_write(benchmark::State& state) {
+    http_conn::HTTP_CODE code = (http_conn::HTTP_CODE)state.range(0);
+    bench_doc_root();
+    bench_conn conn;
+    conn.load(request_corpus[0].data);
+    if(conn.process_read() != http_conn::FILE_REQUEST) {
+        state.SkipWithError("index.html not found in bench doc root");
+        return;
+    }
+    for(auto _ : state) {
+        conn.reset_write();
+        benchmark::DoNotOptimize(conn.process_write(code));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_process_write)
+    ->Arg(http_conn::FILE_REQUEST)
+    ->Arg(http_conn::NO_RESOURCE)
+    ->Arg(http_conn::BAD_REQUEST);
+
+static void BM_urlDecode(benchmark::State& state) {
+    const string url = state.range(0)
+        ? "/%E4%B8%AD%E6%96%87%E6%96%87%E4%BB%B6.txt" : "/static/js/app.min.js";
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(urlDecode(url));
+    }
+    state.SetBytesProcessed(state.iterations() * url.size());
+}
+BENCHMARK(BM_urlDecode)->Arg(0)->Arg(1);
+
+/* 与add_headers中相同的查找方式 */
+static void BM_file_type_map(benchmark::State& state) {
+    const char* key = state.range(0) ? ".unknown" : ".html";
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(get_content_type(key));
+    }
+    state.SetLabel(key);
+}
+BENCHMARK(BM_file_type_map)->Arg(0)->Arg(1);
+
+/* 长连接上一个完整请求（解析、do_request、填充应答、记录日志）的堆分配次数，
+ * 热身之后应当为0，由tests/check_http.cpp校验
+ */
+static void BM_request_allocs(benchmark::State& state) {
+    const corpus_entry& entry = request_corpus[state.range(0)];
+    bench_doc_root();
+    bench_conn conn;
+    auto one_request = [&]() {
+        conn.next_request(entry.data);
+        http_conn::HTTP_CODE ret = conn.process_read();
+        benchmark::DoNotOptimize(conn.process_write(ret));
+    };
+    /* 热身：arena、日志缓冲区、线程私有变量等在这里完成首次分配 */
+    for(int i = 0; i < 16; ++i) {
+        one_request();
+    }
+    log_->save();
+
+    uint64_t allocs = 0;
+    for(auto _ : state) {
+        uint64_t before = alloc_count();
+        one_request();
+        allocs += alloc_count() - before;
+        /* 模拟定时器周期性地将日志写入文件，避免缓冲区无限增长 */
+        if((state.iterations() & 1023) == 0) {
+            log_->save();
+        }
+    }
+    state.SetLabel(entry.name);
+    state.counters["allocs_per_request"] = benchmark::Counter((double)allocs / state.iterations());
+}
+BENCHMARK(BM_request_allocs)->DenseRange(0, request_corpus_size - 1);
+
+/* 每次返回同一块数据，共count次 */
+class repeat_producer : public body_producer{
+public:
+    repeat_producer(const char* data, size_t len, int count) : m_data(data), m_len(len), m_left(count) {}
+    STATUS next(const char** data, size_t* len) override {
+        if(m_left == 0) {
+            return PRODUCE_END;
+        }
+        --m_left;
+        *data = m_data;
+        *len = m_len;
+        return PRODUCE_DATA;
+    }
+
+private:
+    const char* m_data;
+    size_t m_len;
+    int m_left;
+};
+
+/* 分块应答：1MB的消息体按参数大小分块，经socketpair发送并在同一线程中读出 */
+static void BM_chunked_response(benchmark::State& state) {
+    const size_t chunk = state.range(0);
+    const size_t total = 1 << 20;
+    bench_doc_root();
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    string payload(chunk, 'x');
+    bench_conn conn;
+    conn.load("GET /stream HTTP/1.1\r\nHost: bench\r\n\r\n");
+    conn.process_read();
+    char buf[64 * 1024];
+    auto one_response = [&]() {
+        if(! conn.start_stream(fds[0], new repeat_producer(payload.data(), chunk, total / chunk))) {
+            return false;
+        }
+        while(true) {
+            http_conn::WRITE_STATUS status = conn.send_response();
+            while(recv(fds[1], buf, sizeof(buf), 0) > 0) {
+            }
+            if(status != http_conn::WRITE_AGAIN) {
+                return status == http_conn::WRITE_DONE;
+            }
+        }
+    };
+    for(auto _ : state) {
+        if(! one_response()) {
+            state.SkipWithError("chunked response failed");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * total);
+    conn.unmap();
+    close(fds[0]);
+    close(fds[1]);
+}
+BENCHMARK(BM_chunked_response)->Arg(256)->Arg(4096)->Arg(64 * 1024);
+
+/* HPACK：RFC 7541 C.4中连续的两个请求（Huffman编码，第二个引用第一个加入动态表的字段），
+ * 以及一组典型应答头部的编码再解码
+ */
+static void BM_hpack(benchmark::State& state) {
+    static const uint8_t first[] = {0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a,
+        0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff};
+    static const uint8_t second[] = {0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf};
+    static const char* const response[][2] = {
+        {"server", "WangYusong's Server / v0.5.0(Linux)"},
+        {"content-length", "3"},
+        {"last-modified", "Mon, 19 Oct 2026 12:58:03 GMT"},
+        {"content-type", "text/html; charset=utf-8"},
+        {"x-custom", "value"},
+    };
+    string block;
+    hpack_encode_status(block, 200);
+    for(auto& h : response) {
+        hpack_encode_header(block, h[0], strlen(h[0]), h[1], strlen(h[1]));
+    }
+
+    auto run = [&](std::vector<hpack_header>& headers) {
+        hpack_decoder decoder;
+        headers.clear();
+        return decoder.decode(first, sizeof(first), headers) && decoder.decode(second, sizeof(second), headers)
+            && decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), block.size(), headers);
+    };
+    std::vector<hpack_header> headers;
+    for(auto _ : state) {
+        run(headers);
+        benchmark::DoNotOptimize(headers.data());
+    }
+}
+BENCHMARK(BM_hpack);
+
+/* 代理转发chunked消息体时的边界解析：arg大小的分块（带扩展）、trailer */
+static void BM_chunk_framing(benchmark::State& state) {
+    size_t chunk = state.range(0);
+    string body;
+    char size_line[32];
+    for(int i = 0; i < 16; ++i) {
+        snprintf(size_line, sizeof(size_line), "%zx%s\r\n", chunk, (i == 3) ? ";ext=1" : "");
+        body.append(size_line).append(chunk, 'x').append("\r\n");
+    }
+    body.append("0\r\nX-Trailer: 1\r\n\r\n");
+    string input = body + "GET / HTTP/1.1\r\n";
+
+    body_framing framing;
+    for(auto _ : state) {
+        framing.chunked();
+        benchmark::DoNotOptimize(framing.consume(input.data(), input.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_chunk_framing)->Arg(256)->Arg(4096);
+
+/* 路由查找：arg条形如"/api/v1/svcN/items"的PREFIX路由及同样数量的EXACT路由，
+ * 查找时间应只与路径长度有关，与路由数无关
+ */
+class bench_handler : public route_handler{
+public:
+    http_conn::HTTP_CODE handle(http_conn& conn) override { return http_conn::NO_RESOURCE; }
+};
+
+static void BM_router_match(benchmark::State& state) {
+    int count = state.range(0);
+    router r;
+    for(int i = 0; i < count; ++i) {
+        string path = "/api/v1/svc" + std::to_string(i);
+        r.add(path + "/items", router::PREFIX, router::ALL_METHODS, new bench_handler);
+        r.add(path + "/status", router::EXACT, router::method_bit(http_conn::GET), new bench_handler);
+    }
+    string hit = "/api/v1/svc" + std::to_string(count / 2) + "/items/1234/detail";
+    uint32_t allowed = 0;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(r.match(http_conn::GET, hit.c_str(), allowed));
+    }
+}
+BENCHMARK(BM_router_match)->Arg(16)->Arg(4096);
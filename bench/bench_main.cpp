@@ -0,0 +1,38 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 11:15:31
+ * @ Modified Time: 2026-10-19 11:15:31
+ * @ Description  : 基准测试主程序，默认以JSON格式输出结果
+ */
+
+#include <cstring>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+/* usage: ./webserver_bench [--benchmark_filter=...] [--benchmark_out=result.json]
+ * 未指定--benchmark_format时输出JSON，便于不同版本之间对比
+ */
+int main(int argc, char* argv[]) {
+    static char json_format[] = "--benchmark_format=json";
+    std::vector<char*> args(argv, argv + argc);
+    bool has_format = false;
+    for(int i = 1; i < argc; ++i) {
+        if(strncmp(argv[i], "--benchmark_format", 18) == 0) {
+            has_format = true;
+        }
+    }
+    if(! has_format) {
+        args.push_back(json_format);
+    }
+    int n = args.size();
+    args.push_back(nullptr);
+
+    benchmark::Initialize(&n, args.data());
+    if(benchmark::ReportUnrecognizedArguments(n, args.data())) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
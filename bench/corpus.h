@@ -0,0 +1,80 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 10:31:05
+ * @ Modified Time: 2026-10-19 10:31:05
+ * @ Description  : 基准测试用的http请求样本（由真实客户端抓取）
+ */
+
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+struct corpus_entry{
+    const char* name;       /* 样本名称，出现在基准测试结果中 */
+    const char* data;       /* 完整的原始请求 */
+};
+
+/* 请求的目标文件均由bench_conn.cpp在临时网站根目录中创建 */
+static const corpus_entry request_corpus[] = {
+    {"curl",
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: 127.0.0.1:8989\r\n"
+        "User-Agent: curl/7.68.0\r\n"
+        "Accept: */*\r\n"
+        "\r\n"},
+    {"ab_keepalive",
+        "GET /app.js HTTP/1.1\r\n"
+        "Connection: keep-alive\r\n"
+        "Host: 127.0.0.1:8989\r\n"
+        "User-Agent: ApacheBench/2.3\r\n"
+        "Accept: */*\r\n"
+        "\r\n"},
+    {"chrome",
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: 192.168.1.10:8989\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+            "Chrome/92.0.4515.131 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,"
+            "image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.9\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Cookie: _ga=GA1.1.1234567890.1628745600; session=9f8e7d6c5b4a39281706f5e4d3c2b1a0\r\n"
+        "If-Modified-Since: Wed, 18 Aug 2021 08:00:00 GMT\r\n"
+        "\r\n"},
+    {"chinese_name",
+        "GET /%E4%B8%AD%E6%96%87%E6%96%87%E4%BB%B6.txt HTTP/1.1\r\n"
+        "Host: 127.0.0.1:8989\r\n"
+        "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:91.0) Gecko/20100101 Firefox/91.0\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: zh-CN,zh;q=0.8,zh-TW;q=0.7,zh-HK;q=0.5,en-US;q=0.3,en;q=0.2\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"},
+    {"absolute_uri",
+        "GET http://127.0.0.1:8989/images/logo.png HTTP/1.1\r\n"
+        "Host: 127.0.0.1:8989\r\n"
+        "Proxy-Connection: keep-alive\r\n"
+        "\r\n"},
+    {"directory_index",
+        "GET / HTTP/1.1\r\n"
+        "Host: 127.0.0.1:8989\r\n"
+        "User-Agent: curl/7.68.0\r\n"
+        "Accept: */*\r\n"
+        "\r\n"},
+    {"directory_redirect",
+        "GET /images HTTP/1.1\r\n"
+        "Host: 127.0.0.1:8989\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"},
+    {"not_found",
+        "GET /no/such/file.html HTTP/1.1\r\n"
+        "Host: 127.0.0.1:8989\r\n"
+        "\r\n"},
+};
+
+static const int request_corpus_size = sizeof(request_corpus) / sizeof(request_corpus[0]);
+
+#endif
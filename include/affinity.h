@@ -0,0 +1,38 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:58
+ * @ Modified Time: 2026-10-19 23:59:58
+ * @ Description  : CPU绑定、NUMA节点上的内存分配及按接收CPU分配连接 头文件
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <cstddef>
+#include <vector>
+#include <pthread.h>
+
+/* 解析"0-3,8,10-11"形式的CPU列表，格式错误或CPU编号超出CPU_SETSIZE时返回false */
+bool parse_cpu_list(const char* text, std::vector<int>& cpus);
+
+/* cpu所在的NUMA节点（读取/sys），没有NUMA信息时返回-1 */
+int cpu_node(int cpu);
+
+/* 将线程绑定到cpu上；以attr创建的线程从一开始就运行在cpu上，栈也分配在其节点上 */
+bool pin_thread(pthread_t thread, int cpu);
+bool pin_attr(pthread_attr_t* attr, int cpu);
+
+/* 以页为单位分配size字节，优先使用node上的内存（MPOL_PREFERRED），node为-1时不指定；
+ * 失败时返回nullptr，用free_on_node释放
+ */
+void* alloc_on_node(size_t size, int node);
+void free_on_node(void* p, size_t size);
+
+/* 按连接到达时处理网卡接收队列的CPU选择事件循环：listenfd是SO_REUSEPORT组中的任一socket，
+ * 组中第i个开始listen的socket属于绑定在loop_cpus[i]上的事件循环。
+ * 接收CPU上有事件循环时交给它，否则交给同一节点上的事件循环，都没有时由内核按哈希选择
+ */
+bool attach_rx_steering(int listenfd, const std::vector<int>& loop_cpus);
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 19:02:17
+ * @ Modified Time: 2026-10-19 19:02:17
+ * @ Description  : 按请求复用的线性内存分配器（bump arena）
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <new>
+
+/* 每个连接持有一个，请求处理过程中的临时数据都从这里分配，
+ * 请求结束时reset()一次性释放。申请过的内存块不归还给malloc，
+ * 热身之后处理请求不再产生堆分配
+ */
+class arena{
+public:
+    static const size_t BLOCK_SIZE = 4096;
+
+private:
+    struct block{
+        block* next;
+        size_t size;        /* 可用字节数，数据紧跟在结构体之后 */
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    block* m_blocks;        /* 已申请的内存块链表 */
+    block* m_current;       /* 当前正在使用的内存块 */
+    char* m_ptr;            /* 当前块中下一个可分配的位置 */
+    char* m_end;            /* 当前块的结尾 */
+
+public:
+    arena() : m_blocks(nullptr), m_current(nullptr), m_ptr(nullptr), m_end(nullptr) {}
+    ~arena() {
+        while(m_blocks) {
+            block* next = m_blocks->next;
+            free(m_blocks);
+            m_blocks = next;
+        }
+    }
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    /* 分配n字节，按8字节对齐 */
+    void* alloc(size_t n) {
+        n = (n + 7) & ~(size_t)7;
+        if(n > (size_t)(m_end - m_ptr)) {
+            next_block(n);
+        }
+        void* p = m_ptr;
+        m_ptr += n;
+        return p;
+    }
+
+    /* 复制长度为len的字符串，结尾补'\0' */
+    char* strndup(const char* s, size_t len) {
+        char* p = static_cast<char*>(alloc(len + 1));
+        memcpy(p, s, len);
+        p[len] = '\0';
+        return p;
+    }
+
+    /* 格式化字符串，先尝试直接写入当前块的剩余空间 */
+    char* printf(const char* format, ...) {
+        va_list arg_list;
+        va_start(arg_list, format);
+        size_t room = m_end - m_ptr;
+        int len = vsnprintf(m_ptr, room, format, arg_list);
+        va_end(arg_list);
+        if(len < 0) {
+            return nullptr;
+        }
+        if((((size_t)len + 8) & ~(size_t)7) <= room) {
+            return static_cast<char*>(alloc(len + 1));
+        }
+        char* p = static_cast<char*>(alloc(len + 1));
+        va_start(arg_list, format);
+        vsnprintf(p, len + 1, format, arg_list);
+        va_end(arg_list);
+        return p;
+    }
+
+    /* 释放本次请求分配的全部内存，内存块保留给下一个请求 */
+    void reset() {
+        m_current = m_blocks;
+        m_ptr = m_blocks ? m_blocks->data() : nullptr;
+        m_end = m_blocks ? m_ptr + m_blocks->size : nullptr;
+    }
+
+private:
+    /* 当前块空间不足：优先复用链表中的下一块，不够大时新申请一块插入其前 */
+    void next_block(size_t n) {
+        block* candidate = m_current ? m_current->next : m_blocks;
+        if(! candidate || candidate->size < n) {
+            size_t size = (n > BLOCK_SIZE) ? n : BLOCK_SIZE;
+            block* b = static_cast<block*>(malloc(sizeof(block) + size));
+            if(! b) {
+                throw std::bad_alloc();
+            }
+            b->size = size;
+            b->next = candidate;
+            if(m_current) {
+                m_current->next = b;
+            }
+            else {
+                m_blocks = b;
+            }
+            candidate = b;
+        }
+        m_current = candidate;
+        m_ptr = candidate->data();
+        m_end = m_ptr + candidate->size;
+    }
+};
+
+#endif
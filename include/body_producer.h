@@ -0,0 +1,33 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:58:12
+ * @ Modified Time: 2026-10-19 23:58:12
+ * @ Description  : 分块应答的消息体生产者 头文件
+ */
+
+#ifndef BODY_PRODUCER_H
+#define BODY_PRODUCER_H
+
+#include <cstddef>
+
+/* 长度事先未知的应答消息体，如目录项较多时分批生成的目录列表（listing_producer）。
+ * 发送端在socket可写时调用next()拉取下一段数据，数据的指针直接放入writev的iovec，不复制；
+ * TCP写缓冲已满时不再拉取，生产的速度受限于客户端接收的速度。
+ * next()可能在主线程中调用，不能阻塞，只能由已在内存中的数据生成；
+ * HTTP/2的流一次取出全部数据作为消息体。
+ * 对象由http_conn持有，应答结束或连接关闭时析构
+ */
+class body_producer{
+public:
+    enum STATUS {
+        PRODUCE_DATA,   /* data、len指向下一段数据，在下一次调用next()或析构之前保持有效 */
+        PRODUCE_END,    /* 消息体已结束 */
+        PRODUCE_ERROR   /* 出错，关闭连接 */
+    };
+
+    virtual ~body_producer() {}
+    virtual STATUS next(const char** data, size_t* len) = 0;
+};
+
+#endif
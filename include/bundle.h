@@ -0,0 +1,104 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 21:36:50
+ * @ Modified Time: 2026-10-19 21:36:50
+ * @ Description  : 静态资源归档 头文件，整个网站根目录打包为一个文件，启动时mmap一次
+ */
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using std::string;
+
+/* 归档文件格式（由webserver_pack生成）：
+ *   bundle_header
+ *   uint32_t disp[bucket_count]         完美哈希的位移表
+ *   uint32_t slots[slot_count]          槽位 -> entry下标，BUNDLE_EMPTY表示空槽
+ *   bundle_entry entries[entry_count]
+ *   路径及预先生成的应答头部
+ *   文件内容，每个都按页对齐，可以直接用于发送和mincore
+ * 所有整数均为小端序，偏移量均相对于文件开头
+ */
+#define BUNDLE_MAGIC "WSBNDL01"
+#define BUNDLE_EMPTY 0xFFFFFFFFu
+#define BUNDLE_ALIGN 4096
+
+#pragma pack(push, 1)
+struct bundle_header{
+    char magic[8];              /* BUNDLE_MAGIC */
+    uint32_t entry_count;
+    uint32_t bucket_count;
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint64_t disp_offset;
+    uint64_t slot_offset;
+    uint64_t entry_offset;
+    uint64_t file_size;         /* 归档文件的总大小，用于校验 */
+};
+
+/* 一种编码的应答：头部（Content-Length、Content-Type、ETag等，每行以\r\n结尾）及内容 */
+struct bundle_variant{
+    uint64_t header_offset;
+    uint64_t body_offset;
+    uint64_t body_size;
+    uint32_t header_len;
+    char etag[28];              /* 带引号的ETag，以'\0'结尾，用于比较If-None-Match */
+};
+
+struct bundle_entry{
+    uint64_t path_offset;       /* url路径，如"/index.html"，不以'\0'结尾 */
+    uint32_t path_len;
+    uint32_t flags;             /* BUNDLE_GZIP：有预先压缩的版本 */
+    bundle_variant identity;    /* 原始内容 */
+    bundle_variant gzip;        /* gzip压缩后的内容，flags中有BUNDLE_GZIP时有效 */
+};
+#pragma pack(pop)
+
+enum { BUNDLE_GZIP = 1 };
+
+/* 带种子的64位FNV-1a，最后混合一次使低位分布均匀 */
+inline uint64_t bundle_hash(const char* s, size_t len, uint32_t seed) {
+    uint64_t h = 14695981039346656037ull ^ ((uint64_t)seed * 0x9E3779B97F4A7C15ull);
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+/* 先用种子0选出桶，再用该桶的位移作为种子确定槽位，每个路径只需两次哈希和一次比较 */
+inline uint32_t bundle_slot(const char* path, size_t len, const uint32_t* disp,
+        uint32_t bucket_count, uint32_t slot_count) {
+    uint32_t bucket = bundle_hash(path, len, 0) % bucket_count;
+    return bundle_hash(path, len, disp[bucket]) % slot_count;
+}
+
+class bundle{
+private:
+    char* m_base;               /* 归档被mmap到内存的起始位置 */
+    size_t m_size;
+    const bundle_header* m_header;
+    const uint32_t* m_disp;
+    const uint32_t* m_slots;
+    const bundle_entry* m_entries;
+
+public:
+    bundle(const string& file);     /* 打开并mmap归档，格式不正确时抛出异常 */
+    ~bundle();
+    const bundle_entry* find(const char* path, size_t len) const;  /* 不存在时返回nullptr */
+    const char* at(uint64_t offset) const { return m_base + offset; }
+    uint32_t size() const { return m_header->entry_count; }
+};
+
+/* 未使用归档时为nullptr */
+extern bundle* bundle_;
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 16:02:27
+ * @ Modified Time: 2026-10-19 16:02:27
+ * @ Description  : 流量录制 头文件，记录客户端发来的原始请求数据，供webserver_replay回放
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <cstdint>
+#include <string>
+#include "locker.h"
+#include "timer.h"
+
+using std::string;
+
+/* 录制文件格式：
+ *   文件头  capture_header
+ *   记录    capture_record + len字节数据，依次排列
+ * 所有整数均为小端序
+ */
+#define CAPTURE_MAGIC "WSCAP001"
+
+#pragma pack(push, 1)
+struct capture_header{
+    char magic[8];          /* CAPTURE_MAGIC */
+    uint64_t start_time;    /* 开始录制的系统时间（us） */
+};
+
+struct capture_record{
+    uint64_t time;          /* 相对开始录制的时间（us） */
+    uint32_t conn_id;       /* 连接编号 */
+    uint32_t len;           /* 数据长度，仅DATA记录非0 */
+    uint8_t type;           /* 记录类型，见capture::TYPE */
+};
+#pragma pack(pop)
+
+class capture{
+public:
+    enum TYPE { OPEN = 1, DATA, CLOSE };
+
+private:
+    locker m_lock;          /* 互斥锁，read()和close_conn()可能在不同线程调用 */
+    locker m_flush_lock;    /* 保证各次写文件按顺序进行 */
+    string m_buf;           /* 缓冲区，攒够一定数据后再写文件 */
+    int m_fd;               /* 录制文件 文件描述符 */
+    uint64_t m_start;       /* 开始录制的单调时钟时间（us） */
+    uint64_t m_written;     /* 已录制的字节数 */
+    uint64_t m_limit;       /* 录制文件大小上限，超过后停止录制 */
+    my_timer* m_timer;      /* 定时器,定时将缓冲区写入文件 */
+
+public:
+    capture(const string& file, uint64_t limit);
+    ~capture();
+    void add(uint32_t conn_id, TYPE type, const char* data = nullptr, uint32_t len = 0);
+    void flush();           /* 将缓冲区的数据写入文件 */
+    void set_expire(int delay);     /* 更新定时器过期时间 */
+};
+
+/* 未开启录制时为nullptr */
+extern capture* capture_;
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 20:41:32
+ * @ Modified Time: 2026-10-19 20:41:32
+ * @ Description  : 基于排队时间的准入控制（CoDel）
+ */
+
+#ifndef CODEL_H
+#define CODEL_H
+
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+
+/* 单调时钟（ns） */
+inline uint64_t codel_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* CoDel：任务在队列中的等待时间持续超过target达interval之久，说明队列
+ * 已经无法自然排空，进入丢弃状态，之后按interval/sqrt(count)的间隔拒绝任务，
+ * 直到等待时间回落到target以下。短时的突发不会触发拒绝。
+ * 不是线程安全的，由调用者加锁（threadpool在出队时持有队列锁）
+ */
+class codel{
+private:
+    uint64_t m_target;          /* 可接受的排队时间（ns） */
+    uint64_t m_interval;        /* 观察窗口（ns） */
+    uint64_t m_first_above;     /* 排队时间超过target后，窗口结束的时刻，0表示未超过 */
+    uint64_t m_drop_next;       /* 丢弃状态下，下一次拒绝的时刻 */
+    uint32_t m_count;           /* 本次丢弃状态中已拒绝的任务数 */
+    uint32_t m_last_count;
+    bool m_dropping;            /* 是否处于丢弃状态 */
+    uint64_t m_drops;           /* 累计拒绝的任务数 */
+
+public:
+    codel(uint64_t target_ns, uint64_t interval_ns) : m_target(target_ns), m_interval(interval_ns),
+        m_first_above(0), m_drop_next(0), m_count(0), m_last_count(0), m_dropping(false), m_drops(0) {}
+
+    /* 任务出队时调用，sojourn为其排队时间，返回true表示应拒绝该任务 */
+    bool should_drop(uint64_t sojourn, uint64_t now) {
+        bool ok_to_drop = over_target(sojourn, now);
+        if (m_dropping) {
+            if (! ok_to_drop) {
+                m_dropping = false;
+                return false;
+            }
+            if (now >= m_drop_next) {
+                ++m_count;
+                m_drop_next = control_law(m_drop_next);
+                ++m_drops;
+                return true;
+            }
+            return false;
+        }
+        if (ok_to_drop) {
+            m_dropping = true;
+            /* 距上次丢弃状态不久，沿用之前的拒绝频率 */
+            uint32_t delta = m_count - m_last_count;
+            m_count = (delta > 1 && now - m_drop_next < 16 * m_interval) ? delta : 1;
+            m_last_count = m_count;
+            m_drop_next = control_law(now);
+            ++m_drops;
+            return true;
+        }
+        return false;
+    }
+    bool dropping() const { return m_dropping; }
+    uint64_t drops() const { return m_drops; }
+
+private:
+    bool over_target(uint64_t sojourn, uint64_t now) {
+        if (sojourn < m_target) {
+            m_first_above = 0;
+            return false;
+        }
+        if (m_first_above == 0) {
+            m_first_above = now + m_interval;
+            return false;
+        }
+        return now >= m_first_above;
+    }
+    uint64_t control_law(uint64_t t) const {
+        return t + (uint64_t)(m_interval / std::sqrt((double)m_count));
+    }
+};
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 13:20:44
+ * @ Modified Time: 2026-10-19 13:20:44
+ * @ Description  : 服务器运行参数 头文件
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+#include <vector>
+
+using std::string;
+
+class config{
+public:
+    int port;               /* 监听端口 */
+    bool daemon;            /* 是否以守护进程方式运行 */
+    string doc_root;        /* 网站根目录 */
+    string bundle_file;     /* 静态资源归档，不为空时只从归档中提供文件 */
+    int thread_number;      /* 线程池中的线程数 */
+    string capture_file;    /* 流量录制文件，为空时不录制 */
+    long capture_limit;     /* 录制文件大小上限（MB） */
+    bool trace;             /* 启动时是否开启请求追踪 */
+    int trace_sample;       /* 每N个请求采样一个 */
+    int trace_slow;         /* 耗时超过该值（us）的请求总是记录，0表示关闭 */
+    string trace_file;      /* 追踪结果输出文件 */
+    bool direct_write;      /* 由工作线程直接发送应答，而不是交给主线程 */
+    long cache_size;        /* 小文件缓存的容量（MB），0表示不缓存 */
+    long cache_max_file;    /* 可缓存的单个文件大小上限（KB） */
+    int io_threads;         /* 预读文件的I/O线程数，0表示不检查文件是否在内存中 */
+    int codel_target;       /* 可接受的排队时间（ms），0表示不做准入控制 */
+    int codel_interval;     /* 排队时间持续超过target多久后开始拒绝请求（ms） */
+    long bulk_size;         /* 应答达到该大小（KB）时视为大文件，以较低优先级处理，0表示不区分 */
+    long write_quantum;     /* 每个连接每次最多发送的字节数（KB），0表示不限制 */
+    std::vector<string> index_files;    /* 请求目录时依次尝试的index文件 */
+    bool autoindex;         /* 目录中没有index文件时是否返回目录列表 */
+    int keepalive_timeout;  /* 长连接空闲多久（s）后关闭，0表示不保持连接 */
+    int keepalive_requests; /* 一个连接上最多处理的请求数，0表示不限制 */
+    long upload_max;        /* PUT、POST上传的消息体大小上限（MB），0表示不允许上传 */
+    bool h2c;               /* 是否接受明文HTTP/2（连接序言或Upgrade: h2c） */
+    int h2_streams;         /* 一个HTTP/2连接上同时打开的流数上限（SETTINGS_MAX_CONCURRENT_STREAMS） */
+    int tls_port;           /* TLS监听端口，0表示不监听 */
+    string tls_cert;        /* PEM格式的证书链 */
+    string tls_key;         /* PEM格式的私钥，为空时从tls_cert中读取 */
+    std::vector<string> proxy_routes;   /* 反向代理的路由，每项为"前缀=host:port[,host:port...]" */
+    int proxy_idle;         /* 每个上游保留的空闲长连接数 */
+    int proxy_timeout;      /* 转发中的请求多久（s）没有进展时关闭，0表示不限制 */
+    string proxy_check;     /* 健康检查请求的路径，为空时只检查能否建立连接 */
+    string status_path;     /* 返回服务器统计信息的路径，为空时不开启 */
+    int conn_limit;         /* 每个客户端IP同时打开的连接数上限，0表示不限制 */
+    int rate_limit;         /* 每个客户端IP每秒的请求数上限，0表示不限制 */
+    int rate_burst;         /* 每个客户端IP允许的突发请求数（令牌桶的容量） */
+    int event_loops;        /* 事件循环（epoll线程）数，大于1时各自以SO_REUSEPORT监听同一端口 */
+    std::vector<int> cpu_affinity;  /* 依次绑定事件循环与工作线程的CPU，为空时不绑定 */
+    int spin_us;            /* 空闲的工作线程与事件循环阻塞前自旋的最长时间（us），0表示直接阻塞 */
+
+public:
+    config();
+    bool parse(int argc, char* argv[]);     /* 解析命令行参数，失败时打印用法并返回false */
+    void usage(const char* prog) const;
+};
+
+extern config* config_;
+
+#endif
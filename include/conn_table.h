@@ -0,0 +1,80 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:57
+ * @ Modified Time: 2026-10-19 23:59:57
+ * @ Description  : 连接表：按需分配的http_conn池及epoll事件的世代标记 头文件
+ */
+
+#ifndef CONN_TABLE_H
+#define CONN_TABLE_H
+
+#include <cstdint>
+#include <vector>
+#include "locker.h"
+#include "http_conn.h"
+
+/* 每个事件循环一个连接表。客户连接的http_conn按块分配，关闭后放回空闲链表，与fd无关；
+ * 块的内存优先分配在事件循环所在的NUMA节点上。
+ * epoll事件的data不再是fd，而是对象的地址加上对象的世代：
+ *   位0~47为http_conn的地址，位48~62为世代的低15位，位63为UPSTREAM_TAG。
+ * 连接关闭时世代加1，之后取出的该连接的事件（已在本轮events中，或fd被新连接复用）
+ * 世代不相等，由resolve()丢弃，不会作用在复用该对象或该fd的新连接上。
+ * 分配只在所属的事件循环中进行；释放可能在工作线程中进行，由锁保护空闲链表
+ */
+class conn_table{
+public:
+    static const int BLOCK_SLOTS = 256;     /* 每次分配的http_conn个数 */
+    static const int GEN_SHIFT = 48;
+    static const uint64_t GEN_MASK = 0x7fff;
+    static const uint64_t ADDR_MASK = ((uint64_t)1 << GEN_SHIFT) - 1;
+    /* 事件来自该客户连接的反向代理的上游连接 */
+    static const uint64_t UPSTREAM_TAG = (uint64_t)1 << 63;
+
+private:
+    int m_epollfd;                      /* 所属事件循环的epoll，分配出的连接都注册在上面 */
+    int m_node;                         /* 块的内存所在的NUMA节点，-1表示不指定 */
+    std::vector<http_conn*> m_blocks;
+    std::vector<http_conn*> m_free;     /* 已关闭的连接，由m_lock保护 */
+    locker m_lock;
+
+public:
+    conn_table(int epollfd, int node = -1) : m_epollfd(epollfd), m_node(node) {}
+    ~conn_table();
+    conn_table(const conn_table&) = delete;
+    conn_table& operator=(const conn_table&) = delete;
+
+    /* 事件循环在accept后调用，取一个空闲的http_conn，内存不足时抛出异常 */
+    http_conn* acquire();
+    /* close_conn()的最后调用，之后conn随时可能被所属的事件循环复用 */
+    void release(http_conn* conn);
+
+    /* conn当前世代的事件data */
+    static uint64_t key(const http_conn* conn) {
+        return (uint64_t)(uintptr_t)conn | ((uint64_t)(conn->generation() & GEN_MASK) << GEN_SHIFT);
+    }
+    /* 由事件的data找到连接，连接已关闭（世代不同）时返回nullptr；只在所属的事件循环中调用 */
+    static http_conn* resolve(uint64_t data) {
+        http_conn* conn = reinterpret_cast<http_conn*>((uintptr_t)(data & ADDR_MASK));
+        if(((data >> GEN_SHIFT) & GEN_MASK) != (conn->generation() & GEN_MASK)){
+            return nullptr;
+        }
+        return conn;
+    }
+
+    /* 遍历等待事件的连接，只在所属的事件循环中调用。空闲的槽位及正被工作线程处理的连接
+     * （m_waiting为false）被跳过：它们的所有者不是事件循环，f不能读取或关闭它们
+     */
+    template< typename F >
+    void for_each(F f) {
+        for(http_conn* block : m_blocks){
+            for(int i = 0; i < BLOCK_SLOTS; ++i){
+                if(block[i].parked()){
+                    f(block[i]);
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:41:27
+ * @ Modified Time: 2026-10-19 23:41:27
+ * @ Description  : 目录请求的处理方式缓存 头文件
+ */
+
+#ifndef DIR_INDEX_H
+#define DIR_INDEX_H
+
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#include "locker.h"
+#include "file_cache.h"
+#include "body_producer.h"
+
+using std::string;
+
+/* 一个目录的处理方式，由目录的mtime决定：目录中增删文件时mtime会变化 */
+struct dir_entry{
+    enum KIND {
+        INDEX,          /* 返回目录中的index文件 */
+        LISTING,        /* 返回生成好的目录列表 */
+        STREAMED,       /* 目录项较多，目录列表在应答时由listing_producer分块生成 */
+        FORBIDDEN       /* 没有index文件且未开启目录列表 */
+    };
+    KIND kind;
+    string index;               /* INDEX：index文件的完整路径 */
+    cache_entry_ptr listing;    /* LISTING：目录列表页，与缓存的文件一样带有预先生成的应答头部 */
+    std::vector<std::pair<string, bool>> names;     /* STREAMED：排好序的文件名及是否为目录 */
+    struct timespec mtime;      /* 精确到纳秒，同一秒内的多次修改也能发现 */
+    ino_t ino;
+    std::atomic<time_t> checked;    /* 上次stat校验的时间 */
+
+    dir_entry() : kind(FORBIDDEN), mtime{0, 0}, ino(0), checked(0) {}
+};
+
+typedef std::shared_ptr<dir_entry> dir_entry_ptr;
+
+/* 记住每个目录的处理方式，同一目录每秒最多stat一次，
+ * 目录列表在目录的mtime变化时才重新生成
+ */
+class dir_index{
+public:
+    static const size_t MAX_DIRS = 4096;    /* 记录的目录数上限，超过时全部丢弃 */
+    static const size_t STREAM_ENTRIES = 1024;  /* 目录项超过该数目时不生成整个页面，改为分块生成 */
+
+private:
+    locker m_lock;
+    std::unordered_map<string, dir_entry_ptr> m_dirs;   /* 目录路径（不以'/'结尾） -> 处理方式 */
+    std::vector<string> m_index_files;      /* 依次尝试的index文件名 */
+    bool m_autoindex;                       /* 没有index文件时是否返回目录列表 */
+
+public:
+    dir_index(const std::vector<string>& index_files, bool autoindex);
+
+    /* 只查找内存，可以在主线程中调用；本秒内校验过的目录才算命中 */
+    bool get(const char* dir, dir_entry_ptr& entry);
+    /* 由工作线程调用，st为调用者已经获取的目录状态，url为请求中以'/'结尾的路径，用于目录列表的标题；
+     * 目录未变化时只更新校验时间，否则查找index文件或重新生成目录列表
+     */
+    dir_entry_ptr resolve(const char* dir, const struct stat& st, const char* url);
+    void clear();
+
+private:
+    static cache_entry_ptr render(const dir_entry& entry, const string& dir, const char* url);
+};
+
+/* 按STREAMED的目录项分批生成目录列表页，只读取内存中的文件名，不访问磁盘，可以在主线程中调用 */
+class listing_producer : public body_producer{
+public:
+    static const size_t BATCH = 64;     /* 每个分块中的目录项数 */
+
+private:
+    dir_entry_ptr m_dir;        /* 持有目录项，文件名在应答结束之前保持有效 */
+    string m_title;
+    size_t m_next;              /* 下一个要生成的目录项，超过names.size()表示页尾已生成 */
+    bool m_head;                /* 页头已生成 */
+    string m_buf;               /* 当前分块，下一次调用next()时覆盖 */
+
+public:
+    listing_producer(const dir_entry_ptr& dir, const char* url);
+    STATUS next(const char** data, size_t* len) override;
+};
+/* 使用归档时为nullptr */
+extern dir_index* dir_index_;
+
+#endif
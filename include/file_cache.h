@@ -0,0 +1,123 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 19:48:06
+ * @ Modified Time: 2026-10-19 19:48:06
+ * @ Description  : 小文件内容缓存 头文件
+ */
+
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "locker.h"
+#include "slab.h"
+#include "timer.h"
+
+using std::string;
+
+/* 缓存的一个文件，内容只读，由shared_ptr管理：
+ * 被淘汰时正在发送它的连接仍持有引用，发送完毕后才释放
+ */
+struct cache_entry{
+    string path;            /* 文件的完整路径 */
+    char* chunk;            /* 从slab_pool分配的内存，依次存放应答头部和文件内容 */
+    size_t chunk_size;      /* 实际占用的大小，计入缓存容量 */
+    slab_pool* pool;        /* chunk的来源，为nullptr时由new[]分配 */
+    const char* headers;    /* 预先生成的Content-Length、Last-Modified、Content-Type */
+    uint32_t header_len;
+    char* data;             /* 文件内容 */
+    size_t size;            /* 文件大小 */
+    time_t mtime;           /* 最后修改时间 */
+    ino_t ino;              /* inode编号，文件被替换时会变化 */
+    char last_modified[32]; /* 格式化好的Last-Modified */
+    bool watched;           /* 文件的修改会通过inotify通知，命中时不需要校验 */
+    std::atomic<time_t> checked;    /* 上次stat校验的时间 */
+
+    cache_entry() : chunk(nullptr), chunk_size(0), pool(nullptr), headers(nullptr), header_len(0),
+        data(nullptr), size(0), mtime(0), ino(0), watched(false), checked(0) { last_modified[0] = '\0'; }
+    ~cache_entry() {
+        if(pool) {
+            pool->free(chunk);
+        }
+        else {
+            delete [] chunk;
+        }
+    }
+};
+
+typedef std::shared_ptr<cache_entry> cache_entry_ptr;
+
+/* 缓存的统计信息，定时写入日志 */
+struct cache_stats{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;       /* 被接纳进入主区的文件数 */
+    uint64_t rejects;       /* 访问频率不如主区中被淘汰者而未被接纳的文件数 */
+    uint64_t evictions;     /* 因容量不足被淘汰的文件数 */
+    uint64_t invalidations; /* 因文件变化被删除的文件数 */
+    size_t bytes;           /* 当前占用的字节数 */
+    size_t entries;
+};
+
+/* 按路径的哈希分为SHARD_COUNT个分片，每个分片有独立的锁及W-TinyLFU淘汰策略：
+ * 新文件先进入约占1%容量的窗口区（LRU），被挤出窗口时与主区（分段LRU：试用区+保护区）
+ * 中即将被淘汰的文件比较访问频率（Count-Min Sketch估计），频率更高才被接纳，
+ * 一次性的扫描或只访问一次的文件不会挤掉热点文件
+ */
+class file_cache{
+public:
+    static const int SHARD_COUNT = 16;
+    static const size_t MAX_HEADER = 256;   /* 预先生成的应答头部的最大长度 */
+
+private:
+    struct shard;
+
+    std::vector<shard*> m_shards;
+    slab_pool* m_pool;                      /* 文件内容使用的内存池，预留失败时为nullptr */
+    size_t m_capacity;                      /* 缓存的总字节数上限 */
+    size_t m_max_file;                      /* 可缓存的单个文件大小上限 */
+    std::atomic<bool> m_watched;            /* 网站根目录是否由inotify监视 */
+    std::atomic<uint64_t> m_generation;     /* 每次失效加1，读取文件期间发生失效时不加入缓存 */
+    string m_root;                          /* 网站根目录 */
+    string m_real_root;                     /* 网站根目录解析符号链接后的路径 */
+    my_timer* m_timer;                      /* 定时器，定时将统计信息写入日志 */
+
+public:
+    file_cache(size_t capacity, size_t max_file);
+    ~file_cache();
+
+    /* 查找path，命中时entry指向缓存项并返回true；网站根目录由inotify监视时
+     * 命中不需要任何系统调用，否则每个缓存项每秒最多stat一次，文件已修改或被删除时视为未命中
+     */
+    bool get(const char* path, cache_entry_ptr& entry);
+    /* 读取文件内容加入缓存，st为调用者已经获取的文件状态，content_type用于生成应答头部；
+     * 文件过大或读取失败时返回false，由调用者mmap
+     */
+    bool load(const char* path, const struct stat& st, const char* content_type, cache_entry_ptr& entry);
+    size_t max_file() const { return m_max_file; }
+    bool huge_pages() const { return m_pool && m_pool->huge(); }
+    cache_stats stats() const;
+    void report() const;        /* 将统计信息写入日志 */
+    void set_expire(int delay); /* 更新定时器过期时间 */
+
+    /* 下面一组函数由fs_watch调用 */
+    void watch(const string& root);     /* 之后加入的root下的文件不再定时校验，需在开始处理请求前调用 */
+    void unwatch() { m_watched = false; }   /* 部分目录无法监视，之后加入的文件恢复定时校验 */
+    void invalidate(const string& path);        /* 文件被修改、移动或删除 */
+    void invalidate_tree(const string& dir);    /* 目录被移动或删除，其下的文件全部失效 */
+    void clear();           /* 事件丢失后无法确定哪些文件变化了，清空缓存 */
+
+private:
+    shard* shard_of(size_t hash) const { return m_shards[hash % SHARD_COUNT]; }
+};
+
+/* 未开启缓存时为nullptr */
+extern file_cache* file_cache_;
+
+#endif
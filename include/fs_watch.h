@@ -0,0 +1,54 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 22:24:38
+ * @ Modified Time: 2026-10-19 22:24:38
+ * @ Description  : 监视网站根目录，文件变化时使缓存失效 头文件
+ */
+
+#ifndef FS_WATCH_H
+#define FS_WATCH_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <pthread.h>
+#include "file_cache.h"
+
+using std::string;
+
+/* 用inotify递归监视网站根目录，由独立线程读取事件：
+ * 文件被修改、移动或删除时从缓存中删除对应的缓存项，目录被移动或删除时删除其下全部缓存项；
+ * 内核事件队列溢出（IN_Q_OVERFLOW）或一批事件过多时，重新添加监视并清空缓存
+ */
+class fs_watch{
+public:
+    static const size_t MAX_PENDING = 256;  /* 一批事件合并后最多处理的路径数，超过时全量重新扫描 */
+
+private:
+    int m_fd;                               /* inotify实例 */
+    string m_root;
+    file_cache* m_cache;
+    std::unordered_map<int, string> m_dirs; /* 监视描述符 -> 目录路径，只由监视线程访问 */
+    std::vector<string> m_files;            /* 本批事件中失效的文件 */
+    std::vector<string> m_trees;            /* 本批事件中失效的目录 */
+    bool m_rescan;                          /* 本批事件处理完后需要全量重新扫描 */
+    pthread_t m_thread;
+
+public:
+    fs_watch(const string& root, file_cache* cache);    /* 添加监视并启动线程，失败时抛出异常 */
+    ~fs_watch();
+
+private:
+    static void* worker(void* arg);
+    void run();
+    bool add_tree(const string& dir);       /* 递归监视dir及其子目录 */
+    void remove_tree(const string& dir);    /* 目录被移出时取消其下的监视 */
+    void handle(const struct inotify_event* ev);
+    void flush();                           /* 应用本批事件 */
+};
+
+/* 未开启缓存或使用归档时为nullptr */
+extern fs_watch* fs_watch_;
+
+#endif
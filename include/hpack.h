@@ -0,0 +1,61 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:12
+ * @ Modified Time: 2026-10-19 23:59:12
+ * @ Description  : HPACK头部压缩（RFC 7541） 头文件
+ */
+
+#ifndef HPACK_H
+#define HPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+using std::string;
+
+struct hpack_header{
+    string name;
+    string value;
+};
+
+/* 解码客户端发来的头部块：静态表、动态表及Huffman编码的字符串。
+ * 动态表的状态在整个连接上延续，头部块必须按收到的顺序全部解码，
+ * 即使对应的流被拒绝也不能跳过
+ */
+class hpack_decoder{
+public:
+    static const size_t TABLE_SIZE = 4096;  /* SETTINGS_HEADER_TABLE_SIZE，使用默认值 */
+
+private:
+    std::deque<hpack_header> m_table;   /* 动态表，新加入的在前 */
+    size_t m_size;          /* 动态表当前的大小（每项为名称+值+32） */
+    size_t m_max_size;      /* 编码方通过动态表大小更新设置的上限，不超过TABLE_SIZE */
+
+public:
+    hpack_decoder() : m_size(0), m_max_size(TABLE_SIZE) {}
+
+    /* 解码一个完整的头部块，结果追加到headers；格式错误时返回false，应以COMPRESSION_ERROR关闭连接 */
+    bool decode(const uint8_t* data, size_t len, std::vector<hpack_header>& headers);
+
+private:
+    bool lookup(uint64_t index, const hpack_header*& header) const;
+    void insert(const string& name, const string& value);
+    void evict(size_t max_size);
+};
+
+/* 编码应答头部，不使用动态表，不需要跟踪客户端的SETTINGS_HEADER_TABLE_SIZE */
+void hpack_encode_status(string& out, int status);
+/* name须为小写；名称在静态表中时只编码索引，值较短时使用Huffman编码 */
+void hpack_encode_header(string& out, const char* name, size_t name_len, const char* value, size_t value_len);
+
+/* Huffman解码，EOS或填充不合法时返回false */
+bool huffman_decode(const uint8_t* data, size_t len, string& out);
+/* Huffman编码后的长度（字节） */
+size_t huffman_length(const char* data, size_t len);
+void huffman_encode(const char* data, size_t len, string& out);
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:40
+ * @ Modified Time: 2026-10-19 23:59:40
+ * @ Description  : 明文HTTP/2（h2c） 头文件
+ */
+
+#ifndef HTTP2_H
+#define HTTP2_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/uio.h>
+#include "hpack.h"
+#include "http_conn.h"
+
+class h2_stream;
+
+/* 一个流上的请求，由HPACK解码的头部或升级前的HTTP/1.1请求得到 */
+struct h2_request{
+    const char* method;
+    const char* path;               /* 未解码的原始路径 */
+    const char* authority;
+    const char* if_modified_since;
+    const char* if_none_match;
+    bool accept_gzip;
+
+    h2_request() : method(nullptr), path(nullptr), authority(nullptr), if_modified_since(nullptr),
+        if_none_match(nullptr), accept_gzip(false) {}
+};
+
+/* 一个HTTP/2连接，由http_conn持有，只在工作线程中执行（同一时刻只有一个线程，EPOLLONESHOT）。
+ * 每个流的请求交给一个http_conn的子类，与HTTP/1.1走相同的查找、缓存、mmap及应答填充流程，
+ * 生成的HTTP/1.1头部转换为HPACK，消息体（文件内容或缓存项）直接作为DATA帧的iovec发送，不复制；
+ * 多个流的DATA帧轮流发送，受连接及各个流的发送窗口限制
+ */
+class h2_session{
+public:
+    static const size_t FRAME_HEADER = 9;
+    static const uint32_t MAX_FRAME = 16384;        /* SETTINGS_MAX_FRAME_SIZE，使用默认值 */
+    static const size_t MAX_HEADER_BLOCK = 65536;   /* 一个头部块（含CONTINUATION）的大小上限 */
+    static const int MAX_IOV = 33;                  /* 一次writev：控制帧 + 16个DATA帧（帧头+数据） */
+    static const int MAX_LOOPS = 16;                /* 一次处理中最多读取的次数，之后交还给epoll */
+    static const size_t PREFACE_LEN = 24;
+    static const char PREFACE[PREFACE_LEN + 1];     /* 客户端的连接序言 */
+
+    /* 帧类型 */
+    enum FRAME_TYPE { DATA = 0, HEADERS, PRIORITY, RST_STREAM, SETTINGS, PUSH_PROMISE, PING, GOAWAY,
+        WINDOW_UPDATE, CONTINUATION };
+    /* 错误码 */
+    enum ERROR_CODE { NO_ERROR = 0, PROTOCOL_ERROR, INTERNAL_ERROR, FLOW_CONTROL_ERROR, SETTINGS_TIMEOUT,
+        STREAM_CLOSED, FRAME_SIZE_ERROR, REFUSED_STREAM, CANCEL, COMPRESSION_ERROR, CONNECT_ERROR,
+        ENHANCE_YOUR_CALM };
+
+private:
+    http_conn& m_conn;
+
+    /* 接收 */
+    std::vector<char> m_in;     /* 读缓冲，至少能容纳一个最大的帧 */
+    size_t m_in_len;
+    bool m_preface;             /* 已收到客户端的连接序言 */
+    bool m_settings;            /* 已收到客户端的第一个SETTINGS帧 */
+    uint32_t m_last_stream;     /* 客户端打开过的最大流编号 */
+    uint32_t m_header_stream;   /* 正在等待CONTINUATION的流，0表示没有 */
+    uint8_t m_header_flags;     /* 该头部块所在HEADERS帧的标志 */
+    string m_header_block;
+    hpack_decoder m_decoder;
+    std::vector<hpack_header> m_headers;
+
+    /* 流 */
+    std::unordered_map<uint32_t, h2_stream*> m_streams;     /* 打开的流 */
+    std::deque<h2_stream*> m_ready;         /* 有数据待发送且窗口未用完的流，轮流发送 */
+    std::vector<h2_stream*> m_finished;     /* 已结束的流，所在的writev批次发送完毕后才释放 */
+    std::vector<h2_stream*> m_free;         /* 复用的流对象 */
+
+    /* 发送 */
+    string m_out;               /* 待发送的控制帧及HEADERS帧 */
+    size_t m_out_batched;       /* m_out中已放入当前批次的字节数，之后追加的帧在下一批次发送 */
+    struct iovec m_iov[MAX_IOV];
+    int m_iov_count;
+    int m_iov_pos;              /* 当前批次中第一个未发送完的iovec */
+    char m_heads[MAX_IOV / 2][FRAME_HEADER];    /* 当前批次中DATA帧的帧头 */
+    long m_send_window;         /* 连接的发送窗口 */
+    long m_initial_window;      /* 客户端的SETTINGS_INITIAL_WINDOW_SIZE */
+    uint32_t m_peer_max_frame;  /* 客户端的SETTINGS_MAX_FRAME_SIZE */
+    bool m_goaway;              /* 已收到GOAWAY，不再有新的流，全部发送完后关闭 */
+    bool m_closing;             /* 已发送GOAWAY，发送完后关闭 */
+
+public:
+    explicit h2_session(http_conn& conn);
+    ~h2_session();
+
+    /* 通过连接序言（prior knowledge）开始，data为读缓冲中已收到的数据（含序言） */
+    void start(const char* data, size_t len);
+    /* 通过Upgrade: h2c开始：settings为HTTP2-Settings字段，升级前的请求作为流1，
+     * data为读缓冲中该请求之后已收到的数据；settings不合法时返回false
+     */
+    bool upgrade(const char* settings, const h2_request& request, const char* data, size_t len);
+    /* 发送待发送的数据并处理收到的帧，返回false时由调用者关闭连接 */
+    bool process();
+
+private:
+    http_conn::WRITE_STATUS flush();    /* 发送直到没有数据、TCP写缓冲已满或用完write_quantum */
+    bool fill();                        /* 组织下一个writev批次，没有可发送的数据时返回false */
+    void finish_batch();
+    void add_settings();                /* 服务器的连接序言 */
+    bool has_output() const { return ! m_out.empty() || (m_send_window > 0 && ! m_ready.empty()); }
+    long receive();                     /* 读取直到EAGAIN或读缓冲已满，返回读取的字节数，连接已断开时返回-1 */
+    bool parse();                       /* 处理读缓冲中所有完整的帧，连接级错误时返回false */
+    bool on_frame(uint8_t type, uint8_t flags, uint32_t id, const uint8_t* payload, uint32_t len);
+    bool on_headers(uint32_t id, uint8_t flags, const uint8_t* payload, uint32_t len);
+    bool on_header_block(uint32_t id, uint8_t flags);
+    bool on_settings(const uint8_t* payload, uint32_t len);
+    bool on_window_update(uint32_t id, const uint8_t* payload, uint32_t len);
+
+    h2_stream* open_stream(uint32_t id);
+    void serve(h2_stream* stream);      /* 处理请求并加入HEADERS帧，请求已由prepare()转换 */
+    void close_stream(h2_stream* stream);
+    void reset_stream(uint32_t id, uint32_t code);
+    void frame_header(char* out, uint32_t len, uint8_t type, uint8_t flags, uint32_t id) const;
+    void add_frame(uint8_t type, uint8_t flags, uint32_t id, const char* payload, uint32_t len);
+    void add_window_update(uint32_t id, uint32_t increment);
+    bool error(uint32_t code);          /* 发送GOAWAY，返回false */
+};
+
+#endif
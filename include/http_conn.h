@@ -10,11 +10,13 @@
 #define HTTPCONNECTION_H
 
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstdarg>
+#include <atomic>
 #include <string>
 
 #include <strings.h>
@@ -32,21 +34,59 @@
 #include <arpa/inet.h>
 
 #include "locker.h"
+#include "arena.h"
+#include "file_cache.h"
+#include "bundle.h"
+#include "dir_index.h"
+#include "body_producer.h"
+#include "tls.h"
+#include "trace.h"
 
+template< typename T > class threadpool;
+class h2_session;
+class proxy_session;
+struct proxy_route;
+class route_handler;
+struct limit_slot;
+class conn_table;
+
+/* url编码/解码，用于支持中文文件名 */
+std::string urlEncode(const std::string& str);
+std::string urlDecode(const std::string& str);
+/* 将in解码到out（长度不超过in），格式错误时返回-1，否则返回解码后的长度 */
+int urlDecode(const char* in, char* out);
+/* 将in编码到out（长度至少为in的3倍加1），返回编码后的长度，'/'不编码 */
+int urlEncode(const char* in, char* out);
+/* 原地规范化以'/'开头的路径：合并连续的'/'，去掉"."，".."回到上一级，越过根目录时返回false */
+bool normalizePath(char* path);
+
+/* 连接的socket读写由http_conn自身负责，请求解析与应答填充只操作
+ * 读写缓冲区，不依赖socket，可通过feed()灌入数据后单独调用（见bench/）
+ */
 class http_conn{
 public:
     static const int FILENAME_LEN = 200;            /* 文件名的最大长度 */
     static const int READ_BUF_SIZE = 2048;       /* 读缓冲区的大小 */
     static const int WRITE_BUF_SIZE = 1024;      /* 写缓冲区的大小 */
     
-    /* HTTP请求方法，目前只支持GET */
+    /* HTTP请求方法，目前支持GET，以及开启上传时的PUT、POST */
     enum METHOD { GET = 0, POST, HEAD, PUT, DELETE, TRACE, OPTIONS, CONNECT, PATCH };
     
     /* 解析客户请求时，主状态机所处状态 */
     enum CHECK_STATE {  
         CHECK_STATE_REQUESTLINE = 0,    /* 正在分析请求行 */
         CHECK_STATE_HEADER,             /* 正在分析头部字段 */
-        CHECK_STATE_CONTENT 
+        CHECK_STATE_CONTENT,
+        CHECK_STATE_BODY                /* 正在将上传的消息体写入文件 */
+    };
+
+    /* 接收上传的消息体时所处的状态 */
+    enum BODY_STATE {
+        BODY_DATA,          /* 正在接收数据（Content-Length的消息体或一个分块） */
+        CHUNK_SIZE,         /* 等待分块的大小行 */
+        CHUNK_CRLF,         /* 等待分块数据之后的空行 */
+        CHUNK_TRAILER,      /* 等待最后一个分块之后的trailer，以空行结束 */
+        BODY_DONE
     };
 
     /* 服务器处理HTTP请求的结果 */
@@ -57,7 +97,19 @@ public:
         NO_RESOURCE,            /* 目标文件不存在 */
         FORBIDDEN_REQUEST,      /* 访问权限不足 */
         FILE_REQUEST,           /* GET方法资源请求 */
+        NOT_MODIFIED,           /* 目标文件在If-Modified-Since之后未被修改 */
+        MOVED_PERMANENTLY,      /* 请求的目录不以'/'结尾，重定向到以'/'结尾的url */
+        CREATED,                /* 上传的文件已保存 */
+        METHOD_NOT_ALLOWED,     /* 路径不接受该方法，如未开启上传时的PUT、POST，文件的DELETE */
+        PAYLOAD_TOO_LARGE,      /* 上传的消息体超过upload_max */
+        TOO_MANY_REQUESTS,      /* 客户端IP的请求速率超过限制 */
+        STREAM_REQUEST,         /* 消息体由m_producer分块生成，长度事先未知 */
+        CONTENT_REQUEST,        /* 应答由路由的处理器通过respond()给出 */
+        SWITCH_PROTOCOLS,       /* 切换到HTTP/2（连接序言或Upgrade: h2c） */
+        PROXY_REQUEST,          /* 路径属于反向代理的路由，应答来自上游 */
+        PENDING_REQUEST,        /* 缓存未命中，需要访问磁盘，交给线程池继续处理 */
         INTERNAL_ERROR,         /* 服务器内部错误 */
+        BAD_GATEWAY,            /* 没有可用的上游，或上游的应答不合法 */
         CLOSED_CONNECTION       /* 客户端已关闭连接 */
     }; 
 
@@ -68,14 +120,41 @@ public:
         LINE_OPEN       /* 行数据尚且不完整 */
     };
 
+    /* 发送应答的结果 */
+    enum WRITE_STATUS {
+        WRITE_DONE,     /* 应答已全部发送 */
+        WRITE_AGAIN,    /* TCP写缓冲已满，需等待EPOLLOUT */
+        WRITE_ERROR     /* 发送出错 */
+    };
+
+    /* 切换到HTTP/2的方式 */
+    enum UPGRADE {
+        UPGRADE_NONE,
+        UPGRADE_PREFACE,    /* 连接的第一个请求是HTTP/2的连接序言（prior knowledge） */
+        UPGRADE_H2C         /* GET请求带有Upgrade: h2c及HTTP2-Settings */
+    };
+
+    /* 工作线程直接发送应答时，一次最多连续处理的请求数，超过后交还给epoll */
+    static const int MAX_DIRECT_REQUESTS = 8;
+    /* 发送前检查的文件范围，不在page cache中时交给I/O线程预读 */
+    static const size_t PREFETCH_WINDOW = 2 * 1024 * 1024;
+    /* 上传时每次从socket经管道splice到文件的最大字节数，与管道的默认容量相同 */
+    static const size_t UPLOAD_CHUNK = 64 * 1024;
+
 public:
-    /* 所有socket上的事件都注册到同一个epoll内核事件表中，m_epollfd设置为static */
-    static int m_epollfd;
-    static int m_user_count;
+    static std::atomic<int> m_user_count;     /* 工作线程也会关闭连接，需原子操作 */
+    static std::atomic<uint32_t> m_conn_count;  /* 已接受的连接总数，用于生成连接编号 */
+    static threadpool<http_conn>* m_io_pool;    /* 预读文件的I/O线程池，为nullptr时不检查 */
 
-private:
+protected:
     int m_sockfd;                       /* 该http连接的socket */
+    int m_epollfd;                      /* 所属事件循环的epoll内核事件表，由conn_table设置 */
+    conn_table* m_table;                /* 所属的连接表，关闭后放回 */
+    std::atomic<uint32_t> m_gen;        /* 世代，每次关闭连接时加1，见conn_table */
+    uint64_t m_key;                     /* 本次连接注册的epoll事件的data */
+    uint32_t m_conn_id;                 /* 连接编号，用于流量录制 */
     sockaddr_in m_address;              /* 客户端的socket地址 */
+    limit_slot* m_limit;                /* 客户端IP在limiter_中的表项，不限制时为nullptr */
     char m_read_buf[READ_BUF_SIZE];     /* 读缓冲区 */
     int m_read_idx;         /* 标记读缓冲中已经读入的客户数据的最后一个字符的下一位置 */
     int m_checked_idx;      /* 当前正在分析的字符在读缓冲区的中位置 */
@@ -89,36 +168,141 @@ private:
     
     /* 客户请求的目标文件完整路径 */
     char m_real_file[FILENAME_LEN];
-    char* m_url;            /* 目标文件的文件名 */
-    std::string m_file_type;      /* 目标文件的类型 */
-    char* m_version;        /* http协议版本号，只支持http/1.1 */   
+    char* m_url;            /* 解码并规范化后的路径，不含查询串 */
+    char* m_target;         /* 请求行中未解码的目标（含查询串），反向代理原样转发 */
+    const char* m_file_type;      /* 目标文件的扩展名（含'.'），无扩展名时为"default" */
+    char* m_version;        /* http协议版本号，HTTP/1.1或HTTP/1.0，决定默认是否保持连接 */
     char* m_host;           /* 主机名 */
-    int m_content_length;   /* http请求的消息体长度 */
+    char* m_if_modified_since;  /* If-Modified-Since字段 */
+    char* m_if_none_match;  /* If-None-Match字段 */
+    char* m_location;       /* 重定向的目标，位于arena中 */
+    bool m_accept_gzip;     /* Accept-Encoding中包含gzip */
+    long m_content_length;  /* http请求的消息体长度 */
+    bool m_chunked;         /* Transfer-Encoding: chunked */
+    bool m_expect_continue; /* Expect: 100-continue，开始接收消息体前需先回复100 */
     bool m_linger;          /* http请求是否要保持连接 */
 
-    /* 客户请求的目标文件被mmap到内存的起始位置 */
+    /* 客户请求的目标文件被mmap到内存的起始位置，命中缓存时指向缓存的内容 */
     char* m_file_address;
+    cache_entry_ptr m_cache_entry;      /* 命中缓存时持有缓存项，应答发送完毕后释放 */
+    char m_last_modified[32];           /* 目标文件的Last-Modified，为空时不发送 */
+    const char* m_static_headers;       /* 来自归档或缓存时，预先生成的Content-Length等头部 */
+    uint32_t m_static_headers_len;
+    bool m_inline;          /* 正在主线程中处理，不允许执行可能阻塞的操作 */
+    bool m_pending;         /* 请求已解析完毕，等待工作线程执行do_request */
+    bool m_prefetch;        /* 已交给I/O线程，预读完成后注册EPOLLOUT继续发送 */
 
     /* 目标文件状态，判断文件是否存在、是否为目录、是否可读、获取文件大小 */
     struct stat m_file_stat;
 
-    /* 采用writev执行写操作，定义下面两个成员 */
-    struct iovec m_iv[2];
+    /* 采用writev执行写操作，定义下面两个成员：
+     * 文件应答为头部+文件内容，分块应答为头部（未发送完的部分）+分块大小行+生产者的数据
+     */
+    struct iovec m_iv[3];
     int m_iv_count;         /* 被写内存块的数量 */
+    long m_bytes_to_send;   /* 应答中剩余待发送的字节数（头部+文件） */
+    long m_bytes_have_send; /* 应答中已发送的字节数 */
+    long m_last_size;       /* 该连接上一个应答的大小，用于估计下一个应答的大小 */
+    uint32_t m_requests;    /* 该连接上已完成的请求数 */
+    time_t m_idle_begin;    /* 开始等待当前请求的时间 */
+    std::atomic<bool> m_waiting;    /* 已注册事件等待请求（或代理转发中等待客户端、上游），此时只有主线程会访问该连接，可以因超时关闭 */
+    bool m_pipelined;       /* 应答发送完毕时读缓冲中已有下一个请求，不会再产生EPOLLIN */
+
+    /* 分块应答：生产者的数据直接作为iovec发送，只有分块的大小行写在m_chunk_head中 */
+    std::unique_ptr<body_producer> m_producer;  /* 消息体尚未结束时不为空 */
+    bool m_chunk_framing;   /* HTTP/1.1使用chunked编码；HTTP/1.0直接发送数据，以关闭连接表示结束 */
+    bool m_chunk_open;      /* 已发送过分块，下一个大小行之前需先结束上一个分块 */
+    char m_chunk_head[24];  /* "\r\n" + 十六进制长度 + "\r\n" */
+
+    /* 上传：消息体经管道从socket splice到临时文件，接收完毕后rename到目标路径，
+     * 占用的内存与消息体大小无关
+     */
+    BODY_STATE m_body_state;
+    long m_body_left;       /* 当前分块（或整个消息体）剩余的字节数 */
+    long m_body_total;      /* 已接收的字节数 */
+    int m_upload_fd;        /* 临时文件，未在上传时为-1 */
+    int m_pipe[2];          /* splice使用的管道，socket不支持splice时为-1，改用读缓冲中转 */
+    bool m_upload_linger;   /* 上传成功后是否保持连接；消息体未接收完就出错时必须关闭连接 */
+    bool m_upload_replaced; /* 目标文件原已存在，成功时返回204而不是201 */
+    char m_upload_tmp[FILENAME_LEN + 16];   /* 临时文件的路径，与目标文件在同一目录中，rename是原子的 */
+    /* HTTP/2：切换后连接上的所有数据由m_h2处理，只在工作线程中执行 */
+    h2_session* m_h2;
+    UPGRADE m_upgrade;
+    bool m_upgrade_h2c;     /* Upgrade字段中有h2c */
+    bool m_connection_upgrade;  /* Connection字段中有Upgrade */
+    char* m_h2_settings;    /* HTTP2-Settings字段 */
+
+    /* TLS连接：握手在工作线程中完成，之后socket的读写都经过sock_recv、sock_writev */
+    tls_conn m_tls;
+
+    /* 反向代理：请求匹配的路由，及第一次代理请求时创建、随连接一起释放的转发状态 */
+    const proxy_route* m_route;
+    proxy_session* m_proxy;
+
+    /* 路由：请求匹配的处理器；路径匹配但方法不被接受时m_allowed为接受的方法，应答405；
+     * 为0时405应答的Allow为文件所接受的方法
+     */
+    route_handler* m_handler;
+    uint32_t m_allowed;
+    int m_status;               /* respond()给出的状态行及消息体，消息体在应答发送完毕之前有效 */
+    const char* m_status_title;
+    const char* m_content;
+    size_t m_content_len;
+
+    arena m_arena;          /* 请求处理过程中的临时数据，每个请求结束时重置 */
+    trace_ctx m_trace;      /* 当前请求的追踪记录 */
 
 public:
-    http_conn() {}
-    ~http_conn() {}
+    http_conn() : m_sockfd(-1), m_epollfd(-1), m_table(nullptr), m_gen(0), m_key(0), m_limit(nullptr), m_waiting(false), m_upload_fd(-1), m_h2(nullptr), m_proxy(nullptr) { m_pipe[0] = m_pipe[1] = -1; m_upload_tmp[0] = '\0'; }
+    ~http_conn();
+    friend class h2_session;
+    friend class proxy_session;
+    friend class conn_table;
 
 public:
-    void init(int sockfd, const sockaddr_in& addr);   /* 初始化新接受的连接 */
+    /* 初始化新接受的连接，tls表示来自TLS端口，limit为已计入该连接的限流表项 */
+    void init(int sockfd, const sockaddr_in& addr, bool tls = false, limit_slot* limit = nullptr);
     void close_conn(bool real_close = true);          /* 关闭连接 */
     void process();     /* 处理客户请求 */
+    void reject();      /* 服务器过载：返回503并关闭连接 */
+    static void send_busy(int sockfd);  /* 向sockfd发送预先拼好的503应答 */
     bool read();        /* 非阻塞读 */
     bool write();       /* 非阻塞写 */
+    bool process_inline();  /* 由主线程尝试直接处理请求，需要访问磁盘时返回false */
+    bool bulk() const;      /* 应答是否为大文件，大文件的任务和写事件优先级较低 */
+    bool pipelined() const { return m_pipelined; }  /* write()之后检查，为true时由调用者像EPOLLIN一样处理 */
+    bool expired(time_t now) const;     /* 等待请求的时间是否超过keepalive_timeout，或代理转发超时 */
+    trace_ctx& trace() { return m_trace; }
+    uint32_t generation() const { return m_gen.load(std::memory_order_acquire); }
+    /* 已注册事件等待，此时只有事件循环会访问该连接；acquire与交还连接时的release配对 */
+    bool parked() const { return m_waiting.load(std::memory_order_acquire); }
 
-private:
+    /* 下面一组函数供路由的处理器使用 */
+    METHOD method() const { return m_method; }
+    const char* url() const { return m_url; }       /* 解码并规范化后的路径 */
+    const char* query() const;                      /* 查询串（不含'?'），没有时为"" */
+    arena& scratch() { return m_arena; }            /* 请求结束时释放 */
+    /* 以body为消息体应答，type为决定Content-Type的扩展名（如".txt"）；HEAD请求不发送消息体 */
+    HTTP_CODE respond(int status, const char* title, const char* type, const char* body, size_t len);
+    HTTP_CODE stream(body_producer* producer);  /* 以producer生成的消息体应答，接管其所有权 */
+    HTTP_CODE forward(const proxy_route* route);    /* 转发到反向代理的路由 */
+
+protected:
+    bool feed(const char* data, int len);   /* 不经过socket，直接向读缓冲追加数据 */
     void init();                        /* 初始化连接信息 */
+    void finish_request();              /* 应答发送完毕，保留读缓冲中已收到的下一个请求（流水线） */
+    void wait_read();                   /* 注册EPOLLIN等待下一个请求 */
+    WRITE_STATUS send_response();       /* 发送应答，不修改epoll上注册的事件 */
+    body_producer::STATUS next_chunk(); /* 向生产者拉取下一段数据，填入m_iv[1]、m_iv[2] */
+    bool start_h2();                    /* 切换到HTTP/2，返回false时由调用者关闭连接 */
+    bool start_proxy();                 /* 开始转发到上游，返回false时由调用者关闭连接 */
+    bool proxying() const;              /* 正在转发代理请求，连接上的事件都交给m_proxy */
+    HTTP_CODE do_route_request();       /* 调用匹配的处理器，路径匹配但方法不被接受时返回405 */
+    bool handshaking() const { return m_tls.active() && ! m_tls.established(); }
+    ssize_t sock_recv(char* buf, size_t len);   /* 与recv相同，TLS连接上读取解密后的数据 */
+    ssize_t sock_writev(const struct iovec* iov, int count);
+    bool defer_to_io();                 /* 待发送的文件内容不在内存中时交给I/O线程，返回true */
+    void prefetch();                    /* 在I/O线程中将待发送的文件内容读入内存 */
     HTTP_CODE process_read();           /* 解析http请求 */
     bool process_write(HTTP_CODE ret);  /* 填充http应答 */
 
@@ -127,6 +311,17 @@ private:
     HTTP_CODE parse_headers(char* text);
     HTTP_CODE parse_content(char* text);
     HTTP_CODE do_request();
+    HTTP_CODE do_file_request(bool index);  /* 查找m_real_file，index表示其为目录的index文件 */
+    HTTP_CODE do_dir_request(const dir_entry_ptr& dir);    /* 按目录的处理方式生成应答 */
+    bool not_modified(time_t mtime) const;  /* 根据If-Modified-Since判断是否可以返回304 */
+    HTTP_CODE do_bundle_request();      /* 从静态资源归档中查找目标文件 */
+
+    /* 下面一组函数处理PUT、POST上传，只在工作线程中执行 */
+    HTTP_CODE do_upload_request();      /* 检查请求并创建临时文件 */
+    HTTP_CODE receive_body();           /* 接收消息体直到socket中没有数据，完成时rename */
+    HTTP_CODE finish_upload();
+    long splice_body(long len);         /* 从socket最多转存len字节到临时文件，返回0表示暂无数据，-1表示连接已断开，-2表示写文件出错 */
+    void close_upload();                /* 关闭临时文件及管道，临时文件尚未rename时将其删除 */
     char* get_line() { return m_read_buf + m_start_line; }
     LINE_STATUS parse_line();
 
@@ -135,7 +330,9 @@ private:
     void get_file_type();   /* 获取文件类型 */
     bool add_response(const char* format, ...);
     bool add_status_line(int status, const char* title);
-    void add_headers(int content_length);
+    /* has_length为false时不发送Content-Length：304、204没有消息体，分块应答的长度事先未知 */
+    void add_headers(long content_length, bool has_length = true);
+    void add_connection();  /* Connection及Keep-Alive字段 */
     bool add_content(const char* content);
 
 };
@@ -6,52 +6,16 @@
  * @ Description  : 记录http content-type文件类型
  */
 
-#include <unordered_map> 
+#ifndef HTTP_CONTENT_TYPE_H
+#define HTTP_CONTENT_TYPE_H
 
-/* 定义文件类型 */
+#include <string>
+#include <unordered_map>
 
-std::unordered_map<std::string, std::string> file_type_map = {
-    {".js", "application/javascript"},
-    {".xhtml", "application/xhtml+xml"},
-    {".rtf", "application/rtf"},
-    {".pdf", "application/pdf"},
-    {".exe", "application/x-msdownload"},
-    {".word", "application/msword"},
-    {".zip", "application/zip"},
-    {".gzip","application/gzip"},
-    {".gz", "application/x-gzip"},
-    {".tar", "application/x-tar"},
+/* 文件扩展名 -> Content-Type，定义见http_content_type.cpp */
+extern std::unordered_map<std::string, std::string> file_type_map;
 
-    {".png", "image/png"},
-    {".gif", "image/gif"},
-    {".jpg", "image/jpeg"},
-    {".jpeg", "image/jpeg"},
-    {".ico", "image/x-icon"},
-    {".tif", "	image/tiff"},
-    
-    {".mp3", "audio/mp3"}, 
-    {".wav", "audio/wav"},
-    {".m3u", "audio/mpegurl"},
+/* 按扩展名查找Content-Type，不存在时返回"text/plain"，查找过程不分配内存 */
+const char* get_content_type(const char* ext);
 
-    {".mpeg", "video/mpeg"},
-    {".mpg", "video/mpeg"},
-    {".avi", "video/x-msvideo"},
-    {".mp4", "video/mp4"},
-    {".movie", "video/x-sgi-movie"},
-    
-    {".css", "text/css"},
-    {".csv", "text/csv"},
-    {".txt", "text/plain"},
-    {".html", "text/html"},
-    {".xml", "text/xml"},
-    {"", "text/plain"},
-    {".c", "text/plain"},
-    {".cpp", "text/plain"},
-    {".h", "text/plain"},
-    {".hpp", "text/plain"},
-    {".md", "text/plain"},
-    {"default","text/plain"},
-
-    {".class", "java/*"},
-    {".java", "java/*"}
-};
\ No newline at end of file
+#endif
@@ -10,19 +10,23 @@
 #define LOG_H
 
 #include <string>
-#include <list>
+#include <cstring>
 #include <ctime>
 #include "locker.h"
 #include "timer.h"
 
-using std::list;
 using std::string;
 using std::to_string;
 
 class LOG{
+public:
+    static const size_t BUF_SIZE = 1 << 20;     /* 缓冲区初始容量 */
+
 private:
     locker lock;            /* 互斥锁 */
-    list<string> buf;       /* 缓冲区 */
+    locker save_lock;       /* 保证同一时刻只有一个线程在写文件 */
+    string buf;             /* 缓冲区，预留容量，追加日志时不需要分配内存 */
+    string back_buf;        /* 写文件时与buf交换，两者交替使用 */
     string file_name;       /* 日志文件名 */
     string time_r;          /* 当前系统时间 */
     int fd;                 /* 日志文件 文件描述符 */   
@@ -34,8 +38,17 @@ public:
     ~LOG();
     void save();            /* 将缓冲区的数据写入文件 */
     void get_time();        /* 获取系统时间，并记录至time_r */
-    void log(string type, string file, int line, string str, bool flag = false);
+    /* flag为true时将该条日志放在缓冲区最前面 */
+    void log(const string& type, const string& file, int line, const string& str, bool flag = false) {
+        append(type.c_str(), file.c_str(), line, str.c_str(), str.size(), flag);
+    }
+    void log(const char* type, const string& file, int line, const char* str, bool flag = false) {
+        append(type, file.c_str(), line, str, strlen(str), flag);
+    }
     void set_expire(int id, int delay);     /* 更新定时器过期时间 */
+
+private:
+    void append(const char* type, const char* file, int line, const char* str, size_t len, bool flag);
 };
 
 extern LOG* log_;
@@ -0,0 +1,243 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:54
+ * @ Modified Time: 2026-10-19 23:59:54
+ * @ Description  : 反向代理（按路径前缀转发到上游，连接池与健康检查） 头文件
+ */
+
+#ifndef PROXY_H
+#define PROXY_H
+
+#include <atomic>
+#include <cstddef>
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <netinet/in.h>
+#include "locker.h"
+#include "http_conn.h"
+#include "router.h"
+
+using std::string;
+
+/* 一个上游服务器，所有路由共享，同一地址只有一个连接池 */
+struct upstream{
+    string name;                /* host:port，用于日志 */
+    sockaddr_in addr;
+    std::atomic<bool> healthy;  /* 被摘除的上游不再分配请求，由健康检查恢复 */
+    std::atomic<int> failures;  /* 连续失败的次数 */
+    locker lock;
+    std::vector<std::pair<int, time_t>> idle;   /* 空闲的长连接及放入的时间，后放入的先取出 */
+
+    upstream() : healthy(true), failures(0) {}
+};
+
+/* 一个路径前缀，请求在其上游之间轮流分配 */
+struct proxy_route{
+    string prefix;              /* 不以'/'结尾，"/"匹配所有路径 */
+    std::vector<upstream*> upstreams;
+    mutable std::atomic<uint32_t> next;
+
+    proxy_route() : next(0) {}
+};
+
+/* 所有路由及上游。健康检查在独立线程中进行：每隔CHECK_INTERVAL秒连接每个上游，
+ * 配置了检查路径时还要求GET该路径返回2xx或3xx；转发时连续失败MAX_FAILURES次的上游被立即摘除
+ */
+class proxy{
+public:
+    static const int MAX_FAILURES = 3;
+    static const int CHECK_INTERVAL = 2;        /* 健康检查的间隔（s） */
+    static const int CHECK_TIMEOUT = 1000;      /* 一次健康检查的超时（ms） */
+    static const int IDLE_TIMEOUT = 60;         /* 空闲连接在池中保留的时间（s） */
+
+private:
+    std::vector<proxy_route*> m_routes;
+    std::vector<upstream*> m_upstreams;
+    size_t m_max_idle;                      /* 每个上游保留的空闲连接数上限 */
+    string m_check_path;                    /* 为空时只检查能否建立连接 */
+    pthread_t m_thread;
+
+public:
+    /* routes中每项为"前缀=host:port[,host:port...]"，格式错误、无法解析地址或线程创建失败时抛出异常 */
+    proxy(const std::vector<string>& routes, size_t max_idle, const string& check_path);
+    ~proxy();
+
+    /* 每个前缀注册为接受所有方法的PREFIX路由，由router按最长前缀匹配；前缀重复时返回false */
+    bool install(router& r) const;
+    /* 取得一个到上游的非阻塞连接：pooled为true时优先复用池中的空闲连接（reused为true），
+     * 否则新建连接，返回时连接可能仍在进行；所有上游都不可用时返回-1
+     */
+    int acquire(const proxy_route* route, upstream*& up, bool pooled, bool& reused);
+    void release(upstream* up, int fd, bool keep);      /* keep为true时放回池中，否则关闭 */
+    void report(upstream* up, bool ok);                 /* 记录一次转发的结果 */
+
+private:
+    static void* worker(void* arg);
+    void run();
+    bool check(upstream* up) const;
+    void prune(upstream* up, time_t now);   /* 关闭池中已被对端关闭或空闲过久的连接 */
+    void set_healthy(upstream* up, bool healthy);
+};
+
+/* 把路由的请求转发到上游 */
+class proxy_handler : public route_handler{
+private:
+    const proxy_route* m_route;
+
+public:
+    explicit proxy_handler(const proxy_route* route) : m_route(route) {}
+    http_conn::HTTP_CODE handle(http_conn& conn) override { return conn.forward(m_route); }
+};
+
+/* 消息体的边界：Content-Length、chunked或直到连接关闭。chunked的控制部分逐字节解析，
+ * 可以在任意位置被分割；数据原样转发，数据部分的长度已知，可以不经过用户态
+ */
+class body_framing{
+public:
+    enum STATE {
+        BODY_DATA,          /* Content-Length的消息体，或直到连接关闭 */
+        CHUNK_SIZE,         /* 分块大小（十六进制） */
+        CHUNK_EXT,          /* 分块大小之后的扩展，忽略 */
+        CHUNK_SIZE_LF,
+        CHUNK_DATA,
+        CHUNK_DATA_CR,      /* 分块数据之后的CRLF */
+        CHUNK_DATA_LF,
+        TRAILER_BEGIN,      /* 最后一个分块之后的trailer，以空行结束 */
+        TRAILER_LINE,
+        TRAILER_LF,
+        FINAL_LF,
+        BODY_END,
+        BODY_BAD
+    };
+
+private:
+    STATE m_state;
+    long m_left;            /* 当前数据部分剩余的字节数 */
+    int m_digits;           /* 分块大小已读的位数 */
+    bool m_until_eof;       /* 没有长度的应答，以连接关闭结束 */
+
+public:
+    body_framing() : m_state(BODY_END), m_left(0), m_digits(0), m_until_eof(false) {}
+
+    void none() { m_state = BODY_END; m_until_eof = false; }
+    void length(long len) { m_state = len > 0 ? BODY_DATA : BODY_END; m_left = len; m_until_eof = false; }
+    void chunked() { m_state = CHUNK_SIZE; m_left = 0; m_digits = 0; m_until_eof = false; }
+    void until_eof() { m_state = BODY_DATA; m_left = 0; m_until_eof = true; }
+
+    /* 解析data的开头，返回属于消息体的字节数，到达消息体结尾时停止 */
+    size_t consume(const char* data, size_t len);
+    /* 正处于数据部分时，不经解析可以直接转发的字节数 */
+    long direct() const;
+    void skip(long len);            /* 已直接转发len字节（不超过direct()） */
+    void eof();                     /* 源连接已关闭：以连接关闭结束的消息体到此完整，否则不完整 */
+    bool done() const { return m_state == BODY_END; }
+    bool bad() const { return m_state == BODY_BAD; }
+    bool until_close() const { return m_until_eof; }
+};
+
+/* 一个客户连接上的代理状态，由http_conn持有，在事件循环中随连接表的槽位创建，连接关闭时只reset，
+ * 槽位上的下一个连接继续使用。请求头部改写后与消息体一起转发到上游，
+ * 之后读取应答头部，改写后与应答的消息体一起转发给客户端；消息体在两个socket之间
+ * 经管道splice，不经过用户态（TLS连接除外）。同一时刻只在客户连接或上游连接中的一个上
+ * 注册事件（EPOLLONESHOT），上游连接的事件带有conn_table::UPSTREAM_TAG，交给所属的客户连接处理
+ */
+class proxy_session{
+public:
+    static const size_t BUF_SIZE = 16384;       /* 应答头部的大小上限，也是没有splice时的中转缓冲 */
+    static const size_t SPLICE_CHUNK = 65536;   /* 与管道的默认容量相同 */
+
+    enum STATE {
+        IDLE,
+        CONNECTING,         /* 等待连接上游完成 */
+        SEND_REQUEST,       /* 转发请求头部及消息体 */
+        RECV_HEAD,          /* 等待上游的应答头部 */
+        SEND_RESPONSE       /* 转发应答头部及消息体 */
+    };
+
+    /* 一次转发的结果 */
+    enum PUMP {
+        PUMP_DONE,
+        PUMP_WAIT_SOURCE,   /* 源socket暂无数据 */
+        PUMP_WAIT_DEST,     /* 目标socket的写缓冲已满 */
+        PUMP_YIELD,         /* 用完了write_quantum，交还给epoll */
+        PUMP_SOURCE_ERROR,
+        PUMP_DEST_ERROR
+    };
+
+private:
+    http_conn& m_conn;
+    STATE m_state;
+    const proxy_route* m_route;
+    upstream* m_upstream;
+    int m_fd;                   /* 上游连接，没有时为-1 */
+    bool m_registered;          /* m_fd已加入epoll */
+    bool m_reused;              /* m_fd来自连接池，可能已被上游关闭 */
+    bool m_retried;
+    bool m_replayable;          /* 请求没有消息体，连接池中的连接失效时可以在新连接上重发 */
+    bool m_keep_upstream;       /* 应答结束后上游连接可以放回池中 */
+    int m_status;               /* 上游应答的状态码 */
+
+    /* 当前方向的转发：m_prefix（请求或应答的头部）+ 消息体 */
+    bool m_response;            /* false：客户端 -> 上游；true：上游 -> 客户端 */
+    string m_prefix;
+    size_t m_prefix_sent;
+    body_framing m_body;
+    size_t m_unsent;            /* 源缓冲开头已解析、尚未发送的字节数 */
+    size_t m_piped;             /* 管道中尚未发送的字节数 */
+    int m_pipe[2];
+    bool m_splice;              /* 客户连接不是TLS且管道可用 */
+
+    /* 上游的应答，客户端的请求消息体直接使用http_conn的读缓冲 */
+    char m_buf[BUF_SIZE];
+    size_t m_buf_pos;
+    size_t m_buf_len;
+
+    time_t m_active;            /* 上一次有进展的时间 */
+
+public:
+    explicit proxy_session(http_conn& conn);
+    ~proxy_session();
+
+    bool active() const { return m_state != IDLE; }
+    /* 开始转发conn中已解析的请求，返回false时由调用者关闭连接 */
+    bool start(const proxy_route* route);
+    /* 处理客户连接或上游连接上的事件，返回false时由调用者关闭连接 */
+    bool process();
+    /* 由http_conn::expired在连接等待事件（m_waiting为true）时调用 */
+    bool expired(time_t now) const;
+    /* 连接关闭时调用：关闭上游连接，回到IDLE */
+    void reset();
+
+private:
+    bool connect_upstream(bool pooled);
+    void build_request();
+    bool send_request();
+    bool recv_head();
+    bool parse_head(size_t head_len);
+    bool send_response();
+    bool upstream_failed();         /* 收到应答之前上游出错：重试或返回502 */
+    bool fail();                    /* 返回502，之后由http_conn按普通应答发送 */
+    bool finish();                  /* 应答转发完毕 */
+    void release(bool keep);
+
+    PUMP pump(long budget);
+    const char* in_data() const;
+    size_t in_len() const;
+    void in_advance(size_t len);
+    ssize_t in_fill();              /* 源缓冲为空时从源socket读取 */
+    ssize_t write_dest(const struct iovec* iov, int count);
+    int source_fd() const;
+    int dest_fd() const;
+
+    void arm_upstream(int ev);
+    void arm_client(int ev);
+};
+
+/* 未配置--proxy时为nullptr */
+extern proxy* proxy_;
+
+#endif
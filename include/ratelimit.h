@@ -0,0 +1,88 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:56
+ * @ Modified Time: 2026-10-19 23:59:56
+ * @ Description  : 按客户端IP的连接数及请求速率限制 头文件
+ */
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/* 一个客户端IP的状态。令牌桶以GCRA的形式保存为一个字（理论到达时间tat）：
+ * 每个请求使tat增加一个间隔，tat超前当前时间不超过burst个间隔时允许，
+ * 与容量为burst、每个间隔补充一个令牌的令牌桶等价，可以用一次CAS更新
+ */
+struct limit_slot{
+    std::atomic<uint64_t> key;      /* 0表示空闲，否则为IP | KEY_USED，回收中时另有KEY_BUSY */
+    std::atomic<uint64_t> tat;      /* ns，单调时钟 */
+    std::atomic<int32_t> conns;     /* 当前的连接数，不为0时不会被回收 */
+
+    limit_slot() : key(0), tat(0), conns(0) {}
+};
+
+/* 按IP分片的组相联哈希表，容量固定，不申请内存，不加锁。
+ * 查找、插入及回收只在事件循环中进行（accept时、每秒一次），多个事件循环可以同时进行：
+ * 插入以CAS占用组中的空闲表项；回收先以CAS给key加上KEY_BUSY，确认没有连接后再清零，
+ * accept到该IP的事件循环看到KEY_BUSY时撤销回收，因此有连接的表项不会被回收。
+ * 两个事件循环同时插入同一IP且恰逢该组有表项被回收时，可能各占一个表项，
+ * 之后的查找总是找到组中靠前的一个，只放宽了这一瞬间的连接数限制。
+ * 连接持有自己IP的表项，工作线程通过指针以原子操作检查速率、减少连接数。
+ * 表项所在的组已满且都在使用时不限制该IP
+ */
+class rate_limiter{
+public:
+    static const int SHARD_COUNT = 16;          /* 每秒回收一个分片 */
+    static const int SHARD_SLOTS = 4096;
+    static const int WAYS = 8;                  /* 一个IP只可能位于一组的WAYS个表项之一 */
+    static const uint64_t KEY_USED = (uint64_t)1 << 32;
+    static const uint64_t KEY_BUSY = (uint64_t)1 << 33;     /* 正在被回收 */
+
+    /* accept时的结果 */
+    enum ADMIT {
+        ADMIT_OK,
+        ADMIT_UNTRACKED,    /* 表已满，不限制 */
+        ADMIT_REJECT        /* 连接数已达上限，或请求速率已超过限制 */
+    };
+
+private:
+    struct shard{
+        limit_slot slots[SHARD_SLOTS];
+    };
+
+    shard* m_shards;
+    int m_max_conns;            /* 0表示不限制连接数 */
+    uint64_t m_interval;        /* 两个请求之间的间隔（ns），0表示不限制速率 */
+    uint64_t m_tolerance;       /* tat最多超前当前时间多少（ns），即burst - 1个间隔 */
+    int m_next_shard;           /* 下一次回收的分片，只由第一个事件循环访问 */
+    std::atomic<uint64_t> m_rejected;
+
+public:
+    /* max_conns：每个IP同时打开的连接数；rate：每个IP每秒的请求数；burst：允许的突发请求数 */
+    rate_limiter(int max_conns, int rate, int burst);
+    ~rate_limiter();
+
+    /* 事件循环在accept后调用，ADMIT_OK时slot为该IP的表项，连接关闭时需detach */
+    ADMIT admit(uint32_t ip, limit_slot*& slot);
+    void detach(limit_slot* slot) { slot->conns.fetch_sub(1, std::memory_order_relaxed); }
+    /* 开始处理一个请求，超过速率时返回false；可以在任意线程中调用 */
+    bool allow(limit_slot* slot);
+    /* 第一个事件循环每秒调用一次，回收一个分片中没有连接且令牌桶已满的表项 */
+    void age();
+    uint64_t rejected() const { return m_rejected.load(std::memory_order_relaxed); }
+
+private:
+    static uint64_t now();
+    limit_slot* set_of(uint32_t ip) const;
+    bool reclaimable(const limit_slot& slot, uint64_t t) const;
+    bool reclaim(limit_slot& slot, uint64_t key, uint64_t t);  /* 回收key所在的表项，成功时返回true */
+};
+
+/* 未开启--conn-limit及--rate-limit时为nullptr */
+extern rate_limiter* limiter_;
+
+#endif
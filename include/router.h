@@ -0,0 +1,84 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:55
+ * @ Modified Time: 2026-10-19 23:59:55
+ * @ Description  : 请求路由（压缩前缀树）及处理器接口 头文件
+ */
+
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "http_conn.h"
+
+using std::string;
+
+/* 路由的处理器，在启动时注册，随router一起释放。
+ * handle()在请求头部解析完毕后调用，可能在主线程中调用，不能阻塞：
+ * 通过http_conn::respond()、stream()、forward()生成应答，也可以返回任意HTTP_CODE；
+ * 需要访问磁盘等可能阻塞的处理器令blocking()返回true，只在工作线程中调用。
+ * 请求的消息体没有被读取，除转发到上游外应答之后关闭连接
+ */
+class route_handler{
+public:
+    virtual ~route_handler() {}
+    virtual http_conn::HTTP_CODE handle(http_conn& conn) = 0;
+    virtual bool blocking() const { return false; }
+};
+
+/* 按方法与路径查找处理器。路径存放在压缩前缀树中，每条边是一段字符串，
+ * 子节点按边的首字节查找，匹配的时间只与路径长度有关，查找时不申请内存。
+ * EXACT只匹配整个路径；PREFIX按'/'分隔的段匹配："/api"匹配"/api"、"/api/x"，不匹配"/apix"，
+ * "/"匹配所有路径。最长的匹配优先，同一路径上EXACT优先于PREFIX；
+ * 匹配的路由都不接受该方法时，由allowed返回最长匹配所接受的方法，应答405
+ */
+class router{
+public:
+    enum MATCH { EXACT, PREFIX };
+    static const int METHOD_COUNT = http_conn::PATCH + 1;
+    static const uint32_t ALL_METHODS = (1u << METHOD_COUNT) - 1;
+
+    static uint32_t method_bit(http_conn::METHOD method) { return 1u << method; }
+
+private:
+    struct node{
+        string label;                   /* 从父节点到该节点的边 */
+        string first;                   /* 各子节点边的首字节，与children一一对应 */
+        std::vector<node*> children;
+        route_handler* handlers[2][METHOD_COUNT];   /* [EXACT/PREFIX][方法] */
+        uint32_t methods[2];            /* handlers中不为空的方法 */
+
+        node() : handlers(), methods() {}
+        ~node() { for (node* child : children) delete child; }
+    };
+
+    node* m_root;
+    std::vector<route_handler*> m_handlers;
+    size_t m_routes;
+
+public:
+    router();
+    ~router();
+
+    /* 注册path（以'/'开头），接管handler的所有权；PREFIX结尾的'/'被忽略。
+     * path不合法或与已注册的路由冲突时返回false，此时handler仍被接管
+     */
+    bool add(const string& path, MATCH kind, uint32_t methods, route_handler* handler);
+    /* path为已规范化的路径；没有匹配时返回nullptr，allowed为0表示路径也没有匹配 */
+    route_handler* match(http_conn::METHOD method, const char* path, uint32_t& allowed) const;
+    size_t size() const { return m_routes; }
+};
+
+/* --status：以纯文本返回连接数及缓存的统计信息，用于健康检查与监控 */
+class status_handler : public route_handler{
+public:
+    http_conn::HTTP_CODE handle(http_conn& conn) override;
+};
+
+/* 没有注册任何路由时为nullptr，所有请求都按文件处理 */
+extern router* router_;
+
+#endif
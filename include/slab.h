@@ -0,0 +1,67 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 22:58:41
+ * @ Modified Time: 2026-10-19 22:58:41
+ * @ Description  : 缓存内容使用的slab分配器 头文件
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "locker.h"
+
+/* 启动时预留一整段虚拟内存并建议内核使用透明大页，按SLAB_SIZE切分为slab；
+ * 每个slab只存放同一大小级别的内存块，大小级别按约1.25倍递增，内部碎片不超过25%。
+ * slab中的块全部释放后slab归还给全局，可以被其他大小级别使用
+ */
+class slab_pool{
+public:
+    static const size_t SLAB_SIZE = 2 * 1024 * 1024;   /* 与x86的大页大小相同 */
+    static const size_t MIN_CHUNK = 256;
+
+private:
+    struct slab{
+        int cls;            /* 大小级别，-1表示空闲 */
+        uint32_t used;      /* 已分配的块数 */
+        uint32_t carved;    /* 已切分出的字节数，尚未切分的部分没有被访问过 */
+        void* free_list;    /* 已释放的块，块的前8字节存放下一块的地址 */
+        slab* prev;         /* 所在大小级别的未满slab链表 */
+        slab* next;
+        bool partial;       /* 是否在未满slab链表中 */
+    };
+    struct size_class{
+        locker lock;
+        size_t size;
+        slab* partial;      /* 还有空闲块的slab */
+    };
+
+    char* m_base;
+    size_t m_size;
+    bool m_huge;                    /* 是否成功设置MADV_HUGEPAGE */
+    std::vector<slab> m_slabs;
+    std::vector<size_class*> m_classes;
+    locker m_lock;                  /* 保护下面两项 */
+    std::vector<uint32_t> m_free;   /* 被归还的slab */
+    uint32_t m_next;                /* 从未使用过的第一个slab */
+
+public:
+    slab_pool(size_t capacity, size_t max_chunk);   /* 预留内存失败时抛出异常 */
+    ~slab_pool();
+    slab_pool(const slab_pool&) = delete;
+    slab_pool& operator=(const slab_pool&) = delete;
+
+    /* 分配至少n字节，*chunk为实际占用的大小；n过大或内存耗尽时返回nullptr */
+    void* alloc(size_t n, size_t* chunk);
+    void free(void* p);
+    bool huge() const { return m_huge; }
+
+private:
+    int class_of(size_t n) const;
+    void unlink(size_class* c, slab* s);    /* 需持有c->lock */
+};
+
+#endif
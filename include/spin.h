@@ -0,0 +1,80 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:59
+ * @ Modified Time: 2026-10-19 23:59:59
+ * @ Description  : 先自旋再阻塞的自适应等待
+ */
+
+#ifndef SPIN_H
+#define SPIN_H
+
+#include <cstdint>
+#include "codel.h"
+
+/* 自旋时提示CPU，超线程的另一个逻辑核可以使用流水线 */
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+/* 等待者在阻塞（futex、epoll_wait）之前先自旋至多budget纳秒，省去中等负载下的睡眠与唤醒。
+ * 预算随负载调整：自旋期间等到了，或阻塞后不到max就被唤醒（多自旋一会儿就能等到），预算加倍；
+ * 阻塞了max以上，说明处于空闲，预算减半，直至为0，空闲时不占用CPU。
+ * 每个等待者一个，不是线程安全的；max为0时不自旋
+ */
+class spin_budget{
+public:
+    static const uint64_t MIN_NS = 1000;    /* 预算从0增长时的起点 */
+
+private:
+    uint64_t m_max;
+    uint64_t m_budget;
+
+public:
+    explicit spin_budget(uint64_t max_ns) : m_max(max_ns), m_budget(max_ns) {}
+    bool enabled() const { return m_max > 0; }
+    uint64_t budget() const { return m_budget; }
+
+    /* 自旋直到ready()返回true（返回true），预算用完或为0时返回false，由调用者阻塞 */
+    template< typename F >
+    bool spin(F ready) {
+        if(m_budget == 0){
+            return false;
+        }
+        uint64_t deadline = codel_now() + m_budget;
+        for(unsigned i = 1; ; ++i){
+            if(ready()){
+                grow();
+                return true;
+            }
+            cpu_relax();
+            /* 读时钟比pause贵得多，每64次检查一次 */
+            if((i & 63) == 0 && codel_now() >= deadline){
+                return false;
+            }
+        }
+    }
+    /* 阻塞结束后调用，slept为阻塞的时长 */
+    void parked(uint64_t slept_ns) {
+        if(slept_ns < m_max){
+            grow();
+        }
+        else{
+            m_budget = (m_budget / 2 < MIN_NS) ? 0 : m_budget / 2;
+        }
+    }
+
+private:
+    void grow() {
+        m_budget = (m_budget * 2 < MIN_NS) ? MIN_NS : m_budget * 2;
+        if(m_budget > m_max){
+            m_budget = m_max;
+        }
+    }
+};
+
+#endif
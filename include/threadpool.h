@@ -9,43 +9,91 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
-#include <list>
+#include <atomic>
 #include <cstdio>
 #include <exception>
 #include <pthread.h>
 #include "locker.h"
-
-using std::list;
+#include "codel.h"
+#include "affinity.h"
+#include "spin.h"
 
 template< typename T >
 class threadpool{
+public:
+    /* 优先级队列：LANE_BULK中的任务只有在LANE_SMALL为空，或连续处理了
+     * BULK_SHARE个LANE_SMALL任务之后才会被取出，既不会饿死，也不会拖慢小请求
+     */
+    enum LANE { LANE_SMALL = 0, LANE_BULK, LANE_COUNT };
+    static const int BULK_SHARE = 4;
+
 private:
+    /* 每个优先级一个环形缓冲区，入队时无需分配内存 */
+    struct lane{
+        T** queue;                  /* 请求队列，容量为m_max_requests */
+        uint64_t* enqueue_time;     /* 各任务入队的时间，与queue一一对应 */
+        unsigned int head;          /* 队首元素的下标 */
+        unsigned int size;          /* 队列中的任务数 */
+    };
+
     int m_thread_number;            /* 线程池中的线程数 */
-    unsigned int m_max_requests;    /* 请求队列中允许的最大线程数 */
+    unsigned int m_max_requests;    /* 每个请求队列中允许的最大任务数 */
     pthread_t* m_threads;           /* 描述线程池的数组，大小为m_thread_number */
-    list< T* > m_workqueue;         /* 请求队列 */
+    lane m_lanes[ LANE_COUNT ];
+    int m_small_run;                /* 连续取出的LANE_SMALL任务数 */
+    codel* m_codel;                 /* 准入控制，为NULL时不拒绝任务 */
     locker m_queuelocker;           /* 保护请求队列的互斥锁 */
-    sem m_queuestat;                /* 是否有任务需要处理 */
+    sem m_queuestat;                /* 唤醒阻塞的线程，每次post对应一次对m_parked的认领 */
+    std::atomic<unsigned int> m_queued;     /* 两个队列中的任务总数，自旋时不加锁读取 */
+    std::atomic<int> m_parked;      /* 已阻塞（或即将阻塞）且尚未被认领的线程数 */
+    uint64_t m_spin_ns;             /* 空闲线程阻塞前自旋的最长时间，0表示直接阻塞 */
     bool m_stop;                    /* 是否结束线程 */
+    const char* m_name;             /* 线程名，便于在追踪结果及top中区分线程 */
 public:
-    threadpool(int thread_number = 8, unsigned int max_requests = 10000);
+    /* admission不为NULL时，出队时按排队时间判断是否过载，过载时调用任务的reject()代替process()；
+     * cpu_count大于0时第i个线程绑定到cpus[i % cpu_count]；
+     * spin_ns大于0时空闲线程阻塞前先自旋等待新任务，时长随负载在0到spin_ns之间调整
+     */
+    threadpool(int thread_number = 8, unsigned int max_requests = 10000, const char* name = "worker",
+        codel* admission = NULL, const int* cpus = NULL, int cpu_count = 0, uint64_t spin_ns = 0);
     ~threadpool();
-    bool append(T* request);      /* 向请求队列中添加任务 */
+    bool append(T* request, LANE lane = LANE_SMALL);      /* 向请求队列中添加任务 */
 
 private:
     /* 工作线程运行的函数，它不断从队列中取任务并执行 */
     static void* worker(void* arg);
     void run();
+    void release();     /* 构造失败时释放资源 */
+    bool claim();       /* 认领一个阻塞的线程（m_parked减1），成功时该线程将收到一次post */
 };
 
 template< typename T >
-threadpool< T >::threadpool(int thread_number, unsigned int max_requests) : 
-        m_thread_number(thread_number), m_max_requests(max_requests),  m_threads(NULL), m_stop(false)
+void threadpool< T >::release(){
+    delete [] m_threads;
+    for (int i = 0; i < LANE_COUNT; ++i) {
+        delete [] m_lanes[i].queue;
+        delete [] m_lanes[i].enqueue_time;
+    }
+}
+
+template< typename T >
+threadpool< T >::threadpool(int thread_number, unsigned int max_requests, const char* name, codel* admission,
+        const int* cpus, int cpu_count, uint64_t spin_ns) : 
+        m_thread_number(thread_number), m_max_requests(max_requests),  m_threads(NULL), 
+        m_small_run(0), m_codel(admission), m_queued(0), m_parked(0), m_spin_ns(spin_ns),
+        m_stop(false), m_name(name)
 {
     if((thread_number <= 0) || (max_requests <= 0)) {
         throw std::exception();
     }
 
+    for (int i = 0; i < LANE_COUNT; ++i) {
+        m_lanes[i].queue = new T*[ m_max_requests ];
+        m_lanes[i].enqueue_time = new uint64_t[ m_max_requests ];
+        m_lanes[i].head = 0;
+        m_lanes[i].size = 0;
+    }
+
     m_threads = new pthread_t[ m_thread_number ];
     
     if(! m_threads) {
@@ -54,12 +102,20 @@ threadpool< T >::threadpool(int thread_number, unsigned int max_requests) :
 
     /* 创建thread_number个线程，并设置线程分离 */
     for (int i = 0; i < thread_number; ++i) {
-        if(pthread_create(m_threads + i, nullptr, worker, this) != 0) {
-            delete [] m_threads;        /* 出错，释放资源 */
+        /* 绑定CPU的线程以attr创建，栈从一开始就在该CPU所在的节点上 */
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if(cpu_count > 0) {
+            pin_attr(&attr, cpus[i % cpu_count]);
+        }
+        int err = pthread_create(m_threads + i, &attr, worker, this);
+        pthread_attr_destroy(&attr);
+        if(err != 0) {
+            release();               /* 出错，释放资源 */
             throw std::exception();
         }
         if(pthread_detach(m_threads[i])) {
-            delete [] m_threads;        /* 出错，释放资源 */
+            release();               /* 出错，释放资源 */
             throw std::exception();
         }
     }
@@ -72,46 +128,104 @@ threadpool< T >::~threadpool(){
 }
 
 template< typename T >
-bool threadpool< T >::append(T* request){
+bool threadpool< T >::append(T* request, LANE lane_id){
+    lane& q = m_lanes[ lane_id ];
     /* 工作队列被所有线程共享，操作时需要加锁 */
     m_queuelocker.lock();
-    if (m_workqueue.size() > m_max_requests) {
+    if (q.size >= m_max_requests) {
         /* 队列内任务数已达到上限，解锁并返回false */
         m_queuelocker.unlock();
         return false;
     }
     /* 将request添加至任务队列 */
-    m_workqueue.push_back(request);
+    unsigned int tail = (q.head + q.size) % m_max_requests;
+    q.queue[ tail ] = request;
+    if (m_codel) {
+        q.enqueue_time[ tail ] = codel_now();
+    }
+    ++q.size;
+    m_queued.fetch_add(1);
     m_queuelocker.unlock();
-    m_queuestat.post();
+    /* 只有线程已阻塞时才需要post，线程都在忙或在自旋时省去一次系统调用 */
+    if (claim()) {
+        m_queuestat.post();
+    }
     return true;
 }
 
+template< typename T >
+bool threadpool< T >::claim(){
+    int parked = m_parked.load();
+    while (parked > 0) {
+        if (m_parked.compare_exchange_weak(parked, parked - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 template< typename T >
 void* threadpool< T >::worker(void* arg){
     threadpool* pool = (threadpool*)arg;
+    pthread_setname_np(pthread_self(), pool->m_name);
     pool->run();
     return pool;
 }
 
 template< typename T >
 void threadpool< T >::run(){
+    spin_budget spin(m_spin_ns);
     while (! m_stop) {
-        m_queuestat.wait();
+        if (m_queued.load() == 0
+                && ! spin.spin([this] { return m_queued.load(std::memory_order_relaxed) != 0; })) {
+            /* 先登记再检查队列，与append中先入队再检查m_parked相对，不会错过唤醒；
+             * 登记后发现有任务时撤销登记，已被append认领时则必须等待那一次post
+             */
+            m_parked.fetch_add(1);
+            if (m_queued.load() == 0 || ! claim()) {
+                uint64_t begin = spin.enabled() ? codel_now() : 0;
+                m_queuestat.wait();
+                if (spin.enabled()) {
+                    spin.parked(codel_now() - begin);
+                }
+            }
+        }
         m_queuelocker.lock();
-        if (m_workqueue.empty()) {
+        lane* q = NULL;
+        if (m_lanes[ LANE_BULK ].size > 0
+                && (m_lanes[ LANE_SMALL ].size == 0 || m_small_run >= BULK_SHARE)) {
+            q = &m_lanes[ LANE_BULK ];
+            m_small_run = 0;
+        }
+        else if (m_lanes[ LANE_SMALL ].size > 0) {
+            q = &m_lanes[ LANE_SMALL ];
+            ++m_small_run;
+        }
+        if (! q) {
             /* 任务队列为空，解锁并继续循环 */
             m_queuelocker.unlock();
             continue;
         }
         /* 取出任务队列中的第一个任务 */
-        T* request = m_workqueue.front();
-        m_workqueue.pop_front();
+        T* request = q->queue[ q->head ];
+        bool drop = false;
+        if (m_codel) {
+            uint64_t now = codel_now();
+            drop = m_codel->should_drop(now - q->enqueue_time[ q->head ], now);
+        }
+        q->head = (q->head + 1) % m_max_requests;
+        --q->size;
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
         m_queuelocker.unlock();
         if (!request) {
             continue;
         }
-        request->process();
+        if (drop) {
+            request->reject();
+        }
+        else {
+            request->process();
+        }
     }
 }
 
@@ -0,0 +1,71 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:52
+ * @ Modified Time: 2026-10-19 23:59:52
+ * @ Description  : TLS监听（OpenSSL握手，内核TLS加密） 头文件
+ */
+
+#ifndef TLS_H
+#define TLS_H
+
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+using std::string;
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+
+/* 所有TLS连接共用的证书、私钥及会话恢复状态。
+ * TLS 1.3使用无状态的session ticket，TLS 1.2同时支持ticket与服务器端的会话缓存；
+ * 握手完成后由OpenSSL将密钥交给内核（kTLS），之后加解密都在内核中完成
+ */
+class tls_context{
+private:
+    SSL_CTX* m_ctx;
+
+public:
+    tls_context(const string& cert_file, const string& key_file);  /* 加载失败或未编译OpenSSL时抛出异常 */
+    ~tls_context();
+    SSL* create(int fd);    /* 为新接受的连接创建SSL对象，失败时返回nullptr */
+};
+
+/* 一个连接的TLS状态，由http_conn持有。
+ * 发送方向启用了kTLS时socket可以直接writev明文（包括mmap的文件内容），
+ * 否则数据在用户态加密后发送；接收总是经过SSL_read，kTLS接收时OpenSSL只负责处理非数据记录
+ */
+class tls_conn{
+public:
+    enum HANDSHAKE {
+        TLS_DONE,           /* 握手完成 */
+        TLS_WANT_READ,      /* 等待客户端的数据 */
+        TLS_WANT_WRITE,     /* TCP写缓冲已满 */
+        TLS_ERROR
+    };
+
+private:
+    SSL* m_ssl;
+    bool m_established;     /* 握手已完成 */
+    bool m_ktls_send;       /* 发送方向已交给内核 */
+
+public:
+    tls_conn() : m_ssl(nullptr), m_established(false), m_ktls_send(false) {}
+    ~tls_conn() { close(); }
+
+    bool start(int fd);         /* 开始服务器端握手，tls_为nullptr或创建失败时返回false */
+    void close();               /* 尽量发送close_notify并释放SSL对象 */
+    bool active() const { return m_ssl != nullptr; }
+    bool established() const { return m_established; }
+    HANDSHAKE handshake();
+    /* 与recv/writev相同的语义：出错返回-1并设置errno（EAGAIN表示需等待），对端关闭返回0 */
+    ssize_t recv(void* buf, size_t len);
+    ssize_t writev(int fd, const struct iovec* iov, int count);
+    bool pending() const;       /* SSL层中是否还有已解密未读取的数据 */
+    bool ktls_send() const { return m_ktls_send; }
+};
+
+extern tls_context* tls_;
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 18:10:36
+ * @ Modified Time: 2026-10-19 18:10:36
+ * @ Description  : 请求处理热路径追踪 头文件，导出为Chrome/Perfetto trace格式
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <atomic>
+#include <ctime>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* 追踪的阶段，对应请求处理过程中的各个边界 */
+enum TRACE_STAGE {
+    TRACE_REQUEST = 0,      /* 整个请求，从第一次read()到应答发送完毕 */
+    TRACE_ACCEPT,           /* accept及连接初始化 */
+    TRACE_READ,             /* http_conn::read() */
+    TRACE_QUEUE,            /* 在线程池队列中等待：从append到被工作线程取出 */
+    TRACE_PROCESS_READ,     /* 解析请求（包含do_request） */
+    TRACE_DO_REQUEST,       /* stat/open/mmap */
+    TRACE_PROCESS_WRITE,    /* 填充应答 */
+    TRACE_WRITE,            /* http_conn::write()，可能执行多次 */
+    TRACE_PREFETCH,         /* I/O线程将文件读入page cache */
+    TRACE_STAGE_COUNT
+};
+
+/* 运行时开关，关闭时每个追踪点只有一次分支判断 */
+extern std::atomic<bool> trace_on;
+
+inline bool trace_enabled() {
+    return trace_on.load(std::memory_order_relaxed);
+}
+
+/* 读取时间戳计数器，在x86上为rdtsc，其他平台退化为单调时钟(ns) */
+inline uint64_t trace_now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+struct trace_span{
+    uint64_t begin;
+    uint64_t end;
+    uint16_t stage;
+    uint16_t tid;           /* 执行该阶段的线程编号 */
+};
+
+/* 每个连接持有一个，记录当前请求的各阶段，请求结束时决定是否提交 */
+class trace_ctx{
+public:
+    static const int MAX_SPANS = 16;
+
+private:
+    bool m_active;          /* 当前请求是否在记录 */
+    bool m_sampled;         /* 当前请求是否被采样 */
+    uint64_t m_seq;         /* 请求编号 */
+    uint64_t m_start;       /* 请求开始时间 */
+    uint64_t m_enqueue;     /* 加入线程池队列的时间 */
+    uint64_t m_accept[2];   /* 连接建立的时间，记入该连接的第一个请求 */
+    int m_count;
+    trace_span m_spans[MAX_SPANS];
+
+public:
+    trace_ctx() : m_active(false), m_sampled(false), m_seq(0), m_enqueue(0), m_count(0) {
+        m_accept[0] = m_accept[1] = 0;
+    }
+    void accept(uint64_t begin, uint64_t end) { m_accept[0] = begin; m_accept[1] = end; }
+    void begin(uint64_t now);                   /* 开始记录一个新请求 */
+    void add(TRACE_STAGE stage, uint64_t begin, uint64_t end);
+    void enqueue(uint64_t now) { if(m_active) m_enqueue = now; }
+    void dequeue(uint64_t now);
+    bool active() const { return m_active; }
+    /* 请求结束：若被采样或耗时超过阈值，则提交到当前线程的缓冲区 */
+    void commit(uint32_t conn_id, const char* name);
+    void reset() { m_active = false; m_count = 0; m_enqueue = 0; }
+};
+
+/* 在作用域内记录一个阶段 */
+class trace_scope{
+private:
+    trace_ctx& m_ctx;
+    TRACE_STAGE m_stage;
+    uint64_t m_begin;
+
+public:
+    trace_scope(trace_ctx& ctx, TRACE_STAGE stage) : m_ctx(ctx), m_stage(stage), m_begin(0) {
+        if(trace_enabled() && ctx.active()) {
+            m_begin = trace_now();
+        }
+    }
+    ~trace_scope() { finish(); }
+    /* 提前结束该阶段，用于在请求提交之前记录 */
+    void finish() {
+        if(m_begin) {
+            m_ctx.add(m_stage, m_begin, trace_now());
+            m_begin = 0;
+        }
+    }
+};
+
+void trace_init(int sample, int slow_us);   /* 设置采样率和慢请求阈值，并校准时钟 */
+bool trace_dump(const char* file);          /* 将各线程缓冲区中的记录写为Chrome trace JSON */
+
+#endif
@@ -0,0 +1,159 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:58
+ * @ Modified Time: 2026-10-19 23:59:58
+ * @ Description  : CPU绑定、NUMA节点上的内存分配及按接收CPU分配连接
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
+#include <linux/mempolicy.h>
+#include "../include/affinity.h"
+
+bool parse_cpu_list(const char* text, std::vector<int>& cpus){
+    cpus.clear();
+    const char* p = text;
+    while(true){
+        char* end;
+        long first = strtol(p, &end, 10);
+        if(end == p || first < 0){
+            return false;
+        }
+        long last = first;
+        p = end;
+        if(*p == '-'){
+            last = strtol(p + 1, &end, 10);
+            if(end == p + 1 || last < first){
+                return false;
+            }
+            p = end;
+        }
+        if(last >= CPU_SETSIZE){
+            return false;
+        }
+        for(long cpu = first; cpu <= last; ++cpu){
+            cpus.push_back((int)cpu);
+        }
+        if(*p == '\0'){
+            return true;
+        }
+        if(*p != ','){
+            return false;
+        }
+        ++p;
+    }
+}
+
+int cpu_node(int cpu){
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* dir = opendir(path);
+    if(! dir){
+        return -1;
+    }
+    /* CPU的目录中有指向所在节点的链接nodeN */
+    int node = -1;
+    while(dirent* entry = readdir(dir)){
+        if(strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9'){
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+bool pin_thread(pthread_t thread, int cpu){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+bool pin_attr(pthread_attr_t* attr, int cpu){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_attr_setaffinity_np(attr, sizeof(set), &set) == 0;
+}
+
+void* alloc_on_node(size_t size, int node){
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED){
+        return nullptr;
+    }
+    if(node >= 0){
+        /* 只设置策略，物理页在第一次访问时分配；没有NUMA的内核上失败，忽略即可。
+         * 直接调用系统调用，不依赖libnuma
+         */
+        const size_t bits = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> mask(node / bits + 1, 0);
+        mask[node / bits] |= 1ul << (node % bits);
+        syscall(SYS_mbind, p, size, MPOL_PREFERRED, mask.data(), mask.size() * bits + 1, 0);
+    }
+    return p;
+}
+
+void free_on_node(void* p, size_t size){
+    if(p){
+        munmap(p, size);
+    }
+}
+
+bool attach_rx_steering(int listenfd, const std::vector<int>& loop_cpus){
+    const int loops = loop_cpus.size();
+    long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    if(loops == 0 || ncpu <= 0){
+        return false;
+    }
+    /* 每个CPU对应的事件循环：绑定在该CPU上的，否则在同一节点的事件循环之间轮流分配 */
+    std::map<int, std::vector<int>> node_loops;
+    for(int i = 0; i < loops; ++i){
+        int node = cpu_node(loop_cpus[i]);
+        if(node >= 0){
+            node_loops[node].push_back(i);
+        }
+    }
+    std::map<int, int> node_next;
+    std::vector<struct sock_filter> code;
+    /* A = 处理该数据包的CPU */
+    code.push_back((struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (unsigned)(SKF_AD_OFF + SKF_AD_CPU)));
+    for(int cpu = 0; cpu < ncpu && cpu < CPU_SETSIZE; ++cpu){
+        int target = -1;
+        for(int i = 0; i < loops; ++i){
+            if(loop_cpus[i] == cpu){
+                target = i;
+                break;
+            }
+        }
+        if(target < 0){
+            int node = cpu_node(cpu);
+            auto it = node_loops.find(node);
+            if(it == node_loops.end()){
+                continue;
+            }
+            target = it->second[node_next[node]++ % it->second.size()];
+        }
+        code.push_back((struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (unsigned)cpu, 0, 1));
+        code.push_back((struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (unsigned)target));
+    }
+    /* 超出组中socket数的返回值使内核退回按哈希选择 */
+    code.push_back((struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (unsigned)loops));
+    if(code.size() > BPF_MAXINSNS){
+        return false;
+    }
+    struct sock_fprog prog;
+    prog.len = code.size();
+    prog.filter = code.data();
+    return setsockopt(listenfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0;
+}
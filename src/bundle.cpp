@@ -0,0 +1,74 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 21:36:50
+ * @ Modified Time: 2026-10-19 21:36:50
+ * @ Description  : 静态资源归档
+ */
+
+#include <cstring>
+#include <exception>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/bundle.h"
+
+bundle* bundle_ = nullptr;
+
+bundle::bundle(const string& file){
+    int fd = open(file.c_str(), O_RDONLY);
+    if(fd < 0){
+        throw std::exception();
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(bundle_header)){
+        close(fd);
+        throw std::exception();
+    }
+    m_size = st.st_size;
+    void* p = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED){
+        throw std::exception();
+    }
+    m_base = (char*)p;
+    m_header = (const bundle_header*)m_base;
+
+    /* 校验各个表都在文件范围内 */
+    const bundle_header& h = *m_header;
+    bool ok = memcmp(h.magic, BUNDLE_MAGIC, sizeof(h.magic)) == 0
+        && h.file_size == m_size
+        && h.bucket_count > 0 && h.slot_count >= h.entry_count
+        && h.disp_offset + (uint64_t)h.bucket_count * sizeof(uint32_t) <= m_size
+        && h.slot_offset + (uint64_t)h.slot_count * sizeof(uint32_t) <= m_size
+        && h.entry_offset + (uint64_t)h.entry_count * sizeof(bundle_entry) <= m_size;
+    if(! ok){
+        munmap(m_base, m_size);
+        throw std::exception();
+    }
+    m_disp = (const uint32_t*)(m_base + h.disp_offset);
+    m_slots = (const uint32_t*)(m_base + h.slot_offset);
+    m_entries = (const bundle_entry*)(m_base + h.entry_offset);
+}
+
+bundle::~bundle(){
+    munmap(m_base, m_size);
+}
+
+const bundle_entry* bundle::find(const char* path, size_t len) const{
+    if(m_header->entry_count == 0){
+        return nullptr;
+    }
+    uint32_t slot = bundle_slot(path, len, m_disp, m_header->bucket_count, m_header->slot_count);
+    uint32_t index = m_slots[slot];
+    if(index == BUNDLE_EMPTY){
+        return nullptr;
+    }
+    /* 完美哈希只保证已有路径不冲突，不存在的路径也会落到某个槽位，需要比较 */
+    const bundle_entry* e = m_entries + index;
+    if(e->path_len != len || memcmp(m_base + e->path_offset, path, len) != 0){
+        return nullptr;
+    }
+    return e;
+}
@@ -0,0 +1,104 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 16:02:27
+ * @ Modified Time: 2026-10-19 16:02:27
+ * @ Description  : 流量录制
+ */
+
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../include/capture.h"
+#include "../include/log.h"
+
+capture* capture_ = nullptr;
+
+static const size_t CAPTURE_FLUSH_SIZE = 256 * 1024;   /* 缓冲区超过该大小时立即写文件 */
+
+static uint64_t clock_us(clockid_t id){
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void func_capture(){    /* 定时器回调函数,写录制文件 */
+    capture_->flush();
+    capture_->set_expire(TIMESLOT);
+}
+
+capture::capture(const string& file, uint64_t limit){
+    m_fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(m_fd == -1){
+        throw std::exception();
+    }
+    m_start = clock_us(CLOCK_MONOTONIC);
+    m_written = 0;
+    m_limit = limit;
+    m_buf.reserve(CAPTURE_FLUSH_SIZE * 2);
+
+    capture_header header;
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.start_time = clock_us(CLOCK_REALTIME);
+    m_buf.append((const char*)&header, sizeof(header));
+
+    m_timer = new my_timer(TIMESLOT);
+    m_timer->cb_func = func_capture;
+    timer_->add_timer(m_timer);
+}
+
+capture::~capture(){
+    flush();
+    close(m_fd);
+}
+
+void capture::set_expire(int delay){
+    m_timer->expire = time(nullptr) + delay;
+}
+
+void capture::add(uint32_t conn_id, TYPE type, const char* data, uint32_t len){
+    capture_record rec;
+    rec.time = clock_us(CLOCK_MONOTONIC) - m_start;
+    rec.conn_id = conn_id;
+    rec.len = len;
+    rec.type = type;
+
+    bool full = false;
+    m_lock.lock();
+    if(m_written + m_buf.size() + sizeof(rec) + len <= m_limit){
+        m_buf.append((const char*)&rec, sizeof(rec));
+        if(len){
+            m_buf.append(data, len);
+        }
+        full = (m_buf.size() >= CAPTURE_FLUSH_SIZE);
+    }
+    m_lock.unlock();
+    if(full){
+        flush();
+    }
+}
+
+void capture::flush(){
+    string tmp;
+    tmp.reserve(CAPTURE_FLUSH_SIZE * 2);
+    m_flush_lock.lock();
+    m_lock.lock();
+    tmp.swap(m_buf);
+    m_lock.unlock();
+
+    size_t off = 0;
+    while(off < tmp.size()){
+        ssize_t n = write(m_fd, tmp.data() + off, tmp.size() - off);
+        if(n < 0){
+            log_->log("err", "capture.cpp", __LINE__, "capture file write failed");
+            break;
+        }
+        off += n;
+    }
+    m_lock.lock();
+    m_written += tmp.size();
+    m_lock.unlock();
+    m_flush_lock.unlock();
+}
@@ -0,0 +1,355 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 13:20:44
+ * @ Modified Time: 2026-10-19 13:20:44
+ * @ Description  : 服务器运行参数
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <libgen.h>
+#include "../include/config.h"
+#include "../include/affinity.h"
+
+config* config_ = new config;
+
+config::config(){
+    port = 0;
+    daemon = true;
+    doc_root = "/var/www";
+    thread_number = 8;
+    capture_limit = 1024;
+    trace = false;
+    trace_sample = 100;
+    trace_slow = 0;
+    trace_file = "trace.json";
+    direct_write = false;
+    cache_size = 0;
+    cache_max_file = 256;
+    io_threads = 0;
+    codel_target = 0;
+    codel_interval = 100;
+    bulk_size = 0;
+    write_quantum = 0;
+    index_files = {"index.html", "index.htm"};
+    autoindex = false;
+    keepalive_timeout = 15;
+    keepalive_requests = 1000;
+    upload_max = 0;
+    h2c = false;
+    h2_streams = 100;
+    tls_port = 0;
+    proxy_idle = 32;
+    proxy_timeout = 60;
+    conn_limit = 0;
+    rate_limit = 0;
+    rate_burst = 20;
+    event_loops = 1;
+    spin_us = 0;
+}
+
+void config::usage(const char* prog) const{
+    printf("usage: %s [options] port \n", prog);
+    printf("  -f, --foreground        run in the foreground instead of as a daemon\n");
+    printf("  -r, --doc-root=DIR      document root (default: /var/www)\n");
+    printf("  -b, --bundle=FILE       serve everything from an archive built by webserver_pack\n");
+    printf("  -t, --threads=N         number of worker threads (default: 8)\n");
+    printf("      --capture=FILE      record raw request bytes to FILE for webserver_replay\n");
+    printf("      --capture-limit=MB  stop recording when FILE reaches MB (default: 1024)\n");
+    printf("      --trace             start with request tracing enabled (SIGUSR2 toggles it)\n");
+    printf("      --trace-sample=N    trace one in N requests, 0 = none (default: 100)\n");
+    printf("      --trace-slow=US     also trace every request slower than US microseconds\n");
+    printf("      --trace-file=FILE   where SIGUSR1 writes the Chrome trace (default: trace.json)\n");
+    printf("      --direct-write      send responses from the worker thread, fall back to EPOLLOUT on EAGAIN\n");
+    printf("      --cache-size=MB     small file cache, hits are served on the I/O thread, 0 = off (default: 0)\n");
+    printf("      --cache-max-file=KB largest file kept in the cache, at most 2047 (default: 256)\n");
+    printf("      --io-threads=N      threads that fault in files missing from the page cache, 0 = off (default: 0)\n");
+    printf("      --codel-target=MS   answer 503 once queueing delay stays above MS, 0 = off (default: 0)\n");
+    printf("      --codel-interval=MS how long the delay must stay above target (default: 100)\n");
+    printf("      --bulk-size=KB      responses this large go to the low priority lane, 0 = off (default: 0)\n");
+    printf("      --write-quantum=KB  bytes sent per connection before yielding to others, 0 = unlimited (default: 0)\n");
+    printf("      --index=LIST        comma separated index files tried for a directory (default: index.html,index.htm)\n");
+    printf("      --autoindex         list directories that have no index file instead of answering 403\n");
+    printf("      --keepalive-timeout=S  close connections idle for S seconds, 0 = no keep-alive (default: 15)\n");
+    printf("      --keepalive-requests=N requests served on one connection, 0 = unlimited (default: 1000)\n");
+    printf("      --upload-max=MB     accept PUT/POST uploads into the document root up to MB, 0 = off (default: 0)\n");
+    printf("      --h2c               accept cleartext HTTP/2 by prior knowledge or Upgrade: h2c\n");
+    printf("      --h2-streams=N      concurrent streams per HTTP/2 connection (default: 100)\n");
+    printf("      --tls-port=PORT     also listen for TLS on PORT, 0 = off (default: 0)\n");
+    printf("      --tls-cert=FILE     PEM certificate chain for the TLS listener\n");
+    printf("      --tls-key=FILE      PEM private key (default: read from --tls-cert)\n");
+    printf("      --proxy=PREFIX=HOST:PORT[,HOST:PORT...]  forward PREFIX to upstream servers, may be repeated\n");
+    printf("      --proxy-idle=N      idle keep-alive connections kept per upstream (default: 32)\n");
+    printf("      --proxy-timeout=S   fail a proxied request after S seconds without progress, 0 = off (default: 60)\n");
+    printf("      --proxy-check=PATH  health check upstreams with GET PATH instead of a bare connect\n");
+    printf("      --status=PATH       answer GET PATH with connection and cache counters as plain text\n");
+    printf("      --conn-limit=N      connections one client IP may hold open, 0 = unlimited (default: 0)\n");
+    printf("      --rate-limit=N      requests per second per client IP, 0 = unlimited (default: 0)\n");
+    printf("      --rate-burst=N      requests a client IP may send at once above the rate (default: 20)\n");
+    printf("      --event-loops=N     epoll threads sharing the port with SO_REUSEPORT (default: 1)\n");
+    printf("      --cpu-affinity=LIST pin event loops, then worker and I/O threads, to CPUs like 0-3,8 (default: off)\n");
+    printf("      --spin-us=US        idle workers and event loops poll up to US before sleeping, adapts to load, 0 = off (default: 0)\n");
+}
+
+bool config::parse(int argc, char* argv[]){
+    static const struct option long_options[] = {
+        {"foreground", no_argument, nullptr, 'f'},
+        {"doc-root", required_argument, nullptr, 'r'},
+        {"bundle", required_argument, nullptr, 'b'},
+        {"threads", required_argument, nullptr, 't'},
+        {"capture", required_argument, nullptr, 1},
+        {"capture-limit", required_argument, nullptr, 2},
+        {"trace", no_argument, nullptr, 3},
+        {"trace-sample", required_argument, nullptr, 4},
+        {"trace-slow", required_argument, nullptr, 5},
+        {"trace-file", required_argument, nullptr, 6},
+        {"direct-write", no_argument, nullptr, 7},
+        {"cache-size", required_argument, nullptr, 8},
+        {"cache-max-file", required_argument, nullptr, 9},
+        {"io-threads", required_argument, nullptr, 10},
+        {"codel-target", required_argument, nullptr, 11},
+        {"codel-interval", required_argument, nullptr, 12},
+        {"bulk-size", required_argument, nullptr, 13},
+        {"write-quantum", required_argument, nullptr, 14},
+        {"index", required_argument, nullptr, 15},
+        {"autoindex", no_argument, nullptr, 16},
+        {"keepalive-timeout", required_argument, nullptr, 17},
+        {"keepalive-requests", required_argument, nullptr, 18},
+        {"upload-max", required_argument, nullptr, 19},
+        {"h2c", no_argument, nullptr, 20},
+        {"h2-streams", required_argument, nullptr, 21},
+        {"tls-port", required_argument, nullptr, 22},
+        {"tls-cert", required_argument, nullptr, 23},
+        {"tls-key", required_argument, nullptr, 24},
+        {"proxy", required_argument, nullptr, 25},
+        {"proxy-idle", required_argument, nullptr, 26},
+        {"proxy-timeout", required_argument, nullptr, 27},
+        {"proxy-check", required_argument, nullptr, 28},
+        {"status", required_argument, nullptr, 29},
+        {"conn-limit", required_argument, nullptr, 30},
+        {"rate-limit", required_argument, nullptr, 31},
+        {"rate-burst", required_argument, nullptr, 32},
+        {"event-loops", required_argument, nullptr, 33},
+        {"cpu-affinity", required_argument, nullptr, 34},
+        {"spin-us", required_argument, nullptr, 35},
+        {nullptr, 0, nullptr, 0}
+    };
+    char* prog = basename(argv[0]);
+    int opt = 0;
+    while((opt = getopt_long(argc, argv, "fr:b:t:", long_options, nullptr)) != -1){
+        switch(opt){
+            case 'f':
+                daemon = false;
+                break;
+            case 'r':
+                doc_root = optarg;
+                /* 去掉末尾的'/'，url总是以'/'开头 */
+                while(doc_root.size() > 1 && doc_root.back() == '/'){
+                    doc_root.pop_back();
+                }
+                break;
+            case 'b':
+                bundle_file = optarg;
+                break;
+            case 't':
+                thread_number = atoi(optarg);
+                if(thread_number <= 0){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 1:
+                capture_file = optarg;
+                break;
+            case 2:
+                capture_limit = atol(optarg);
+                break;
+            case 3:
+                trace = true;
+                break;
+            case 4:
+                trace_sample = atoi(optarg);
+                break;
+            case 5:
+                trace_slow = atoi(optarg);
+                break;
+            case 6:
+                trace_file = optarg;
+                break;
+            case 7:
+                direct_write = true;
+                break;
+            case 8:
+                cache_size = atol(optarg);
+                break;
+            case 9:
+                cache_max_file = atol(optarg);
+                /* 缓存项连同应答头部不能超过一个slab（2MB） */
+                if(cache_max_file < 0 || cache_max_file > 2047){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 10:
+                io_threads = atoi(optarg);
+                break;
+            case 11:
+                codel_target = atoi(optarg);
+                break;
+            case 12:
+                codel_interval = atoi(optarg);
+                if(codel_interval <= 0){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 13:
+                bulk_size = atol(optarg);
+                break;
+            case 14:
+                write_quantum = atol(optarg);
+                break;
+            case 15: {
+                /* 为空时不查找index文件 */
+                index_files.clear();
+                string list = optarg;
+                size_t begin = 0;
+                while(begin <= list.size()){
+                    size_t end = list.find(',', begin);
+                    if(end == string::npos){
+                        end = list.size();
+                    }
+                    string name = list.substr(begin, end - begin);
+                    if(name.find('/') != string::npos){
+                        usage(prog);
+                        return false;
+                    }
+                    if(! name.empty()){
+                        index_files.push_back(name);
+                    }
+                    begin = end + 1;
+                }
+                break;
+            }
+            case 16:
+                autoindex = true;
+                break;
+            case 17:
+                keepalive_timeout = atoi(optarg);
+                break;
+            case 18:
+                keepalive_requests = atoi(optarg);
+                break;
+            case 19:
+                upload_max = atol(optarg);
+                if(upload_max < 0){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 20:
+                h2c = true;
+                break;
+            case 21:
+                h2_streams = atoi(optarg);
+                if(h2_streams <= 0){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 22:
+                tls_port = atoi(optarg);
+                if(tls_port < 0 || tls_port > 65535){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 23:
+                tls_cert = optarg;
+                break;
+            case 24:
+                tls_key = optarg;
+                break;
+            case 25:
+                /* 前缀与上游地址由proxy在启动时解析 */
+                proxy_routes.push_back(optarg);
+                break;
+            case 26:
+                proxy_idle = atoi(optarg);
+                if(proxy_idle < 0){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 27:
+                proxy_timeout = atoi(optarg);
+                break;
+            case 28:
+                proxy_check = optarg;
+                if(proxy_check[0] != '/'){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 29:
+                status_path = optarg;
+                if(status_path[0] != '/'){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 30:
+                conn_limit = atoi(optarg);
+                break;
+            case 31:
+                rate_limit = atoi(optarg);
+                break;
+            case 32:
+                rate_burst = atoi(optarg);
+                if(rate_burst < 1){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 33:
+                event_loops = atoi(optarg);
+                if(event_loops < 1){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 34:
+                if(! parse_cpu_list(optarg, cpu_affinity)){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            case 35:
+                spin_us = atoi(optarg);
+                if(spin_us < 0 || spin_us > 100000){
+                    usage(prog);
+                    return false;
+                }
+                break;
+            default:
+                usage(prog);
+                return false;
+        }
+    }
+    if(optind >= argc){
+        usage(prog);
+        return false;
+    }
+    port = atoi(argv[optind]);
+    /* 私钥与证书可以在同一个PEM文件中 */
+    if(tls_key.empty()){
+        tls_key = tls_cert;
+    }
+    if(tls_port > 0 && tls_cert.empty()){
+        usage(prog);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:57
+ * @ Modified Time: 2026-10-19 23:59:57
+ * @ Description  : 连接表：按需分配的http_conn池及epoll事件的世代标记
+ */
+
+#include <exception>
+#include <new>
+#include "../include/conn_table.h"
+#include "../include/affinity.h"
+
+conn_table::~conn_table(){
+    for(http_conn* block : m_blocks){
+        for(int i = 0; i < BLOCK_SLOTS; ++i){
+            block[i].~http_conn();
+        }
+        free_on_node(block, sizeof(http_conn) * BLOCK_SLOTS);
+    }
+}
+
+http_conn* conn_table::acquire(){
+    m_lock.lock();
+    if(! m_free.empty()){
+        http_conn* conn = m_free.back();
+        m_free.pop_back();
+        m_lock.unlock();
+        return conn;
+    }
+    m_lock.unlock();
+
+    /* 没有空闲的连接，分配新的一块，除第一个外都放入空闲链表 */
+    http_conn* block = static_cast<http_conn*>(alloc_on_node(sizeof(http_conn) * BLOCK_SLOTS, m_node));
+    if(! block){
+        throw std::exception();
+    }
+    /* 地址的高16位用来存放世代，用户空间的地址不会超过47位 */
+    if((uintptr_t)(block + BLOCK_SLOTS) > ADDR_MASK){
+        free_on_node(block, sizeof(http_conn) * BLOCK_SLOTS);
+        throw std::exception();
+    }
+    for(int i = 0; i < BLOCK_SLOTS; ++i){
+        http_conn* conn = new (block + i) http_conn;
+        conn->m_epollfd = m_epollfd;
+        conn->m_table = this;
+    }
+    m_blocks.push_back(block);
+    m_lock.lock();
+    for(int i = BLOCK_SLOTS - 1; i > 0; --i){
+        m_free.push_back(block + i);
+    }
+    m_lock.unlock();
+    return block;
+}
+
+void conn_table::release(http_conn* conn){
+    m_lock.lock();
+    m_free.push_back(conn);
+    m_lock.unlock();
+}
@@ -0,0 +1,241 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:41:27
+ * @ Modified Time: 2026-10-19 23:41:27
+ * @ Description  : 目录请求的处理方式缓存
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <dirent.h>
+#include "../include/dir_index.h"
+#include "../include/http_conn.h"
+#include "../include/http_content_type.h"
+
+dir_index* dir_index_ = nullptr;
+
+using std::pair;
+using std::vector;
+
+dir_index::dir_index(const vector<string>& index_files, bool autoindex)
+    : m_index_files(index_files), m_autoindex(autoindex){
+}
+
+/* 目录路径去掉末尾的'/'作为key，"/docs"与"/docs/"对应同一项 */
+static void dir_key(const char* dir, string& key){
+    key.assign(dir);
+    while(key.size() > 1 && key.back() == '/'){
+        key.pop_back();
+    }
+}
+
+/* 转义文件名中的html特殊字符 */
+static void append_escaped(string& out, const string& s){
+    for(char c : s){
+        switch(c){
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            default: out += c;
+        }
+    }
+}
+
+/* 读取目录中的文件名并排序，只列出文件名：文件内容的修改不会改变目录的mtime，
+ * 页面中若包含大小或修改时间就无法按目录的mtime缓存；以'.'开头的文件不列出
+ */
+static bool read_names(const string& dir, vector<pair<string, bool>>& names){
+    DIR* d = opendir(dir.c_str());
+    if(! d){
+        return false;
+    }
+    while(struct dirent* e = readdir(d)){
+        if(e->d_name[0] == '.'){
+            continue;
+        }
+        bool is_dir = (e->d_type == DT_DIR);
+        if(e->d_type == DT_LNK || e->d_type == DT_UNKNOWN){
+            struct stat link_st;
+            is_dir = stat((dir + "/" + e->d_name).c_str(), &link_st) == 0 && S_ISDIR(link_st.st_mode);
+        }
+        names.emplace_back(e->d_name, is_dir);
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    return true;
+}
+
+/* 页头，第一次请求可能是被重定向的不以'/'结尾的url */
+static void listing_head(string& out, const string& url){
+    string title = url;
+    if(title.back() != '/'){
+        title += '/';
+    }
+    out += "<html><head><title>Index of ";
+    append_escaped(out, title);
+    out += "</title></head><body><h1>Index of ";
+    append_escaped(out, title);
+    out += "</h1><hr><pre>\n";
+    if(title != "/"){
+        out += "<a href=\"../\">../</a>\n";
+    }
+}
+
+/* 一个目录项，href为复用的编码缓冲区 */
+static void listing_item(string& out, const pair<string, bool>& name, vector<char>& href){
+    const char* slash = name.second ? "/" : "";
+    href.resize(name.first.size() * 3 + 1);
+    urlEncode(name.first.c_str(), href.data());
+    out += "<a href=\"";
+    append_escaped(out, href.data());
+    out += slash;
+    out += "\">";
+    append_escaped(out, name.first);
+    out += slash;
+    out += "</a>\n";
+}
+
+static const char listing_tail[] = "</pre><hr></body></html>\n";
+
+bool dir_index::get(const char* dir, dir_entry_ptr& entry){
+    /* 复用线程私有的key，命中时不分配内存 */
+    static thread_local string key;
+    dir_key(dir, key);
+    m_lock.lock();
+    auto it = m_dirs.find(key);
+    if(it == m_dirs.end()){
+        m_lock.unlock();
+        return false;
+    }
+    entry = it->second;
+    m_lock.unlock();
+    if(entry->checked.load(std::memory_order_relaxed) != time(nullptr)){
+        entry.reset();
+        return false;
+    }
+    return true;
+}
+
+dir_entry_ptr dir_index::resolve(const char* dir, const struct stat& st, const char* url){
+    /* 目录未变化时同样不分配内存 */
+    static thread_local string key;
+    dir_key(dir, key);
+    time_t now = time(nullptr);
+    m_lock.lock();
+    auto it = m_dirs.find(key);
+    if(it != m_dirs.end() && it->second->mtime.tv_sec == st.st_mtim.tv_sec
+            && it->second->mtime.tv_nsec == st.st_mtim.tv_nsec && it->second->ino == st.st_ino){
+        dir_entry_ptr entry = it->second;
+        m_lock.unlock();
+        entry->checked.store(now, std::memory_order_relaxed);
+        return entry;
+    }
+    m_lock.unlock();
+
+    /* 目录是新的或已被修改，在锁外查找index文件或生成目录列表 */
+    dir_entry_ptr entry = std::make_shared<dir_entry>();
+    entry->mtime = st.st_mtim;
+    entry->ino = st.st_ino;
+    entry->checked.store(now, std::memory_order_relaxed);
+    for(const string& name : m_index_files){
+        string path = key + "/" + name;
+        struct stat index_st;
+        if(stat(path.c_str(), &index_st) == 0 && S_ISREG(index_st.st_mode)){
+            entry->kind = dir_entry::INDEX;
+            entry->index = path;
+            break;
+        }
+    }
+    if(entry->kind != dir_entry::INDEX && m_autoindex && read_names(key, entry->names)){
+        if(entry->names.size() > STREAM_ENTRIES){
+            entry->kind = dir_entry::STREAMED;
+        }
+        else{
+            entry->listing = render(*entry, key, url);
+            vector<pair<string, bool>>().swap(entry->names);
+            if(entry->listing){
+                entry->kind = dir_entry::LISTING;
+            }
+        }
+    }
+
+    m_lock.lock();
+    if(m_dirs.size() >= MAX_DIRS){
+        m_dirs.clear();
+    }
+    m_dirs[key] = entry;
+    m_lock.unlock();
+    return entry;
+}
+
+void dir_index::clear(){
+    m_lock.lock();
+    m_dirs.clear();
+    m_lock.unlock();
+}
+
+/* 生成整个目录列表页 */
+cache_entry_ptr dir_index::render(const dir_entry& entry, const string& dir, const char* url){
+    string body;
+    listing_head(body, url);
+    vector<char> href;
+    for(const auto& name : entry.names){
+        listing_item(body, name, href);
+    }
+    body += listing_tail;
+
+    cache_entry_ptr e = std::make_shared<cache_entry>();
+    e->path = dir;
+    e->size = body.size();
+    e->mtime = entry.mtime.tv_sec;
+    e->ino = entry.ino;
+    struct tm tm_buf;
+    strftime(e->last_modified, sizeof(e->last_modified), "%a, %d %b %Y %H:%M:%S GMT",
+        gmtime_r(&e->mtime, &tm_buf));
+    char headers[file_cache::MAX_HEADER];
+    int header_len = snprintf(headers, sizeof(headers),
+        "Content-Length: %zu\r\nLast-Modified: %s\r\nContent-Type: %s; charset=utf-8\r\n",
+        e->size, e->last_modified, get_content_type(".html"));
+    if(header_len < 0 || header_len >= (int)sizeof(headers)){
+        return nullptr;
+    }
+    e->chunk = new char[header_len + e->size];
+    e->chunk_size = header_len + e->size;
+    memcpy(e->chunk, headers, header_len);
+    e->headers = e->chunk;
+    e->header_len = header_len;
+    e->data = e->chunk + header_len;
+    memcpy(e->data, body.data(), e->size);
+    return e;
+}
+
+listing_producer::listing_producer(const dir_entry_ptr& dir, const char* url)
+    : m_dir(dir), m_title(url), m_next(0), m_head(false){
+}
+
+body_producer::STATUS listing_producer::next(const char** data, size_t* len){
+    const auto& names = m_dir->names;
+    if(m_next > names.size()){
+        return PRODUCE_END;
+    }
+    static thread_local vector<char> href;
+    m_buf.clear();
+    if(! m_head){
+        listing_head(m_buf, m_title);
+        m_head = true;
+    }
+    size_t end = std::min(m_next + BATCH, names.size());
+    for(; m_next < end; ++m_next){
+        listing_item(m_buf, names[m_next], href);
+    }
+    if(m_next == names.size()){
+        m_buf += listing_tail;
+        ++m_next;
+    }
+    *data = m_buf.data();
+    *len = m_buf.size();
+    return PRODUCE_DATA;
+}
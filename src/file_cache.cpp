@@ -0,0 +1,424 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 19:48:06
+ * @ Modified Time: 2026-10-19 19:48:06
+ * @ Description  : 小文件内容缓存，W-TinyLFU淘汰
+ */
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <list>
+#include <unordered_map>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../include/file_cache.h"
+#include "../include/log.h"
+
+file_cache* file_cache_ = nullptr;
+
+/* 定义文件名,用于记录日志 */
+static const string this_file = "file_cache.cpp";
+
+void func_cache_stats(){    /* 定时器回调函数,记录缓存统计信息 */
+    file_cache_->report();
+    file_cache_->set_expire(TIMESLOT * 6);
+}
+
+/* 访问频率的估计：4行4位计数器（存为uint8_t，上限15），取各行的最小值；
+ * 计数总数达到计数器个数的10倍时全部减半，使频率反映近期的访问
+ */
+class frequency_sketch{
+private:
+    std::vector<uint8_t> m_table;
+    uint32_t m_mask;
+    uint32_t m_additions;
+    uint32_t m_sample;
+
+    uint32_t index(uint64_t h, int row) const {
+        static const uint64_t seeds[4] = {0xc3a5c85c97cb3127ull, 0xb492b66fbe98f273ull,
+            0x9ae16a3b2f90404full, 0xcbf29ce484222325ull};
+        uint64_t x = (h + seeds[row]) * seeds[(row + 1) & 3];
+        return (uint32_t)(x >> 32) & m_mask;
+    }
+
+public:
+    void init(size_t expected) {
+        size_t width = 64;
+        while(width < expected) {
+            width <<= 1;
+        }
+        m_table.assign(width * 4, 0);
+        m_mask = width - 1;
+        m_additions = 0;
+        m_sample = width * 10;
+    }
+    void add(uint64_t h) {
+        bool added = false;
+        for(int row = 0; row < 4; ++row) {
+            uint8_t& c = m_table[row * (m_mask + 1) + index(h, row)];
+            if(c < 15) {
+                ++c;
+                added = true;
+            }
+        }
+        if(added && ++m_additions >= m_sample) {
+            for(uint8_t& c : m_table) {
+                c >>= 1;
+            }
+            m_additions /= 2;
+        }
+    }
+    uint8_t frequency(uint64_t h) const {
+        uint8_t f = 15;
+        for(int row = 0; row < 4; ++row) {
+            uint8_t c = m_table[row * (m_mask + 1) + index(h, row)];
+            f = (c < f) ? c : f;
+        }
+        return f;
+    }
+};
+
+/* 一个分片：窗口区、试用区、保护区三条LRU链表，最近访问的在前 */
+struct file_cache::shard{
+    enum SEGMENT { WINDOW = 0, PROBATION, PROTECTED, SEGMENT_COUNT };
+    typedef std::list<cache_entry_ptr> lru_list;
+    struct node{
+        lru_list::iterator it;
+        int seg;
+    };
+
+    locker lock;
+    std::unordered_map<string, node> map;
+    lru_list lists[SEGMENT_COUNT];
+    size_t bytes[SEGMENT_COUNT];
+    size_t window_cap;
+    size_t main_cap;
+    size_t protected_cap;
+    frequency_sketch sketch;
+    uint64_t hits, misses, inserts, rejects, evictions, invalidations;
+
+    explicit shard(size_t capacity) {
+        /* 大于窗口区的文件进入窗口后立即参与准入比较 */
+        window_cap = capacity / 100;
+        main_cap = capacity > window_cap ? capacity - window_cap : 0;
+        protected_cap = main_cap / 5 * 4;
+        for(int i = 0; i < SEGMENT_COUNT; ++i) {
+            bytes[i] = 0;
+        }
+        sketch.init(capacity / 4096);
+        hits = misses = inserts = rejects = evictions = invalidations = 0;
+    }
+
+    static uint64_t hash(const string& path) { return std::hash<string>()(path); }
+
+    void move(node& n, int seg) {
+        size_t size = (*n.it)->chunk_size;
+        lists[seg].splice(lists[seg].begin(), lists[n.seg], n.it);
+        bytes[n.seg] -= size;
+        bytes[seg] += size;
+        n.seg = seg;
+    }
+
+    void remove(std::unordered_map<string, node>::iterator it) {
+        node& n = it->second;
+        bytes[n.seg] -= (*n.it)->chunk_size;
+        lists[n.seg].erase(n.it);
+        map.erase(it);
+    }
+
+    /* 命中：试用区中的文件晋升到保护区，保护区超出容量时最久未访问的降回试用区 */
+    void touch(node& n) {
+        if(n.seg == PROBATION) {
+            move(n, PROTECTED);
+            while(bytes[PROTECTED] > protected_cap && lists[PROTECTED].size() > 1) {
+                move(map.find(lists[PROTECTED].back()->path)->second, PROBATION);
+            }
+        }
+        else {
+            lists[n.seg].splice(lists[n.seg].begin(), lists[n.seg], n.it);
+        }
+    }
+
+    void insert(const cache_entry_ptr& e) {
+        auto it = map.find(e->path);
+        if(it != map.end()) {
+            remove(it);
+        }
+        lists[WINDOW].push_front(e);
+        bytes[WINDOW] += e->chunk_size;
+        map[e->path] = node{lists[WINDOW].begin(), WINDOW};
+
+        /* 窗口区超出容量：被挤出的文件与主区中即将被淘汰的文件比较访问频率 */
+        while(bytes[WINDOW] > window_cap) {
+            node& cand = map.find(lists[WINDOW].back()->path)->second;
+            size_t size = (*cand.it)->chunk_size;
+            uint8_t freq = sketch.frequency(hash((*cand.it)->path));
+            bool admit = size <= main_cap;
+            while(admit && bytes[PROBATION] + bytes[PROTECTED] + size > main_cap) {
+                lru_list& victims = lists[PROBATION].empty() ? lists[PROTECTED] : lists[PROBATION];
+                const string& victim = victims.back()->path;
+                if(freq <= sketch.frequency(hash(victim))) {
+                    admit = false;
+                    break;
+                }
+                remove(map.find(victim));
+                ++evictions;
+            }
+            if(admit) {
+                move(cand, PROBATION);
+                ++inserts;
+            }
+            else {
+                remove(map.find((*cand.it)->path));
+                ++rejects;
+            }
+        }
+    }
+};
+
+file_cache::file_cache(size_t capacity, size_t max_file){
+    m_capacity = capacity;
+    m_max_file = max_file;
+    m_watched = false;
+    m_generation = 0;
+    size_t max_chunk = max_file + MAX_HEADER;
+    for(int i = 0; i < SHARD_COUNT; ++i){
+        m_shards.push_back(new shard(capacity / SHARD_COUNT));
+    }
+    /* 内存池预留失败时退回到new[]，只是失去大页 */
+    try {
+        m_pool = new slab_pool(capacity, max_chunk);
+    }
+    catch(...) {
+        m_pool = nullptr;
+    }
+    m_timer = new my_timer(TIMESLOT * 6);          /* 每1分钟记录一次统计信息 */
+    m_timer->cb_func = func_cache_stats;
+    timer_->add_timer(m_timer);
+}
+
+file_cache::~file_cache(){
+    /* 定时器由时间堆释放，这里只让它不再到期 */
+    m_timer->cb_func = nullptr;
+    m_timer->expire = std::numeric_limits<time_t>::max();
+    for(shard* s : m_shards){
+        delete s;
+    }
+    /* 被连接持有的缓存项可能晚于缓存释放，内存池不随缓存销毁 */
+}
+
+void file_cache::set_expire(int delay){
+    m_timer->expire = time(nullptr) + delay;
+}
+
+bool file_cache::get(const char* path, cache_entry_ptr& entry){
+    /* 复用线程私有的key，命中时不分配内存 */
+    static thread_local string key;
+    key.assign(path);
+    uint64_t h = shard::hash(key);
+    shard* s = shard_of(h);
+
+    s->lock.lock();
+    s->sketch.add(h);
+    auto it = s->map.find(key);
+    if(it == s->map.end()){
+        ++s->misses;
+        s->lock.unlock();
+        return false;
+    }
+    s->touch(it->second);
+    entry = *it->second.it;
+    ++s->hits;
+    s->lock.unlock();
+
+    /* 由inotify监视的文件被修改时缓存项已被删除，无需校验 */
+    if(entry->watched){
+        return true;
+    }
+    /* 校验文件是否被修改，stat在锁外进行 */
+    time_t now = time(nullptr);
+    if(entry->checked.load(std::memory_order_relaxed) != now){
+        struct stat st;
+        if(stat(path, &st) < 0 || st.st_mtime != entry->mtime
+                || st.st_ino != entry->ino || (size_t)st.st_size != entry->size){
+            s->lock.lock();
+            it = s->map.find(key);
+            if(it != s->map.end() && *it->second.it == entry){
+                s->remove(it);
+                ++s->invalidations;
+            }
+            /* 实际未命中 */
+            --s->hits;
+            ++s->misses;
+            s->lock.unlock();
+            entry.reset();
+            return false;
+        }
+        entry->checked.store(now, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool file_cache::load(const char* path, const struct stat& st, const char* content_type, cache_entry_ptr& entry){
+    if((size_t)st.st_size > m_max_file){
+        return false;
+    }
+    /* 先记下失效计数再打开文件：读取期间若收到该文件的修改事件，读到的内容可能已过时 */
+    uint64_t generation = m_generation.load();
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        return false;
+    }
+    /* 调用者stat之后文件可能已被替换，以打开的文件为准 */
+    struct stat cur;
+    if(fstat(fd, &cur) < 0 || cur.st_ino != st.st_ino || cur.st_size != st.st_size
+            || cur.st_mtime != st.st_mtime){
+        close(fd);
+        return false;
+    }
+    cache_entry_ptr e = std::make_shared<cache_entry>();
+    e->path = path;
+    e->size = st.st_size;
+    e->mtime = st.st_mtime;
+    e->ino = st.st_ino;
+    e->checked.store(time(nullptr), std::memory_order_relaxed);
+    struct tm tm_buf;
+    strftime(e->last_modified, sizeof(e->last_modified), "%a, %d %b %Y %H:%M:%S GMT",
+        gmtime_r(&e->mtime, &tm_buf));
+
+    /* 应答头部与文件内容放在同一块内存中，命中时不需要再格式化 */
+    char headers[MAX_HEADER];
+    int header_len = snprintf(headers, sizeof(headers),
+        "Content-Length: %zu\r\nLast-Modified: %s\r\nContent-Type: %s; charset=utf-8\r\n",
+        e->size, e->last_modified, content_type);
+    if(header_len < 0 || header_len >= (int)sizeof(headers)){
+        close(fd);
+        return false;
+    }
+    size_t need = header_len + e->size;
+    e->chunk = m_pool ? (char*)m_pool->alloc(need, &e->chunk_size) : nullptr;
+    if(e->chunk){
+        e->pool = m_pool;
+    }
+    else{
+        e->chunk = new char[need];
+        e->chunk_size = need;
+    }
+    memcpy(e->chunk, headers, header_len);
+    e->headers = e->chunk;
+    e->header_len = header_len;
+    e->data = e->chunk + header_len;
+    size_t done = 0;
+    while(done < e->size){
+        ssize_t n = pread(fd, e->data + done, e->size - done, done);
+        if(n <= 0){     /* 读取出错或文件被截断 */
+            close(fd);
+            return false;
+        }
+        done += n;
+    }
+    close(fd);
+
+    /* 路径中有符号链接时，目标文件的修改不会通知到网站根目录下，仍需定时校验 */
+    if(m_watched){
+        char real[PATH_MAX];
+        e->watched = realpath(path, real) && strncmp(path, m_root.c_str(), m_root.size()) == 0
+            && m_real_root + (path + m_root.size()) == real;
+    }
+
+    shard* s = shard_of(shard::hash(e->path));
+    s->lock.lock();
+    if(m_generation.load() == generation){
+        s->insert(e);
+    }
+    /* 否则内容仍可用于本次应答，但不加入缓存 */
+    s->lock.unlock();
+    entry = e;
+    return true;
+}
+
+cache_stats file_cache::stats() const{
+    cache_stats st;
+    memset(&st, 0, sizeof(st));
+    for(shard* s : m_shards){
+        s->lock.lock();
+        st.hits += s->hits;
+        st.misses += s->misses;
+        st.inserts += s->inserts;
+        st.rejects += s->rejects;
+        st.evictions += s->evictions;
+        st.invalidations += s->invalidations;
+        for(int i = 0; i < shard::SEGMENT_COUNT; ++i){
+            st.bytes += s->bytes[i];
+        }
+        st.entries += s->map.size();
+        s->lock.unlock();
+    }
+    return st;
+}
+
+void file_cache::report() const{
+    cache_stats st = stats();
+    uint64_t lookups = st.hits + st.misses;
+    char buf[256];
+    snprintf(buf, sizeof(buf), "Cache: hit ratio %.1f%% (%llu/%llu), %zu files, %.1f/%.1f MB, "
+        "admitted %llu, rejected %llu, evicted %llu, invalidated %llu",
+        lookups ? st.hits * 100.0 / lookups : 0.0, (unsigned long long)st.hits, (unsigned long long)lookups,
+        st.entries, st.bytes / 1048576.0, m_capacity / 1048576.0, (unsigned long long)st.inserts,
+        (unsigned long long)st.rejects, (unsigned long long)st.evictions, (unsigned long long)st.invalidations);
+    log_->log("msg", this_file, __LINE__, buf);
+}
+
+void file_cache::watch(const string& root){
+    char real[PATH_MAX];
+    m_root = root;
+    m_real_root = realpath(root.c_str(), real) ? real : root;
+    m_watched = true;
+}
+
+void file_cache::invalidate(const string& path){
+    ++m_generation;
+    shard* s = shard_of(shard::hash(path));
+    s->lock.lock();
+    auto it = s->map.find(path);
+    if(it != s->map.end()){
+        s->remove(it);
+        ++s->invalidations;
+    }
+    s->lock.unlock();
+}
+
+void file_cache::invalidate_tree(const string& dir){
+    ++m_generation;
+    string prefix = dir + "/";
+    for(shard* s : m_shards){
+        s->lock.lock();
+        for(auto it = s->map.begin(); it != s->map.end(); ){
+            auto next = std::next(it);
+            if(it->first.compare(0, prefix.size(), prefix) == 0){
+                s->remove(it);
+                ++s->invalidations;
+            }
+            it = next;
+        }
+        s->lock.unlock();
+    }
+}
+
+void file_cache::clear(){
+    ++m_generation;
+    for(shard* s : m_shards){
+        s->lock.lock();
+        s->invalidations += s->map.size();
+        for(int i = 0; i < shard::SEGMENT_COUNT; ++i){
+            s->lists[i].clear();
+            s->bytes[i] = 0;
+        }
+        s->map.clear();
+        s->lock.unlock();
+    }
+}
@@ -0,0 +1,194 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 22:24:38
+ * @ Modified Time: 2026-10-19 22:24:38
+ * @ Description  : 监视网站根目录，文件变化时使缓存失效
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <exception>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "../include/fs_watch.h"
+#include "../include/log.h"
+
+fs_watch* fs_watch_ = nullptr;
+
+/* 定义文件名,用于记录日志 */
+static const string this_file = "fs_watch.cpp";
+
+/* 目录自身的事件只关心根目录被删除或移动，子目录的变化由其父目录的事件通知 */
+static const uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+    | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+fs_watch::fs_watch(const string& root, file_cache* cache) : m_root(root), m_cache(cache), m_rescan(false){
+    m_fd = inotify_init1(IN_CLOEXEC);
+    if(m_fd < 0){
+        throw std::exception();
+    }
+    /* 超出fs.inotify.max_user_watches时无法保证缓存及时失效，保持定时校验 */
+    if(! add_tree(m_root)){
+        close(m_fd);
+        throw std::exception();
+    }
+    m_cache->watch(m_root);
+    if(pthread_create(&m_thread, nullptr, worker, this) != 0){
+        m_cache->unwatch();
+        close(m_fd);
+        throw std::exception();
+    }
+}
+
+fs_watch::~fs_watch(){
+    pthread_cancel(m_thread);
+    pthread_join(m_thread, nullptr);
+    close(m_fd);
+}
+
+void* fs_watch::worker(void* arg){
+    pthread_setname_np(pthread_self(), "fswatch");
+    fs_watch* watch = (fs_watch*)arg;
+    watch->run();
+    return watch;
+}
+
+void fs_watch::run(){
+    alignas(struct inotify_event) char buf[64 * 1024];
+    while(true){
+        ssize_t len = read(m_fd, buf, sizeof(buf));
+        if(len < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            log_->log("err", this_file, __LINE__, "Failed to read inotify events, cache falls back to stat.");
+            m_cache->unwatch();
+            m_cache->clear();
+            return;
+        }
+        /* 一次read得到的事件作为一批，合并后再修改缓存 */
+        for(char* p = buf; p < buf + len; ){
+            const struct inotify_event* ev = (const struct inotify_event*)p;
+            handle(ev);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+        flush();
+    }
+}
+
+bool fs_watch::add_tree(const string& dir){
+    int wd = inotify_add_watch(m_fd, dir.c_str(), WATCH_MASK);
+    if(wd < 0){
+        /* 目录在收到事件之前已被删除，不算失败 */
+        return errno == ENOENT || errno == ENOTDIR;
+    }
+    m_dirs[wd] = dir;
+    DIR* d = opendir(dir.c_str());
+    if(! d){
+        return true;
+    }
+    bool ok = true;
+    while(struct dirent* e = readdir(d)){
+        if(e->d_name[0] == '.' && (e->d_name[1] == '\0' || (e->d_name[1] == '.' && e->d_name[2] == '\0'))){
+            continue;
+        }
+        string path = dir + "/" + e->d_name;
+        bool is_dir = (e->d_type == DT_DIR);
+        if(e->d_type == DT_UNKNOWN){
+            struct stat st;
+            is_dir = lstat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        /* 不跟随指向目录的符号链接，其下的文件由file_cache定时校验 */
+        if(is_dir){
+            ok = add_tree(path) && ok;
+        }
+    }
+    closedir(d);
+    return ok;
+}
+
+void fs_watch::remove_tree(const string& dir){
+    string prefix = dir + "/";
+    for(auto it = m_dirs.begin(); it != m_dirs.end(); ){
+        if(it->second == dir || it->second.compare(0, prefix.size(), prefix) == 0){
+            inotify_rm_watch(m_fd, it->first);
+            it = m_dirs.erase(it);
+        }
+        else{
+            ++it;
+        }
+    }
+}
+
+void fs_watch::handle(const struct inotify_event* ev){
+    if(ev->mask & IN_Q_OVERFLOW){
+        m_rescan = true;
+        return;
+    }
+    if(ev->mask & IN_IGNORED){
+        m_dirs.erase(ev->wd);
+        return;
+    }
+    auto it = m_dirs.find(ev->wd);
+    if(it == m_dirs.end()){
+        return;
+    }
+    if(ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)){
+        if(it->second == m_root){
+            m_rescan = true;
+        }
+        return;
+    }
+    if(ev->len == 0 || m_rescan){
+        return;
+    }
+    string path = it->second + "/" + ev->name;
+    if(ev->mask & IN_ISDIR){
+        if(ev->mask & (IN_DELETE | IN_MOVED_FROM)){
+            remove_tree(path);
+            m_trees.push_back(path);
+        }
+        else if(ev->mask & (IN_CREATE | IN_MOVED_TO)){
+            /* 先添加监视再使其下的缓存项失效，之后加入缓存的文件一定能收到事件 */
+            if(! add_tree(path)){
+                log_->log("err", this_file, __LINE__, "Failed to watch " + path + ", cache falls back to stat.");
+                m_cache->unwatch();
+            }
+            m_trees.push_back(path);
+        }
+    }
+    else{
+        m_files.push_back(path);
+    }
+    if(m_files.size() + m_trees.size() > MAX_PENDING){
+        m_rescan = true;
+    }
+}
+
+void fs_watch::flush(){
+    if(m_rescan){
+        /* 事件已丢失，无法知道哪些目录被创建或移动，重新添加全部监视 */
+        log_->log("msg", this_file, __LINE__, "Too many file system events, rescanning " + m_root);
+        if(! add_tree(m_root)){
+            m_cache->unwatch();
+        }
+        m_cache->clear();
+        m_rescan = false;
+    }
+    else{
+        for(const string& dir : m_trees){
+            m_cache->invalidate_tree(dir);
+        }
+        /* 写入一个文件会产生多个事件，去重后每个文件只查找一次 */
+        std::sort(m_files.begin(), m_files.end());
+        m_files.erase(std::unique(m_files.begin(), m_files.end()), m_files.end());
+        for(const string& file : m_files){
+            m_cache->invalidate(file);
+        }
+    }
+    m_trees.clear();
+    m_files.clear();
+}
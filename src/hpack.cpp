@@ -0,0 +1,430 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:12
+ * @ Modified Time: 2026-10-19 23:59:12
+ * @ Description  : HPACK头部压缩（RFC 7541）
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/hpack.h"
+
+using std::vector;
+
+/* 静态表（RFC 7541 附录A），索引从1开始 */
+static const char* const static_table[][2] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""}
+};
+static const size_t STATIC_COUNT = sizeof(static_table) / sizeof(static_table[0]);
+
+/* Huffman编码表（RFC 7541 附录B）：每个符号的编码及位数，256为EOS */
+static const struct {
+    uint32_t code;
+    uint8_t bits;
+} huffman_table[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+    {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+    {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+    {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+    {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+    {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+    {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+    {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+    {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+    {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+    {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+    {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+    {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+    {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+    {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+    {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+    {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+    {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+    {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+    {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+    {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+    {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+    {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+    {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+    {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+    {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+    {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+    {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+    {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+    {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+    {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+    {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+    {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+    {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+    {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+    {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+    {0x3fffffff, 30}
+};
+
+/* 由编码表构造的解码树，叶子节点的sym为符号，内部节点为-1 */
+struct huffman_tree{
+    struct node{
+        int16_t next[2];
+        int16_t sym;
+    };
+    node nodes[513];
+    int count;
+
+    huffman_tree() : count(1) {
+        nodes[0] = {{-1, -1}, -1};
+        for(int sym = 0; sym < 257; ++sym){
+            int n = 0;
+            for(int i = huffman_table[sym].bits - 1; i >= 0; --i){
+                int bit = (huffman_table[sym].code >> i) & 1;
+                if(nodes[n].next[bit] < 0){
+                    nodes[count] = {{-1, -1}, -1};
+                    nodes[n].next[bit] = count++;
+                }
+                n = nodes[n].next[bit];
+            }
+            nodes[n].sym = sym;
+        }
+    }
+};
+
+static const huffman_tree& decode_tree(){
+    static const huffman_tree tree;
+    return tree;
+}
+
+bool huffman_decode(const uint8_t* data, size_t len, string& out){
+    const huffman_tree& tree = decode_tree();
+    int n = 0;
+    int depth = 0;          /* 当前符号已读入的位数 */
+    bool ones = true;       /* 当前符号已读入的位是否全为1 */
+    for(size_t i = 0; i < len; ++i){
+        for(int shift = 7; shift >= 0; --shift){
+            int bit = (data[i] >> shift) & 1;
+            n = tree.nodes[n].next[bit];
+            if(n < 0){
+                return false;
+            }
+            ++depth;
+            ones = ones && bit;
+            int sym = tree.nodes[n].sym;
+            if(sym >= 0){
+                if(sym == 256){
+                    return false;
+                }
+                out += (char)sym;
+                n = 0;
+                depth = 0;
+                ones = true;
+            }
+        }
+    }
+    /* 末尾的填充只能是EOS编码的前缀（全为1），且不足8位 */
+    return depth < 8 && ones;
+}
+
+size_t huffman_length(const char* data, size_t len){
+    size_t bits = 0;
+    for(size_t i = 0; i < len; ++i){
+        bits += huffman_table[(uint8_t)data[i]].bits;
+    }
+    return (bits + 7) / 8;
+}
+
+void huffman_encode(const char* data, size_t len, string& out){
+    uint64_t acc = 0;
+    int n = 0;
+    for(size_t i = 0; i < len; ++i){
+        const auto& code = huffman_table[(uint8_t)data[i]];
+        acc = (acc << code.bits) | code.code;
+        n += code.bits;
+        while(n >= 8){
+            n -= 8;
+            out += (char)(acc >> n);
+        }
+        acc &= ((uint64_t)1 << n) - 1;
+    }
+    /* 不足一个字节的部分用EOS的高位（全1）填充 */
+    if(n > 0){
+        out += (char)((acc << (8 - n)) | (0xff >> n));
+    }
+}
+
+/* 整数以prefix位前缀编码，超出前缀的部分每字节7位（RFC 7541 5.1） */
+static bool decode_int(const uint8_t*& p, const uint8_t* end, int prefix, uint64_t& value){
+    uint64_t max = (1u << prefix) - 1;
+    value = *p++ & max;
+    if(value < max){
+        return true;
+    }
+    for(int shift = 0; p < end && shift <= 28; shift += 7){
+        uint8_t b = *p++;
+        value += (uint64_t)(b & 0x7f) << shift;
+        if(! (b & 0x80)){
+            return true;
+        }
+    }
+    return false;
+}
+
+static void encode_int(string& out, uint8_t first, int prefix, uint64_t value){
+    uint64_t max = (1u << prefix) - 1;
+    if(value < max){
+        out += (char)(first | value);
+        return;
+    }
+    out += (char)(first | max);
+    value -= max;
+    while(value >= 128){
+        out += (char)(value % 128 + 128);
+        value /= 128;
+    }
+    out += (char)value;
+}
+
+static bool decode_string(const uint8_t*& p, const uint8_t* end, string& out){
+    if(p >= end){
+        return false;
+    }
+    bool huffman = *p & 0x80;
+    uint64_t len;
+    if(! decode_int(p, end, 7, len) || len > (uint64_t)(end - p)){
+        return false;
+    }
+    out.clear();
+    bool ok = true;
+    if(huffman){
+        ok = huffman_decode(p, len, out);
+    }
+    else{
+        out.assign((const char*)p, len);
+    }
+    p += len;
+    return ok;
+}
+
+static void encode_string(string& out, const char* data, size_t len){
+    size_t huffman = huffman_length(data, len);
+    if(huffman < len){
+        encode_int(out, 0x80, 7, huffman);
+        huffman_encode(data, len, out);
+    }
+    else{
+        encode_int(out, 0x00, 7, len);
+        out.append(data, len);
+    }
+}
+
+bool hpack_decoder::lookup(uint64_t index, const hpack_header*& header) const{
+    static const vector<hpack_header> statics = [](){
+        vector<hpack_header> v;
+        for(size_t i = 0; i < STATIC_COUNT; ++i){
+            v.push_back({static_table[i][0], static_table[i][1]});
+        }
+        return v;
+    }();
+    if(index == 0){
+        return false;
+    }
+    if(index <= STATIC_COUNT){
+        header = &statics[index - 1];
+        return true;
+    }
+    index -= STATIC_COUNT + 1;
+    if(index >= m_table.size()){
+        return false;
+    }
+    header = &m_table[index];
+    return true;
+}
+
+void hpack_decoder::evict(size_t max_size){
+    while(m_size > max_size){
+        m_size -= m_table.back().name.size() + m_table.back().value.size() + 32;
+        m_table.pop_back();
+    }
+}
+
+/* 加入动态表前先淘汰旧的表项；表项本身超过上限时清空动态表（RFC 7541 4.4） */
+void hpack_decoder::insert(const string& name, const string& value){
+    size_t size = name.size() + value.size() + 32;
+    if(size > m_max_size){
+        evict(0);
+        return;
+    }
+    evict(m_max_size - size);
+    m_table.push_front({name, value});
+    m_size += size;
+}
+
+bool hpack_decoder::decode(const uint8_t* data, size_t len, vector<hpack_header>& headers){
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    bool started = false;       /* 动态表大小更新只能出现在头部块的开头 */
+    while(p < end){
+        uint8_t b = *p;
+        uint64_t index;
+        if(b & 0x80){
+            /* 索引表示 */
+            const hpack_header* header;
+            if(! decode_int(p, end, 7, index) || ! lookup(index, header)){
+                return false;
+            }
+            headers.push_back(*header);
+            started = true;
+        }
+        else if((b & 0xe0) == 0x20){
+            /* 动态表大小更新 */
+            if(started || ! decode_int(p, end, 5, index) || index > TABLE_SIZE){
+                return false;
+            }
+            m_max_size = index;
+            evict(m_max_size);
+        }
+        else{
+            /* 字面值表示：01加入动态表，0000不加入，0001永不加入 */
+            bool add = (b & 0x40) != 0;
+            hpack_header header;
+            if(! decode_int(p, end, add ? 6 : 4, index)){
+                return false;
+            }
+            if(index){
+                const hpack_header* indexed;
+                if(! lookup(index, indexed)){
+                    return false;
+                }
+                header.name = indexed->name;
+            }
+            else if(! decode_string(p, end, header.name)){
+                return false;
+            }
+            if(! decode_string(p, end, header.value)){
+                return false;
+            }
+            if(add){
+                insert(header.name, header.value);
+            }
+            headers.push_back(std::move(header));
+            started = true;
+        }
+    }
+    return true;
+}
+
+void hpack_encode_status(string& out, int status){
+    /* 静态表中有的状态码只需一个字节 */
+    for(size_t i = 7; i < 14; ++i){
+        if(atoi(static_table[i][1]) == status){
+            encode_int(out, 0x80, 7, i + 1);
+            return;
+        }
+    }
+    char value[8];
+    int len = snprintf(value, sizeof(value), "%d", status);
+    encode_int(out, 0x00, 4, 8);
+    encode_string(out, value, len);
+}
+
+void hpack_encode_header(string& out, const char* name, size_t name_len, const char* value, size_t value_len){
+    size_t index = 0;
+    for(size_t i = 0; i < STATIC_COUNT; ++i){
+        if(strlen(static_table[i][0]) == name_len && memcmp(static_table[i][0], name, name_len) == 0){
+            index = i + 1;
+            break;
+        }
+    }
+    encode_int(out, 0x00, 4, index);
+    if(! index){
+        encode_string(out, name, name_len);
+    }
+    encode_string(out, value, value_len);
+}
@@ -0,0 +1,904 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:40
+ * @ Modified Time: 2026-10-19 23:59:40
+ * @ Description  : 明文HTTP/2（h2c）
+ */
+
+#include <algorithm>
+#include <climits>
+#include <ctime>
+#include "../include/http2.h"
+#include "../include/config.h"
+#include "../include/log.h"
+
+extern void modfd(int epollfd, int fd, int ev, uint64_t key);
+
+static const string this_file = "http2.cpp";
+
+const char h2_session::PREFACE[PREFACE_LEN + 1] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+/* 帧标志 */
+static const uint8_t FLAG_END_STREAM = 0x1;
+static const uint8_t FLAG_ACK = 0x1;
+static const uint8_t FLAG_END_HEADERS = 0x4;
+static const uint8_t FLAG_PADDED = 0x8;
+static const uint8_t FLAG_PRIORITY = 0x20;
+
+/* SETTINGS参数 */
+static const uint16_t SETTINGS_ENABLE_PUSH = 0x2;
+static const uint16_t SETTINGS_MAX_CONCURRENT_STREAMS = 0x3;
+static const uint16_t SETTINGS_INITIAL_WINDOW_SIZE = 0x4;
+static const uint16_t SETTINGS_MAX_FRAME_SIZE = 0x5;
+
+static const long MAX_WINDOW = 0x7fffffff;
+static const size_t MAX_FREE_STREAMS = 16;      /* 最多保留的空闲流对象 */
+
+static uint32_t read32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void write32(char* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/* HTTP2-Settings字段为base64url编码（可以省略末尾的'='） */
+static bool base64url_decode(const char* in, string& out) {
+    uint32_t acc = 0;
+    int bits = 0;
+    for (; *in && *in != '='; ++in) {
+        int v;
+        char c = *in;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '-' || c == '+') v = 62;
+        else if (c == '_' || c == '/') v = 63;
+        else if (c == ' ' || c == '\t') continue;
+        else return false;
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out += (char)(acc >> bits);
+        }
+    }
+    return true;
+}
+
+/* 一个流，复用http_conn的请求解析、文件查找与应答填充：请求被转换为HTTP/1.1请求灌入读缓冲，
+ * 不经过socket；应答的头部由写缓冲中的HTTP/1.1头部转换而来，消息体仍是m_iv指向的内存
+ */
+class h2_stream : public http_conn{
+public:
+    uint32_t id;
+    long window;            /* 发送窗口 */
+    const char* body;       /* 应答的消息体，在流被释放之前保持有效 */
+    size_t body_len;
+    size_t offset;          /* 已放入DATA帧的字节数 */
+    bool remote_closed;     /* 已收到END_STREAM，请求完整 */
+    bool queued;            /* 在h2_session::m_ready中 */
+
+private:
+    bool m_get;             /* 只支持GET，其他方法返回405 */
+    bool m_too_large;       /* 转换后的请求超出读缓冲 */
+    string m_generated;     /* 分块生成的消息体，在流被释放之前保持有效 */
+
+public:
+    void open(uint32_t stream_id, uint32_t conn_id, const sockaddr_in& addr, long initial_window) {
+        init();
+        m_sockfd = -1;
+        m_conn_id = conn_id;
+        m_address = addr;
+        m_requests = 0;
+        m_last_size = 0;
+        id = stream_id;
+        window = initial_window;
+        body = nullptr;
+        body_len = 0;
+        offset = 0;
+        remote_closed = false;
+        queued = false;
+        m_get = false;
+        m_too_large = false;
+    }
+
+    /* 字段中含有换行等无法出现在HTTP/1.1请求中的字符时返回false（请求格式错误） */
+    bool prepare(const h2_request& request) {
+        m_get = strcmp(request.method, "GET") == 0;
+        if (! m_get) {
+            return true;
+        }
+        const char* fields[] = {request.path, request.authority, request.if_modified_since, request.if_none_match};
+        for (const char* field : fields) {
+            if (field && field[strcspn(field, "\r\n")] != '\0') {
+                return false;
+            }
+        }
+        if (request.path[0] != '/' || request.path[strcspn(request.path, " \t")] != '\0') {
+            return false;
+        }
+        char* buf = m_read_buf;
+        int size = READ_BUF_SIZE;
+        int len = snprintf(buf, size, "GET %s HTTP/1.1\r\n", request.path);
+        if (request.authority && len < size) {
+            len += snprintf(buf + len, size - len, "Host: %s\r\n", request.authority);
+        }
+        if (request.if_modified_since && len < size) {
+            len += snprintf(buf + len, size - len, "If-Modified-Since: %s\r\n", request.if_modified_since);
+        }
+        if (request.if_none_match && len < size) {
+            len += snprintf(buf + len, size - len, "If-None-Match: %s\r\n", request.if_none_match);
+        }
+        if (request.accept_gzip && len < size) {
+            len += snprintf(buf + len, size - len, "Accept-Encoding: gzip\r\n");
+        }
+        if (len < size) {
+            len += snprintf(buf + len, size - len, "\r\n");
+        }
+        /* 读缓冲已满时process_read同样返回BAD_REQUEST，这里提前判断 */
+        m_too_large = len >= size - 1;
+        m_read_idx = m_too_large ? 0 : len;
+        return true;
+    }
+
+    HTTP_CODE run() {
+        if (! m_get) {
+            m_allowed = 1u << GET;
+            return METHOD_NOT_ALLOWED;
+        }
+        if (m_too_large) {
+            return BAD_REQUEST;
+        }
+        HTTP_CODE ret = process_read();
+        /* 流没有自己的socket，不能转发到上游 */
+        if (ret == PROXY_REQUEST) {
+            return BAD_GATEWAY;
+        }
+        /* 请求是完整的，不会是NO_REQUEST；不在主线程中，也不会是PENDING_REQUEST */
+        return (ret == NO_REQUEST || ret == PENDING_REQUEST) ? BAD_REQUEST : ret;
+    }
+
+    /* 填充应答：HTTP/1.1头部转换为HPACK追加到block，消息体记录在body、body_len中 */
+    void respond(HTTP_CODE ret, string& block) {
+        /* 分块生成的消息体一次取出，作为DATA帧发送 */
+        if (ret == STREAM_REQUEST) {
+            ret = drain();
+        }
+        if (! process_write(ret)) {
+            unmap();
+            m_write_idx = 0;
+            process_write(INTERNAL_ERROR);
+        }
+        const char* end = strstr(m_write_buf, "\r\n\r\n");
+        size_t header_len = end + 4 - m_write_buf;
+        hpack_encode_status(block, atoi(m_write_buf + 9));
+        const char* line = strstr(m_write_buf, "\r\n") + 2;
+        while (line < end) {
+            const char* eol = strstr(line, "\r\n");
+            const char* colon = static_cast<const char*>(memchr(line, ':', eol - line));
+            if (colon) {
+                /* HTTP/2的字段名为小写，连接相关的字段不能出现 */
+                char name[64];
+                size_t name_len = std::min((size_t)(colon - line), sizeof(name));
+                for (size_t i = 0; i < name_len; ++i) {
+                    name[i] = tolower((unsigned char)line[i]);
+                }
+                const char* value = colon + 1 + strspn(colon + 1, " \t");
+                if (! hop_by_hop(name, name_len)) {
+                    hpack_encode_header(block, name, name_len, value, eol - value);
+                }
+            }
+            line = eol + 2;
+        }
+        if (m_iv_count == 2) {
+            body = static_cast<const char*>(m_iv[1].iov_base);
+            body_len = m_iv[1].iov_len;
+        }
+        else {
+            body = m_write_buf + header_len;
+            body_len = m_write_idx - header_len;
+        }
+    }
+
+    void release() {
+        unmap();
+    }
+
+    /* 生产者的数据都已在内存中，复制到m_generated，之后按普通的应答处理 */
+    HTTP_CODE drain() {
+        m_generated.clear();
+        const char* data = nullptr;
+        size_t len = 0;
+        body_producer::STATUS status;
+        while ((status = m_producer->next(&data, &len)) == body_producer::PRODUCE_DATA) {
+            m_generated.append(data, len);
+        }
+        m_producer.reset();
+        if (status != body_producer::PRODUCE_END) {
+            return INTERNAL_ERROR;
+        }
+        return http_conn::respond(200, "OK", m_file_type, m_generated.data(), m_generated.size());
+    }
+
+    static bool hop_by_hop(const char* name, size_t len) {
+        static const char* const names[] = {"connection", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade"};
+        for (const char* n : names) {
+            if (strlen(n) == len && memcmp(n, name, len) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+h2_session::h2_session(http_conn& conn)
+    : m_conn(conn), m_in(PREFACE_LEN + FRAME_HEADER + MAX_FRAME), m_in_len(0), m_preface(false),
+      m_settings(false), m_last_stream(0), m_header_stream(0), m_header_flags(0), m_out_batched(0),
+      m_iov_count(0), m_iov_pos(0), m_send_window(65535), m_initial_window(65535), m_peer_max_frame(16384),
+      m_goaway(false), m_closing(false) {
+}
+
+h2_session::~h2_session() {
+    for (auto& it : m_streams) {
+        it.second->release();
+        delete it.second;
+    }
+    for (h2_stream* s : m_finished) {
+        s->release();
+        delete s;
+    }
+    for (h2_stream* s : m_free) {
+        delete s;
+    }
+}
+
+/* 服务器的连接序言：一个SETTINGS帧 */
+void h2_session::add_settings() {
+    char payload[6];
+    payload[0] = 0;
+    payload[1] = SETTINGS_MAX_CONCURRENT_STREAMS;
+    write32(payload + 2, config_->h2_streams);
+    add_frame(SETTINGS, 0, 0, payload, sizeof(payload));
+}
+
+void h2_session::start(const char* data, size_t len) {
+    add_settings();
+    memcpy(m_in.data(), data, len);
+    m_in_len = len;
+}
+
+bool h2_session::upgrade(const char* settings, const h2_request& request, const char* data, size_t len) {
+    string payload;
+    if (! base64url_decode(settings, payload) || payload.size() % 6 != 0
+            || ! on_settings(reinterpret_cast<const uint8_t*>(payload.data()), payload.size())) {
+        return false;
+    }
+    m_out = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+    add_settings();
+    memcpy(m_in.data(), data, len);
+    m_in_len = len;
+
+    /* 升级前的请求成为流1，客户端已发送完毕（half-closed） */
+    m_last_stream = 1;
+    h2_stream* stream = open_stream(1);
+    stream->remote_closed = true;
+    if (! stream->prepare(request)) {
+        reset_stream(1, PROTOCOL_ERROR);
+        return true;
+    }
+    serve(stream);
+    return true;
+}
+
+bool h2_session::process() {
+    for (int i = 0; ; ++i) {
+        http_conn::WRITE_STATUS status = flush();
+        if (status == http_conn::WRITE_ERROR) {
+            return false;
+        }
+        if (status == http_conn::WRITE_AGAIN) {
+            modfd(m_conn.m_epollfd, m_conn.m_sockfd, EPOLLOUT, m_conn.m_key);
+            return true;
+        }
+        /* 出错时已发送GOAWAY；客户端发送GOAWAY后所有流都已结束 */
+        if (m_closing || (m_goaway && m_streams.empty())) {
+            return false;
+        }
+        /* 客户端持续发送时交还给epoll，数据仍在内核缓冲区中，重新注册后立即产生EPOLLIN */
+        if (i >= MAX_LOOPS) {
+            m_conn.wait_read();
+            return true;
+        }
+        long got = receive();
+        if (got < 0) {
+            return false;
+        }
+        if (got > 0) {
+            m_conn.m_idle_begin = time(nullptr);
+        }
+        if (! parse()) {
+            /* GOAWAY已加入待发送的数据，发送后关闭 */
+            continue;
+        }
+        if (got == 0 && ! has_output()) {
+            m_conn.wait_read();
+            return true;
+        }
+    }
+}
+
+http_conn::WRITE_STATUS h2_session::flush() {
+    long budget = (config_->write_quantum > 0) ? (long)config_->write_quantum << 10 : LONG_MAX;
+    while (true) {
+        if (m_iov_pos == m_iov_count) {
+            finish_batch();
+            if (! fill()) {
+                return http_conn::WRITE_DONE;
+            }
+        }
+        ssize_t temp = m_conn.sock_writev(m_iov + m_iov_pos, m_iov_count - m_iov_pos);
+        if (temp < 0) {
+            return (errno == EAGAIN) ? http_conn::WRITE_AGAIN : http_conn::WRITE_ERROR;
+        }
+        /* writev可能只发送了部分数据，调整iovec使下次从未发送的位置继续 */
+        size_t sent = temp;
+        while (m_iov_pos < m_iov_count && sent >= m_iov[m_iov_pos].iov_len) {
+            sent -= m_iov[m_iov_pos].iov_len;
+            ++m_iov_pos;
+        }
+        if (sent > 0) {
+            m_iov[m_iov_pos].iov_base = static_cast<char*>(m_iov[m_iov_pos].iov_base) + sent;
+            m_iov[m_iov_pos].iov_len -= sent;
+        }
+        budget -= temp;
+        if (budget <= 0 && (m_iov_pos < m_iov_count || has_output())) {
+            return http_conn::WRITE_AGAIN;
+        }
+    }
+}
+
+/* 控制帧及HEADERS帧在前，之后各个流轮流放入一个DATA帧，直到iovec用完或窗口用完 */
+bool h2_session::fill() {
+    m_iov_count = 0;
+    m_iov_pos = 0;
+    if (! m_out.empty()) {
+        m_iov[0].iov_base = &m_out[0];
+        m_iov[0].iov_len = m_out.size();
+        m_iov_count = 1;
+        m_out_batched = m_out.size();
+    }
+    int heads = 0;
+    while (m_iov_count + 2 <= MAX_IOV && m_send_window > 0 && ! m_ready.empty()) {
+        h2_stream* stream = m_ready.front();
+        m_ready.pop_front();
+        stream->queued = false;
+        long len = std::min({(long)(stream->body_len - stream->offset), stream->window,
+            m_send_window, (long)m_peer_max_frame});
+        if (len <= 0) {
+            /* 流的窗口已用完，收到WINDOW_UPDATE后重新加入 */
+            continue;
+        }
+        bool last = stream->offset + len == stream->body_len;
+        frame_header(m_heads[heads], len, DATA, last ? FLAG_END_STREAM : 0, stream->id);
+        m_iov[m_iov_count].iov_base = m_heads[heads++];
+        m_iov[m_iov_count++].iov_len = FRAME_HEADER;
+        m_iov[m_iov_count].iov_base = const_cast<char*>(stream->body + stream->offset);
+        m_iov[m_iov_count++].iov_len = len;
+        stream->offset += len;
+        stream->window -= len;
+        m_send_window -= len;
+        if (last) {
+            close_stream(stream);
+        }
+        else if (stream->window > 0) {
+            stream->queued = true;
+            m_ready.push_back(stream);
+        }
+    }
+    return m_iov_count > 0;
+}
+
+/* 上一个批次已发送完毕：其中的控制帧可以丢弃，其中结束的流可以释放 */
+void h2_session::finish_batch() {
+    m_out.erase(0, m_out_batched);
+    m_out_batched = 0;
+    for (h2_stream* stream : m_finished) {
+        stream->release();
+        if (m_free.size() < MAX_FREE_STREAMS) {
+            m_free.push_back(stream);
+        }
+        else {
+            delete stream;
+        }
+    }
+    m_finished.clear();
+    m_iov_count = 0;
+    m_iov_pos = 0;
+}
+
+long h2_session::receive() {
+    long total = 0;
+    while (m_in_len < m_in.size()) {
+        ssize_t len = m_conn.sock_recv(m_in.data() + m_in_len, m_in.size() - m_in_len);
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        if (len == 0) {
+            log_->log("msg", this_file, __LINE__, "Connection closed by client.");
+            return -1;
+        }
+        m_in_len += len;
+        total += len;
+    }
+    return total;
+}
+
+bool h2_session::parse() {
+    const uint8_t* buf = reinterpret_cast<const uint8_t*>(m_in.data());
+    size_t pos = 0;
+    if (! m_preface) {
+        size_t len = std::min(m_in_len, PREFACE_LEN);
+        if (memcmp(buf, PREFACE, len) != 0) {
+            return error(PROTOCOL_ERROR);
+        }
+        if (len < PREFACE_LEN) {
+            return true;
+        }
+        m_preface = true;
+        pos = len;
+    }
+    while (m_in_len - pos >= FRAME_HEADER) {
+        const uint8_t* h = buf + pos;
+        uint32_t len = (uint32_t)h[0] << 16 | (uint32_t)h[1] << 8 | h[2];
+        if (len > MAX_FRAME) {
+            return error(FRAME_SIZE_ERROR);
+        }
+        if (m_in_len - pos < FRAME_HEADER + len) {
+            break;
+        }
+        if (! on_frame(h[3], h[4], read32(h + 5) & 0x7fffffff, h + FRAME_HEADER, len)) {
+            return false;
+        }
+        pos += FRAME_HEADER + len;
+    }
+    memmove(m_in.data(), m_in.data() + pos, m_in_len - pos);
+    m_in_len -= pos;
+    return true;
+}
+
+bool h2_session::on_frame(uint8_t type, uint8_t flags, uint32_t id, const uint8_t* payload, uint32_t len) {
+    /* 连接序言之后的第一个帧必须是SETTINGS；头部块的CONTINUATION之间不能插入其他帧 */
+    if (! m_settings && type != SETTINGS) {
+        return error(PROTOCOL_ERROR);
+    }
+    if (m_header_stream && (type != CONTINUATION || id != m_header_stream)) {
+        return error(PROTOCOL_ERROR);
+    }
+    switch (type) {
+        case DATA: {
+            if (id == 0) {
+                return error(PROTOCOL_ERROR);
+            }
+            if ((flags & FLAG_PADDED) && (len < 1 || payload[0] >= len)) {
+                return error(PROTOCOL_ERROR);
+            }
+            /* 只支持GET，消息体直接丢弃，同时归还流量控制窗口 */
+            if (len > 0) {
+                add_window_update(0, len);
+            }
+            auto it = m_streams.find(id);
+            if (it == m_streams.end() || it->second->remote_closed) {
+                if (id > m_last_stream) {
+                    return error(PROTOCOL_ERROR);
+                }
+                reset_stream(id, STREAM_CLOSED);
+                return true;
+            }
+            h2_stream* stream = it->second;
+            if (flags & FLAG_END_STREAM) {
+                stream->remote_closed = true;
+                serve(stream);
+            }
+            else if (len > 0) {
+                add_window_update(id, len);
+            }
+            return true;
+        }
+        case HEADERS: {
+            return on_headers(id, flags, payload, len);
+        }
+        case PRIORITY: {
+            /* 不按优先级调度，各个流轮流发送 */
+            if (id == 0) {
+                return error(PROTOCOL_ERROR);
+            }
+            if (len != 5) {
+                reset_stream(id, FRAME_SIZE_ERROR);
+            }
+            return true;
+        }
+        case RST_STREAM: {
+            if (id == 0 || id > m_last_stream) {
+                return error(PROTOCOL_ERROR);
+            }
+            if (len != 4) {
+                return error(FRAME_SIZE_ERROR);
+            }
+            auto it = m_streams.find(id);
+            if (it != m_streams.end()) {
+                close_stream(it->second);
+            }
+            return true;
+        }
+        case SETTINGS: {
+            if (id != 0) {
+                return error(PROTOCOL_ERROR);
+            }
+            if (flags & FLAG_ACK) {
+                return len == 0 || error(FRAME_SIZE_ERROR);
+            }
+            if (len % 6 != 0) {
+                return error(FRAME_SIZE_ERROR);
+            }
+            if (! on_settings(payload, len)) {
+                return false;
+            }
+            m_settings = true;
+            add_frame(SETTINGS, FLAG_ACK, 0, nullptr, 0);
+            return true;
+        }
+        case PING: {
+            if (id != 0) {
+                return error(PROTOCOL_ERROR);
+            }
+            if (len != 8) {
+                return error(FRAME_SIZE_ERROR);
+            }
+            if (! (flags & FLAG_ACK)) {
+                add_frame(PING, FLAG_ACK, 0, reinterpret_cast<const char*>(payload), len);
+            }
+            return true;
+        }
+        case GOAWAY: {
+            if (id != 0) {
+                return error(PROTOCOL_ERROR);
+            }
+            m_goaway = true;
+            return true;
+        }
+        case WINDOW_UPDATE: {
+            return on_window_update(id, payload, len);
+        }
+        case CONTINUATION: {
+            if (! m_header_stream) {
+                return error(PROTOCOL_ERROR);
+            }
+            m_header_block.append(reinterpret_cast<const char*>(payload), len);
+            if (m_header_block.size() > MAX_HEADER_BLOCK) {
+                return error(ENHANCE_YOUR_CALM);
+            }
+            if (flags & FLAG_END_HEADERS) {
+                m_header_stream = 0;
+                return on_header_block(id, m_header_flags);
+            }
+            return true;
+        }
+        case PUSH_PROMISE: {
+            /* 客户端不能推送 */
+            return error(PROTOCOL_ERROR);
+        }
+        default: {
+            /* 未知类型的帧直接忽略 */
+            return true;
+        }
+    }
+}
+
+bool h2_session::on_headers(uint32_t id, uint8_t flags, const uint8_t* payload, uint32_t len) {
+    if (id == 0 || ! (id & 1)) {
+        return error(PROTOCOL_ERROR);
+    }
+    uint32_t begin = 0;
+    uint32_t pad = 0;
+    if (flags & FLAG_PADDED) {
+        if (len < 1) {
+            return error(FRAME_SIZE_ERROR);
+        }
+        pad = payload[0];
+        begin = 1;
+    }
+    if (flags & FLAG_PRIORITY) {
+        begin += 5;
+    }
+    if (begin + pad > len) {
+        return error(PROTOCOL_ERROR);
+    }
+    m_header_block.assign(reinterpret_cast<const char*>(payload) + begin, len - begin - pad);
+    m_header_flags = flags;
+    if (flags & FLAG_END_HEADERS) {
+        return on_header_block(id, flags);
+    }
+    m_header_stream = id;
+    return true;
+}
+
+/* 头部块必须解码以保持动态表同步，之后才判断是否接受该流 */
+bool h2_session::on_header_block(uint32_t id, uint8_t flags) {
+    m_headers.clear();
+    if (! m_decoder.decode(reinterpret_cast<const uint8_t*>(m_header_block.data()), m_header_block.size(), m_headers)) {
+        return error(COMPRESSION_ERROR);
+    }
+
+    auto it = m_streams.find(id);
+    if (it != m_streams.end()) {
+        /* 已打开的流上的第二个头部块是trailer，必须结束该流 */
+        h2_stream* stream = it->second;
+        if (stream->remote_closed) {
+            reset_stream(id, STREAM_CLOSED);
+        }
+        else if (! (flags & FLAG_END_STREAM)) {
+            return error(PROTOCOL_ERROR);
+        }
+        else {
+            stream->remote_closed = true;
+            serve(stream);
+        }
+        return true;
+    }
+    if (id <= m_last_stream) {
+        return error(STREAM_CLOSED);
+    }
+    m_last_stream = id;
+    if (m_streams.size() >= (size_t)config_->h2_streams) {
+        reset_stream(id, REFUSED_STREAM);
+        return true;
+    }
+
+    /* 伪头部字段必须在普通字段之前，字段名必须为小写，不能有连接相关的字段 */
+    h2_request request;
+    const char* scheme = nullptr;
+    bool regular = false;
+    bool malformed = false;
+    for (const hpack_header& h : m_headers) {
+        const char* name = h.name.c_str();
+        const char* value = h.value.c_str();
+        if (h.name.empty() || h.name.find('\0') != string::npos || h.value.find('\0') != string::npos) {
+            malformed = true;
+        }
+        else if (name[0] == ':') {
+            const char** field = nullptr;
+            if (h.name == ":method") field = &request.method;
+            else if (h.name == ":path") field = &request.path;
+            else if (h.name == ":scheme") field = &scheme;
+            else if (h.name == ":authority") field = &request.authority;
+            if (regular || ! field || *field) {
+                malformed = true;
+            }
+            else {
+                *field = value;
+            }
+        }
+        else {
+            regular = true;
+            if (std::any_of(h.name.begin(), h.name.end(), [](char c) { return c >= 'A' && c <= 'Z'; })
+                    || h2_stream::hop_by_hop(name, h.name.size()) || (h.name == "te" && h.value != "trailers")) {
+                malformed = true;
+            }
+            else if (h.name == "host" && ! request.authority) {
+                request.authority = value;
+            }
+            else if (h.name == "if-modified-since") {
+                request.if_modified_since = value;
+            }
+            else if (h.name == "if-none-match") {
+                request.if_none_match = value;
+            }
+            else if (h.name == "accept-encoding") {
+                request.accept_gzip = request.accept_gzip || h.value.find("gzip") != string::npos;
+            }
+        }
+    }
+    if (malformed || ! request.method || ! request.path || ! scheme || request.path[0] == '\0') {
+        reset_stream(id, PROTOCOL_ERROR);
+        return true;
+    }
+
+    h2_stream* stream = open_stream(id);
+    if (! stream->prepare(request)) {
+        reset_stream(id, PROTOCOL_ERROR);
+        return true;
+    }
+    if (flags & FLAG_END_STREAM) {
+        stream->remote_closed = true;
+        serve(stream);
+    }
+    return true;
+}
+
+bool h2_session::on_settings(const uint8_t* payload, uint32_t len) {
+    for (uint32_t i = 0; i + 6 <= len; i += 6) {
+        uint16_t id = payload[i] << 8 | payload[i + 1];
+        uint32_t value = read32(payload + i + 2);
+        switch (id) {
+            case SETTINGS_ENABLE_PUSH: {
+                if (value > 1) {
+                    return error(PROTOCOL_ERROR);
+                }
+                break;
+            }
+            case SETTINGS_INITIAL_WINDOW_SIZE: {
+                /* 新的初始窗口对所有已打开的流生效，窗口可能变为负数 */
+                if (value > (uint32_t)MAX_WINDOW) {
+                    return error(FLOW_CONTROL_ERROR);
+                }
+                long delta = (long)value - m_initial_window;
+                m_initial_window = value;
+                for (auto& it : m_streams) {
+                    h2_stream* stream = it.second;
+                    stream->window += delta;
+                    if (stream->window > MAX_WINDOW) {
+                        return error(FLOW_CONTROL_ERROR);
+                    }
+                    if (! stream->queued && stream->window > 0 && stream->offset < stream->body_len) {
+                        stream->queued = true;
+                        m_ready.push_back(stream);
+                    }
+                }
+                break;
+            }
+            case SETTINGS_MAX_FRAME_SIZE: {
+                if (value < 16384 || value > 16777215) {
+                    return error(PROTOCOL_ERROR);
+                }
+                m_peer_max_frame = value;
+                break;
+            }
+            default: {
+                /* 不使用动态表编码，不关心SETTINGS_HEADER_TABLE_SIZE；其他参数忽略 */
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool h2_session::on_window_update(uint32_t id, const uint8_t* payload, uint32_t len) {
+    if (len != 4) {
+        return error(FRAME_SIZE_ERROR);
+    }
+    uint32_t increment = read32(payload) & 0x7fffffff;
+    if (id == 0) {
+        if (increment == 0) {
+            return error(PROTOCOL_ERROR);
+        }
+        m_send_window += increment;
+        return m_send_window <= MAX_WINDOW || error(FLOW_CONTROL_ERROR);
+    }
+    auto it = m_streams.find(id);
+    if (increment == 0) {
+        reset_stream(id, PROTOCOL_ERROR);
+        return true;
+    }
+    if (it == m_streams.end()) {
+        return true;
+    }
+    h2_stream* stream = it->second;
+    stream->window += increment;
+    if (stream->window > MAX_WINDOW) {
+        reset_stream(id, FLOW_CONTROL_ERROR);
+        return true;
+    }
+    if (! stream->queued && stream->window > 0 && stream->offset < stream->body_len) {
+        stream->queued = true;
+        m_ready.push_back(stream);
+    }
+    return true;
+}
+
+h2_stream* h2_session::open_stream(uint32_t id) {
+    h2_stream* stream;
+    if (! m_free.empty()) {
+        stream = m_free.back();
+        m_free.pop_back();
+    }
+    else {
+        stream = new h2_stream;
+    }
+    stream->open(id, m_conn.m_conn_id, m_conn.m_address, m_initial_window);
+    m_streams[id] = stream;
+    return stream;
+}
+
+/* 与HTTP/1.1相同的流程处理请求（可能访问磁盘），应答头部作为HEADERS帧，
+ * 消息体等待轮到该流时作为DATA帧发送
+ */
+void h2_session::serve(h2_stream* stream) {
+    http_conn::HTTP_CODE ret = stream->run();
+    string block;
+    stream->respond(ret, block);
+    bool end = stream->body_len == 0;
+    size_t offset = 0;
+    uint8_t type = HEADERS;
+    do {
+        size_t len = std::min(block.size() - offset, (size_t)m_peer_max_frame);
+        uint8_t flags = (type == HEADERS && end) ? FLAG_END_STREAM : 0;
+        if (offset + len == block.size()) {
+            flags |= FLAG_END_HEADERS;
+        }
+        add_frame(type, flags, stream->id, block.data() + offset, len);
+        offset += len;
+        type = CONTINUATION;
+    } while (offset < block.size());
+
+    if (end) {
+        close_stream(stream);
+    }
+    else if (stream->window > 0) {
+        stream->queued = true;
+        m_ready.push_back(stream);
+    }
+}
+
+void h2_session::close_stream(h2_stream* stream) {
+    m_streams.erase(stream->id);
+    if (stream->queued) {
+        m_ready.erase(std::find(m_ready.begin(), m_ready.end(), stream));
+        stream->queued = false;
+    }
+    m_finished.push_back(stream);
+}
+
+void h2_session::reset_stream(uint32_t id, uint32_t code) {
+    char payload[4];
+    write32(payload, code);
+    add_frame(RST_STREAM, 0, id, payload, sizeof(payload));
+    auto it = m_streams.find(id);
+    if (it != m_streams.end()) {
+        close_stream(it->second);
+    }
+}
+
+void h2_session::frame_header(char* out, uint32_t len, uint8_t type, uint8_t flags, uint32_t id) const {
+    out[0] = len >> 16;
+    out[1] = len >> 8;
+    out[2] = len;
+    out[3] = type;
+    out[4] = flags;
+    write32(out + 5, id);
+}
+
+void h2_session::add_frame(uint8_t type, uint8_t flags, uint32_t id, const char* payload, uint32_t len) {
+    char head[FRAME_HEADER];
+    frame_header(head, len, type, flags, id);
+    m_out.append(head, FRAME_HEADER);
+    m_out.append(payload, len);
+}
+
+void h2_session::add_window_update(uint32_t id, uint32_t increment) {
+    char payload[4];
+    write32(payload, increment);
+    add_frame(WINDOW_UPDATE, 0, id, payload, sizeof(payload));
+}
+
+/* 连接级错误：不再发送DATA帧，发送GOAWAY后关闭连接 */
+bool h2_session::error(uint32_t code) {
+    char payload[8];
+    write32(payload, m_last_stream);
+    write32(payload + 4, code);
+    add_frame(GOAWAY, 0, 0, payload, sizeof(payload));
+    for (h2_stream* stream : m_ready) {
+        stream->queued = false;
+    }
+    m_ready.clear();
+    m_closing = true;
+    log_->log("err", this_file, __LINE__, "HTTP/2 connection error, sending GOAWAY.");
+    return false;
+}
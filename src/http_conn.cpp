@@ -6,35 +6,74 @@
  * @ Description  : http逻辑任务处理
  */
 
+#include <algorithm>
 #include <cctype>
+#include <climits>
 #include <ctime>
 #include <sys/uio.h>
 #include <unordered_map>
 
 #include "../include/locker.h"
 #include "../include/http_conn.h"
+#include "../include/http2.h"
+#include "../include/proxy.h"
+#include "../include/router.h"
+#include "../include/ratelimit.h"
+#include "../include/conn_table.h"
 #include "../include/http_content_type.h"
 #include "../include/log.h"
+#include "../include/config.h"
+#include "../include/capture.h"
+#include "../include/threadpool.h"
 
 using std::string;
 using std::unordered_map;
 
 /* 定义http响应的状态信息 */
 const char* ok_200_title = "OK";
+const char* ok_201_title = "Created";
+const char* ok_204_title = "No Content";
+const char* ok_301_title = "Moved Permanently";
+const char* ok_301_form = "The requested directory has moved to a url ending with '/'.\n";
+const char* ok_304_title = "Not Modified";
 const char* error_400_title = "Bad Request";
 const char* error_400_form = "Your request has bad syntax or is inherently impossible to satisfy.\n";
 const char* error_403_title = "Forbidden";
 const char* error_403_form = "You do not have permission to get file from this server.\n";
 const char* error_404_title = "Not Found";
 const char* error_404_form = "The requested file was not found on this server.\n";
+const char* error_405_title = "Method Not Allowed";
+const char* error_405_form = "The requested method is not supported for this path.\n";
+const char* error_413_title = "Payload Too Large";
+const char* error_413_form = "The upload exceeds the size limit of this server.\n";
 const char* error_500_title = "Internal Error";
 const char* error_500_form = "There was an unusual problem serving the requested file.\n";
+const char* error_502_title = "Bad Gateway";
+const char* error_502_form = "The upstream server is unavailable or sent an invalid response.\n";
+
+/* 与METHOD的顺序一致，用于405应答的Allow字段 */
+static const char* const method_names[] = {"GET", "POST", "HEAD", "PUT", "DELETE", "TRACE", "OPTIONS", "CONNECT", "PATCH"};
 
 /* 定义服务器名称，用于填充响应字段 */
-const char* server_name = "Server: WangYusong's Server / v0.5.0(Linux)\r\n";
+#define SERVER_NAME "Server: WangYusong's Server / v0.5.0(Linux)\r\n"
+const char* server_name = SERVER_NAME;
 
-/* ----------网站根目录---------- */
-const char* doc_root = "/var/www";
+/* 过载时的应答，预先拼好，拒绝请求时只需一次send */
+/* 超过速率限制时的应答，不需要格式化，之后关闭连接 */
+const char error_429_response[] =
+    "HTTP/1.1 429 Too Many Requests\r\n"
+    SERVER_NAME
+    "Retry-After: 1\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+const char error_503_response[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    SERVER_NAME
+    "Retry-After: 1\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
 
 /* 定义文件名,用于记录日志 */
 const string this_file = "http_conn.cpp";
@@ -53,10 +92,11 @@ int setnonblocking(int fd) {
 /* 将fd上的EPOLLIN注册到epfd指示的epoll内核事件表中，
  * one_shoot指示是否注册EPOLLONESHOT
  * 注册EPOLLONESHOT后，一个socket连接在任一时刻只被一个线程处理
+ * key为事件的data：客户连接为conn_table::key()，监听socket为fd本身
  */
-void addfd(int epollfd, int fd, bool one_shot) {
+void addfd(int epollfd, int fd, bool one_shot, uint64_t key) {
     epoll_event event;
-    event.data.fd = fd;
+    event.data.u64 = key;
     event.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
     if(one_shot) {
         event.events |= EPOLLONESHOT;
@@ -72,9 +112,9 @@ void removefd(int epollfd, int fd) {
 }
 
 /* 重置fd上的事件 */
-void modfd(int epollfd, int fd, int ev) {
+void modfd(int epollfd, int fd, int ev, uint64_t key) {
     epoll_event event;
-    event.data.fd = fd;
+    event.data.u64 = key;
     event.events = ev | EPOLLET | EPOLLONESHOT | EPOLLRDHUP;
     epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
 }
@@ -126,33 +166,159 @@ string urlDecode(const string& str) {
     return strTemp;  
 }  
 
+int urlDecode(const char* in, char* out) {
+    char* p = out;
+    for(; *in; ++in) {
+        if(*in == '+') {
+            *p++ = ' ';
+        }
+        else if(*in == '%') {
+            if(! isxdigit((unsigned char)in[1]) || ! isxdigit((unsigned char)in[2])) {
+                return -1;
+            }
+            *p++ = fromHex((unsigned char)in[1]) * 16 + fromHex((unsigned char)in[2]);
+            in += 2;
+        }
+        else {
+            *p++ = *in;
+        }
+    }
+    *p = '\0';
+    return p - out;
+}
+
+int urlEncode(const char* in, char* out) {
+    char* p = out;
+    for(; *in; ++in) {
+        unsigned char c = *in;
+        if(isalnum(c) || strchr("/_.-~", c)) {
+            *p++ = c;
+        }
+        else {
+            *p++ = '%';
+            *p++ = toHex(c >> 4);
+            *p++ = toHex(c % 16);
+        }
+    }
+    *p = '\0';
+    return p - out;
+}
+
+bool normalizePath(char* path) {
+    char* out = path;       /* 已输出部分的结尾 */
+    const char* in = path;
+    bool dir = false;       /* 结果是否以'/'结尾 */
+    while(*in) {
+        while(*in == '/') {
+            ++in;
+        }
+        const char* seg = in;
+        while(*in && *in != '/') {
+            ++in;
+        }
+        size_t len = in - seg;
+        dir = true;
+        if(len == 0 || (len == 1 && seg[0] == '.')) {
+            continue;
+        }
+        if(len == 2 && seg[0] == '.' && seg[1] == '.') {
+            if(out == path) {
+                return false;
+            }
+            while(*--out != '/') {
+            }
+            continue;
+        }
+        *out++ = '/';
+        memmove(out, seg, len);
+        out += len;
+        dir = (*in == '/');
+    }
+    if(out == path || dir) {
+        *out++ = '/';
+    }
+    *out = '\0';
+    return true;
+}
+
 /* 初始化用户数量为0 */
-int http_conn::m_user_count = 0;
-int http_conn::m_epollfd = -1;
+std::atomic<int> http_conn::m_user_count(0);
+std::atomic<uint32_t> http_conn::m_conn_count(0);
+threadpool<http_conn>* http_conn::m_io_pool = nullptr;
+
+/* 由连接表在所属的事件循环中析构 */
+http_conn::~http_conn() {
+    delete m_proxy;
+}
 
 /* 关闭连接 */
 void http_conn::close_conn(bool real_close) {
     if(real_close && (m_sockfd != -1)) {
-        removefd(m_epollfd, m_sockfd);
-        log_->log("msg", this_file, __LINE__, "Connection closed.");
+        /* 可能由工作线程调用：fd关闭后主线程可能立即accept到相同的fd并
+         * 重新初始化该对象，因此所有操作都要在close之前完成
+         */
+        int sockfd = m_sockfd;
         m_sockfd = -1;
+        m_gen.fetch_add(1, std::memory_order_release);  /* 之后取出的该连接的事件都被丢弃 */
+        m_waiting = false;
+        close_upload();
+        unmap();    /* 释放文件映射或缓存项，以及未结束的分块应答的生产者 */
+        delete m_h2;
+        m_h2 = nullptr;
+        if(m_proxy) {
+            m_proxy->reset();   /* 关闭转发中的上游连接，对象留给该槽位的下一个连接 */
+        }
+        m_tls.close();
+        if(m_limit) {
+            limiter_->detach(m_limit);
+            m_limit = nullptr;
+        }
+        m_trace.commit(m_conn_id, m_url ? m_url : "");
+        if(capture_) {
+            capture_->add(m_conn_id, capture::CLOSE);
+        }
+        log_->log("msg", this_file, __LINE__, "Connection closed.");
         m_user_count--;     /* 关闭连接时，用户数量减1 */
+        removefd(m_epollfd, sockfd);
+        if(m_table) {
+            m_table->release(this);
+        }
     }
 }
 
 /* 初始化新接受的连接 */
-void http_conn::init(int sockfd, const sockaddr_in& addr) {
+void http_conn::init(int sockfd, const sockaddr_in& addr, bool tls, limit_slot* limit) {
     m_sockfd = sockfd;
     m_address = addr;
+    m_limit = limit;
+    m_conn_id = ++m_conn_count;
+    m_last_size = 0;
+    m_requests = 0;
+    m_trace.reset();
+    if(capture_) {
+        capture_->add(m_conn_id, capture::OPEN);
+    }
     int error = 0;
     socklen_t len = sizeof(error);
     getsockopt(m_sockfd, SOL_SOCKET, SO_ERROR, &error, &len);
     /* 设置端口复用 */
     int reuse = 1;
     setsockopt(m_sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
-    addfd(m_epollfd, sockfd, true);
+    m_key = conn_table::key(this);
+    /* 代理状态只在事件循环中创建（这里）和销毁（连接表析构时），
+     * 超时检查与工作线程之间不会因为创建、释放m_proxy而竞争
+     */
+    if(proxy_ && ! m_proxy) {
+        m_proxy = new proxy_session(*this);
+    }
+    addfd(m_epollfd, sockfd, true, m_key);
     m_user_count++;
     init();     /* 初始化连接信息 */
+    m_waiting.store(true, std::memory_order_release);
+    if(tls && ! m_tls.start(sockfd)) {
+        log_->log("err", this_file, __LINE__, "Failed to create TLS session.");
+        close_conn();
+    }
 }
 
 /* 初始化连接信息 */
@@ -161,17 +327,91 @@ void http_conn::init() {
     m_linger = false;
     m_method = GET;
     m_url = 0;
-    m_file_type = "";
+    m_target = 0;
+    m_route = nullptr;
+    m_handler = nullptr;
+    m_allowed = 0;
+    m_file_type = "default";
     m_version = 0;
     m_content_length = 0;
+    m_chunked = false;
+    m_expect_continue = false;
+    m_body_state = BODY_DONE;
+    m_body_left = 0;
+    m_body_total = 0;
     m_host = 0;
+    m_if_modified_since = 0;
+    m_if_none_match = 0;
+    m_location = 0;
+    m_accept_gzip = false;
+    m_file_address = 0;
+    m_last_modified[0] = '\0';
+    m_static_headers = 0;
+    m_static_headers_len = 0;
+    m_inline = false;
+    m_pending = false;
+    m_prefetch = false;
     m_start_line = 0;
     m_checked_idx = 0;
     m_read_idx = 0;
     m_write_idx = 0;
-    memset(m_read_buf, '\0', READ_BUF_SIZE);
+    m_bytes_to_send = 0;
+    m_bytes_have_send = 0;
+    m_pipelined = false;
+    m_producer.reset();
+    m_chunk_framing = false;
+    m_chunk_open = false;
+    m_upgrade = UPGRADE_NONE;
+    m_upgrade_h2c = false;
+    m_connection_upgrade = false;
+    m_h2_settings = 0;
+    m_idle_begin = time(nullptr);
     memset(m_write_buf, '\0', WRITE_BUF_SIZE);
     memset(m_real_file, '\0', FILENAME_LEN);
+    m_arena.reset();
+}
+
+/* 读缓冲中当前请求之后的数据属于下一个请求，移到缓冲区开头，
+ * 否则客户端以流水线方式发送的请求会丢失
+ */
+void http_conn::finish_request() {
+    int end = m_checked_idx;
+    if (m_check_state == CHECK_STATE_CONTENT) {
+        end += m_content_length;
+    }
+    int left = (m_read_idx > end) ? m_read_idx - end : 0;
+    ++m_requests;
+    init();
+    if (left > 0) {
+        memmove(m_read_buf, m_read_buf + end, left);
+        m_read_idx = left;
+    }
+}
+
+/* 先标记再注册事件：注册之后主线程随时可能收到事件 */
+void http_conn::wait_read() {
+    /* 读缓冲已满时TLS层中可能还有已解密的数据，不会再产生EPOLLIN；
+     * 注册EPOLLOUT（立即触发），由write()像流水线请求一样交给serve继续读取
+     */
+    if (m_tls.pending()) {
+        modfd(m_epollfd, m_sockfd, EPOLLOUT, m_key);
+        return;
+    }
+    m_waiting.store(true, std::memory_order_release);
+    modfd(m_epollfd, m_sockfd, EPOLLIN, m_key);
+}
+
+/* 由主线程调用。先检查m_waiting：为true时该连接只能由主线程处理，之后读取m_proxy、
+ * m_idle_begin是安全的；为false时连接可能正被工作线程处理，不访问其他成员
+ */
+bool http_conn::expired(time_t now) const {
+    if (! m_waiting.load(std::memory_order_acquire)) {
+        return false;
+    }
+    if (proxying()) {
+        return m_proxy->expired(now);
+    }
+    return config_->keepalive_timeout > 0 && now - m_idle_begin >= config_->keepalive_timeout;
 }
 
 /* 从状态机，用于解析一行内容 */
@@ -215,13 +455,29 @@ http_conn::LINE_STATUS http_conn::parse_line() {
 
 /* 循环读取客户数据，直到无数据可读或对方关闭连接 */
 bool http_conn::read() {
+    m_waiting = false;
+    /* HTTP/2的帧由工作线程中的m_h2读取，TLS握手也在工作线程中进行 */
+    if(m_h2 || handshaking()) {
+        return true;
+    }
+    /* 上传的消息体由工作线程直接从socket读取，代理请求的消息体由m_proxy读取 */
+    if(m_check_state == CHECK_STATE_BODY || proxying()) {
+        return true;
+    }
+    /* 读缓冲中的请求尚未处理完（流水线），由process_read判断请求是否过大 */
     if(m_read_idx >= READ_BUF_SIZE) {
-        return false;
+        return true;
+    }
+    /* 新请求的第一次读取，开始追踪 */
+    if(trace_enabled() && ! m_trace.active()) {
+        m_trace.begin(trace_now());
     }
+    trace_scope scope(m_trace, TRACE_READ);
 
     int bytes_read = 0;
-    while(true) {
-        bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, READ_BUF_SIZE - m_read_idx, 0);
+    /* 读缓冲已满时停止，剩余的数据留在内核（或TLS层）中，长度为0的recv会被误认为对端关闭 */
+    while(m_read_idx < READ_BUF_SIZE) {
+        bytes_read = sock_recv(m_read_buf + m_read_idx, READ_BUF_SIZE - m_read_idx);
         if (bytes_read == -1) {
             if(errno == EAGAIN || errno == EWOULDBLOCK) {
                 break;
@@ -232,22 +488,47 @@ bool http_conn::read() {
             log_->log("msg", this_file, __LINE__, "Connection closed by client.");
             return false;
         }
+        if(capture_) {
+            /* 录制模式：记录客户端发来的原始数据 */
+            capture_->add(m_conn_id, capture::DATA, m_read_buf + m_read_idx, bytes_read);
+        }
         m_read_idx += bytes_read;
     }
     return true;
 }
 
+ssize_t http_conn::sock_recv(char* buf, size_t len) {
+    return m_tls.active() ? m_tls.recv(buf, len) : recv(m_sockfd, buf, len, 0);
+}
+
+ssize_t http_conn::sock_writev(const struct iovec* iov, int count) {
+    return m_tls.active() ? m_tls.writev(m_sockfd, iov, count) : writev(m_sockfd, iov, count);
+}
+
+/* 将内存中的数据追加到读缓冲，供不经过socket的场景使用（如基准测试） */
+bool http_conn::feed(const char* data, int len) {
+    if(len > READ_BUF_SIZE - m_read_idx) {
+        return false;
+    }
+    memcpy(m_read_buf + m_read_idx, data, len);
+    m_read_idx += len;
+    return true;
+}
+
 /* 获取文件类型 */
 void http_conn::get_file_type(){
-    string name = string(m_url);
     /* 从右向左寻找第一个'.' */
-    int pos = name.rfind('.');
-    m_file_type = (pos == -1) ? "default" : name.substr(pos);
+    const char* dot = strrchr(m_url, '.');
+    m_file_type = dot ? dot : "default";
 }
 
 /* 解析HTTP请求行，获得请求方法、目标url、http版本等信息 */
 http_conn::HTTP_CODE http_conn::parse_request_line(char* text) {
     //printf("parse_request_line -- text: %s\n",text);
+    /* 每个请求消耗客户端IP的一个令牌，超过速率时不再解析 */
+    if (m_limit && ! limiter_->allow(m_limit)) {
+        return TOO_MANY_REQUESTS;
+    }
     m_url = strpbrk(text, " \t");
     if (! m_url) {
         return BAD_REQUEST;
@@ -258,6 +539,25 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char* text) {
     if (strcasecmp(method, "GET") == 0) {
         m_method = GET;
     }
+    else if (strcasecmp(method, "PUT") == 0) {
+        m_method = PUT;
+    }
+    else if (strcasecmp(method, "POST") == 0) {
+        m_method = POST;
+    }
+    else if (strcasecmp(method, "HEAD") == 0) {
+        m_method = HEAD;
+    }
+    /* 其他方法只能交给路由的处理器，路径没有匹配的路由时返回405 */
+    else if (strcasecmp(method, "DELETE") == 0) {
+        m_method = DELETE;
+    }
+    else if (strcasecmp(method, "OPTIONS") == 0) {
+        m_method = OPTIONS;
+    }
+    else if (strcasecmp(method, "PATCH") == 0) {
+        m_method = PATCH;
+    }
     else{
         return BAD_REQUEST;
     }
@@ -270,7 +570,14 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char* text) {
     }
     *m_version++ = '\0';
     m_version += strspn(m_version, " \t");
-    if (strcasecmp(m_version, "HTTP/1.1") != 0) {
+    /* HTTP/1.1默认保持连接，HTTP/1.0需要Connection: keep-alive */
+    if (strcasecmp(m_version, "HTTP/1.1") == 0) {
+        m_linger = true;
+    }
+    else if (strcasecmp(m_version, "HTTP/1.0") == 0) {
+        m_linger = false;
+    }
+    else {
         return BAD_REQUEST;
     }
 
@@ -281,10 +588,20 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char* text) {
     if (! m_url || m_url[ 0 ] != '/') {
         return BAD_REQUEST;
     }
+    m_target = m_url;
 
-    /* 解码链接unicode */
-    string tmp = string(m_url);
-    strcpy(m_url, urlDecode(tmp).c_str());
+    /* 只解码'?'之前的路径（查询串由query()从m_target中取得），结果放在arena中，
+     * 读缓冲中的原始请求保持不变；解码后再规范化，同一文件只对应一个缓存项，
+     * 也不能通过".."访问网站根目录之外的文件
+     */
+    size_t path_len = strcspn(m_url, "?");
+    char* decoded = static_cast<char*>(m_arena.alloc(path_len + 1));
+    memcpy(decoded, m_url, path_len);
+    decoded[path_len] = '\0';
+    if (urlDecode(decoded, decoded) < 0 || ! normalizePath(decoded)) {
+        return BAD_REQUEST;
+    }
+    m_url = decoded;
     get_file_type();
     //printf("get file type:%s\n", m_file_type.c_str());
     m_check_state = CHECK_STATE_HEADER;
@@ -296,7 +613,30 @@ http_conn::HTTP_CODE http_conn::parse_headers(char* text) {
     //printf("parse_headers text: %s\n",text);
     /* 遇到空行，表示头部字段解析完毕 */
     if(text[ 0 ] == '\0') {
-        if (m_method == HEAD) {
+        /* 未开启长连接或达到单个连接的请求数上限时，本次应答后关闭连接 */
+        if (config_->keepalive_timeout <= 0 || (config_->keepalive_requests > 0
+                && m_requests + 1 >= (uint32_t)config_->keepalive_requests)) {
+            m_linger = false;
+        }
+        /* 交给处理器的请求不读取消息体：代理请求的消息体由m_proxy直接转发到上游 */
+        m_handler = router_ ? router_->match(m_method, m_url, m_allowed) : nullptr;
+        if (m_handler || m_allowed) {
+            return GET_REQUEST;
+        }
+        /* 没有消息体的HTTP/1.1 GET请求才能升级到h2c，该请求作为流1在HTTP/2上应答 */
+        if (m_upgrade_h2c && m_connection_upgrade && m_h2_settings && m_method == GET
+                && m_content_length == 0 && ! m_chunked && strcasecmp(m_version, "HTTP/1.1") == 0) {
+            m_upgrade = UPGRADE_H2C;
+        }
+        /* 上传的消息体不经过读缓冲，由do_request直接写入文件 */
+        if (m_method == PUT || m_method == POST) {
+            return GET_REQUEST;
+        }
+        /* chunked编码的消息体不读取（同时有Content-Length时以chunked为准，RFC 9112 6.1），
+         * 无法确定下一个请求从哪里开始，不能把消息体当作流水线的请求解析，应答后关闭连接
+         */
+        if (m_chunked) {
+            m_linger = false;
             return GET_REQUEST;
         }
         /* http请求有消息体，还需要读取消息体，状态转移至CHECK_STATE_CONTENT */
@@ -308,18 +648,60 @@ http_conn::HTTP_CODE http_conn::parse_headers(char* text) {
         return GET_REQUEST;
     }
     else if (strncasecmp(text, "Connection:", 11) == 0) {
-        /* 处理Connection字段 */
+        /* 处理Connection字段，可能包含多个以','分隔的选项，如"keep-alive, Upgrade" */
         text += 11;
-        text += strspn(text, " \t");
-        if (strcasecmp(text, "keep-alive") == 0) {
-            m_linger = true;
+        while (*text) {
+            text += strspn(text, " \t,");
+            size_t len = strcspn(text, " \t,");
+            if (len == 5 && strncasecmp(text, "close", 5) == 0) {
+                m_linger = false;
+            }
+            else if (len == 10 && strncasecmp(text, "keep-alive", 10) == 0) {
+                m_linger = true;
+            }
+            else if (len == 7 && strncasecmp(text, "upgrade", 7) == 0) {
+                m_connection_upgrade = true;
+            }
+            text += len;
         }
     }
     else if (strncasecmp(text, "Content-Length:", 15) == 0) {
         /* 处理Content-Lenght字段 */
         text += 15;
         text += strspn(text, " \t");
-        m_content_length = atol(text);
+        char* end = 0;
+        m_content_length = strtol(text, &end, 10);
+        if (end == text || *end != '\0' || m_content_length < 0) {
+            return BAD_REQUEST;
+        }
+    }
+    else if (strncasecmp(text, "Transfer-Encoding:", 18) == 0) {
+        /* 处理Transfer-Encoding字段，只支持chunked */
+        text += 18;
+        m_chunked = strcasestr(text, "chunked") != NULL;
+    }
+    else if (config_->h2c && strncasecmp(text, "Upgrade:", 8) == 0) {
+        /* 处理Upgrade字段，只支持h2c，可能与其他协议一起以','分隔列出 */
+        text += 8;
+        while (*text) {
+            text += strspn(text, " \t,");
+            size_t len = strcspn(text, " \t,");
+            if (len == 3 && strncasecmp(text, "h2c", 3) == 0) {
+                m_upgrade_h2c = true;
+            }
+            text += len;
+        }
+    }
+    else if (config_->h2c && strncasecmp(text, "HTTP2-Settings:", 15) == 0) {
+        /* 处理HTTP2-Settings字段，base64url编码的SETTINGS帧内容 */
+        text += 15;
+        text += strspn(text, " \t");
+        m_h2_settings = text;
+    }
+    else if (strncasecmp(text, "Expect:", 7) == 0) {
+        /* 处理Expect字段 */
+        text += 7;
+        m_expect_continue = strcasestr(text, "100-continue") != NULL;
     }
     else if (strncasecmp(text, "Host:", 5) == 0) {
         /* 处理Host字段 */
@@ -327,6 +709,23 @@ http_conn::HTTP_CODE http_conn::parse_headers(char* text) {
         text += strspn(text, " \t");
         m_host = text;
     }
+    else if (strncasecmp(text, "If-Modified-Since:", 18) == 0) {
+        /* 处理If-Modified-Since字段 */
+        text += 18;
+        text += strspn(text, " \t");
+        m_if_modified_since = text;
+    }
+    else if (strncasecmp(text, "If-None-Match:", 14) == 0) {
+        /* 处理If-None-Match字段 */
+        text += 14;
+        text += strspn(text, " \t");
+        m_if_none_match = text;
+    }
+    else if (strncasecmp(text, "Accept-Encoding:", 16) == 0) {
+        /* 处理Accept-Encoding字段，只关心是否接受gzip */
+        text += 16;
+        m_accept_gzip = strcasestr(text, "gzip") != NULL;
+    }
     else {
         /* 其他字段暂未处理 */
         //printf("oop! unknow header %s\n", text);
@@ -335,10 +734,11 @@ http_conn::HTTP_CODE http_conn::parse_headers(char* text) {
     return NO_REQUEST;
 }
 
-/* 并未解析HTTP请求的消息体，只是判断是否被完整读入 */
+/* 并未解析HTTP请求的消息体，只是判断是否被完整读入；
+ * 消息体之后可能是流水线的下一个请求，不能在结尾写入'\0'
+ */
 http_conn::HTTP_CODE http_conn::parse_content(char* text) {
     if (m_read_idx >= (m_content_length + m_checked_idx)) {
-        text[ m_content_length ] = '\0';
         return GET_REQUEST;
     }
 
@@ -347,6 +747,7 @@ http_conn::HTTP_CODE http_conn::parse_content(char* text) {
 
 /* 主状态机 */
 http_conn::HTTP_CODE http_conn::process_read() {
+    trace_scope scope(m_trace, TRACE_PROCESS_READ);
     /* 记录当前行的读取状态 */
     LINE_STATUS line_status = LINE_OK;
     /* 记录http请求的处理结果 */ 
@@ -354,6 +755,24 @@ http_conn::HTTP_CODE http_conn::process_read() {
 
     char* text = 0;
 
+    /* 正在接收上传的消息体，需要写文件，不能在主线程中执行 */
+    if (m_check_state == CHECK_STATE_BODY) {
+        return m_inline ? PENDING_REQUEST : receive_body();
+    }
+
+    /* 开启h2c时，连接上的第一个请求可能是HTTP/2的连接序言，按HTTP/1.1解析会得到BAD_REQUEST */
+    if (config_->h2c && m_requests == 0 && m_check_state == CHECK_STATE_REQUESTLINE && m_start_line == 0
+            && m_read_idx > 0 && m_read_buf[0] == 'P') {
+        size_t len = std::min((size_t)m_read_idx, h2_session::PREFACE_LEN);
+        if (memcmp(m_read_buf, h2_session::PREFACE, len) == 0) {
+            if (len < h2_session::PREFACE_LEN) {
+                return NO_REQUEST;
+            }
+            m_upgrade = UPGRADE_PREFACE;
+            return do_request();
+        }
+    }
+
     /* 依次从缓冲区取出所有行 */
     while (((m_check_state == CHECK_STATE_CONTENT) && (line_status == LINE_OK ))
                 || ((line_status = parse_line()) == LINE_OK))
@@ -366,8 +785,8 @@ http_conn::HTTP_CODE http_conn::process_read() {
             case CHECK_STATE_REQUESTLINE: {
                 /* 第一个状态：分析请求行 */ 
                 ret = parse_request_line(text);
-                if (ret == BAD_REQUEST) {
-                    return BAD_REQUEST;
+                if (ret == BAD_REQUEST || ret == TOO_MANY_REQUESTS) {
+                    return ret;
                 }
                 break;
             }
@@ -398,98 +817,796 @@ http_conn::HTTP_CODE http_conn::process_read() {
         }
     }
 
+    /* 读缓冲已满仍不是完整的请求（请求过大）或行格式错误，不能再等待更多数据 */
+    if (line_status == LINE_BAD || m_read_idx >= READ_BUF_SIZE) {
+        return BAD_REQUEST;
+    }
     return NO_REQUEST;
 }
 
+/* 切换到HTTP/2。升级前的请求已解析，转换为HTTP/2的请求作为流1，
+ * 读缓冲中该请求之后的数据（客户端的连接序言等）交给m_h2
+ */
+bool http_conn::start_h2() {
+    m_h2 = new h2_session(*this);
+    m_trace.reset();
+    if (m_upgrade == UPGRADE_PREFACE) {
+        m_h2->start(m_read_buf, m_read_idx);
+    }
+    else {
+        /* m_url已解码，重新编码后由流1再次解码 */
+        h2_request request;
+        request.method = "GET";
+        char* path = static_cast<char*>(m_arena.alloc(strlen(m_url) * 3 + 1));
+        urlEncode(m_url, path);
+        request.path = path;
+        request.authority = m_host;
+        request.if_modified_since = m_if_modified_since;
+        request.if_none_match = m_if_none_match;
+        request.accept_gzip = m_accept_gzip;
+        if (! m_h2->upgrade(m_h2_settings, request, m_read_buf + m_checked_idx, m_read_idx - m_checked_idx)) {
+            return false;
+        }
+    }
+    log_->log("msg", this_file, __LINE__, "Switched to HTTP/2.");
+    return m_h2->process();
+}
+
+bool http_conn::start_proxy() {
+    return m_proxy && m_proxy->start(m_route);
+}
+
+bool http_conn::proxying() const {
+    return m_proxy && m_proxy->active();
+}
+
+http_conn::HTTP_CODE http_conn::do_route_request() {
+    if (m_inline && m_handler && m_handler->blocking()) {
+        m_pending = true;
+        return PENDING_REQUEST;
+    }
+    HTTP_CODE ret = m_handler ? m_handler->handle(*this) : METHOD_NOT_ALLOWED;
+    /* 消息体仍在socket中，无法确定下一个请求从哪里开始 */
+    if (ret != PROXY_REQUEST && (m_content_length > 0 || m_chunked)) {
+        m_linger = false;
+    }
+    return ret;
+}
+
+const char* http_conn::query() const {
+    const char* q = m_target ? strchr(m_target, '?') : nullptr;
+    return q ? q + 1 : "";
+}
+
+http_conn::HTTP_CODE http_conn::respond(int status, const char* title, const char* type, const char* body, size_t len) {
+    m_status = status;
+    m_status_title = title;
+    m_file_type = type;
+    m_content = body;
+    m_content_len = len;
+    return CONTENT_REQUEST;
+}
+
+/* 连接上游不会阻塞，可以在主线程中开始 */
+http_conn::HTTP_CODE http_conn::forward(const proxy_route* route) {
+    m_route = route;
+    return PROXY_REQUEST;
+}
+
 /* 当获得完整且正确的http请求时，分析目标文件属性，若文件存在、
  * 有权访问、且不是目录，则mmap到m_file_address处
  */
 http_conn::HTTP_CODE http_conn::do_request() {
+    trace_scope scope(m_trace, TRACE_DO_REQUEST);
+    /* HTTP/2连接由工作线程处理 */
+    if (m_upgrade != UPGRADE_NONE) {
+        if (m_inline) {
+            m_pending = true;
+            return PENDING_REQUEST;
+        }
+        return SWITCH_PROTOCOLS;
+    }
+    if (m_handler || m_allowed) {
+        return do_route_request();
+    }
+    if (m_method == PUT || m_method == POST) {
+        return do_upload_request();
+    }
+    if (m_method != GET && m_method != HEAD) {
+        return METHOD_NOT_ALLOWED;
+    }
+    if (bundle_) {
+        return do_bundle_request();
+    }
+    const char* doc_root = config_->doc_root.c_str();    /* 网站根目录 */
     strcpy(m_real_file, doc_root);
     int len = strlen(doc_root);
     strncpy(m_real_file + len, m_url, FILENAME_LEN - len - 1);
 
-    string info ="visit file or dir: [ " + string(m_real_file) + " ] ";
-    
-    
+    /* 目录的处理方式已知时不需要访问磁盘 */
+    dir_entry_ptr dir;
+    if (dir_index_ && m_url[strlen(m_url) - 1] == '/' && dir_index_->get(m_real_file, dir)) {
+        return do_dir_request(dir);
+    }
+    return do_file_request(false);
+}
+
+http_conn::HTTP_CODE http_conn::do_file_request(bool index) {
+    const char* info = "visit file or dir: [ %s ] [ %s ]";
+
+    /* 先查缓存，命中时不需要访问磁盘 */
+    if (file_cache_ && file_cache_->get(m_real_file, m_cache_entry)) {
+        log_->log("msg", this_file, __LINE__, m_arena.printf(info, m_real_file, "ok"));
+        memcpy(m_last_modified, m_cache_entry->last_modified, sizeof(m_last_modified));
+        if (not_modified(m_cache_entry->mtime)) {
+            m_cache_entry.reset();
+            return NOT_MODIFIED;
+        }
+        m_file_stat.st_size = m_cache_entry->size;
+        m_file_address = m_cache_entry->data;
+        m_static_headers = m_cache_entry->headers;
+        m_static_headers_len = m_cache_entry->header_len;
+        return FILE_REQUEST;
+    }
+
+    /* 不以'/'结尾的目录已被记住时直接重定向 */
+    dir_entry_ptr dir;
+    if (dir_index_ && ! index && dir_index_->get(m_real_file, dir)) {
+        return do_dir_request(dir);
+    }
+
+    /* 未命中缓存，stat/open/mmap可能阻塞在磁盘上，不能在主线程中执行 */
+    if (m_inline) {
+        m_pending = true;
+        return PENDING_REQUEST;
+    }
+
     if (stat(m_real_file, &m_file_stat) < 0){   /* 目标文件不存在 */
-        info += "[ not found ]";
-        log_->log("msg", this_file, __LINE__, info);    /* 文件被访问,记录到日志 */
+        log_->log("msg", this_file, __LINE__, m_arena.printf(info, m_real_file, "not found"));
         return NO_RESOURCE;
     }
 
     if (! (m_file_stat.st_mode & S_IROTH)) {    /* 无访问权限 */
-        info += "[ no permission ]";
-        log_->log("msg", this_file, __LINE__, info);    /* 文件被访问,记录到日志 */
+        log_->log("msg", this_file, __LINE__, m_arena.printf(info, m_real_file, "no permission"));
         return FORBIDDEN_REQUEST;
     }
 
-    if (S_ISDIR(m_file_stat.st_mode)) {         /* 目标文件为目录，访问错误 */
-        info += "[ dir, failed to visit ]";
-        log_->log("msg", this_file, __LINE__, info);    /* 文件被访问,记录到日志 */
-        return BAD_REQUEST;
+    if (S_ISDIR(m_file_stat.st_mode)) {         /* 目标文件为目录，查找index文件或返回目录列表 */
+        if (! dir_index_ || index) {
+            log_->log("msg", this_file, __LINE__, m_arena.printf(info, m_real_file, "dir, failed to visit"));
+            return index ? NO_RESOURCE : BAD_REQUEST;
+        }
+        return do_dir_request(dir_index_->resolve(m_real_file, m_file_stat, m_url));
+    }
+
+    /* 文件被访问,记录到日志 */
+    log_->log("msg", this_file, __LINE__, m_arena.printf(info, m_real_file, "ok"));
+    struct tm tm_buf;
+    strftime(m_last_modified, sizeof(m_last_modified), "%a, %d %b %Y %H:%M:%S GMT",
+        gmtime_r(&m_file_stat.st_mtime, &tm_buf));
+    if (not_modified(m_file_stat.st_mtime)) {
+        return NOT_MODIFIED;
+    }
+
+    /* 小文件读入缓存，之后的请求可以直接在主线程中处理 */
+    if (file_cache_ && file_cache_->load(m_real_file, m_file_stat, get_content_type(m_file_type), m_cache_entry)) {
+        m_file_address = m_cache_entry->data;
+        m_static_headers = m_cache_entry->headers;
+        m_static_headers_len = m_cache_entry->header_len;
+        return FILE_REQUEST;
+    }
+    if (m_file_stat.st_size == 0) {
+        return FILE_REQUEST;
     }
 
-    info += "[ ok ]";
-    log_->log("msg", this_file, __LINE__, info);    /* 文件被访问,记录到日志 */
     /* 打开文件，mmap到m_file_address */
     int fd = open(m_real_file, O_RDONLY);
+    if (fd < 0) {
+        return NO_RESOURCE;
+    }
     m_file_address = (char*)mmap(0, m_file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
     close(fd);
+    if (m_file_address == MAP_FAILED) {
+        m_file_address = 0;
+        return INTERNAL_ERROR;
+    }
     return FILE_REQUEST;
 }
 
+/* 不以'/'结尾的url重定向，使页面中的相对链接以该目录为基准；
+ * 否则返回index文件、目录列表或403
+ */
+http_conn::HTTP_CODE http_conn::do_dir_request(const dir_entry_ptr& dir) {
+    size_t len = strlen(m_url);
+    if (m_url[len - 1] != '/') {
+        m_location = static_cast<char*>(m_arena.alloc(len * 3 + 2));
+        int n = urlEncode(m_url, m_location);
+        m_location[n] = '/';
+        m_location[n + 1] = '\0';
+        return MOVED_PERMANENTLY;
+    }
+    switch (dir->kind) {
+        case dir_entry::INDEX: {
+            if (dir->index.size() >= (size_t)FILENAME_LEN) {
+                return NO_RESOURCE;
+            }
+            memcpy(m_real_file, dir->index.c_str(), dir->index.size() + 1);
+            const char* dot = strrchr(m_real_file, '.');
+            m_file_type = (dot && ! strchr(dot, '/')) ? dot : "default";
+            return do_file_request(true);
+        }
+        case dir_entry::LISTING: {
+            m_cache_entry = dir->listing;
+            memcpy(m_last_modified, m_cache_entry->last_modified, sizeof(m_last_modified));
+            if (not_modified(m_cache_entry->mtime)) {
+                m_cache_entry.reset();
+                return NOT_MODIFIED;
+            }
+            m_file_stat.st_size = m_cache_entry->size;
+            m_file_address = m_cache_entry->data;
+            m_static_headers = m_cache_entry->headers;
+            m_static_headers_len = m_cache_entry->header_len;
+            return FILE_REQUEST;
+        }
+        case dir_entry::STREAMED: {
+            struct tm tm_buf;
+            strftime(m_last_modified, sizeof(m_last_modified), "%a, %d %b %Y %H:%M:%S GMT",
+                gmtime_r(&dir->mtime.tv_sec, &tm_buf));
+            if (not_modified(dir->mtime.tv_sec)) {
+                return NOT_MODIFIED;
+            }
+            m_file_type = ".html";
+            return stream(new listing_producer(dir, m_url));
+        }
+        default: {
+            return FORBIDDEN_REQUEST;
+        }
+    }
+}
+
+/* 归档在启动时被整个mmap，查找只需计算哈希并比较路径，不需要任何系统调用，
+ * 可以在主线程中直接处理；归档中没有的路径一律返回404
+ */
+http_conn::HTTP_CODE http_conn::do_bundle_request() {
+    const char* info = "visit file or dir: [ %s ] [ %s ]";
+    const bundle_entry* e = bundle_->find(m_url, strlen(m_url));
+    if (! e) {
+        log_->log("msg", this_file, __LINE__, m_arena.printf(info, m_url, "not found"));
+        return NO_RESOURCE;
+    }
+    log_->log("msg", this_file, __LINE__, m_arena.printf(info, m_url, "ok"));
+    const bundle_variant& v = (m_accept_gzip && (e->flags & BUNDLE_GZIP)) ? e->gzip : e->identity;
+    m_static_headers = bundle_->at(v.header_offset);
+    m_static_headers_len = v.header_len;
+    if (m_if_none_match && (strstr(m_if_none_match, v.etag) || strcmp(m_if_none_match, "*") == 0)) {
+        return NOT_MODIFIED;
+    }
+    m_file_stat.st_size = v.body_size;
+    m_file_address = const_cast<char*>(bundle_->at(v.body_offset));
+    return FILE_REQUEST;
+}
+
+/* 将len字节全部写入fd */
+static bool write_all(int fd, const char* buf, long len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+/* 上传的目标为网站根目录下的文件。消息体先写入同一目录中以'.'开头的临时文件
+ * （目录列表中不显示），全部接收后再rename到目标路径，下载方不会看到写了一半的文件
+ */
+http_conn::HTTP_CODE http_conn::do_upload_request() {
+    /* 消息体尚未接收完时出错，无法确定下一个请求从哪里开始，只能关闭连接 */
+    m_upload_linger = m_linger;
+    m_linger = false;
+    if (config_->upload_max <= 0 || bundle_) {
+        return METHOD_NOT_ALLOWED;
+    }
+    if (! m_chunked && m_content_length > (config_->upload_max << 20)) {
+        return PAYLOAD_TOO_LARGE;
+    }
+    /* 创建文件可能阻塞在磁盘上 */
+    if (m_inline) {
+        m_pending = true;
+        m_linger = m_upload_linger;
+        return PENDING_REQUEST;
+    }
+
+    const char* info = "upload file: [ %s ] [ %s ]";
+    const char* doc_root = config_->doc_root.c_str();
+    int root_len = strlen(doc_root);
+    int url_len = strlen(m_url);
+    if (m_url[url_len - 1] == '/') {
+        return FORBIDDEN_REQUEST;
+    }
+    if (root_len + url_len >= FILENAME_LEN) {
+        return BAD_REQUEST;
+    }
+    memcpy(m_real_file, doc_root, root_len);
+    memcpy(m_real_file + root_len, m_url, url_len + 1);
+    /* 临时文件名：目录 + "/." + 文件名 + ".XXXXXX" */
+    const char* name = strrchr(m_real_file, '/') + 1;
+    snprintf(m_upload_tmp, sizeof(m_upload_tmp), "%.*s.%s.XXXXXX", (int)(name - m_real_file), m_real_file, name);
+    m_upload_fd = mkostemp(m_upload_tmp, O_CLOEXEC);
+    if (m_upload_fd < 0) {
+        int err = errno;
+        m_upload_tmp[0] = '\0';
+        log_->log("msg", this_file, __LINE__, m_arena.printf(info, m_real_file, strerror(err)));
+        if (err == ENOENT || err == ENOTDIR) {
+            return NO_RESOURCE;
+        }
+        return (err == EACCES || err == EROFS) ? FORBIDDEN_REQUEST : INTERNAL_ERROR;
+    }
+    /* mkstemp创建的文件只有属主可读，而发送文件时要求S_IROTH */
+    fchmod(m_upload_fd, 0644);
+    /* TLS连接上的数据需经SSL_read解密，不能从socket直接splice */
+    if (m_tls.active() || pipe2(m_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        m_pipe[0] = m_pipe[1] = -1;
+    }
+
+    /* 请求头部已不再需要，读缓冲中剩余的数据是消息体的开头，移到缓冲区开头 */
+    m_check_state = CHECK_STATE_BODY;
+    m_body_state = m_chunked ? CHUNK_SIZE : BODY_DATA;
+    m_body_left = m_chunked ? 0 : m_content_length;
+    m_body_total = 0;
+    memmove(m_read_buf, m_read_buf + m_checked_idx, m_read_idx - m_checked_idx);
+    m_read_idx -= m_checked_idx;
+    m_checked_idx = 0;
+    m_start_line = 0;
+    if (m_expect_continue && m_read_idx == 0) {
+        static const char continue_response[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        struct iovec iv = {const_cast<char*>(continue_response), sizeof(continue_response) - 1};
+        sock_writev(&iv, 1);
+    }
+    return receive_body();
+}
+
+/* 在socket中没有数据之前一直接收，返回NO_REQUEST时等待下一个EPOLLIN再继续；
+ * 分块编码的控制行经过读缓冲解析，数据部分与Content-Length的消息体一样直接splice到文件
+ */
+http_conn::HTTP_CODE http_conn::receive_body() {
+    long limit = config_->upload_max << 20;
+    while (m_body_state != BODY_DONE) {
+        if (m_body_state == BODY_DATA) {
+            if (m_body_left == 0) {
+                m_body_state = m_chunked ? CHUNK_CRLF : BODY_DONE;
+                continue;
+            }
+            long n = m_read_idx - m_checked_idx;
+            if (n > 0) {
+                /* 先写入已经读到读缓冲中的部分 */
+                n = (n < m_body_left) ? n : m_body_left;
+                if (! write_all(m_upload_fd, m_read_buf + m_checked_idx, n)) {
+                    return INTERNAL_ERROR;
+                }
+                m_checked_idx += n;
+            }
+            else {
+                n = splice_body((m_body_left < (long)UPLOAD_CHUNK) ? m_body_left : UPLOAD_CHUNK);
+                if (n == 0) {
+                    return NO_REQUEST;
+                }
+                if (n < 0) {
+                    return (n == -1) ? CLOSED_CONNECTION : INTERNAL_ERROR;
+                }
+            }
+            m_body_left -= n;
+            m_body_total += n;
+            /* 有进展就不算空闲，大文件的上传不受keepalive_timeout限制 */
+            m_idle_begin = time(nullptr);
+            continue;
+        }
+
+        /* 分块编码的控制行，不完整时继续读取 */
+        char* line = m_read_buf + m_checked_idx;
+        char* crlf = (char*)memmem(line, m_read_idx - m_checked_idx, "\r\n", 2);
+        if (! crlf) {
+            memmove(m_read_buf, line, m_read_idx - m_checked_idx);
+            m_read_idx -= m_checked_idx;
+            m_checked_idx = 0;
+            if (m_read_idx >= READ_BUF_SIZE) {
+                return BAD_REQUEST;
+            }
+            ssize_t n = sock_recv(m_read_buf + m_read_idx, READ_BUF_SIZE - m_read_idx);
+            if (n > 0) {
+                m_read_idx += n;
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return NO_REQUEST;
+            }
+            return CLOSED_CONNECTION;
+        }
+        *crlf = '\0';
+        m_checked_idx = crlf + 2 - m_read_buf;
+        switch (m_body_state) {
+            case CHUNK_CRLF: {
+                if (line[0] != '\0') {
+                    return BAD_REQUEST;
+                }
+                m_body_state = CHUNK_SIZE;
+                break;
+            }
+            case CHUNK_SIZE: {
+                /* 大小为十六进制，之后可能有";扩展"，位数限制在long的范围内 */
+                size_t digits = strspn(line, "0123456789abcdefABCDEF");
+                if (digits == 0 || digits > 15 || (line[digits] != '\0' && line[digits] != ';'
+                        && line[digits] != ' ' && line[digits] != '\t')) {
+                    return BAD_REQUEST;
+                }
+                long size = strtol(line, 0, 16);
+                if (m_body_total + size > limit) {
+                    return PAYLOAD_TOO_LARGE;
+                }
+                m_body_left = size;
+                m_body_state = (size == 0) ? CHUNK_TRAILER : BODY_DATA;
+                break;
+            }
+            default: {
+                /* trailer中的字段全部忽略，以空行结束 */
+                if (line[0] == '\0') {
+                    m_body_state = BODY_DONE;
+                }
+                break;
+            }
+        }
+    }
+    return finish_upload();
+}
+
+long http_conn::splice_body(long len) {
+    if (m_pipe[0] >= 0) {
+        ssize_t n = splice(m_sockfd, NULL, m_pipe[1], NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            /* 管道中只有这n字节，全部转存到文件 */
+            for (ssize_t moved = 0; moved < n; ) {
+                ssize_t m = splice(m_pipe[0], NULL, m_upload_fd, NULL, n - moved, SPLICE_F_MOVE);
+                if (m <= 0) {
+                    return -2;
+                }
+                moved += m;
+            }
+            return n;
+        }
+        if (n == 0) {
+            return -1;
+        }
+        if (errno == EAGAIN) {
+            return 0;
+        }
+        if (errno != EINVAL) {
+            return -1;
+        }
+        /* socket不支持splice，改用读缓冲中转 */
+        close(m_pipe[0]);
+        close(m_pipe[1]);
+        m_pipe[0] = m_pipe[1] = -1;
+    }
+    /* 调用时读缓冲中的数据已全部写入文件 */
+    m_read_idx = m_checked_idx = 0;
+    ssize_t n = sock_recv(m_read_buf, (len < READ_BUF_SIZE) ? len : READ_BUF_SIZE);
+    if (n > 0) {
+        return write_all(m_upload_fd, m_read_buf, n) ? n : -2;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+    }
+    return -1;
+}
+
+http_conn::HTTP_CODE http_conn::finish_upload() {
+    const char* info = "upload file: [ %s ] [ %s ]";
+    m_upload_replaced = access(m_real_file, F_OK) == 0;
+    if (rename(m_upload_tmp, m_real_file) < 0) {
+        int err = errno;
+        log_->log("msg", this_file, __LINE__, m_arena.printf(info, m_real_file, strerror(err)));
+        close_upload();
+        return (err == EISDIR || err == EACCES) ? FORBIDDEN_REQUEST : INTERNAL_ERROR;
+    }
+    m_upload_tmp[0] = '\0';
+    close_upload();
+    log_->log("msg", this_file, __LINE__, m_arena.printf("upload file: [ %s ] [ %ld bytes ]", m_real_file, m_body_total));
+    /* 不等inotify事件，立即使旧内容失效 */
+    if (file_cache_) {
+        file_cache_->invalidate(m_real_file);
+    }
+    m_linger = m_upload_linger;
+    return CREATED;
+}
+
+void http_conn::close_upload() {
+    if (m_upload_fd >= 0) {
+        close(m_upload_fd);
+        m_upload_fd = -1;
+    }
+    if (m_pipe[0] >= 0) {
+        close(m_pipe[0]);
+        close(m_pipe[1]);
+        m_pipe[0] = m_pipe[1] = -1;
+    }
+    if (m_upload_tmp[0]) {
+        unlink(m_upload_tmp);
+        m_upload_tmp[0] = '\0';
+    }
+}
+
+/* 客户端缓存的版本不早于文件的修改时间时返回true */
+bool http_conn::not_modified(time_t mtime) const {
+    if (! m_if_modified_since) {
+        return false;
+    }
+    /* 浏览器一般原样回传上次收到的Last-Modified */
+    if (strcmp(m_if_modified_since, m_last_modified) == 0) {
+        return true;
+    }
+    struct tm tm_buf;
+    memset(&tm_buf, 0, sizeof(tm_buf));
+    const char* end = strptime(m_if_modified_since, "%a, %d %b %Y %H:%M:%S GMT", &tm_buf);
+    return end && *end == '\0' && mtime <= timegm(&tm_buf);
+}
+
 /* 对内存映射区执行munmap操作 */
 void http_conn::unmap() {
-    if(m_file_address) {
+    m_static_headers = 0;
+    m_producer.reset();
+    if(m_cache_entry) {
+        /* 内容来自缓存，只释放引用 */
+        m_cache_entry.reset();
+        m_file_address = 0;
+    }
+    else if(bundle_) {
+        /* 内容来自归档，归档一直映射在内存中 */
+        m_file_address = 0;
+    }
+    else if(m_file_address) {
         munmap(m_file_address, m_file_stat.st_size);
         m_file_address = 0;
     }
 }
 
-/* 写http响应 */
+/* 写http响应，由主线程在EPOLLOUT事件中调用 */
 bool http_conn::write() {
-    int temp = 0;
-    int bytes_have_send = 0;
-    int bytes_to_send = m_write_idx;
-    if (bytes_to_send == 0) {
-        modfd(m_epollfd, m_sockfd, EPOLLIN);
-        init();
+    m_pipelined = false;
+    /* HTTP/2的发送与帧的处理交织在一起，交给工作线程；TLS握手同样在工作线程中继续 */
+    if (m_h2 || handshaking()) {
+        m_pipelined = true;
+        return true;
+    }
+    /* 客户连接可写，或上游连接上的事件（见conn_table::UPSTREAM_TAG） */
+    if (proxying()) {
+        return m_proxy->process();
+    }
+    if (m_bytes_to_send == 0 && ! m_producer) {
+        /* 工作线程连续处理的请求数达到上限，交还读缓冲中剩余的流水线请求；
+         * 或者TLS层中还有数据（见wait_read）
+         */
+        if (m_read_idx > 0 || m_tls.pending()) {
+            m_pipelined = true;
+        }
+        else {
+            wait_read();
+        }
+        return true;
+    }
+    /* 大文件可能分多次发送，每次发送前都检查，避免主线程阻塞在缺页上 */
+    if (defer_to_io()) {
         return true;
     }
 
-    while(true) {
-        temp = writev(m_sockfd, m_iv, m_iv_count);
-        if (temp <= -1) {
+    switch(send_response()) {
+        case WRITE_AGAIN: {
             /* 如果TCP写缓冲没有空间，则等待下一轮EPOLLOUT事件，虽然在此
              * 期间服务器无法立即收到同一客户的下一请求，但可以保证连接完整性
              */
-            if(errno == EAGAIN) {
-                modfd(m_epollfd, m_sockfd, EPOLLOUT);
+            modfd(m_epollfd, m_sockfd, EPOLLOUT, m_key);
+            return true;
+        }
+        case WRITE_DONE: {
+            /* 发送http响应成功，根据http请求中的Connection字段决定是否关闭连接 */
+            if(m_linger) {
+                finish_request();
+                if(m_read_idx > 0) {
+                    m_pipelined = true;
+                }
+                else {
+                    wait_read();
+                }
                 return true;
             }
-            unmap();
             return false;
         }
+        default: {
+            return false;
+        }
+    }
+}
+
+/* 检查下一次writev将要发送的文件内容是否都在page cache中，
+ * 不在时交给I/O线程预读，由I/O线程在预读完成后注册EPOLLOUT
+ */
+bool http_conn::defer_to_io() {
+    if (! m_io_pool || ! m_file_address || m_cache_entry) {
+        return false;
+    }
+    static const long page_size = sysconf(_SC_PAGESIZE);
+    long offset = (m_bytes_have_send > m_write_idx) ? m_bytes_have_send - m_write_idx : 0;
+    long len = m_file_stat.st_size - offset;
+    if (len > (long)PREFETCH_WINDOW) {
+        len = PREFETCH_WINDOW;
+    }
+    if (len <= 0) {
+        return false;
+    }
+    /* mmap返回的地址是页对齐的，起始位置向下对齐到页 */
+    long begin = offset & ~(page_size - 1);
+    long span = offset + len - begin;
+    unsigned char vec[PREFETCH_WINDOW / 4096 + 2];
+    if (mincore(m_file_address + begin, span, vec) < 0) {
+        return false;
+    }
+    long pages = (span + page_size - 1) / page_size;
+    long i = 0;
+    while (i < pages && (vec[i] & 1)) {
+        ++i;
+    }
+    if (i == pages) {
+        return false;
+    }
+    m_prefetch = true;
+    if (! m_io_pool->append(this)) {
+        /* I/O线程池队列已满，只能直接发送 */
+        m_prefetch = false;
+        return false;
+    }
+    return true;
+}
+
+/* 由I/O线程执行：先用MADV_WILLNEED发起异步预读，再逐页访问等待读取完成 */
+void http_conn::prefetch() {
+    trace_scope scope(m_trace, TRACE_PREFETCH);
+    static const long page_size = sysconf(_SC_PAGESIZE);
+    long offset = (m_bytes_have_send > m_write_idx) ? m_bytes_have_send - m_write_idx : 0;
+    long len = m_file_stat.st_size - offset;
+    if (len > (long)PREFETCH_WINDOW) {
+        len = PREFETCH_WINDOW;
+    }
+    long begin = offset & ~(page_size - 1);
+    long end = offset + len;
+    madvise(m_file_address + begin, end - begin, MADV_WILLNEED);
+    volatile char sink = 0;
+    for (long pos = begin; pos < end; pos += page_size) {
+        sink += m_file_address[pos];
+    }
+    (void)sink;
+}
 
-        bytes_to_send -= temp;
-        bytes_have_send += temp;
-        if (bytes_to_send <= bytes_have_send) {
+/* 循环writev直到应答发送完毕或TCP写缓冲已满 */
+http_conn::WRITE_STATUS http_conn::send_response() {
+    trace_scope scope(m_trace, TRACE_WRITE);
+    /* 每次最多发送write_quantum字节，剩余部分交还给epoll（返回WRITE_AGAIN），
+     * 大文件的发送与其他连接轮流进行，不会长时间占用线程
+     */
+    long budget = (config_->write_quantum > 0) ? (long)config_->write_quantum << 10 : LONG_MAX;
+    int temp = 0;
+    while(true) {
+        if (m_producer && m_bytes_to_send == (long)m_iv[0].iov_len) {
+            /* 上一个分块已发送完毕，拉取下一个，与未发送完的头部一起writev */
+            body_producer::STATUS status = next_chunk();
+            if (status == body_producer::PRODUCE_ERROR) {
+                unmap();
+                return WRITE_ERROR;
+            }
+        }
+        if (m_bytes_to_send <= 0) {
+            if (m_producer) {
+                /* 生产者返回了空的数据 */
+                continue;
+            }
             unmap();
-            /* 发送http响应成功，根据http请求中的Connection字段决定是否关闭连接 */
-            if(m_linger) {
-                init();
-                modfd(m_epollfd, m_sockfd, EPOLLIN);
-                return true;
+            m_last_size = m_bytes_have_send;
+            /* 应答发送完毕，提交本次请求的追踪记录 */
+            scope.finish();
+            m_trace.commit(m_conn_id, m_url ? m_url : "");
+            return WRITE_DONE;
+        }
+
+        struct iovec iv[3];
+        long left = budget;
+        for (int i = 0; i < m_iv_count; ++i) {
+            iv[i].iov_base = m_iv[i].iov_base;
+            iv[i].iov_len = ((long)m_iv[i].iov_len < left) ? m_iv[i].iov_len : left;
+            left -= iv[i].iov_len;
+        }
+        temp = sock_writev(iv, m_iv_count);
+        if (temp <= -1) {
+            if(errno == EAGAIN) {
+                return WRITE_AGAIN;
             }
-            else {
-                modfd(m_epollfd, m_sockfd, EPOLLIN);
-                return false;
-            } 
+            unmap();
+            return WRITE_ERROR;
+        }
+
+        m_bytes_to_send -= temp;
+        m_bytes_have_send += temp;
+        /* writev可能只发送了部分数据，调整iovec使下次从未发送的位置继续 */
+        long sent = temp;
+        for (int i = 0; i < m_iv_count && sent > 0; ++i) {
+            long len = ((long)m_iv[i].iov_len < sent) ? m_iv[i].iov_len : sent;
+            m_iv[i].iov_base = (char*)m_iv[i].iov_base + len;
+            m_iv[i].iov_len -= len;
+            sent -= len;
+        }
+
+        budget -= temp;
+        if (budget <= 0 && (m_bytes_to_send > 0 || m_producer)) {
+            return WRITE_AGAIN;
         }
     }
 }
 
+/* 接管producer，由process_write填充头部，send_response在头部之后拉取数据 */
+http_conn::HTTP_CODE http_conn::stream(body_producer* producer) {
+    m_producer.reset(producer);
+    m_chunk_open = false;
+    return STREAM_REQUEST;
+}
+
+body_producer::STATUS http_conn::next_chunk() {
+    const char* data = nullptr;
+    size_t len = 0;
+    body_producer::STATUS status = m_producer->next(&data, &len);
+    m_iv[1].iov_len = 0;
+    m_iv[2].iov_len = 0;
+    if (status == body_producer::PRODUCE_DATA && len > 0) {
+        if (m_chunk_framing) {
+            /* 上一个分块的结尾与本分块的大小行放在一起 */
+            int n = snprintf(m_chunk_head, sizeof(m_chunk_head), "%s%zx\r\n", m_chunk_open ? "\r\n" : "", len);
+            m_iv[1].iov_base = m_chunk_head;
+            m_iv[1].iov_len = n;
+            m_chunk_open = true;
+        }
+        m_iv[2].iov_base = const_cast<char*>(data);
+        m_iv[2].iov_len = len;
+        m_bytes_to_send += m_iv[1].iov_len + len;
+    }
+    else if (status == body_producer::PRODUCE_END) {
+        /* 数据都已发送，可以释放生产者；剩下最后一个长度为0的分块 */
+        m_producer.reset();
+        if (m_chunk_framing) {
+            const char* last = m_chunk_open ? "\r\n0\r\n\r\n" : "0\r\n\r\n";
+            m_iv[1].iov_base = const_cast<char*>(last);
+            m_iv[1].iov_len = strlen(last);
+            m_bytes_to_send += m_iv[1].iov_len;
+        }
+    }
+    return status;
+}
+
+/* 正在发送的应答按其实际大小判断；尚未解析的请求无法得知应答大小，按该连接上
+ * 一个应答的大小估计，下载大文件的客户端通常会连续请求大文件
+ */
+bool http_conn::bulk() const {
+    if (config_->bulk_size <= 0) {
+        return false;
+    }
+    /* 上传也会长时间占用线程 */
+    if (m_check_state == CHECK_STATE_BODY && m_body_state != BODY_DONE) {
+        return true;
+    }
+    long size = (m_bytes_to_send > 0) ? m_bytes_to_send + m_bytes_have_send : m_last_size;
+    return size >= (long)config_->bulk_size << 10;
+}
+
 /* 向写缓冲中写入待发送的数据 */
 bool http_conn::add_response(const char* format, ...) {
     if(m_write_idx >= WRITE_BUF_SIZE) {
@@ -510,30 +1627,61 @@ bool http_conn::add_status_line(int status, const char* title) {
     return add_response("%s %d %s\r\n", "HTTP/1.1", status, title);
 }
 
-void http_conn::add_headers(int content_len) {
+void http_conn::add_headers(long content_len, bool has_length) {
     /* 获取GMT时间 */
     time_t t= time( NULL );
+    struct tm tm_buf;
     char time_buf[128]={0};
-    strftime( time_buf ,127 ,"%a, %d %b %Y %H:%M:%S GMT" , gmtime(&t));
+    strftime( time_buf ,127 ,"%a, %d %b %Y %H:%M:%S GMT" , gmtime_r(&t, &tm_buf));
 
     /* 在哈希表中查找当前文件类型对应的value，不存在则设置为text/plain */
-    string val = (file_type_map.find(m_file_type) == file_type_map.end()) 
-        ? "text/plain" : file_type_map[m_file_type];
+    const char* val = get_content_type(m_file_type);
 
     add_response(server_name);
-    add_response("Content-Length: %d\r\n", content_len);
-    add_response("Connection: %s\r\n", (m_linger == true) ? "keep-alive" : "close");
-    add_response("Content-Type: %s; charset=utf-8\r\n", val.c_str());
+    if(m_static_headers) {
+        /* 归档或缓存中预先生成的Content-Length、Content-Type、Last-Modified等 */
+        add_response("%.*s", (int)m_static_headers_len, m_static_headers);
+        add_connection();
+        add_response("Date: %s\r\n\r\n", time_buf);
+        return;
+    }
+    if(has_length) {
+        add_response("Content-Length: %ld\r\n", content_len);
+    }
+    if(m_last_modified[0]) {
+        add_response("Last-Modified: %s\r\n", m_last_modified);
+    }
+    add_connection();
+    add_response("Content-Type: %s; charset=utf-8\r\n", val);
     add_response("Date: %s\r\n",time_buf);
     add_response("%s", "\r\n");     /* 添加最后的空行 */
 }
 
+/* 保持连接时告知客户端空闲超时及剩余的请求数，客户端可以在服务器关闭连接之前主动放弃 */
+void http_conn::add_connection() {
+    if (! m_linger) {
+        add_response("Connection: close\r\n");
+    }
+    else if (config_->keepalive_requests > 0) {
+        add_response("Connection: keep-alive\r\nKeep-Alive: timeout=%d, max=%d\r\n",
+            config_->keepalive_timeout, config_->keepalive_requests - (int)m_requests - 1);
+    }
+    else {
+        add_response("Connection: keep-alive\r\nKeep-Alive: timeout=%d\r\n", config_->keepalive_timeout);
+    }
+}
+
+/* HEAD请求的应答只有头部，Content-Length与GET相同 */
 bool http_conn::add_content(const char* content) {
+    if (m_method == HEAD) {
+        return true;
+    }
     return add_response("%s", content);
 }
 
 /* 根据服务器处理HTTP请求的结果，决定返回给客户端的内容 */
 bool http_conn::process_write(HTTP_CODE ret) {
+    trace_scope scope(m_trace, TRACE_PROCESS_WRITE);
     switch (ret) {
         case INTERNAL_ERROR: {
             add_status_line(500, error_500_title);
@@ -543,7 +1691,17 @@ bool http_conn::process_write(HTTP_CODE ret) {
             }
             break;
         }
+        case BAD_GATEWAY: {
+            add_status_line(502, error_502_title);
+            add_headers(strlen(error_502_form));
+            if (! add_content(error_502_form)) {
+                return false;
+            }
+            break;
+        }
         case BAD_REQUEST: {
+            /* 请求格式错误时无法确定下一个请求从哪里开始 */
+            m_linger = false;
             add_status_line(400, error_400_title);
             add_headers(strlen(error_400_form));
             if (! add_content(error_400_form)) {
@@ -569,13 +1727,23 @@ bool http_conn::process_write(HTTP_CODE ret) {
         }
         case FILE_REQUEST: {
             add_status_line(200, ok_200_title);
+            if (m_static_headers && m_file_stat.st_size == 0) {
+                add_headers(0);
+                break;
+            }
             if (m_file_stat.st_size != 0) {
-                add_headers(m_file_stat.st_size);
+                add_headers((long)m_file_stat.st_size);
+                /* HEAD不发送文件内容，提前释放，也不会交给I/O线程预读 */
+                if (m_method == HEAD) {
+                    unmap();
+                    break;
+                }
                 m_iv[0].iov_base = m_write_buf;
                 m_iv[0].iov_len = m_write_idx;
                 m_iv[1].iov_base = m_file_address;
                 m_iv[1].iov_len = m_file_stat.st_size;
                 m_iv_count = 2;
+                m_bytes_to_send = m_write_idx + m_file_stat.st_size;
                 return true;
             }
             else {
@@ -585,6 +1753,109 @@ bool http_conn::process_write(HTTP_CODE ret) {
                     return false;
                 }
             }
+            break;
+        }
+        case CREATED: {
+            /* 204应答不能带有Content-Length */
+            if (m_upload_replaced) {
+                add_status_line(204, ok_204_title);
+                add_headers(0, false);
+            }
+            else {
+                add_status_line(201, ok_201_title);
+                add_headers(0);
+            }
+            break;
+        }
+        case METHOD_NOT_ALLOWED: {
+            /* 路径匹配的路由所接受的方法，没有匹配的路由时为文件所接受的方法 */
+            uint32_t allowed = m_allowed;
+            if (! allowed) {
+                allowed = (1u << GET) | (1u << HEAD);
+                if (config_->upload_max > 0 && ! bundle_) {
+                    allowed |= (1u << PUT) | (1u << POST);
+                }
+            }
+            add_status_line(405, error_405_title);
+            add_response("Allow: ");
+            for (int m = GET, n = 0; m <= PATCH; ++m) {
+                if (allowed & (1u << m)) {
+                    add_response(n++ ? ", %s" : "%s", method_names[m]);
+                }
+            }
+            add_response("\r\n");
+            add_headers(strlen(error_405_form));
+            if (! add_content(error_405_form)) {
+                return false;
+            }
+            break;
+        }
+        case CONTENT_REQUEST: {
+            add_status_line(m_status, m_status_title);
+            add_headers((long)m_content_len);
+            if (m_method == HEAD || m_content_len == 0) {
+                break;
+            }
+            m_iv[0].iov_base = m_write_buf;
+            m_iv[0].iov_len = m_write_idx;
+            m_iv[1].iov_base = const_cast<char*>(m_content);
+            m_iv[1].iov_len = m_content_len;
+            m_iv_count = 2;
+            m_bytes_to_send = m_write_idx + m_content_len;
+            return true;
+        }
+        case TOO_MANY_REQUESTS: {
+            /* 请求没有读完，关闭连接 */
+            m_linger = false;
+            memcpy(m_write_buf, error_429_response, sizeof(error_429_response) - 1);
+            m_write_idx = sizeof(error_429_response) - 1;
+            break;
+        }
+        case PAYLOAD_TOO_LARGE: {
+            add_status_line(413, error_413_title);
+            add_headers(strlen(error_413_form));
+            if (! add_content(error_413_form)) {
+                return false;
+            }
+            break;
+        }
+        case MOVED_PERMANENTLY: {
+            add_status_line(301, ok_301_title);
+            add_response("Location: %s\r\n", m_location);
+            add_headers(strlen(ok_301_form));
+            if (! add_content(ok_301_form)) {
+                return false;
+            }
+            break;
+        }
+        case NOT_MODIFIED: {
+            add_status_line(304, ok_304_title);
+            add_headers(0, false);
+            break;
+        }
+        case STREAM_REQUEST: {
+            /* HTTP/1.0的客户端不认识chunked编码，不发送长度，发送完毕后关闭连接 */
+            m_chunk_framing = m_version && strcasecmp(m_version, "HTTP/1.1") == 0;
+            add_status_line(200, ok_200_title);
+            if (m_chunk_framing) {
+                add_response("Transfer-Encoding: chunked\r\n");
+            }
+            else {
+                m_linger = false;
+            }
+            add_headers(0, false);
+            /* HEAD不拉取消息体 */
+            if (m_method == HEAD) {
+                m_producer.reset();
+                break;
+            }
+            m_iv[0].iov_base = m_write_buf;
+            m_iv[0].iov_len = m_write_idx;
+            m_iv[1].iov_len = 0;
+            m_iv[2].iov_len = 0;
+            m_iv_count = 3;
+            m_bytes_to_send = m_write_idx;
+            return true;
         }
         default: {
             return false;
@@ -594,22 +1865,234 @@ bool http_conn::process_write(HTTP_CODE ret) {
     m_iv[0].iov_base = m_write_buf;
     m_iv[0].iov_len = m_write_idx;
     m_iv_count = 1;
+    m_bytes_to_send = m_write_idx;
     return true;
 }
 
+/* 排队时间过长或队列已满时调用，不解析请求，直接返回503并关闭连接 */
+void http_conn::reject() {
+    if (! m_tls.active()) {
+        send_busy(m_sockfd);
+    }
+    else if (m_tls.established()) {
+        struct iovec iv = {const_cast<char*>(error_503_response), sizeof(error_503_response) - 1};
+        m_tls.writev(m_sockfd, &iv, 1);
+    }
+    log_->log("msg", this_file, __LINE__, "Server overloaded, request rejected.");
+    close_conn();
+}
+
+void http_conn::send_busy(int sockfd) {
+    send(sockfd, error_503_response, sizeof(error_503_response) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+    /* 接收缓冲区中有未读数据时close会发送RST，客户端可能收不到应答，先读出丢弃 */
+    char buf[1024];
+    while(recv(sockfd, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+    }
+}
+
+/* 由主线程在read()之后调用。请求不完整、有语法错误、命中缓存或可以返回304时，
+ * 不需要访问磁盘，直接在主线程中生成并发送应答，省去交给线程池的开销；
+ * 否则返回false，由调用者交给线程池
+ */
+bool http_conn::process_inline() {
+    if (m_h2 || handshaking()) {
+        return false;
+    }
+    /* 转发中的代理请求：客户端发来了消息体的下一部分 */
+    if (proxying()) {
+        if (! m_proxy->process()) {
+            close_conn();
+        }
+        return true;
+    }
+    for (int i = 1; ; ++i) {
+        m_inline = true;
+        HTTP_CODE read_ret = process_read();
+        m_inline = false;
+        if (read_ret == PENDING_REQUEST) {
+            return false;
+        }
+        if (read_ret == PROXY_REQUEST) {
+            if (! start_proxy()) {
+                close_conn();
+            }
+            return true;
+        }
+        if (read_ret == NO_REQUEST) {
+            wait_read();
+            return true;
+        }
+        if (! process_write(read_ret)) {
+            close_conn();
+            return true;
+        }
+        /* 来自归档的内容可能不在page cache中 */
+        if (defer_to_io()) {
+            return true;
+        }
+        switch (send_response()) {
+            case WRITE_AGAIN: {
+                modfd(m_epollfd, m_sockfd, EPOLLOUT, m_key);
+                return true;
+            }
+            case WRITE_DONE: {
+                break;
+            }
+            default: {
+                close_conn();
+                return true;
+            }
+        }
+        if (! m_linger) {
+            close_conn();
+            return true;
+        }
+        finish_request();
+        if (m_read_idx == 0) {
+            wait_read();
+            return true;
+        }
+        /* 读缓冲中已有流水线发送的下一个请求，继续处理；
+         * 连续处理的请求数达到上限时交给线程池，避免一个连接长期占用主线程
+         */
+        if (i >= MAX_DIRECT_REQUESTS) {
+            return false;
+        }
+    }
+}
+
 /* 由线程池中的工作线程调用，是处理http请求的入口函数 */
 void http_conn::process() {
-    HTTP_CODE read_ret = process_read();
-    if (read_ret == NO_REQUEST) {
-        modfd(m_epollfd, m_sockfd, EPOLLIN);
+    if(m_prefetch) {
+        /* 由I/O线程池调用：预读完成后交给主线程继续发送 */
+        m_prefetch = false;
+        prefetch();
+        modfd(m_epollfd, m_sockfd, EPOLLOUT, m_key);
         return;
     }
-
-    bool write_ret = process_write(read_ret);
-    if (! write_ret) {
-        close_conn();
+    if(m_trace.active()) {
+        m_trace.dequeue(trace_now());
+    }
+    if(m_h2) {
+        if(! m_h2->process()) {
+            close_conn();
+        }
+        return;
+    }
+    if(proxying()) {
+        if(! m_proxy->process()) {
+            close_conn();
+        }
+        return;
+    }
+    /* TLS握手的计算量较大，不在主线程中进行；握手完成时客户端可能已经发送了请求 */
+    if(handshaking()) {
+        switch(m_tls.handshake()) {
+            case tls_conn::TLS_WANT_READ: {
+                wait_read();
+                return;
+            }
+            case tls_conn::TLS_WANT_WRITE: {
+                modfd(m_epollfd, m_sockfd, EPOLLOUT, m_key);
+                return;
+            }
+            case tls_conn::TLS_ERROR: {
+                close_conn();
+                return;
+            }
+            default: {
+                break;
+            }
+        }
+        if(! read()) {
+            close_conn();
+            return;
+        }
+        if(m_read_idx == 0) {
+            wait_read();
+            return;
+        }
     }
+    for(int i = 1; ; ++i) {
+        HTTP_CODE read_ret;
+        if (m_pending) {
+            /* 主线程已解析完请求，但缓存未命中 */
+            m_pending = false;
+            read_ret = do_request();
+        }
+        else {
+            read_ret = process_read();
+        }
+        if (read_ret == NO_REQUEST) {
+            wait_read();
+            return;
+        }
+        if (read_ret == SWITCH_PROTOCOLS) {
+            if (! start_h2()) {
+                close_conn();
+            }
+            return;
+        }
+        if (read_ret == PROXY_REQUEST) {
+            if (! start_proxy()) {
+                close_conn();
+            }
+            return;
+        }
+
+        bool write_ret = process_write(read_ret);
+        if (! write_ret) {
+            close_conn();
+            return;
+        }
+        if (defer_to_io()) {
+            return;
+        }
+
+        if (! config_->direct_write) {
+            /* 交给主线程在EPOLLOUT事件中发送 */
+            modfd(m_epollfd, m_sockfd, EPOLLOUT, m_key);
+            return;
+        }
 
-    modfd(m_epollfd, m_sockfd, EPOLLOUT);
+        /* 直接在工作线程中发送，只有TCP写缓冲已满时才注册EPOLLOUT */
+        WRITE_STATUS status = send_response();
+        if (status == WRITE_AGAIN) {
+            modfd(m_epollfd, m_sockfd, EPOLLOUT, m_key);
+            return;
+        }
+        if (status == WRITE_ERROR || ! m_linger) {
+            close_conn();
+            return;
+        }
+        finish_request();
+
+        /* 连续处理的请求数已达上限，交还给epoll，避免一个连接长期占用工作线程；
+         * 数据仍在内核缓冲区中，EPOLL_CTL_MOD会立即产生EPOLLIN事件；
+         * 数据已在读缓冲中时不会再有EPOLLIN，注册EPOLLOUT（socket可写，立即触发），由write()交还给主线程
+         */
+        if (i >= MAX_DIRECT_REQUESTS) {
+            if (m_read_idx > 0) {
+                modfd(m_epollfd, m_sockfd, EPOLLOUT, m_key);
+            }
+            else {
+                wait_read();
+            }
+            return;
+        }
+
+        /* 仍持有该连接（EPOLLONESHOT），先尝试读取下一个请求，
+         * 没有数据时才重新注册EPOLLIN，省去一次epoll_wait唤醒及线程切换
+         */
+        if (! read()) {
+            close_conn();
+            return;
+        }
+        if (m_read_idx == 0) {
+            m_trace.reset();
+            wait_read();
+            return;
+        }
+    }
 }
 
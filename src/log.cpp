@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <cerrno>
 #include <exception>
 #include "../include/log.h"
 
@@ -26,6 +27,8 @@ void func_time(){   /* 定时器回调函数,更新time_r */
 
 LOG::LOG(string file){
     this->file_name = file;
+    this->buf.reserve(BUF_SIZE);
+    this->back_buf.reserve(BUF_SIZE);
     this->fd = open(file.c_str(),O_RDWR | O_APPEND | O_CREAT, 0644);
     if(fd == -1){
         throw std::exception();
@@ -68,16 +71,23 @@ void LOG::get_time(){
     time_r = str;       /* 格式：[2021-08-18 20:33] */
 }
 
-void LOG::log(string type, string file, int line, string str, bool flag){
-    /* 拼接字符串 */
-    string info = time_r + " -- " + type + " -- " + file + ":" + std::to_string(line) + " -- " + str + "\n";
+void LOG::append(const char* type, const char* file, int line, const char* str, size_t len, bool flag){
+    char line_buf[16];
+    int line_len = snprintf(line_buf, sizeof(line_buf), "%d", line);
+    lock.lock();
+    size_t pos = flag ? 0 : buf.size();
     if(flag){
-        lock.lock();
-        this->buf.push_front(info);
+        buf.insert(0, "\n");     /* 先占位，再依次在前面插入各部分 */
     }
-    else{
-        lock.lock();
-        this->buf.push_back(info);
+    /* 直接拼接到缓冲区，避免构造临时字符串 */
+    const char* parts[] = { time_r.c_str(), " -- ", type, " -- ", file, ":", line_buf, " -- ", str };
+    size_t lens[] = { time_r.size(), 4, strlen(type), 4, strlen(file), 1, (size_t)line_len, 4, len };
+    for(int i = 0; i < 9; ++i){
+        buf.insert(pos, parts[i], lens[i]);
+        pos += lens[i];
+    }
+    if(! flag){
+        buf.push_back('\n');
     }
     lock.unlock();
 }
@@ -91,31 +101,32 @@ void LOG::save(){
             "----- The log file was not found, this file was created just now!-----", true);
     }
 
-    string str;
-    list<string> tmp_list;
-    int n = 0;
-    
+    /* 交换两个缓冲区，在锁外写文件；写文件的只有定时器和退出流程，
+     * 用save_lock保证back_buf不会被同时使用
+     */
+    save_lock.lock();
     lock.lock();    /* 加锁 */
-    for(auto& it : buf){            /* 将多个字符串拼接到一起，从而减少write系统调用的次数 */
-        str += it;
-        if(str.size() > 999999){    /* 字符串过长，临时保存到链表中 */
-            tmp_list.push_back(str);
-            str.clear();
-        }
-    }
-
-    buf.clear();
+    buf.swap(back_buf);
     lock.unlock();      /* 解锁 */
 
-    if(!str.empty()){   /* str字符串非空，保存到链表 */
-        tmp_list.push_back(str);
-    }
-
-    for(auto& it : tmp_list){
-        n = write(fd, it.c_str(), it.size());
+    bool failed = false;
+    size_t off = 0;
+    while(off < back_buf.size()){
+        ssize_t n = write(fd, back_buf.data() + off, back_buf.size() - off);
         if(n < 0){      /* 写失败 */
-            log_->log("err", "log.cpp", __LINE__, "log file write failed");
+            if(errno == EINTR){
+                continue;
+            }
+            failed = true;
+            break;
         }
+        off += n;
+    }
+    back_buf.clear();   /* 保留容量，下次交换后继续使用 */
+    save_lock.unlock();
+
+    if(failed){
+        log_->log("err", "log.cpp", __LINE__, "log file write failed");
     }
 
 } 
\ No newline at end of file
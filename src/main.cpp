@@ -13,11 +13,25 @@
 #include "../include/threadpool.h"
 #include "../include/http_conn.h"
 #include "../include/log.h"
+#include "../include/config.h"
+#include "../include/capture.h"
+#include "../include/trace.h"
+#include "../include/file_cache.h"
+#include "../include/fs_watch.h"
+#include "../include/bundle.h"
+#include "../include/dir_index.h"
+#include "../include/tls.h"
+#include "../include/proxy.h"
+#include "../include/router.h"
+#include "../include/ratelimit.h"
+#include "../include/conn_table.h"
+#include "../include/affinity.h"
+#include "../include/spin.h"
 
 #define MAX_FD 65536
 #define MAX_EVENT_NUMBER 10000
 
-extern int addfd(int epollfd, int fd, bool one_shot);
+extern int addfd(int epollfd, int fd, bool one_shot, uint64_t key);
 extern int removefd(int epollfd, int fd);
 
 /* 定义文件名,用于记录日志 */
@@ -47,24 +61,292 @@ static void* signal_handle(void* arg){
         if(sig == SIGALRM){
             timer_->tick();
             alarm(TIMESLOT);   /* 一次alarm只会产生1次SIGALRM信号,因此要重新定时 */
-        }        
+        }
+        else if(sig == SIGUSR1){
+            /* 导出追踪记录 */
+            if(trace_dump(config_->trace_file.c_str())){
+                log_->log("msg", this_file, __LINE__, "Trace written to " + config_->trace_file);
+            }
+            else{
+                log_->log("err", this_file, __LINE__, "Failed to write " + config_->trace_file);
+            }
+        }
+        else if(sig == SIGUSR2){
+            /* 运行时开关追踪 */
+            bool on = ! trace_on.load();
+            trace_on.store(on);
+            log_->log("msg", this_file, __LINE__, on ? "Tracing enabled." : "Tracing disabled.");
+        }
+        else if(sig == SIGINT || sig == SIGTERM){
+            /* 前台运行时由终端或测试脚本结束进程，退出前保存日志 */
+            log_->log("msg", this_file, __LINE__, "---------- Server is stopped! ----------");
+            log_->save();
+            if(capture_){
+                capture_->flush();
+            }
+            _exit(0);
+        }
+    }
+}
+
+/* 一个事件循环：自己的epoll、连接表及监听socket（--event-loops大于1时以SO_REUSEPORT共享端口），
+ * 接受的连接只在该循环中处理，请求都交给同一个线程池
+ */
+struct event_loop{
+    int index;
+    int cpu;                /* 绑定的CPU，-1表示不绑定 */
+    int listenfd;
+    int tls_listenfd;       /* 没有TLS监听时为-1 */
+    threadpool< http_conn >* pool;
+};
+
+static void run_loop(event_loop& loop) {
+    /* 绑定CPU之后再分配epoll及连接表，内存在该CPU所在的节点上 */
+    int node = -1;
+    if(loop.cpu >= 0){
+        if(! pin_thread(pthread_self(), loop.cpu)){
+            log_->log("err", this_file , __LINE__, "Failed to pin event loop to CPU " + to_string(loop.cpu));
+        }
+        node = cpu_node(loop.cpu);
+    }
+    threadpool< http_conn >* pool = loop.pool;
+    int listenfd = loop.listenfd;
+    int tls_listenfd = loop.tls_listenfd;
+
+    epoll_event events[MAX_EVENT_NUMBER];
+    uint64_t bulk_keys[MAX_EVENT_NUMBER];
+    int epollfd = epoll_create(5);
+    assert(epollfd != -1);
+    /* 监听socket的data为fd本身，小于65536，不会与连接对象的地址相同 */
+    addfd(epollfd, listenfd, false, listenfd);
+    if(tls_listenfd >= 0){
+        addfd(epollfd, tls_listenfd, false, tls_listenfd);
+    }
+    /* 客户连接的http_conn在accept时从连接表中取出，按需成块分配 */
+    conn_table table(epollfd, node);
+
+    /* 读取并处理请求：不需要访问磁盘的请求直接在事件循环中完成，否则交给线程池 */
+    auto serve = [&](http_conn* conn) {
+        if(! conn->read()) {
+            conn->close_conn();
+            return;
+        }
+        if((file_cache_ || bundle_ || router_) && conn->process_inline()) {
+            return;
+        }
+        if(conn->trace().active()) {
+            conn->trace().enqueue(trace_now());
+        }
+        threadpool< http_conn >::LANE lane = conn->bulk()
+            ? threadpool< http_conn >::LANE_BULK : threadpool< http_conn >::LANE_SMALL;
+        if(! pool->append(conn, lane)) {
+            /* 队列已满，不能丢下请求不管，否则连接不会再被注册事件，客户端将一直等待 */
+            conn->reject();
+        }
+    };
+    /* 发送应答，读缓冲中已有流水线发送的下一个请求时接着处理 */
+    auto respond = [&](http_conn* conn) {
+        if(! conn->write()) {
+            conn->close_conn();
+        }
+        else if(conn->pipelined()) {
+            serve(conn);
+        }
+    };
+
+    /* 每秒检查一次空闲的长连接及超时的代理请求 */
+    time_t last_sweep = time(nullptr);
+    int wait_ms = (config_->keepalive_timeout > 0 || limiter_ || (proxy_ && config_->proxy_timeout > 0)) ? 1000 : -1;
+
+    /* 先以0超时轮询epoll，预算内没有事件时才阻塞，见spin_budget */
+    spin_budget spin((uint64_t)config_->spin_us * 1000);
+    while(true) {
+        int number = 0;
+        if(! spin.spin([&] { number = epoll_wait(epollfd, events, MAX_EVENT_NUMBER, 0); return number != 0; })) {
+            uint64_t park_begin = spin.enabled() ? codel_now() : 0;
+            number = epoll_wait(epollfd, events, MAX_EVENT_NUMBER, wait_ms);
+            if(spin.enabled()) {
+                spin.parked(codel_now() - park_begin);
+            }
+        }
+        if ((number < 0) && (errno != EINTR)) {
+            log_->log("err", this_file , __LINE__, "Epoll error!");
+            break;
+        }
+
+        /* 大文件的写事件放到本轮最后处理，先处理新请求和小文件 */
+        int bulk_count = 0;
+        for (int i = 0; i < number; i++) {
+            uint64_t key = events[i].data.u64;
+            if(key == (uint64_t)listenfd || key == (uint64_t)tls_listenfd) {      /* 新连接请求 */
+                int sockfd = (int)key;
+                /* listenfd为ET模式，需循环accept直到没有新连接，否则剩余连接得不到处理 */
+                while(true) {
+                    uint64_t accept_begin = trace_enabled() ? trace_now() : 0;
+                    struct sockaddr_in client_address;
+                    socklen_t client_addrlength = sizeof(client_address);
+                    int connfd = accept(sockfd, (struct sockaddr*)&client_address, &client_addrlength);
+                    if (connfd < 0) {
+                        if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                            log_->log("err", this_file , __LINE__, "Accept error!");
+                        }
+                        break;
+                    }
+                    if(http_conn::m_user_count >= MAX_FD) {
+                        if(sockfd == listenfd) {
+                            http_conn::send_busy(connfd);
+                        }
+                        close(connfd);
+                        log_->log("err", this_file , __LINE__, "Internal server busy");
+                        continue;
+                    }
+                    /* 超过限制的客户端不记录日志也不发送应答，避免被用来放大负载 */
+                    limit_slot* limit = nullptr;
+                    if(limiter_ && limiter_->admit(client_address.sin_addr.s_addr, limit) == rate_limiter::ADMIT_REJECT) {
+                        close(connfd);
+                        continue;
+                    }
+                    char str[16];
+                    string cli_info = "new client, ip: " + string(inet_ntop(AF_INET, &client_address.sin_addr.s_addr, str, sizeof(str)))
+                        + ", port: " + std::to_string(ntohs(client_address.sin_port));
+                    log_->log("new", this_file , __LINE__, cli_info);
+                    /* 初始化客户连接 */
+                    http_conn* conn = table.acquire();
+                    conn->init(connfd, client_address, sockfd == tls_listenfd, limit);
+                    if(accept_begin){
+                        conn->trace().accept(accept_begin, trace_now());
+                    }
+                }
+                continue;
+            }
+            /* 连接已经关闭（fd可能已被新连接复用）后取出的事件，丢弃 */
+            http_conn* conn = conn_table::resolve(key);
+            if(! conn) {
+                continue;
+            }
+            if(key & conn_table::UPSTREAM_TAG) {
+                /* 反向代理的上游连接，由所属的客户连接继续转发 */
+                respond(conn);
+            }
+            else if(events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                /* 如果有异常，关闭客户连接 */
+                conn->close_conn();
+            }
+            else if(events[i].events & EPOLLIN) {
+                serve(conn);
+            }
+            else if(events[i].events & EPOLLOUT) {
+                if(conn->bulk()) {
+                    bulk_keys[bulk_count++] = key;
+                    continue;
+                }
+                respond(conn);
+            }
+            else {}
+        }
+        /* 每个大文件连接每轮最多发送write_quantum字节，未发送完的重新注册EPOLLOUT，
+         * 下一轮与其他连接轮流发送
+         */
+        for (int i = 0; i < bulk_count; i++) {
+            http_conn* conn = conn_table::resolve(bulk_keys[i]);
+            if(conn) {
+                respond(conn);
+            }
+        }
+
+        /* 关闭空闲超时的长连接，for_each只访问等待事件的连接，不会作用在工作线程正在处理的连接上 */
+        time_t now = time(nullptr);
+        if(wait_ms > 0 && now != last_sweep) {
+            last_sweep = now;
+            if(limiter_ && loop.index == 0) {
+                limiter_->age();
+            }
+            table.for_each([&](http_conn& conn) {
+                if(conn.expired(now)) {
+                    log_->log("msg", this_file , __LINE__, "Keep-alive connection timed out.");
+                    conn.close_conn();
+                }
+            });
+        }
     }
+
+    close(epollfd);
+}
+
+static void* loop_thread(void* arg) {
+    run_loop(*(event_loop*)arg);
+    return arg;
 }
 
 int main(int argc, char* argv[]) {
-    if(argc < 2) {
-        printf("usage: %s port \n", basename(argv[0]));
+    if(! config_->parse(argc, argv)) {
         return 1;
     }
-    int port = atoi(argv[1]);
+    int port = config_->port;
+
+    /* 创建守护进程，-f参数指定在前台运行 */
+    int ret = 0;
+    if(config_->daemon){
+        ret = daemon(1,0);
+        if(ret != 0){
+            printf("daemon error!\n");
+            exit(1);
+        }
+    }
 
-    /* 创建守护进程 */
-    int ret = daemon(1,0);
-    if(ret != 0){
-        printf("daemon error!\n");
-        exit(1);
+    /* 流量录制，需在信号处理线程启动前添加定时器 */
+    if(! config_->capture_file.empty()){
+        try {
+            capture_ = new capture(config_->capture_file, (uint64_t)config_->capture_limit << 20);
+        }
+        catch(...) {
+            log_->log("err", this_file , __LINE__, "Failed to open capture file!");
+            return 1;
+        }
+        log_->log("msg", this_file , __LINE__, "Capturing requests to " + config_->capture_file);
     }
 
+    /* 静态资源归档，启动时只需一次mmap，之后所有请求都由主线程直接处理 */
+    if(! config_->bundle_file.empty()){
+        try {
+            bundle_ = new bundle(config_->bundle_file);
+        }
+        catch(...) {
+            log_->log("err", this_file , __LINE__, "Failed to load bundle " + config_->bundle_file);
+            return 1;
+        }
+        log_->log("msg", this_file , __LINE__, "Serving " + to_string(bundle_->size())
+            + " paths from " + config_->bundle_file);
+    }
+
+    /* 小文件缓存，命中时由主线程直接处理；使用归档时不访问网站根目录，不需要缓存 */
+    if(config_->cache_size > 0 && ! bundle_){
+        file_cache_ = new file_cache((size_t)config_->cache_size << 20, (size_t)config_->cache_max_file << 10);
+        log_->log("msg", this_file , __LINE__, file_cache_->huge_pages()
+            ? "File cache uses transparent huge pages." : "File cache runs without huge pages.");
+    }
+
+    /* 目录请求的处理方式，每个目录每秒最多stat一次 */
+    if(! bundle_){
+        dir_index_ = new dir_index(config_->index_files, config_->autoindex);
+    }
+
+    /* TLS监听，证书在启动时加载，加载失败时不启动 */
+    if(config_->tls_port > 0){
+        try {
+            tls_ = new tls_context(config_->tls_cert, config_->tls_key);
+        }
+        catch(...) {
+            log_->log("err", this_file , __LINE__, "Failed to load TLS certificate " + config_->tls_cert
+                + " (or the server was built without OpenSSL)");
+            return 1;
+        }
+    }
+
+    /* 请求追踪，SIGUSR1导出，SIGUSR2开关 */
+    trace_init(config_->trace_sample, config_->trace_slow);
+    trace_on.store(config_->trace);
+
     /* 信号处理 */
     sigset_t mask;
     sigfillset(&mask);
@@ -74,9 +356,54 @@ int main(int argc, char* argv[]) {
     pthread_t sig_pid;
     pthread_create(&sig_pid, 0, signal_handle, &mask);
     pthread_detach(sig_pid);
+
+    /* 监视网站根目录，文件变化时使缓存失效，命中缓存时不再需要stat；
+     * 需在屏蔽信号之后创建，监视线程不处理信号
+     */
+    if(file_cache_){
+        try {
+            fs_watch_ = new fs_watch(config_->doc_root, file_cache_);
+        }
+        catch(...) {
+            log_->log("err", this_file , __LINE__, "Failed to watch " + config_->doc_root
+                + ", cached files will be revalidated with stat.");
+        }
+    }
+
+    /* 反向代理，健康检查线程同样需在屏蔽信号之后创建 */
+    if(! config_->proxy_routes.empty()){
+        try {
+            proxy_ = new proxy(config_->proxy_routes, config_->proxy_idle, config_->proxy_check);
+        }
+        catch(...) {
+            log_->log("err", this_file , __LINE__, "Invalid --proxy route or unresolvable upstream");
+            return 1;
+        }
+        log_->log("msg", this_file , __LINE__, "Proxying " + to_string(config_->proxy_routes.size()) + " route(s).");
+    }
+
+    /* 路由：在启动时注册所有处理器，没有路由时不查找 */
+    if(proxy_ || ! config_->status_path.empty()){
+        router_ = new router;
+        bool ok = ! proxy_ || proxy_->install(*router_);
+        if(ok && ! config_->status_path.empty()){
+            ok = router_->add(config_->status_path, router::EXACT,
+                router::method_bit(http_conn::GET) | router::method_bit(http_conn::HEAD), new status_handler);
+        }
+        if(! ok){
+            log_->log("err", this_file , __LINE__, "Duplicate route");
+            return 1;
+        }
+        log_->log("msg", this_file , __LINE__, "Routing " + to_string(router_->size()) + " path(s).");
+    }
+
+    /* 按客户端IP限制连接数及请求速率，一个客户端不能占满线程池的队列和所有fd */
+    if(config_->conn_limit > 0 || config_->rate_limit > 0){
+        limiter_ = new rate_limiter(config_->conn_limit, config_->rate_limit, config_->rate_burst);
+    }
    
     /* 检验端口号是否合法 */
-    if(port > 65535 || port <= 0){
+    if(port > 65535 || port <= 0 || port == config_->tls_port){
         log_->log("err", this_file , __LINE__, "Port number is not available");
         return 1;
     }
@@ -86,117 +413,128 @@ int main(int argc, char* argv[]) {
     /* 定时 */
     alarm(TIMESLOT);
     
+    /* 绑定CPU时，事件循环依次使用列表开头的CPU，工作线程及I/O线程使用其余的CPU，
+     * 列表不比事件循环多时与事件循环共用全部CPU
+     */
+    const std::vector<int>& cpus = config_->cpu_affinity;
+    int loop_count = config_->event_loops;
+    std::vector<int> loop_cpus;
+    for(int i = 0; ! cpus.empty() && i < loop_count; i++) {
+        loop_cpus.push_back(cpus[i % cpus.size()]);
+    }
+    std::vector<int> worker_cpus;
+    if(cpus.size() > (size_t)loop_count) {
+        worker_cpus.assign(cpus.begin() + loop_count, cpus.end());
+    }
+    else {
+        worker_cpus = cpus;
+    }
+
     /* 创建线程池 */
     threadpool< http_conn >* pool = NULL;
     try {
         log_->log("msg", this_file , __LINE__, "Try to create threadpool......");
-        pool = new threadpool< http_conn >(8);  /* 初始创建8个线程 */
+        /* 准入控制：排队时间持续过长时以503拒绝部分请求，而不是让延迟无限增长 */
+        codel* admission = NULL;
+        if(config_->codel_target > 0){
+            admission = new codel((uint64_t)config_->codel_target * 1000000,
+                (uint64_t)config_->codel_interval * 1000000);
+        }
+        pool = new threadpool< http_conn >(config_->thread_number, 10000, "worker", admission,
+            worker_cpus.data(), worker_cpus.size(), (uint64_t)config_->spin_us * 1000);
     }
     catch(...) {
         log_->log("err", this_file , __LINE__, "Failed to create threadpool!");
         return 1;
     }
-    log_->log("msg", this_file , __LINE__, "Succeed in creating threadpool!(8 threads)");
-    
-    /* 预先对每个可能的客户连接分配一个http_conn对象 */
-    http_conn* users = new http_conn[MAX_FD];
-    if(!users){
-        log_->log("err", this_file , __LINE__, "Failed to create users[]!");
-        return 1; 
-    }
-    //int user_count = 0;
+    log_->log("msg", this_file , __LINE__, "Succeed in creating threadpool!("
+        + to_string(config_->thread_number) + " threads)");
 
-    int listenfd = socket(PF_INET, SOCK_STREAM, 0);
-    if(listenfd < 0){
-        log_->log("err", this_file , __LINE__, "Failed to create socket!");
+    /* I/O线程池，将不在page cache中的文件读入内存，避免主线程阻塞在磁盘上 */
+    if(config_->io_threads > 0){
+        try {
+            http_conn::m_io_pool = new threadpool< http_conn >(config_->io_threads, 10000, "io", NULL,
+                worker_cpus.data(), worker_cpus.size());
+        }
+        catch(...) {
+            log_->log("err", this_file , __LINE__, "Failed to create I/O threadpool!");
+            return 1;
+        }
     }
+    
+    auto open_listener = [&](int listen_port) {
+        int fd = socket(PF_INET, SOCK_STREAM, 0);
+        if(fd < 0){
+            log_->log("err", this_file , __LINE__, "Failed to create socket!");
+        }
 
-    /* 使close系统调用立即返回 */
-    struct linger tmp = { 1, 0 };
-    setsockopt(listenfd, SOL_SOCKET, SO_LINGER, &tmp, sizeof(tmp));
-
-    struct sockaddr_in address;
-    bzero(&address, sizeof(address));
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = htonl(INADDR_ANY);    /* 自动获取服务器ip地址 */
-    address.sin_port = htons(port);
-
-    ret = bind(listenfd, (struct sockaddr*)&address, sizeof(address));
-    if(ret < 0){
-        log_->log("err", this_file , __LINE__, "Bind error!");
-    }
+        if(config_->event_loops > 1){
+            int reuse = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+        }
 
-    ret = listen(listenfd, 5);
-    if(ret < 0){
-        log_->log("err", this_file , __LINE__, "Listen error!");
-    }
+        struct sockaddr_in address;
+        bzero(&address, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);    /* 自动获取服务器ip地址 */
+        address.sin_port = htons(listen_port);
 
-    epoll_event events[MAX_EVENT_NUMBER];
-    int epollfd = epoll_create(5);
-    assert(epollfd != -1);
-    addfd(epollfd, listenfd, false);
-    http_conn::m_epollfd = epollfd;
+        ret = bind(fd, (struct sockaddr*)&address, sizeof(address));
+        if(ret < 0){
+            log_->log("err", this_file , __LINE__, "Bind error!");
+        }
 
-    while(true) {
-        int number = epoll_wait(epollfd, events, MAX_EVENT_NUMBER, -1);
-        if ((number < 0) && (errno != EINTR)) {
-            log_->log("err", this_file , __LINE__, "Epoll error!");
-            break;
+        ret = listen(fd, 1024);
+        if(ret < 0){
+            log_->log("err", this_file , __LINE__, "Listen error!");
         }
+        return fd;
+    };
 
-        for (int i = 0; i < number; i++) {
-            int sockfd = events[i].data.fd;
-            if(sockfd == listenfd) {      /* 新连接请求 */
-                struct sockaddr_in client_address;
-                socklen_t client_addrlength = sizeof(client_address);
-                int connfd = accept(listenfd, (struct sockaddr*)&client_address, &client_addrlength);
-                if (connfd < 0) {
-                    log_->log("err", this_file , __LINE__, "Accept error!");
-                    continue;
-                }
-                if(http_conn::m_user_count >= MAX_FD) {
-                    const char *info = "Internal server busy";
-                    send(connfd, info, strlen(info), 0);
-                    close(connfd);
-                    log_->log("err", this_file , __LINE__, string(info));
-                    continue;
-                }
-                char str[16];
-                string cli_info = "new client, ip: " + string(inet_ntop(AF_INET, &client_address.sin_addr.s_addr, str, sizeof(str)))
-                    + ", port: " + std::to_string(ntohs(client_address.sin_port));
-                log_->log("new", this_file , __LINE__, cli_info);
-                /* 初始化客户连接 */
-                users[connfd].init(connfd, client_address);
-            }
-            else if(events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                /* 如果有异常，关闭客户连接 */
-                users[sockfd].close_conn();
-            }
-            else if(events[i].events & EPOLLIN) {
-                /* 根据读的结果，决定将任务添加到线程池还是关闭连接 */
-                if(users[sockfd].read()) {
-                    pool->append(users + sockfd);
-                }
-                else {
-                    users[sockfd].close_conn();
-                }
-            }
-            else if(events[i].events & EPOLLOUT) {
-                /* 根据写的结果，决定是否关闭连接 */
-                if(!users[sockfd].write()) {
-                    users[sockfd].close_conn();
-                }
-            }
-            else {}
+    /* 各事件循环有自己的监听socket，内核按SO_REUSEPORT在其间分配新连接；
+     * 绑定CPU时附加CBPF程序，把连接交给绑定在处理其网卡接收队列的CPU（或同一节点）上的事件循环
+     */
+    std::vector<event_loop> loops(loop_count);
+    for(int i = 0; i < loop_count; i++) {
+        loops[i].index = i;
+        loops[i].cpu = loop_cpus.empty() ? -1 : loop_cpus[i];
+        loops[i].listenfd = open_listener(port);
+        /* TLS端口上接受的连接先握手，之后与明文连接走相同的处理流程 */
+        loops[i].tls_listenfd = tls_ ? open_listener(config_->tls_port) : -1;
+        loops[i].pool = pool;
+    }
+    if(loop_count > 1 && ! loop_cpus.empty()) {
+        bool steered = attach_rx_steering(loops[0].listenfd, loop_cpus);
+        if(steered && tls_) {
+            steered = attach_rx_steering(loops[0].tls_listenfd, loop_cpus);
+        }
+        if(! steered) {
+            log_->log("err", this_file , __LINE__, "Failed to attach the reuseport CBPF program, connections are spread by hash");
+        }
+    }
+    for(int i = 1; i < loop_count; i++) {
+        pthread_t tid;
+        if(pthread_create(&tid, nullptr, loop_thread, &loops[i]) != 0) {
+            log_->log("err", this_file , __LINE__, "Failed to create event loop!");
+            return 1;
         }
+        pthread_detach(tid);
     }
+    if(loop_count > 1) {
+        log_->log("msg", this_file , __LINE__, "Running " + to_string(loop_count) + " event loops.");
+    }
+    /* 主线程运行第一个事件循环，最后才绑定CPU，之前创建的线程不继承它的绑定 */
+    run_loop(loops[0]);
 
     /* 没有实际意义，只是消除 warning: variable ‘ret’ set but not used */
     (void)ret;
 
-    close(epollfd);
-    close(listenfd);
-    delete [] users;
+    for(event_loop& loop : loops){
+        close(loop.listenfd);
+        if(loop.tls_listenfd >= 0){
+            close(loop.tls_listenfd);
+        }
+    }
     delete pool;
     return 0;
 }
@@ -0,0 +1,1006 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:54
+ * @ Modified Time: 2026-10-19 23:59:54
+ * @ Description  : 反向代理（按路径前缀转发到上游，连接池与健康检查）
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "../include/proxy.h"
+#include "../include/config.h"
+#include "../include/log.h"
+#include "../include/conn_table.h"
+
+extern void modfd(int epollfd, int fd, int ev, uint64_t key);
+
+proxy* proxy_ = nullptr;
+
+/* 定义文件名,用于记录日志 */
+static const string this_file = "proxy.cpp";
+
+/* line以"name:"开头（不区分大小写） */
+static bool header_is(const char* line, size_t len, const char* name){
+    size_t n = strlen(name);
+    return len > n && line[n] == ':' && strncasecmp(line, name, n) == 0;
+}
+
+/* 逐跳的头部只对一个连接有意义，不转发；Expect由服务器自己回复100 Continue */
+static bool hop_by_hop(const char* line, size_t len){
+    static const char* const names[] = {"Connection", "Keep-Alive", "Proxy-Connection", "TE", "Upgrade",
+        "HTTP2-Settings", "Expect"};
+    for(const char* name : names){
+        if(header_is(line, len, name)){
+            return true;
+        }
+    }
+    return false;
+}
+
+static int hex_value(char c){
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* 解析"host:port"，host可以是域名，只在启动时调用 */
+static bool resolve(const string& name, sockaddr_in& addr){
+    size_t colon = name.rfind(':');
+    if(colon == string::npos || colon == 0 || colon + 1 == name.size()){
+        return false;
+    }
+    string host = name.substr(0, colon);
+    string port = name.substr(colon + 1);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    if(getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || ! result){
+        return false;
+    }
+    memcpy(&addr, result->ai_addr, sizeof(addr));
+    freeaddrinfo(result);
+    return true;
+}
+
+proxy::proxy(const std::vector<string>& routes, size_t max_idle, const string& check_path)
+    : m_max_idle(max_idle), m_check_path(check_path){
+    auto cleanup = [this](){
+        for(proxy_route* route : m_routes){
+            delete route;
+        }
+        for(upstream* up : m_upstreams){
+            delete up;
+        }
+    };
+    for(const string& spec : routes){
+        size_t eq = spec.find('=');
+        if(spec[0] != '/' || eq == string::npos){
+            cleanup();
+            throw std::exception();
+        }
+        proxy_route* route = new proxy_route;
+        m_routes.push_back(route);
+        route->prefix = spec.substr(0, eq);
+        while(route->prefix.size() > 1 && route->prefix.back() == '/'){
+            route->prefix.pop_back();
+        }
+        size_t begin = eq + 1;
+        while(begin <= spec.size()){
+            size_t end = spec.find(',', begin);
+            if(end == string::npos){
+                end = spec.size();
+            }
+            string name = spec.substr(begin, end - begin);
+            begin = end + 1;
+            if(name.empty()){
+                continue;
+            }
+            /* 多个路由使用同一上游时共用一个连接池 */
+            auto found = std::find_if(m_upstreams.begin(), m_upstreams.end(),
+                [&name](const upstream* up) { return up->name == name; });
+            upstream* up = nullptr;
+            if(found != m_upstreams.end()){
+                up = *found;
+            }
+            else{
+                up = new upstream;
+                up->name = name;
+                m_upstreams.push_back(up);
+                if(! resolve(name, up->addr)){
+                    cleanup();
+                    throw std::exception();
+                }
+            }
+            route->upstreams.push_back(up);
+        }
+        if(route->upstreams.empty()){
+            cleanup();
+            throw std::exception();
+        }
+    }
+    if(pthread_create(&m_thread, nullptr, worker, this) != 0){
+        cleanup();
+        throw std::exception();
+    }
+}
+
+proxy::~proxy(){
+    pthread_cancel(m_thread);
+    pthread_join(m_thread, nullptr);
+    for(upstream* up : m_upstreams){
+        for(auto& conn : up->idle){
+            close(conn.first);
+        }
+        delete up;
+    }
+    for(proxy_route* route : m_routes){
+        delete route;
+    }
+}
+
+bool proxy::install(router& r) const{
+    for(const proxy_route* route : m_routes){
+        if(! r.add(route->prefix, router::PREFIX, router::ALL_METHODS, new proxy_handler(route))){
+            return false;
+        }
+    }
+    return true;
+}
+
+int proxy::acquire(const proxy_route* route, upstream*& up, bool pooled, bool& reused){
+    size_t count = route->upstreams.size();
+    uint32_t first = route->next++;
+    for(size_t i = 0; i < count; ++i){
+        upstream* candidate = route->upstreams[(first + i) % count];
+        if(! candidate->healthy){
+            continue;
+        }
+        up = candidate;
+        if(pooled){
+            int fd = -1;
+            candidate->lock.lock();
+            while(fd < 0 && ! candidate->idle.empty()){
+                int idle_fd = candidate->idle.back().first;
+                candidate->idle.pop_back();
+                /* 空闲期间被上游关闭的连接可读（EOF），空闲的连接上也不应有数据 */
+                char c;
+                if(recv(idle_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+                    fd = idle_fd;
+                }
+                else{
+                    close(idle_fd);
+                }
+            }
+            candidate->lock.unlock();
+            if(fd >= 0){
+                reused = true;
+                return fd;
+            }
+        }
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(fd < 0){
+            return -1;
+        }
+        /* 请求的头部与消息体可能分多次发送 */
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        if(connect(fd, (const struct sockaddr*)&candidate->addr, sizeof(candidate->addr)) == 0
+                || errno == EINPROGRESS){
+            reused = false;
+            return fd;
+        }
+        close(fd);
+        report(candidate, false);
+    }
+    return -1;
+}
+
+void proxy::release(upstream* up, int fd, bool keep){
+    if(keep && up->healthy){
+        up->lock.lock();
+        if(up->idle.size() < m_max_idle){
+            up->idle.push_back(std::make_pair(fd, time(nullptr)));
+            up->lock.unlock();
+            return;
+        }
+        up->lock.unlock();
+    }
+    close(fd);
+}
+
+void proxy::report(upstream* up, bool ok){
+    if(ok){
+        up->failures = 0;
+        return;
+    }
+    if(++up->failures >= MAX_FAILURES){
+        set_healthy(up, false);
+    }
+}
+
+void proxy::set_healthy(upstream* up, bool healthy){
+    if(healthy){
+        up->failures = 0;
+        if(! up->healthy.exchange(true)){
+            log_->log("msg", this_file, __LINE__, "Upstream " + up->name + " is back, serving requests again.");
+        }
+        return;
+    }
+    if(up->healthy.exchange(false)){
+        log_->log("err", this_file, __LINE__, "Upstream " + up->name + " failed, ejected until it passes a health check.");
+        /* 池中的连接也不能再用 */
+        up->lock.lock();
+        for(auto& conn : up->idle){
+            close(conn.first);
+        }
+        up->idle.clear();
+        up->lock.unlock();
+    }
+}
+
+void* proxy::worker(void* arg){
+    pthread_setname_np(pthread_self(), "proxy");
+    proxy* p = (proxy*)arg;
+    p->run();
+    return p;
+}
+
+void proxy::run(){
+    while(true){
+        sleep(CHECK_INTERVAL);
+        time_t now = time(nullptr);
+        for(upstream* up : m_upstreams){
+            set_healthy(up, check(up));
+            prune(up, now);
+        }
+    }
+}
+
+/* 在健康检查线程中执行，可以阻塞，每一步最多等待CHECK_TIMEOUT */
+bool proxy::check(upstream* up) const{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0){
+        return up->healthy;
+    }
+    auto wait = [fd](short events){
+        struct pollfd pfd = {fd, events, 0};
+        return poll(&pfd, 1, CHECK_TIMEOUT) == 1;
+    };
+    bool ok = false;
+    if(connect(fd, (const struct sockaddr*)&up->addr, sizeof(up->addr)) == 0
+            || (errno == EINPROGRESS && wait(POLLOUT))){
+        int error = 0;
+        socklen_t len = sizeof(error);
+        ok = getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0;
+    }
+    /* 只看状态行："HTTP/1.x 2xx"或"HTTP/1.x 3xx" */
+    if(ok && ! m_check_path.empty()){
+        string request = "GET " + m_check_path + " HTTP/1.0\r\nHost: " + up->name + "\r\n\r\n";
+        ok = send(fd, request.data(), request.size(), MSG_NOSIGNAL) == (ssize_t)request.size();
+        char status[16];
+        size_t got = 0;
+        while(ok && got < 12){
+            ssize_t n = wait(POLLIN) ? recv(fd, status + got, sizeof(status) - got, 0) : -1;
+            if(n <= 0){
+                ok = false;
+                break;
+            }
+            got += n;
+        }
+        ok = ok && strncmp(status, "HTTP/1.", 7) == 0 && (status[9] == '2' || status[9] == '3');
+    }
+    close(fd);
+    return ok;
+}
+
+void proxy::prune(upstream* up, time_t now){
+    up->lock.lock();
+    for(size_t i = 0; i < up->idle.size(); ){
+        int fd = up->idle[i].first;
+        char c;
+        bool alive = now - up->idle[i].second < IDLE_TIMEOUT
+            && recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        if(alive){
+            ++i;
+            continue;
+        }
+        close(fd);
+        up->idle.erase(up->idle.begin() + i);
+    }
+    up->lock.unlock();
+}
+
+size_t body_framing::consume(const char* data, size_t len){
+    size_t i = 0;
+    while(i < len && m_state != BODY_END && m_state != BODY_BAD){
+        /* 数据部分整段跳过 */
+        if(m_state == BODY_DATA || m_state == CHUNK_DATA){
+            size_t n = len - i;
+            if(! m_until_eof && (long)n > m_left){
+                n = m_left;
+            }
+            i += n;
+            skip(n);
+            continue;
+        }
+        char c = data[i++];
+        switch(m_state){
+            case CHUNK_SIZE: {
+                int v = hex_value(c);
+                if(v >= 0){
+                    /* 位数限制在long的范围内 */
+                    if(++m_digits > 15){
+                        m_state = BODY_BAD;
+                    }
+                    m_left = m_left * 16 + v;
+                }
+                else if(m_digits == 0){
+                    m_state = BODY_BAD;
+                }
+                else if(c == '\r'){
+                    m_state = CHUNK_SIZE_LF;
+                }
+                else if(c == ';' || c == ' ' || c == '\t'){
+                    m_state = CHUNK_EXT;
+                }
+                else{
+                    m_state = BODY_BAD;
+                }
+                break;
+            }
+            case CHUNK_EXT: {
+                if(c == '\r'){
+                    m_state = CHUNK_SIZE_LF;
+                }
+                break;
+            }
+            case CHUNK_SIZE_LF: {
+                if(c != '\n'){
+                    m_state = BODY_BAD;
+                }
+                else{
+                    m_state = (m_left > 0) ? CHUNK_DATA : TRAILER_BEGIN;
+                }
+                break;
+            }
+            case CHUNK_DATA_CR: {
+                m_state = (c == '\r') ? CHUNK_DATA_LF : BODY_BAD;
+                break;
+            }
+            case CHUNK_DATA_LF: {
+                m_state = (c == '\n') ? CHUNK_SIZE : BODY_BAD;
+                m_left = 0;
+                m_digits = 0;
+                break;
+            }
+            case TRAILER_BEGIN: {
+                m_state = (c == '\r') ? FINAL_LF : TRAILER_LINE;
+                break;
+            }
+            case TRAILER_LINE: {
+                if(c == '\r'){
+                    m_state = TRAILER_LF;
+                }
+                break;
+            }
+            case TRAILER_LF: {
+                m_state = (c == '\n') ? TRAILER_BEGIN : BODY_BAD;
+                break;
+            }
+            case FINAL_LF: {
+                m_state = (c == '\n') ? BODY_END : BODY_BAD;
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+    return i;
+}
+
+long body_framing::direct() const{
+    if(m_state == BODY_DATA){
+        return m_until_eof ? LONG_MAX : m_left;
+    }
+    return (m_state == CHUNK_DATA) ? m_left : 0;
+}
+
+void body_framing::skip(long len){
+    if(m_until_eof){
+        return;
+    }
+    m_left -= len;
+    if(m_left == 0){
+        m_state = (m_state == BODY_DATA) ? BODY_END : CHUNK_DATA_CR;
+    }
+}
+
+void body_framing::eof(){
+    if(m_state != BODY_END){
+        m_state = (m_state == BODY_DATA && m_until_eof) ? BODY_END : BODY_BAD;
+    }
+}
+
+proxy_session::proxy_session(http_conn& conn) : m_conn(conn), m_state(IDLE), m_route(nullptr), m_upstream(nullptr),
+    m_fd(-1), m_registered(false), m_reused(false), m_retried(false), m_replayable(false), m_keep_upstream(false),
+    m_status(0), m_response(false), m_prefix_sent(0), m_unsent(0), m_piped(0), m_splice(false),
+    m_buf_pos(0), m_buf_len(0), m_active(0){
+    m_pipe[0] = m_pipe[1] = -1;
+}
+
+proxy_session::~proxy_session(){
+    release(false);
+    if(m_pipe[0] >= 0){
+        close(m_pipe[0]);
+        close(m_pipe[1]);
+    }
+}
+
+bool proxy_session::start(const proxy_route* route){
+    m_route = route;
+    m_upstream = nullptr;
+    m_retried = false;
+    m_status = 0;
+    m_active = time(nullptr);
+    /* TLS连接上的数据需经过SSL_read、SSL_write，不能splice */
+    m_splice = ! m_conn.m_tls.active();
+    if(m_splice && m_pipe[0] < 0 && pipe2(m_pipe, O_CLOEXEC | O_NONBLOCK) < 0){
+        m_pipe[0] = m_pipe[1] = -1;
+        m_splice = false;
+    }
+    build_request();
+
+    /* 请求的消息体紧接在读缓冲中的头部之后 */
+    m_response = false;
+    m_prefix_sent = 0;
+    m_unsent = 0;
+    m_piped = 0;
+    m_buf_pos = m_buf_len = 0;
+    if(m_conn.m_chunked){
+        m_body.chunked();
+    }
+    else{
+        m_body.length(m_conn.m_content_length);
+    }
+    m_replayable = m_body.done();
+    if(! m_replayable && m_conn.m_expect_continue && m_conn.m_read_idx == m_conn.m_checked_idx){
+        static const char continue_response[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        struct iovec iv = {const_cast<char*>(continue_response), sizeof(continue_response) - 1};
+        m_conn.sock_writev(&iv, 1);
+    }
+    return connect_upstream(true);
+}
+
+/* 请求行中的方法、未解码的目标及版本原样转发；头部各行在读缓冲中以"\0\0"结尾（见parse_line），
+ * 去掉逐跳的头部，加上X-Forwarded-For、X-Forwarded-Proto。HTTP/1.0的请求仍以HTTP/1.0转发，
+ * 上游不会使用chunked编码。同时带有Transfer-Encoding: chunked与Content-Length时按chunked转发消息体，
+ * 去掉Content-Length（RFC 9112 6.1），否则上游可能按另一个长度划分请求
+ */
+void proxy_session::build_request(){
+    bool http10 = strcasecmp(m_conn.m_version, "HTTP/1.0") == 0;
+    m_prefix.clear();
+    m_prefix.append(m_conn.m_read_buf).append(" ").append(m_conn.m_target)
+        .append(http10 ? " HTTP/1.0\r\n" : " HTTP/1.1\r\n");
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &m_conn.m_address.sin_addr, ip, sizeof(ip));
+    bool forwarded = false;
+    for(const char* line = m_conn.m_version + strlen(m_conn.m_version) + 2; *line; ){
+        size_t len = strlen(line);
+        if(! hop_by_hop(line, len) && ! (m_conn.m_chunked && header_is(line, len, "Content-Length"))){
+            m_prefix.append(line, len);
+            if(header_is(line, len, "X-Forwarded-For")){
+                m_prefix.append(", ").append(ip);
+                forwarded = true;
+            }
+            m_prefix.append("\r\n");
+        }
+        line += len + 2;
+    }
+    if(! forwarded){
+        m_prefix.append("X-Forwarded-For: ").append(ip).append("\r\n");
+    }
+    m_prefix.append(m_conn.m_tls.active() ? "X-Forwarded-Proto: https\r\n" : "X-Forwarded-Proto: http\r\n");
+    if(http10){
+        m_prefix.append("Connection: keep-alive\r\n");
+    }
+    m_prefix.append("\r\n");
+}
+
+bool proxy_session::connect_upstream(bool pooled){
+    m_fd = proxy_->acquire(m_route, m_upstream, pooled, m_reused);
+    if(m_fd < 0){
+        log_->log("err", this_file, __LINE__, "No upstream available for " + m_route->prefix);
+        return fail();
+    }
+    if(m_reused){
+        m_state = SEND_REQUEST;
+        return send_request();
+    }
+    m_state = CONNECTING;
+    arm_upstream(EPOLLOUT);
+    return true;
+}
+
+bool proxy_session::process(){
+    m_conn.m_waiting.store(false, std::memory_order_relaxed);
+    switch(m_state){
+        case CONNECTING: {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if(getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0){
+                return upstream_failed();
+            }
+            m_state = SEND_REQUEST;
+            return send_request();
+        }
+        case SEND_REQUEST: {
+            return send_request();
+        }
+        case RECV_HEAD: {
+            return recv_head();
+        }
+        case SEND_RESPONSE: {
+            return send_response();
+        }
+        default: {
+            return true;
+        }
+    }
+}
+
+bool proxy_session::expired(time_t now) const{
+    return config_->proxy_timeout > 0 && now - m_active >= config_->proxy_timeout;
+}
+
+void proxy_session::reset(){
+    release(false);
+    m_state = IDLE;
+}
+
+bool proxy_session::send_request(){
+    switch(pump(LONG_MAX)){
+        case PUMP_DONE: {
+            m_state = RECV_HEAD;
+            return recv_head();
+        }
+        case PUMP_WAIT_SOURCE: {
+            arm_client(EPOLLIN);
+            return true;
+        }
+        case PUMP_WAIT_DEST: {
+            arm_upstream(EPOLLOUT);
+            return true;
+        }
+        case PUMP_DEST_ERROR: {
+            return upstream_failed();
+        }
+        default: {
+            /* 客户端断开，或消息体的分块格式错误 */
+            return false;
+        }
+    }
+}
+
+bool proxy_session::recv_head(){
+    size_t scanned = 0;
+    while(true){
+        char* end = (char*)memmem(m_buf + scanned, m_buf_len - scanned, "\r\n\r\n", 4);
+        if(end){
+            size_t head_len = end + 4 - m_buf;
+            if(! parse_head(head_len)){
+                log_->log("err", this_file, __LINE__, "Invalid response from upstream " + m_upstream->name);
+                proxy_->report(m_upstream, false);
+                return fail();
+            }
+            if(m_status >= 200){
+                m_state = SEND_RESPONSE;
+                return send_response();
+            }
+            /* 1xx的中间应答不转发，继续等待最终的应答 */
+            memmove(m_buf, m_buf + head_len, m_buf_len - head_len);
+            m_buf_len -= head_len;
+            scanned = 0;
+            continue;
+        }
+        if(m_buf_len == BUF_SIZE){
+            log_->log("err", this_file, __LINE__, "Response header too large from upstream " + m_upstream->name);
+            proxy_->report(m_upstream, false);
+            return fail();
+        }
+        scanned = (m_buf_len > 3) ? m_buf_len - 3 : 0;
+        ssize_t n = recv(m_fd, m_buf + m_buf_len, BUF_SIZE - m_buf_len, 0);
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            arm_upstream(EPOLLIN);
+            return true;
+        }
+        if(n <= 0){
+            return upstream_failed();
+        }
+        m_buf_len += n;
+        m_active = time(nullptr);
+    }
+}
+
+/* 状态行改为HTTP/1.1，去掉上游的Connection、Keep-Alive，按客户连接加上Connection；
+ * 由应答确定消息体的边界及上游连接能否复用。1xx应答只解析状态行
+ */
+bool proxy_session::parse_head(size_t head_len){
+    const char* p = m_buf;
+    const char* end = m_buf + head_len - 2;     /* 结尾的空行 */
+    const char* eol = (const char*)memmem(p, head_len, "\r\n", 2);
+    if(eol - p < 12 || strncmp(p, "HTTP/1.", 7) != 0 || (p[7] != '0' && p[7] != '1') || p[8] != ' '
+            || ! isdigit((unsigned char)p[9]) || ! isdigit((unsigned char)p[10]) || ! isdigit((unsigned char)p[11])
+            || (p[12] != ' ' && p + 12 != eol)){
+        return false;
+    }
+    m_status = (p[9] - '0') * 100 + (p[10] - '0') * 10 + (p[11] - '0');
+    if(m_status < 200){
+        /* 不支持协议升级（101） */
+        return m_status >= 100 && m_status != 101;
+    }
+    bool close = (p[7] == '0');
+    bool chunked = false;
+    long length = -1;
+    m_prefix.assign("HTTP/1.1 ").append(p + 9, eol - p - 9).append("\r\n");
+    for(const char* line = eol + 2; line < end; ){
+        const char* next = (const char*)memmem(line, end + 2 - line, "\r\n", 2);
+        size_t len = next - line;
+        const char* colon = (const char*)memchr(line, ':', len);
+        if(! colon || colon == line){
+            return false;
+        }
+        const char* value = colon + 1;
+        while(value < next && (*value == ' ' || *value == '\t')){
+            ++value;
+        }
+        size_t value_len = next - value;
+        if(header_is(line, len, "Connection")){
+            /* 以','分隔的选项 */
+            for(const char* t = value; t < next; ){
+                t += strspn(t, " \t,");
+                size_t n = std::min(strcspn(t, " \t,\r"), (size_t)(next - t));
+                if(n == 5 && strncasecmp(t, "close", 5) == 0){
+                    close = true;
+                }
+                else if(n == 10 && strncasecmp(t, "keep-alive", 10) == 0){
+                    close = false;
+                }
+                t += n;
+            }
+        }
+        else if(! header_is(line, len, "Keep-Alive") && ! header_is(line, len, "Proxy-Connection")){
+            if(header_is(line, len, "Transfer-Encoding")){
+                chunked = memmem(value, value_len, "chunked", 7) != nullptr;
+            }
+            else if(header_is(line, len, "Content-Length")){
+                char* digits_end = nullptr;
+                length = strtol(value, &digits_end, 10);
+                if(digits_end == value || length < 0){
+                    return false;
+                }
+            }
+            m_prefix.append(line, len).append("\r\n");
+        }
+        line = next + 2;
+    }
+
+    /* HEAD的应答及204、304没有消息体；既没有chunked也没有长度时以上游关闭连接结束 */
+    if(m_conn.m_method == http_conn::HEAD || m_status == 204 || m_status == 304){
+        m_body.none();
+    }
+    else if(chunked){
+        m_body.chunked();
+    }
+    else if(length >= 0){
+        m_body.length(length);
+    }
+    else{
+        m_body.until_eof();
+        close = true;
+        m_conn.m_linger = false;
+    }
+    m_keep_upstream = ! close;
+
+    /* Connection及Keep-Alive字段与服务器自己的应答相同 */
+    m_conn.m_write_idx = 0;
+    m_conn.add_connection();
+    m_prefix.append(m_conn.m_write_buf, m_conn.m_write_idx).append("\r\n");
+    m_conn.m_write_idx = 0;
+
+    /* 之后转发应答：读缓冲中头部之后的数据是消息体的开头 */
+    m_response = true;
+    m_prefix_sent = 0;
+    m_unsent = 0;
+    m_piped = 0;
+    m_buf_pos = head_len;
+    return true;
+}
+
+bool proxy_session::send_response(){
+    long budget = (config_->write_quantum > 0) ? (long)config_->write_quantum << 10 : LONG_MAX;
+    switch(pump(budget)){
+        case PUMP_DONE: {
+            return finish();
+        }
+        case PUMP_WAIT_SOURCE: {
+            arm_upstream(EPOLLIN);
+            return true;
+        }
+        case PUMP_WAIT_DEST:
+        case PUMP_YIELD: {
+            /* 与大文件一样，用完write_quantum后与其他连接轮流发送 */
+            arm_client(EPOLLOUT);
+            return true;
+        }
+        case PUMP_SOURCE_ERROR: {
+            log_->log("err", this_file, __LINE__, "Upstream " + m_upstream->name + " broke off the response.");
+            proxy_->report(m_upstream, false);
+            if(m_prefix_sent == 0){
+                return fail();
+            }
+            return false;
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+bool proxy_session::upstream_failed(){
+    /* 连接池中的连接可能恰好被上游关闭，请求没有消息体时在新建的连接上重发一次 */
+    if(m_reused && m_replayable && ! m_retried && m_buf_len == 0){
+        m_retried = true;
+        release(false);
+        m_response = false;
+        m_prefix_sent = 0;
+        m_unsent = 0;
+        m_body.none();
+        return connect_upstream(false);
+    }
+    if(! m_reused){
+        proxy_->report(m_upstream, false);
+    }
+    log_->log("err", this_file, __LINE__, "Failed to forward request to upstream " + m_upstream->name);
+    return fail();
+}
+
+bool proxy_session::fail(){
+    release(false);
+    /* 请求的消息体没有读完，无法确定下一个请求从哪里开始 */
+    if(! m_response && ! m_body.done()){
+        m_conn.m_linger = false;
+    }
+    m_state = IDLE;
+    m_conn.m_write_idx = 0;
+    if(! m_conn.process_write(http_conn::BAD_GATEWAY)){
+        return false;
+    }
+    /* 之后由write()按普通应答发送 */
+    modfd(m_conn.m_epollfd, m_conn.m_sockfd, EPOLLOUT, m_conn.m_key);
+    return true;
+}
+
+bool proxy_session::finish(){
+    release(m_keep_upstream);
+    proxy_->report(m_upstream, true);
+    m_state = IDLE;
+    log_->log("msg", this_file, __LINE__, m_conn.m_arena.printf("proxy: [ %s ] [ %s ] [ %d ]",
+        m_conn.m_url, m_upstream->name.c_str(), m_status));
+    m_conn.m_trace.commit(m_conn.m_conn_id, m_conn.m_url);
+    if(! m_conn.m_linger){
+        return false;
+    }
+    m_conn.finish_request();
+    /* 读缓冲中已有流水线发送的下一个请求时注册EPOLLOUT（立即触发），由write()交给serve */
+    if(m_conn.m_read_idx > 0){
+        modfd(m_conn.m_epollfd, m_conn.m_sockfd, EPOLLOUT, m_conn.m_key);
+    }
+    else{
+        m_conn.wait_read();
+    }
+    return true;
+}
+
+void proxy_session::release(bool keep){
+    if(m_fd < 0){
+        return;
+    }
+    if(m_registered){
+        epoll_ctl(m_conn.m_epollfd, EPOLL_CTL_DEL, m_fd, nullptr);
+        m_registered = false;
+    }
+    if(keep && m_upstream){
+        proxy_->release(m_upstream, m_fd, true);
+    }
+    else{
+        close(m_fd);
+    }
+    m_fd = -1;
+}
+
+/* 从源转发m_prefix及一个消息体到目标，直到完成、一方需要等待或出错。
+ * 源缓冲中的数据先由m_body解析出属于消息体的部分，与m_prefix一起writev；
+ * 源缓冲为空且正处于数据部分时，数据经管道splice，不经过用户态
+ */
+proxy_session::PUMP proxy_session::pump(long budget){
+    while(true){
+        if(m_unsent == 0 && m_piped == 0 && ! m_body.done() && in_len() > 0){
+            m_unsent = m_body.consume(in_data(), in_len());
+            if(m_body.bad()){
+                return PUMP_SOURCE_ERROR;
+            }
+        }
+        if(m_prefix_sent < m_prefix.size() || m_unsent > 0){
+            struct iovec iov[2];
+            int count = 0;
+            if(m_prefix_sent < m_prefix.size()){
+                iov[count].iov_base = const_cast<char*>(m_prefix.data()) + m_prefix_sent;
+                iov[count++].iov_len = m_prefix.size() - m_prefix_sent;
+            }
+            if(m_unsent > 0){
+                iov[count].iov_base = const_cast<char*>(in_data());
+                iov[count++].iov_len = m_unsent;
+            }
+            ssize_t n = write_dest(iov, count);
+            if(n < 0){
+                return (errno == EAGAIN || errno == EWOULDBLOCK) ? PUMP_WAIT_DEST : PUMP_DEST_ERROR;
+            }
+            m_active = time(nullptr);
+            size_t sent = n;
+            size_t head = std::min(sent, m_prefix.size() - m_prefix_sent);
+            m_prefix_sent += head;
+            in_advance(sent - head);
+            m_unsent -= sent - head;
+            budget -= n;
+            if(budget <= 0 && (m_unsent > 0 || ! m_body.done())){
+                return PUMP_YIELD;
+            }
+            continue;
+        }
+        if(m_piped > 0){
+            ssize_t n = splice(m_pipe[0], NULL, dest_fd(), NULL, m_piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if(n <= 0){
+                return (n < 0 && errno == EAGAIN) ? PUMP_WAIT_DEST : PUMP_DEST_ERROR;
+            }
+            m_active = time(nullptr);
+            m_piped -= n;
+            budget -= n;
+            if(budget <= 0 && (m_piped > 0 || ! m_body.done())){
+                return PUMP_YIELD;
+            }
+            continue;
+        }
+        if(m_body.done()){
+            /* 上游在应答之后多发送了数据，该连接不能再复用 */
+            if(m_response && in_len() > 0){
+                m_keep_upstream = false;
+            }
+            return PUMP_DONE;
+        }
+        long direct = m_body.direct();
+        if(direct > 0 && m_splice){
+            size_t len = (direct < (long)SPLICE_CHUNK) ? direct : SPLICE_CHUNK;
+            ssize_t n = splice(source_fd(), NULL, m_pipe[1], NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if(n > 0){
+                m_body.skip(n);
+                m_piped = n;
+                continue;
+            }
+            if(n == 0){
+                m_body.eof();
+                if(m_body.bad()){
+                    return PUMP_SOURCE_ERROR;
+                }
+                continue;
+            }
+            if(errno == EAGAIN){
+                return PUMP_WAIT_SOURCE;
+            }
+            if(errno != EINVAL){
+                return PUMP_SOURCE_ERROR;
+            }
+            /* socket不支持splice，改用缓冲中转 */
+            m_splice = false;
+        }
+        ssize_t n = in_fill();
+        if(n < 0){
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? PUMP_WAIT_SOURCE : PUMP_SOURCE_ERROR;
+        }
+        if(n == 0){
+            m_body.eof();
+            if(m_body.bad()){
+                return PUMP_SOURCE_ERROR;
+            }
+        }
+    }
+}
+
+const char* proxy_session::in_data() const{
+    return m_response ? m_buf + m_buf_pos : m_conn.m_read_buf + m_conn.m_checked_idx;
+}
+
+size_t proxy_session::in_len() const{
+    return m_response ? m_buf_len - m_buf_pos : m_conn.m_read_idx - m_conn.m_checked_idx;
+}
+
+void proxy_session::in_advance(size_t len){
+    if(m_response){
+        m_buf_pos += len;
+    }
+    else{
+        m_conn.m_checked_idx += len;
+    }
+}
+
+/* 请求的消息体读入http_conn的读缓冲，消息体之后的数据是流水线发送的下一个请求，留在读缓冲中 */
+ssize_t proxy_session::in_fill(){
+    ssize_t n = 0;
+    if(m_response){
+        m_buf_pos = m_buf_len = 0;
+        n = recv(m_fd, m_buf, BUF_SIZE, 0);
+        if(n > 0){
+            m_buf_len = n;
+        }
+        return n;
+    }
+    m_conn.m_read_idx = m_conn.m_checked_idx = m_conn.m_start_line = 0;
+    n = m_conn.sock_recv(m_conn.m_read_buf, http_conn::READ_BUF_SIZE);
+    if(n > 0){
+        m_conn.m_read_idx = n;
+    }
+    return n;
+}
+
+ssize_t proxy_session::write_dest(const struct iovec* iov, int count){
+    if(m_response){
+        return m_conn.sock_writev(iov, count);
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = const_cast<struct iovec*>(iov);
+    msg.msg_iovlen = count;
+    return sendmsg(m_fd, &msg, MSG_NOSIGNAL);
+}
+
+int proxy_session::source_fd() const{
+    return m_response ? m_fd : m_conn.m_sockfd;
+}
+
+int proxy_session::dest_fd() const{
+    return m_response ? m_conn.m_sockfd : m_fd;
+}
+
+/* 先标记再注册事件：注册之后主线程随时可能收到事件 */
+void proxy_session::arm_upstream(int ev){
+    epoll_event event;
+    event.data.u64 = conn_table::UPSTREAM_TAG | m_conn.m_key;
+    event.events = ev | EPOLLET | EPOLLONESHOT | EPOLLRDHUP;
+    int op = m_registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    m_registered = true;
+    m_conn.m_waiting.store(true, std::memory_order_release);
+    epoll_ctl(m_conn.m_epollfd, op, m_fd, &event);
+}
+
+void proxy_session::arm_client(int ev){
+    m_conn.m_waiting.store(true, std::memory_order_release);
+    modfd(m_conn.m_epollfd, m_conn.m_sockfd, ev, m_conn.m_key);
+}
@@ -0,0 +1,147 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:56
+ * @ Modified Time: 2026-10-19 23:59:56
+ * @ Description  : 按客户端IP的连接数及请求速率限制
+ */
+
+#include <ctime>
+#include "../include/ratelimit.h"
+
+rate_limiter* limiter_ = nullptr;
+
+rate_limiter::rate_limiter(int max_conns, int rate, int burst)
+    : m_shards(new shard[SHARD_COUNT]), m_max_conns(max_conns), m_interval(0), m_tolerance(0),
+      m_next_shard(0), m_rejected(0){
+    if(rate > 0){
+        m_interval = 1000000000ull / rate;
+        m_tolerance = (burst > 1) ? m_interval * (burst - 1) : 0;
+    }
+}
+
+rate_limiter::~rate_limiter(){
+    delete [] m_shards;
+}
+
+/* 粗粒度时钟（精度为一个tick，约4ms）通过vDSO读取，比CLOCK_MONOTONIC便宜，对每秒的速率足够 */
+uint64_t rate_limiter::now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+limit_slot* rate_limiter::set_of(uint32_t ip) const{
+    /* 乘法哈希的高位与IP的所有位有关：最高4位选分片，之后的9位选组 */
+    uint32_t h = ip * 0x9E3779B1u;
+    shard& s = m_shards[h >> 28];
+    return s.slots + ((h >> 19) & (SHARD_SLOTS / WAYS - 1)) * WAYS;
+}
+
+bool rate_limiter::reclaimable(const limit_slot& slot, uint64_t t) const{
+    return slot.conns.load(std::memory_order_relaxed) == 0 && slot.tat.load(std::memory_order_relaxed) <= t;
+}
+
+bool rate_limiter::reclaim(limit_slot& slot, uint64_t key, uint64_t t){
+    /* 先标记再检查连接数，与admit中先增加连接数再检查key相对（都是顺序一致的操作）：
+     * 两者同时进行时，要么这里看到连接，要么admit看到标记并撤销回收
+     */
+    uint64_t busy = key | KEY_BUSY;
+    if(! slot.key.compare_exchange_strong(key, busy)){
+        return false;
+    }
+    if(! reclaimable(slot, t)){
+        slot.key.compare_exchange_strong(busy, key);
+        return false;
+    }
+    /* tat不超过当前时间，与新表项的0等价，不需要重置；失败时回收已被撤销 */
+    return slot.key.compare_exchange_strong(busy, 0);
+}
+
+rate_limiter::ADMIT rate_limiter::admit(uint32_t ip, limit_slot*& slot){
+    uint64_t key = ip | KEY_USED;
+    uint64_t t = now();
+    limit_slot* set = set_of(ip);
+    while(true){
+        limit_slot* found = nullptr;
+        limit_slot* free_slot = nullptr;
+        for(int i = 0; i < WAYS; ++i){
+            uint64_t k = set[i].key.load();
+            if((k & ~KEY_BUSY) == key){
+                found = set + i;
+                break;
+            }
+            if(! free_slot && k == 0){
+                free_slot = set + i;
+            }
+        }
+        if(! found){
+            if(! free_slot){
+                /* 组已满，回收一个没有连接且令牌桶已满的表项后重试 */
+                bool reclaimed = false;
+                for(int i = 0; i < WAYS && ! reclaimed; ++i){
+                    uint64_t k = set[i].key.load();
+                    reclaimed = ! (k & KEY_BUSY) && reclaimable(set[i], t) && reclaim(set[i], k, t);
+                }
+                if(! reclaimed){
+                    return ADMIT_UNTRACKED;
+                }
+                continue;
+            }
+            /* 其他事件循环抢先占用了该表项时重新查找，可能它插入的正是同一IP */
+            uint64_t empty = 0;
+            free_slot->key.compare_exchange_strong(empty, key);
+            continue;
+        }
+        int32_t conns = found->conns.fetch_add(1);
+        uint64_t k = found->key.load();
+        if(k == (key | KEY_BUSY)){
+            found->key.compare_exchange_strong(k, key);     /* 撤销回收 */
+            k = found->key.load();
+        }
+        if(k != key){
+            /* 表项已被回收，可能已属于其他IP */
+            found->conns.fetch_sub(1);
+            continue;
+        }
+        /* 令牌已经用完的客户端不必等到发送请求，直接关闭新连接 */
+        if((m_max_conns > 0 && conns >= m_max_conns)
+                || (m_interval > 0 && found->tat.load(std::memory_order_relaxed) > t + m_tolerance)){
+            found->conns.fetch_sub(1, std::memory_order_relaxed);
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            return ADMIT_REJECT;
+        }
+        slot = found;
+        return ADMIT_OK;
+    }
+}
+
+bool rate_limiter::allow(limit_slot* slot){
+    if(m_interval == 0){
+        return true;
+    }
+    uint64_t t = now();
+    uint64_t tat = slot->tat.load(std::memory_order_relaxed);
+    while(true){
+        uint64_t base = (tat > t) ? tat : t;
+        if(base - t > m_tolerance){
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if(slot->tat.compare_exchange_weak(tat, base + m_interval, std::memory_order_relaxed)){
+            return true;
+        }
+    }
+}
+
+void rate_limiter::age(){
+    uint64_t t = now();
+    shard& s = m_shards[m_next_shard];
+    m_next_shard = (m_next_shard + 1) % SHARD_COUNT;
+    for(limit_slot& slot : s.slots){
+        uint64_t k = slot.key.load(std::memory_order_relaxed);
+        if(k != 0 && ! (k & KEY_BUSY) && reclaimable(slot, t)){
+            reclaim(slot, k, t);
+        }
+    }
+}
@@ -0,0 +1,135 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:55
+ * @ Modified Time: 2026-10-19 23:59:55
+ * @ Description  : 请求路由（压缩前缀树）及处理器接口
+ */
+
+#include <cstring>
+#include "../include/router.h"
+#include "../include/file_cache.h"
+#include "../include/ratelimit.h"
+
+router* router_ = nullptr;
+
+router::router() : m_root(new node), m_routes(0){
+}
+
+router::~router(){
+    delete m_root;
+    for(route_handler* handler : m_handlers){
+        delete handler;
+    }
+}
+
+bool router::add(const string& path, MATCH kind, uint32_t methods, route_handler* handler){
+    m_handlers.push_back(handler);
+    string key = path;
+    while(kind == PREFIX && key.size() > 1 && key.back() == '/'){
+        key.pop_back();
+    }
+    if(key.empty() || key[0] != '/' || (methods & ALL_METHODS) == 0){
+        return false;
+    }
+
+    /* 沿已有的边向下，边只有一部分相同时在相同部分的结尾分裂出一个节点 */
+    node* n = m_root;
+    size_t i = 0;
+    while(i < key.size()){
+        size_t idx = n->first.find(key[i]);
+        if(idx == string::npos){
+            node* child = new node;
+            child->label = key.substr(i);
+            n->first.push_back(key[i]);
+            n->children.push_back(child);
+            n = child;
+            break;
+        }
+        node* child = n->children[idx];
+        size_t len = 0;
+        while(len < child->label.size() && i + len < key.size() && child->label[len] == key[i + len]){
+            ++len;
+        }
+        if(len < child->label.size()){
+            node* mid = new node;
+            mid->label = child->label.substr(0, len);
+            child->label.erase(0, len);
+            mid->first.push_back(child->label[0]);
+            mid->children.push_back(child);
+            n->children[idx] = mid;
+            child = mid;
+        }
+        n = child;
+        i += len;
+    }
+
+    if(n->methods[kind] & methods){
+        return false;
+    }
+    n->methods[kind] |= methods & ALL_METHODS;
+    for(int m = 0; m < METHOD_COUNT; ++m){
+        if(methods & (1u << m)){
+            n->handlers[kind][m] = handler;
+        }
+    }
+    ++m_routes;
+    return true;
+}
+
+route_handler* router::match(http_conn::METHOD method, const char* path, uint32_t& allowed) const{
+    uint32_t bit = method_bit(method);
+    route_handler* found = nullptr;
+    allowed = 0;
+    const node* n = m_root;
+    const char* p = path;
+    while(true){
+        /* p之前的部分与n对应的路径相同；更深的匹配覆盖之前的结果 */
+        bool end = (*p == '\0');
+        if(n->methods[PREFIX] && (end || *p == '/' || (p > path && p[-1] == '/'))){
+            if(n->methods[PREFIX] & bit){
+                found = n->handlers[PREFIX][method];
+            }
+            allowed = n->methods[PREFIX];
+        }
+        if(end){
+            if(n->methods[EXACT] & bit){
+                found = n->handlers[EXACT][method];
+            }
+            if(n->methods[EXACT]){
+                allowed = n->methods[EXACT];
+            }
+            break;
+        }
+        const char* idx = static_cast<const char*>(memchr(n->first.data(), *p, n->first.size()));
+        if(! idx){
+            break;
+        }
+        const node* child = n->children[idx - n->first.data()];
+        /* label不含'\0'，path先结束时在结尾处不相等 */
+        if(strncmp(p, child->label.c_str(), child->label.size()) != 0){
+            break;
+        }
+        p += child->label.size();
+        n = child;
+    }
+    if(found){
+        allowed = 0;
+    }
+    return found;
+}
+
+http_conn::HTTP_CODE status_handler::handle(http_conn& conn){
+    arena& scratch = conn.scratch();
+    char* body = scratch.printf("connections: %d\naccepted: %u\n",
+        http_conn::m_user_count.load(), http_conn::m_conn_count.load());
+    if(file_cache_){
+        cache_stats stats = file_cache_->stats();
+        body = scratch.printf("%scache_hits: %llu\ncache_misses: %llu\ncache_evictions: %llu\n", body,
+            (unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.evictions);
+    }
+    if(limiter_){
+        body = scratch.printf("%srate_limited: %llu\n", body, (unsigned long long)limiter_->rejected());
+    }
+    return conn.respond(200, "OK", ".txt", body, strlen(body));
+}
@@ -0,0 +1,170 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 22:58:41
+ * @ Modified Time: 2026-10-19 22:58:41
+ * @ Description  : 缓存内容使用的slab分配器
+ */
+
+#include <exception>
+#include <sys/mman.h>
+#include "../include/slab.h"
+
+slab_pool::slab_pool(size_t capacity, size_t max_chunk){
+    if(max_chunk > SLAB_SIZE){
+        throw std::exception();
+    }
+    for(size_t size = MIN_CHUNK; ; size = (size * 5 / 4 + 63) & ~(size_t)63){
+        size_class* c = new size_class;
+        c->size = (size < max_chunk) ? size : (max_chunk + 63) & ~(size_t)63;
+        c->partial = nullptr;
+        m_classes.push_back(c);
+        if(size >= max_chunk){
+            break;
+        }
+    }
+    /* 每个大小级别多预留一个slab，避免未满的slab占用的空间使容量内的分配失败；
+     * 只预留地址空间，实际使用时才分配物理内存
+     */
+    size_t count = (capacity + SLAB_SIZE - 1) / SLAB_SIZE + m_classes.size();
+    m_size = (count + 1) * SLAB_SIZE;
+    void* p = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(p == MAP_FAILED){
+        for(size_class* c : m_classes){
+            delete c;
+        }
+        throw std::exception();
+    }
+    /* 透明大页要求2MB对齐 */
+    uintptr_t aligned = ((uintptr_t)p + SLAB_SIZE - 1) & ~(uintptr_t)(SLAB_SIZE - 1);
+    m_base = (char*)aligned;
+    m_huge = madvise(m_base, count * SLAB_SIZE, MADV_HUGEPAGE) == 0;
+    if(m_base != p){
+        munmap(p, m_base - (char*)p);
+    }
+    munmap(m_base + count * SLAB_SIZE, (char*)p + m_size - (m_base + count * SLAB_SIZE));
+    m_size = count * SLAB_SIZE;
+    m_slabs.resize(count);
+    m_next = 0;
+}
+
+slab_pool::~slab_pool(){
+    munmap(m_base, m_size);
+    for(size_class* c : m_classes){
+        delete c;
+    }
+}
+
+int slab_pool::class_of(size_t n) const{
+    /* 大小级别不超过几十个，二分查找 */
+    int lo = 0, hi = m_classes.size();
+    while(lo < hi){
+        int mid = (lo + hi) / 2;
+        if(m_classes[mid]->size < n){
+            lo = mid + 1;
+        }
+        else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void* slab_pool::alloc(size_t n, size_t* chunk){
+    int cls = class_of(n);
+    if(cls == (int)m_classes.size()){
+        return nullptr;
+    }
+    size_class* c = m_classes[cls];
+    c->lock.lock();
+    slab* s = c->partial;
+    if(! s){
+        /* 没有未满的slab，从全局取一个 */
+        uint32_t index;
+        m_lock.lock();
+        if(! m_free.empty()){
+            index = m_free.back();
+            m_free.pop_back();
+        }
+        else if(m_next < m_slabs.size()){
+            index = m_next++;
+        }
+        else{
+            m_lock.unlock();
+            c->lock.unlock();
+            return nullptr;
+        }
+        m_lock.unlock();
+        s = &m_slabs[index];
+        s->cls = cls;
+        s->used = 0;
+        s->carved = 0;
+        s->free_list = nullptr;
+        s->prev = nullptr;
+        s->next = nullptr;
+        s->partial = true;
+        c->partial = s;
+    }
+    void* p;
+    if(s->free_list){
+        p = s->free_list;
+        s->free_list = *(void**)p;
+    }
+    else{
+        p = m_base + (s - &m_slabs[0]) * SLAB_SIZE + s->carved;
+        s->carved += c->size;
+    }
+    ++s->used;
+    if(! s->free_list && s->carved + c->size > SLAB_SIZE){
+        unlink(c, s);
+    }
+    c->lock.unlock();
+    *chunk = c->size;
+    return p;
+}
+
+void slab_pool::free(void* p){
+    if(! p){
+        return;
+    }
+    slab* s = &m_slabs[((char*)p - m_base) / SLAB_SIZE];
+    size_class* c = m_classes[s->cls];
+    c->lock.lock();
+    *(void**)p = s->free_list;
+    s->free_list = p;
+    if(--s->used == 0){
+        /* slab已全部释放，归还给全局 */
+        if(s->partial){
+            unlink(c, s);
+        }
+        s->cls = -1;
+        c->lock.unlock();
+        m_lock.lock();
+        m_free.push_back(s - &m_slabs[0]);
+        m_lock.unlock();
+        return;
+    }
+    if(! s->partial){
+        s->partial = true;
+        s->prev = nullptr;
+        s->next = c->partial;
+        if(c->partial){
+            c->partial->prev = s;
+        }
+        c->partial = s;
+    }
+    c->lock.unlock();
+}
+
+void slab_pool::unlink(size_class* c, slab* s){
+    if(s->prev){
+        s->prev->next = s->next;
+    }
+    else{
+        c->partial = s->next;
+    }
+    if(s->next){
+        s->next->prev = s->prev;
+    }
+    s->partial = false;
+}
@@ -0,0 +1,270 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 23:59:52
+ * @ Modified Time: 2026-10-19 23:59:52
+ * @ Description  : TLS监听（OpenSSL握手，内核TLS加密）
+ */
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "../include/tls.h"
+#include "../include/log.h"
+
+#ifdef WEBSERVER_HAVE_OPENSSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+tls_context* tls_ = nullptr;
+
+#ifdef WEBSERVER_HAVE_OPENSSL
+
+static const string this_file = "tls.cpp";
+
+static const long SESSION_CACHE = 20480;    /* TLS 1.2会话缓存的容量 */
+static const long SESSION_TIMEOUT = 3600;   /* 会话（包括ticket）的有效期（s） */
+static const size_t MAX_RECORD = 16384;     /* 用户态加密时每次SSL_write的长度，正好是一个记录 */
+
+tls_context::tls_context(const string& cert_file, const string& key_file){
+    m_ctx = SSL_CTX_new(TLS_server_method());
+    if(! m_ctx){
+        throw std::exception();
+    }
+    if(SSL_CTX_use_certificate_chain_file(m_ctx, cert_file.c_str()) != 1
+            || SSL_CTX_use_PrivateKey_file(m_ctx, key_file.c_str(), SSL_FILETYPE_PEM) != 1
+            || SSL_CTX_check_private_key(m_ctx) != 1){
+        ERR_clear_error();
+        SSL_CTX_free(m_ctx);
+        throw std::exception();
+    }
+    SSL_CTX_set_min_proto_version(m_ctx, TLS1_2_VERSION);
+    /* 握手时协商内核支持的密码套件（AES-GCM、ChaCha20-Poly1305），由OpenSSL设置TCP_ULP "tls"并交出密钥；
+     * 内核不支持时OpenSSL继续在用户态加解密。客户端不发送close_notify直接断开时视为正常关闭
+     */
+    SSL_CTX_set_options(m_ctx, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION | SSL_OP_IGNORE_UNEXPECTED_EOF
+        | SSL_OP_CIPHER_SERVER_PREFERENCE);
+    /* 非阻塞发送：允许只发送一部分，重试时iovec的位置可能已经变化；空闲连接不保留读写缓冲 */
+    SSL_CTX_set_mode(m_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER
+        | SSL_MODE_RELEASE_BUFFERS);
+
+    /* 会话恢复：TLS 1.3发送一个无状态的ticket，TLS 1.2的ticket与会话缓存都可用，恢复时省去证书签名 */
+    static const unsigned char sid_ctx[] = "WebServer";
+    SSL_CTX_set_session_id_context(m_ctx, sid_ctx, sizeof(sid_ctx) - 1);
+    SSL_CTX_set_session_cache_mode(m_ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(m_ctx, SESSION_CACHE);
+    SSL_CTX_set_timeout(m_ctx, SESSION_TIMEOUT);
+    SSL_CTX_set_num_tickets(m_ctx, 1);
+}
+
+tls_context::~tls_context(){
+    SSL_CTX_free(m_ctx);
+}
+
+SSL* tls_context::create(int fd){
+    SSL* ssl = SSL_new(m_ctx);
+    if(! ssl){
+        ERR_clear_error();
+        return nullptr;
+    }
+    if(SSL_set_fd(ssl, fd) != 1){
+        ERR_clear_error();
+        SSL_free(ssl);
+        return nullptr;
+    }
+    SSL_set_accept_state(ssl);
+    return ssl;
+}
+
+bool tls_conn::start(int fd){
+    close();
+    if(! tls_){
+        return false;
+    }
+    m_ssl = tls_->create(fd);
+    /* 用户态加密时一个应答可能分为多个记录，每个记录一次send，
+     * 不关闭Nagle算法时最后一个不满的段要等待客户端的延迟ACK
+     */
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return m_ssl != nullptr;
+}
+
+void tls_conn::close(){
+    if(! m_ssl){
+        return;
+    }
+    /* 不等待客户端的close_notify，socket随后就会关闭 */
+    if(m_established){
+        SSL_shutdown(m_ssl);
+    }
+    ERR_clear_error();
+    SSL_free(m_ssl);
+    m_ssl = nullptr;
+    m_established = false;
+    m_ktls_send = false;
+}
+
+tls_conn::HANDSHAKE tls_conn::handshake(){
+    ERR_clear_error();
+    int ret = SSL_do_handshake(m_ssl);
+    if(ret == 1){
+        m_established = true;
+        m_ktls_send = BIO_get_ktls_send(SSL_get_wbio(m_ssl));
+        char info[128];
+        snprintf(info, sizeof(info), "TLS handshake done: %s %s%s%s.", SSL_get_version(m_ssl),
+            SSL_get_cipher_name(m_ssl), SSL_session_reused(m_ssl) ? ", resumed" : "",
+            m_ktls_send ? ", kTLS" : "");
+        log_->log("msg", this_file, __LINE__, info);
+        return TLS_DONE;
+    }
+    switch(SSL_get_error(m_ssl, ret)){
+        case SSL_ERROR_WANT_READ:
+            return TLS_WANT_READ;
+        case SSL_ERROR_WANT_WRITE:
+            return TLS_WANT_WRITE;
+        default:
+            ERR_clear_error();
+            return TLS_ERROR;
+    }
+}
+
+ssize_t tls_conn::recv(void* buf, size_t len){
+    ERR_clear_error();
+    int n = SSL_read(m_ssl, buf, (len < INT_MAX) ? len : INT_MAX);
+    if(n > 0){
+        return n;
+    }
+    switch(SSL_get_error(m_ssl, n)){
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            errno = EAGAIN;
+            return -1;
+        case SSL_ERROR_ZERO_RETURN:
+            return 0;
+        default:
+            ERR_clear_error();
+            errno = ECONNRESET;
+            return -1;
+    }
+}
+
+ssize_t tls_conn::writev(int fd, const struct iovec* iov, int count){
+    /* 内核负责加密，与明文连接走同一条零拷贝路径 */
+    if(m_ktls_send){
+        return ::writev(fd, iov, count);
+    }
+    /* 每次SSL_write一个记录：当前iovec剩余不足一个记录时（如应答头部），与之后的iovec拼成一个记录，
+     * 否则头部与消息体会成为两个TCP段。记录的内容只取决于当前位置，返回EAGAIN后调用者
+     * 从同一位置重试，SSL_write得到的数据与长度都与上次相同
+     */
+    static thread_local char record[MAX_RECORD];
+    ssize_t total = 0;
+    int i = 0;
+    size_t offset = 0;
+    while(i < count){
+        if(offset == iov[i].iov_len){
+            ++i;
+            offset = 0;
+            continue;
+        }
+        const char* data = static_cast<const char*>(iov[i].iov_base) + offset;
+        size_t len = iov[i].iov_len - offset;
+        if(len < MAX_RECORD && i + 1 < count){
+            len = 0;
+            size_t from = offset;
+            for(int j = i; j < count && len < MAX_RECORD; ++j, from = 0){
+                size_t n = iov[j].iov_len - from;
+                if(n > MAX_RECORD - len){
+                    n = MAX_RECORD - len;
+                }
+                memcpy(record + len, static_cast<const char*>(iov[j].iov_base) + from, n);
+                len += n;
+            }
+            data = record;
+        }
+        else if(len > MAX_RECORD){
+            len = MAX_RECORD;
+        }
+        ERR_clear_error();
+        int n = SSL_write(m_ssl, data, len);
+        if(n <= 0){
+            int err = SSL_get_error(m_ssl, n);
+            if(err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ){
+                if(total > 0){
+                    return total;
+                }
+                errno = EAGAIN;
+                return -1;
+            }
+            ERR_clear_error();
+            errno = EPIPE;
+            return -1;
+        }
+        total += n;
+        /* 前进n字节，可能跨过多个iovec */
+        for(size_t left = n; left > 0; ){
+            size_t step = iov[i].iov_len - offset;
+            if(left < step){
+                offset += left;
+                break;
+            }
+            left -= step;
+            ++i;
+            offset = 0;
+        }
+    }
+    return total;
+}
+
+bool tls_conn::pending() const{
+    return m_ssl && SSL_pending(m_ssl) > 0;
+}
+
+#else
+
+/* 未找到OpenSSL时编译的版本：无法创建tls_context，连接上不会有TLS状态 */
+tls_context::tls_context(const string& cert_file, const string& key_file) : m_ctx(nullptr){
+    throw std::exception();
+}
+
+tls_context::~tls_context(){
+}
+
+SSL* tls_context::create(int fd){
+    return nullptr;
+}
+
+bool tls_conn::start(int fd){
+    return false;
+}
+
+void tls_conn::close(){
+}
+
+tls_conn::HANDSHAKE tls_conn::handshake(){
+    return TLS_ERROR;
+}
+
+ssize_t tls_conn::recv(void* buf, size_t len){
+    errno = ENOTCONN;
+    return -1;
+}
+
+ssize_t tls_conn::writev(int fd, const struct iovec* iov, int count){
+    errno = ENOTCONN;
+    return -1;
+}
+
+bool tls_conn::pending() const{
+    return false;
+}
+
+#endif
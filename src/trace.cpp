@@ -0,0 +1,245 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 18:10:36
+ * @ Modified Time: 2026-10-19 18:10:36
+ * @ Description  : 请求处理热路径追踪
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+#include "../include/trace.h"
+#include "../include/locker.h"
+
+using std::vector;
+
+std::atomic<bool> trace_on(false);
+
+static int trace_sample = 100;          /* 每N个请求采样一个，0表示不采样 */
+static uint64_t trace_slow = 0;         /* 慢请求阈值（时钟周期），0表示不按阈值记录 */
+static double ticks_per_us = 1000;      /* 校准后的时钟频率 */
+static uint64_t trace_base = 0;         /* 导出时的时间零点 */
+static std::atomic<uint64_t> request_seq(0);
+
+static const char* stage_names[TRACE_STAGE_COUNT] = {
+    "request", "accept", "read", "queue", "process_read", "do_request", "process_write", "write", "prefetch"
+};
+
+/* 提交到线程缓冲区的一条记录 */
+struct trace_event{
+    uint64_t begin;
+    uint64_t end;
+    uint64_t seq;           /* 请求编号 */
+    uint32_t conn_id;
+    uint16_t stage;
+    uint16_t tid;
+    char name[40];          /* 仅TRACE_REQUEST记录url */
+};
+
+/* 每个线程一个环形缓冲区，写满后覆盖最旧的记录 */
+class trace_buffer{
+public:
+    static const size_t CAPACITY = 16384;
+    locker lock;            /* 只与导出操作竞争 */
+    trace_event* events;
+    uint64_t count;         /* 累计写入的记录数 */
+    uint16_t tid;
+    char thread_name[16];
+
+    trace_buffer(uint16_t id) : events(new trace_event[CAPACITY]), count(0), tid(id) {
+        if(pthread_getname_np(pthread_self(), thread_name, sizeof(thread_name)) != 0) {
+            strcpy(thread_name, "thread");
+        }
+    }
+    void push(const trace_event& ev) {
+        events[count % CAPACITY] = ev;
+        ++count;
+    }
+};
+
+static locker buffers_lock;
+static vector<trace_buffer*> buffers;
+static thread_local trace_buffer* local_buffer = nullptr;
+
+/* 线程第一次记录时创建缓冲区，线程编号从1开始 */
+static trace_buffer* get_buffer() {
+    if(! local_buffer) {
+        buffers_lock.lock();
+        local_buffer = new trace_buffer(buffers.size() + 1);
+        buffers.push_back(local_buffer);
+        buffers_lock.unlock();
+    }
+    return local_buffer;
+}
+
+void trace_init(int sample, int slow_us) {
+    trace_sample = sample;
+#if defined(__x86_64__) || defined(__i386__)
+    /* 用单调时钟校准rdtsc的频率 */
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t c0 = trace_now();
+    usleep(20000);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    uint64_t c1 = trace_now();
+    double us = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+    ticks_per_us = (c1 - c0) / us;
+#endif
+    trace_slow = (uint64_t)(slow_us * ticks_per_us);
+    trace_base = trace_now();
+}
+
+void trace_ctx::begin(uint64_t now) {
+    m_count = 0;
+    m_enqueue = 0;
+    m_start = now;
+    m_seq = request_seq.fetch_add(1, std::memory_order_relaxed) + 1;
+    m_sampled = (trace_sample > 0) && (m_seq % trace_sample == 0);
+    /* 设置了慢请求阈值时每个请求都要记录，结束时才知道是否需要提交 */
+    m_active = m_sampled || (trace_slow > 0);
+}
+
+void trace_ctx::add(TRACE_STAGE stage, uint64_t begin, uint64_t end) {
+    if(! m_active || m_count >= MAX_SPANS) {
+        return;
+    }
+    trace_span& span = m_spans[m_count++];
+    span.begin = begin;
+    span.end = end;
+    span.stage = stage;
+    span.tid = get_buffer()->tid;
+}
+
+void trace_ctx::dequeue(uint64_t now) {
+    if(m_active && m_enqueue) {
+        add(TRACE_QUEUE, m_enqueue, now);
+        m_enqueue = 0;
+    }
+}
+
+void trace_ctx::commit(uint32_t conn_id, const char* name) {
+    if(! m_active) {
+        return;
+    }
+    uint64_t end = trace_now();
+    if(! m_sampled && end - m_start < trace_slow) {
+        reset();
+        return;
+    }
+    trace_buffer* buf = get_buffer();
+    trace_event ev;
+    ev.seq = m_seq;
+    ev.conn_id = conn_id;
+    ev.name[0] = '\0';
+
+    buf->lock.lock();
+    ev.begin = m_start;
+    ev.end = end;
+    ev.stage = TRACE_REQUEST;
+    ev.tid = buf->tid;
+    /* 截断url时不能拆开UTF-8字符 */
+    size_t len = strlen(name);
+    if(len >= sizeof(ev.name)) {
+        len = sizeof(ev.name) - 1;
+        while(len > 0 && ((unsigned char)name[len] & 0xC0) == 0x80) {
+            --len;
+        }
+    }
+    memcpy(ev.name, name, len);
+    ev.name[len] = '\0';
+    buf->push(ev);
+
+    ev.name[0] = '\0';
+    if(m_accept[0]) {
+        ev.begin = m_accept[0];
+        ev.end = m_accept[1];
+        ev.stage = TRACE_ACCEPT;
+        buf->push(ev);
+        m_accept[0] = m_accept[1] = 0;
+    }
+    for(int i = 0; i < m_count; ++i) {
+        ev.begin = m_spans[i].begin;
+        ev.end = m_spans[i].end;
+        ev.stage = m_spans[i].stage;
+        ev.tid = m_spans[i].tid;
+        buf->push(ev);
+    }
+    buf->lock.unlock();
+    reset();
+}
+
+static double to_us(uint64_t tick) {
+    return (tick > trace_base) ? (tick - trace_base) / ticks_per_us : 0;
+}
+
+static void write_escaped(FILE* fp, const char* s) {
+    for(; *s; ++s) {
+        unsigned char c = *s;
+        if(c == '"' || c == '\\') {
+            fprintf(fp, "\\%c", c);
+        }
+        else if(c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        }
+        else {
+            fputc(c, fp);
+        }
+    }
+}
+
+bool trace_dump(const char* file) {
+    FILE* fp = fopen(file, "w");
+    if(! fp) {
+        return false;
+    }
+    fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    fprintf(fp, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"WebServer\"}}");
+
+    vector<trace_event> events;
+    buffers_lock.lock();
+    vector<trace_buffer*> all = buffers;
+    buffers_lock.unlock();
+    for(trace_buffer* buf : all) {
+        fprintf(fp, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"",
+            buf->tid);
+        write_escaped(fp, buf->thread_name);
+        fprintf(fp, "\"}}");
+
+        buf->lock.lock();
+        uint64_t first = (buf->count > trace_buffer::CAPACITY) ? buf->count - trace_buffer::CAPACITY : 0;
+        events.clear();
+        for(uint64_t i = first; i < buf->count; ++i) {
+            events.push_back(buf->events[i % trace_buffer::CAPACITY]);
+        }
+        buf->lock.unlock();
+
+        for(const trace_event& ev : events) {
+            double ts = to_us(ev.begin);
+            double dur = (ev.end - ev.begin) / ticks_per_us;
+            if(ev.stage == TRACE_REQUEST || ev.stage == TRACE_QUEUE) {
+                /* 整个请求和排队时间跨越多个线程，用异步事件表示，按请求编号关联 */
+                const char* name = (ev.stage == TRACE_REQUEST) ? ev.name : stage_names[ev.stage];
+                fprintf(fp, ",\n{\"name\": \"");
+                write_escaped(fp, name);
+                fprintf(fp, "\", \"cat\": \"request\", \"ph\": \"b\", \"id\": %llu, \"pid\": 1, \"tid\": %u, "
+                    "\"ts\": %.3f, \"args\": {\"conn\": %u}}",
+                    (unsigned long long)ev.seq, ev.tid, ts, ev.conn_id);
+                fprintf(fp, ",\n{\"name\": \"");
+                write_escaped(fp, name);
+                fprintf(fp, "\", \"cat\": \"request\", \"ph\": \"e\", \"id\": %llu, \"pid\": 1, \"tid\": %u, "
+                    "\"ts\": %.3f}", (unsigned long long)ev.seq, ev.tid, ts + dur);
+            }
+            else {
+                fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"http\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"request\": %llu, \"conn\": %u}}",
+                    stage_names[ev.stage], ev.tid, ts, dur, (unsigned long long)ev.seq, ev.conn_id);
+            }
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    return true;
+}
@@ -0,0 +1,36 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-20 09:12:40
+ * @ Modified Time: 2026-10-20 09:12:40
+ * @ Description  : 正确性测试的用例注册与断言 头文件
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <string>
+
+/* CHECK_CASE定义的用例在main之前注册，由check_main.cpp依次执行；
+ * CHECK失败时打印表达式及位置，用例继续执行，有失败时webserver_check返回1
+ */
+typedef void (*check_fn)();
+
+struct check_case{
+    check_case(const char* name, check_fn fn);
+};
+
+void check_failed(const char* file, int line, const char* expr);
+
+/* 创建/tmp下的临时目录，返回其路径；remove_tree删除目录及其中的所有内容 */
+std::string make_temp_dir();
+void remove_tree(const std::string& dir);
+
+#define CHECK(cond) do { if(! (cond)) check_failed(__FILE__, __LINE__, #cond); } while(0)
+
+#define CHECK_CASE(name) \
+    static void name(); \
+    static check_case name##_case(#name, name); \
+    static void name()
+
+#endif
@@ -0,0 +1,537 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-20 09:12:40
+ * @ Modified Time: 2026-10-20 09:12:40
+ * @ Description  : 正确性测试：限流、连接表、slab内存池、文件缓存、静态资源归档
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "check.h"
+#include "alloc_count.h"
+#include "ratelimit.h"
+#include "bundle.h"
+#include "codel.h"
+#include "conn_table.h"
+#include "file_cache.h"
+#include "fs_watch.h"
+#include "slab.h"
+
+/* accept时的admit()+detach()及每个请求的allow()不申请内存 */
+CHECK_CASE(rate_limit_allocs) {
+    rate_limiter limiter(1000000, 1000000000, 1000000000);
+    limit_slot* slot = nullptr;
+    CHECK(limiter.admit(0x0100000a, slot) == rate_limiter::ADMIT_OK);
+    uint64_t before = alloc_count();
+    for(uint32_t ip = 0; ip < 4096; ++ip) {
+        CHECK(limiter.allow(slot));
+        limit_slot* s = nullptr;
+        if(limiter.admit(0x0a000000 + (ip & 1023), s) == rate_limiter::ADMIT_OK) {
+            limiter.detach(s);
+        }
+    }
+    CHECK(alloc_count() == before);
+}
+
+/* 多个事件循环同时accept：同一IP的连接数不超过上限，插入不加锁 */
+CHECK_CASE(rate_limit_concurrent_admit) {
+    const int max_conns = 3;
+    const uint32_t ips = 512;
+    rate_limiter limiter(max_conns, 0, 0);
+    std::atomic<int> admitted[ips];
+    for(auto& a : admitted) {
+        a.store(0);
+    }
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 8; ++t) {
+        threads.emplace_back([&]() {
+            for(uint32_t ip = 0; ip < ips; ++ip) {
+                limit_slot* s = nullptr;
+                if(limiter.admit(0x0a000000 + ip, s) == rate_limiter::ADMIT_OK) {
+                    admitted[ip].fetch_add(1);
+                }
+            }
+        });
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+    int wrong = 0;
+    for(auto& a : admitted) {
+        wrong += (a.load() != max_conns);
+    }
+    CHECK(wrong == 0);
+}
+
+/* 回收与accept同时进行：比组的容量多一倍的IP落在同一组中，不断插入、回收；
+ * 持有连接的表项不会被回收或被其他IP占用，结束后每个IP的连接数都回到0
+ */
+CHECK_CASE(rate_limit_reclaim) {
+    rate_limiter limiter(2, 0, 0);
+    std::vector<uint32_t> ips;
+    for(uint32_t ip = 0x0a000000; ips.size() < 2 * rate_limiter::WAYS; ++ip) {
+        if((ip * 0x9E3779B1u) >> 19 == (0x0a000000u * 0x9E3779B1u) >> 19) {
+            ips.push_back(ip);
+        }
+    }
+    std::atomic<bool> done(false);
+    std::atomic<int> stolen(0);
+    std::thread ager([&]() {
+        while(! done.load()) {
+            limiter.age();
+            std::this_thread::yield();
+        }
+    });
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for(int i = 0; i < 5000; ++i) {
+                uint32_t ip = ips[(i + t) % ips.size()];
+                limit_slot* s = nullptr;
+                if(limiter.admit(ip, s) == rate_limiter::ADMIT_OK) {
+                    std::this_thread::yield();      /* 持有连接期间让回收有机会进行 */
+                    uint64_t key = s->key.load() & ~rate_limiter::KEY_BUSY;
+                    stolen.fetch_add(key != (ip | rate_limiter::KEY_USED));
+                    limiter.detach(s);
+                }
+            }
+        });
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+    done.store(true);
+    ager.join();
+    CHECK(stolen.load() == 0);
+    /* 没有遗留的连接数：组中容纳得下的IP都能再建立两个连接，第三个被拒绝 */
+    int wrong = 0;
+    for(size_t i = 0; i < rate_limiter::WAYS; ++i) {
+        limit_slot* s = nullptr;
+        wrong += limiter.admit(ips[i], s) != rate_limiter::ADMIT_OK || s->conns.load() != 1;
+        wrong += limiter.admit(ips[i], s) != rate_limiter::ADMIT_OK;
+        wrong += limiter.admit(ips[i], s) != rate_limiter::ADMIT_REJECT;
+    }
+    CHECK(wrong == 0);
+}
+
+/* 事件的data（包括上游连接的）找回原来的连接，块分配好之后取出、放回不申请内存 */
+CHECK_CASE(conn_table_keys) {
+    conn_table table(-1);
+    table.release(table.acquire());
+    uint64_t before = alloc_count();
+    for(int i = 0; i < 1024; ++i) {
+        http_conn* conn = table.acquire();
+        uint64_t key = conn_table::key(conn);
+        CHECK(conn_table::resolve(key) == conn);
+        CHECK(conn_table::resolve(key | conn_table::UPSTREAM_TAG) == conn);
+        table.release(conn);
+    }
+    CHECK(alloc_count() == before);
+}
+
+/* 每秒的超时检查只访问等待事件的连接：工作线程取走的连接在它关闭（release）期间不会被访问，
+ * 世代只由所有者加1；检查关闭的连接之后也不再被访问
+ */
+CHECK_CASE(conn_table_sweep) {
+    const int count = 64;
+    int epollfd = epoll_create1(EPOLL_CLOEXEC);
+    CHECK(epollfd >= 0);
+    conn_table table(epollfd);
+    sockaddr_in addr = {};
+    std::vector<http_conn*> parked, owned;
+    std::vector<int> peers;
+    for(int i = 0; i < count; ++i) {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+        peers.push_back(fds[1]);
+        http_conn* conn = table.acquire();
+        conn->init(fds[0], addr);
+        /* 事件循环取出连接的事件，交给工作线程 */
+        if(i & 1) {
+            conn->read();
+            owned.push_back(conn);
+        }
+        else {
+            parked.push_back(conn);
+        }
+    }
+    std::vector<uint32_t> gens;
+    for(http_conn* conn : owned) {
+        gens.push_back(conn->generation());
+    }
+    auto is_owned = [&](http_conn& conn) {
+        return std::find(owned.begin(), owned.end(), &conn) != owned.end();
+    };
+
+    /* 工作线程关闭取走的连接，同时事件循环反复检查 */
+    std::atomic<bool> done(false);
+    std::thread worker([&]() {
+        for(http_conn* conn : owned) {
+            conn->close_conn();
+        }
+        done.store(true);
+    });
+    int visited_owned = 0;
+    do {
+        int visited = 0;
+        table.for_each([&](http_conn& conn) {
+            ++visited;
+            visited_owned += is_owned(conn);
+        });
+        CHECK(visited == (int)parked.size());
+    } while(! done.load());
+    worker.join();
+    CHECK(visited_owned == 0);
+    for(size_t i = 0; i < owned.size(); ++i) {
+        CHECK(owned[i]->generation() == gens[i] + 1);
+    }
+
+    /* 事件循环关闭等待中的连接，之后不再访问它们 */
+    table.for_each([&](http_conn& conn) {
+        conn.close_conn();
+    });
+    int visited = 0;
+    table.for_each([&](http_conn& conn) {
+        ++visited;
+    });
+    CHECK(visited == 0);
+    for(int fd : peers) {
+        close(fd);
+    }
+    close(epollfd);
+}
+
+/* CoDel的拒绝时机：以注入的排队时间及时刻驱动，短时的突发不拒绝，持续超过target达interval之后
+ * 开始拒绝，间隔按interval/sqrt(count)缩短，排队时间回落后停止；不久后再次过载时沿用之前的频率
+ */
+CHECK_CASE(codel_drop_schedule) {
+    const uint64_t ms = 1000000;
+    codel admission(5 * ms, 100 * ms);
+    CHECK(! admission.should_drop(10 * ms, 0));
+    CHECK(! admission.should_drop(10 * ms, 50 * ms));
+    CHECK(! admission.should_drop(1 * ms, 60 * ms));     /* 突发结束，重新计时 */
+    CHECK(! admission.should_drop(10 * ms, 70 * ms));
+    CHECK(! admission.should_drop(10 * ms, 169 * ms));
+    CHECK(! admission.dropping());
+
+    CHECK(admission.should_drop(10 * ms, 170 * ms));     /* 进入丢弃状态，下一次在270ms */
+    CHECK(admission.dropping());
+    CHECK(! admission.should_drop(10 * ms, 200 * ms));
+    CHECK(admission.should_drop(10 * ms, 270 * ms));     /* 下一次在270 + 100/sqrt(2) ms */
+    CHECK(! admission.should_drop(10 * ms, 340 * ms));
+    CHECK(admission.should_drop(10 * ms, 341 * ms));
+    CHECK(! admission.should_drop(1 * ms, 350 * ms));
+    CHECK(! admission.dropping());
+    CHECK(! admission.should_drop(1 * ms, 360 * ms));
+    CHECK(admission.drops() == 3);
+
+    CHECK(! admission.should_drop(10 * ms, 400 * ms));
+    CHECK(admission.should_drop(10 * ms, 500 * ms));     /* count沿用为2，下一次在500 + 100/sqrt(2) ms */
+    CHECK(! admission.should_drop(10 * ms, 570 * ms));
+    CHECK(admission.should_drop(10 * ms, 571 * ms));
+    CHECK(admission.drops() == 5);
+}
+
+/* 被拒绝的连接收到预先拼好的503及Retry-After，之后连接被关闭 */
+CHECK_CASE(codel_reject_response) {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    sockaddr_in addr = {};
+    http_conn conn;
+    conn.init(fds[0], addr);
+    const char request[] = "GET /index.html HTTP/1.1\r\nHost: check\r\n\r\n";
+    CHECK(write(fds[1], request, sizeof(request) - 1) == (ssize_t)sizeof(request) - 1);
+    CHECK(conn.read());
+    conn.reject();
+
+    std::string response;
+    char buf[1024];
+    ssize_t n;
+    while((n = ::read(fds[1], buf, sizeof(buf))) > 0) {
+        response.append(buf, n);
+    }
+    CHECK(n == 0);      /* 读到EOF：连接已关闭 */
+    CHECK(response.compare(0, 34, "HTTP/1.1 503 Service Unavailable\r\n") == 0);
+    CHECK(response.find("\r\nRetry-After: 1\r\n") != std::string::npos);
+    CHECK(response.find("\r\nContent-Length: 0\r\n") != std::string::npos);
+    CHECK(response.find("\r\nConnection: close\r\n\r\n") == response.size() - 23);
+    close(fds[1]);
+}
+
+/* 大小级别：实际大小不小于请求的大小且按64字节对齐，超过max_chunk时返回nullptr */
+CHECK_CASE(slab_classes) {
+    const size_t max_chunk = 64 * 1024;
+    slab_pool pool(slab_pool::SLAB_SIZE, max_chunk);
+    size_t chunk = 0;
+    for(size_t n = 1; n <= max_chunk; n += 97) {
+        void* p = pool.alloc(n, &chunk);
+        CHECK(p && chunk >= n && chunk % 64 == 0 && chunk <= max_chunk + 63);
+        pool.free(p);
+    }
+    CHECK(pool.alloc(max_chunk + 64, &chunk) == nullptr);
+}
+
+/* 分配到容量用完时返回nullptr，分配出的块互不重叠；全部释放后slab归还给全局，
+ * 可以被另一个大小级别使用
+ */
+CHECK_CASE(slab_capacity) {
+    const size_t big = 64 * 1024, small = 1024;
+    slab_pool pool(slab_pool::SLAB_SIZE, big);
+    auto fill = [&](size_t n, std::vector<std::pair<char*, size_t>>& chunks) {
+        size_t chunk;
+        while(char* p = (char*)pool.alloc(n, &chunk)) {
+            memset(p, 0x5a, n);
+            chunks.emplace_back(p, chunk);
+        }
+    };
+    std::vector<std::pair<char*, size_t>> chunks;
+    fill(big, chunks);
+    CHECK(chunks.size() >= slab_pool::SLAB_SIZE / big);
+    std::sort(chunks.begin(), chunks.end());
+    bool overlap = false;
+    for(size_t i = 1; i < chunks.size(); ++i) {
+        overlap |= chunks[i - 1].first + chunks[i - 1].second > chunks[i].first;
+    }
+    CHECK(! overlap);
+    size_t slabs = chunks.size() / (slab_pool::SLAB_SIZE / chunks[0].second);
+    for(auto& c : chunks) {
+        pool.free(c.first);
+    }
+
+    /* 所有slab都已归还，另一个大小级别可以用满同样多的slab */
+    std::vector<std::pair<char*, size_t>> small_chunks;
+    fill(small, small_chunks);
+    CHECK(! small_chunks.empty() && small_chunks.size() == slabs * (slab_pool::SLAB_SIZE / small_chunks[0].second));
+    for(auto& c : small_chunks) {
+        pool.free(c.first);
+    }
+}
+
+/* 写入一个size字节的文件 */
+static void write_file(const std::string& path, size_t size) {
+    std::string data(size, 'c');
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0 && write(fd, data.data(), size) == (ssize_t)size);
+    close(fd);
+}
+
+/* W-TinyLFU：只访问一次的文件的扫描不会挤掉经常访问的文件（纯LRU下会被全部淘汰）；
+ * 所有文件都落在同一个分片中。目录名固定，路径的哈希及Count-Min Sketch的冲突每次相同
+ */
+CHECK_CASE(cache_scan_resistance) {
+    const std::string dir = "/tmp/webserver_check_cache";
+    const size_t shard_size = 1024 * 1024, file_size = 16 * 1024;
+    remove_tree(dir);
+    mkdir(dir.c_str(), 0755);
+    file_cache cache(file_cache::SHARD_COUNT * shard_size, file_size);
+    auto same_shard = [&](const char* prefix, int count) {
+        std::vector<std::string> paths;
+        for(int i = 0; (int)paths.size() < count; ++i) {
+            std::string path = dir + "/" + prefix + std::to_string(i);
+            if(std::hash<std::string>()(path) % file_cache::SHARD_COUNT == 0) {
+                paths.push_back(path);
+            }
+        }
+        return paths;
+    };
+    auto access = [&](const std::string& path) {
+        cache_entry_ptr entry;
+        if(cache.get(path.c_str(), entry)) {
+            return true;
+        }
+        struct stat st;
+        if(stat(path.c_str(), &st) < 0) {
+            write_file(path, file_size);
+            stat(path.c_str(), &st);
+        }
+        cache.load(path.c_str(), st, "text/plain", entry);
+        return false;
+    };
+
+    std::vector<std::string> hot = same_shard("hot", 8), cold = same_shard("cold", 100);
+    for(int round = 0; round < 10; ++round) {
+        for(const std::string& path : hot) {
+            access(path);
+        }
+    }
+    for(const std::string& path : cold) {
+        access(path);
+    }
+    int hits = 0;
+    for(const std::string& path : hot) {
+        hits += access(path);
+    }
+    CHECK(hits == (int)hot.size());
+    cache_stats st = cache.stats();
+    CHECK(st.rejects > 0 && st.bytes <= shard_size);
+
+    /* 主区已被占满时，之前多次未命中的文件（访问频率高于被淘汰者）被接纳，只访问一次的不被接纳 */
+    std::vector<std::string> late = same_shard("late", 2);
+    for(int i = 0; i < 5; ++i) {
+        access(late[0]);
+        cache.invalidate(late[0]);
+    }
+    access(late[0]);
+    access(late[1]);
+    CHECK(access(late[0]));
+    CHECK(! access(late[1]));
+
+    remove_tree(dir);
+}
+
+/* inotify使缓存失效：网站根目录下的文件被改写、被另一个文件替换（rename）或所在目录被移走后，
+ * 命中的缓存项不经stat校验，必须由fs_watch删除，之后读到的是新内容
+ */
+CHECK_CASE(fs_watch_invalidate) {
+    const std::string dir = make_temp_dir();
+    mkdir((dir + "/sub").c_str(), 0755);
+    auto put = [](const std::string& path, const std::string& data) {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        CHECK(fd >= 0 && write(fd, data.data(), data.size()) == (ssize_t)data.size());
+        close(fd);
+    };
+    put(dir + "/a.html", "old a");
+    put(dir + "/sub/b.html", "old b");
+    file_cache cache(file_cache::SHARD_COUNT * 1024 * 1024, 64 * 1024);
+    fs_watch watch(dir, &cache);
+
+    /* 未命中时读取文件并加入缓存，返回读到的内容 */
+    auto fetch = [&](const std::string& path) {
+        cache_entry_ptr entry;
+        struct stat st;
+        if(! cache.get(path.c_str(), entry)
+                && (stat(path.c_str(), &st) < 0 || ! cache.load(path.c_str(), st, "text/html", entry))) {
+            return std::string();
+        }
+        return std::string(entry->data, entry->size);
+    };
+    /* 事件由监视线程异步处理，最多等待5秒 */
+    auto invalidated = [&](const std::string& path) {
+        cache_entry_ptr entry;
+        for(int i = 0; i < 5000; ++i) {
+            if(! cache.get(path.c_str(), entry)) {
+                return true;
+            }
+            entry.reset();
+            usleep(1000);
+        }
+        return false;
+    };
+    cache_entry_ptr entry;
+    CHECK(fetch(dir + "/a.html") == "old a");
+    CHECK(cache.get((dir + "/a.html").c_str(), entry) && entry->watched);
+    entry.reset();
+
+    /* 原地改写，大小不变 */
+    put(dir + "/a.html", "new a");
+    CHECK(invalidated(dir + "/a.html"));
+    CHECK(fetch(dir + "/a.html") == "new a");
+
+    /* 写入临时文件后rename替换 */
+    put(dir + "/a.tmp", "renamed a");
+    CHECK(rename((dir + "/a.tmp").c_str(), (dir + "/a.html").c_str()) == 0);
+    CHECK(invalidated(dir + "/a.html"));
+    CHECK(fetch(dir + "/a.html") == "renamed a");
+
+    /* 子目录被移走后其下的缓存项全部失效 */
+    CHECK(fetch(dir + "/sub/b.html") == "old b");
+    CHECK(rename((dir + "/sub").c_str(), (dir + "/moved").c_str()) == 0);
+    CHECK(invalidated(dir + "/sub/b.html"));
+    CHECK(fetch(dir + "/sub/b.html").empty());
+
+    remove_tree(dir);
+}
+
+/* 归档的往返：webserver_pack打包临时目录，每个路径都能经完美哈希找到且内容按页对齐、与原文件相同；
+ * 不存在的路径找不到；被截断、魔数错误或不完整的归档在打开时被拒绝
+ */
+CHECK_CASE(bundle_round_trip) {
+    const std::string root = make_temp_dir();
+    mkdir((root + "/site").c_str(), 0755);
+    mkdir((root + "/site/css").c_str(), 0755);
+    std::vector<std::pair<std::string, std::string>> files = {
+        {"/index.html", std::string(3000, 'h')},
+        {"/css/app.css", std::string(10000, 'c')},
+        {"/logo.png", std::string(5000, 'p')},
+        {"/中文文件.txt", "text"},
+        {"/empty.txt", ""},
+    };
+    for(auto& f : files) {
+        int fd = open((root + "/site" + f.first).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        CHECK(fd >= 0 && write(fd, f.second.data(), f.second.size()) == (ssize_t)f.second.size());
+        close(fd);
+    }
+    const std::string archive = root + "/site.bundle";
+    std::string cmd = std::string(WEBSERVER_PACK) + " -o " + archive + " " + root + "/site > /dev/null";
+    CHECK(system(cmd.c_str()) == 0);
+
+    try {
+        bundle b(archive);
+        CHECK(b.size() == files.size() + 1);      /* 另有index.html对应的"/" */
+        files.emplace_back("/", files[0].second);
+        for(auto& f : files) {
+            const bundle_entry* e = b.find(f.first.c_str(), f.first.size());
+            CHECK(e != nullptr);
+            if(! e) {
+                continue;
+            }
+            CHECK(e->identity.body_size == f.second.size());
+            CHECK(e->identity.body_offset % BUNDLE_ALIGN == 0);
+            CHECK(memcmp(b.at(e->identity.body_offset), f.second.data(), f.second.size()) == 0);
+            std::string headers(b.at(e->identity.header_offset), e->identity.header_len);
+            CHECK(headers.find("Content-Length: " + std::to_string(f.second.size()) + "\r\n") != std::string::npos);
+        }
+        CHECK(b.find("/missing.html", 13) == nullptr);
+        CHECK(b.find("/index.htm", 10) == nullptr);
+        CHECK(b.find("/css", 4) == nullptr);
+    }
+    catch(...) {
+        CHECK(! "archive rejected");
+    }
+
+    /* 损坏的归档：截断、魔数错误、比头部还短 */
+    auto rejected = [&](const std::string& path) {
+        try {
+            bundle b(path);
+        }
+        catch(...) {
+            return true;
+        }
+        return false;
+    };
+    std::string data;
+    int fd = open(archive.c_str(), O_RDONLY);
+    char buf[65536];
+    ssize_t n;
+    while((n = read(fd, buf, sizeof(buf))) > 0) {
+        data.append(buf, n);
+    }
+    close(fd);
+    auto write_copy = [&](const std::string& content) {
+        const std::string path = root + "/bad.bundle";
+        int out = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        CHECK(out >= 0 && write(out, content.data(), content.size()) == (ssize_t)content.size());
+        close(out);
+        return path;
+    };
+    CHECK(rejected(write_copy(data.substr(0, data.size() - 1))));
+    std::string bad_magic = data;
+    bad_magic[0] ^= 1;
+    CHECK(rejected(write_copy(bad_magic)));
+    CHECK(rejected(write_copy(data.substr(0, sizeof(bundle_header) - 1))));
+    CHECK(rejected(root + "/none.bundle"));
+    remove_tree(root);
+}
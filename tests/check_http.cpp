@@ -0,0 +1,623 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-20 09:12:40
+ * @ Modified Time: 2026-10-20 09:12:40
+ * @ Description  : 正确性测试：请求路径的内存分配、分块应答、HPACK、消息体边界、路由
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "check.h"
+#include "alloc_count.h"
+#include "bench_conn.h"
+#include "corpus.h"
+#include "dir_index.h"
+#include "hpack.h"
+#include "proxy.h"
+#include "router.h"
+#include "config.h"
+#include "log.h"
+
+using std::string;
+
+/* 用例使用的临时网站根目录，用例结束时删除 */
+struct doc_root_scope{
+    const string path;
+    doc_root_scope() : path(bench_doc_root()) {}
+    ~doc_root_scope() { remove_bench_doc_root(); }
+};
+
+/* 长连接上一个完整请求（解析、do_request、填充应答、记录日志）热身之后不申请内存 */
+CHECK_CASE(request_allocs) {
+    doc_root_scope doc_root;
+    for(const corpus_entry& entry : request_corpus) {
+        bench_conn conn;
+        auto one_request = [&]() {
+            conn.next_request(entry.data);
+            conn.process_write(conn.process_read());
+        };
+        /* 热身：arena、日志缓冲区、线程私有变量等在这里完成首次分配 */
+        for(int i = 0; i < 16; ++i) {
+            one_request();
+        }
+        log_->save();
+        uint64_t before = alloc_count();
+        for(int i = 0; i < 256; ++i) {
+            one_request();
+        }
+        CHECK(alloc_count() == before);
+        log_->save();
+    }
+}
+
+/* 每次返回同一块数据，共count次 */
+class repeat_producer : public body_producer{
+public:
+    repeat_producer(const char* data, size_t len, int count) : m_data(data), m_len(len), m_left(count) {}
+    STATUS next(const char** data, size_t* len) override {
+        if(m_left == 0) {
+            return PRODUCE_END;
+        }
+        --m_left;
+        *data = m_data;
+        *len = m_len;
+        return PRODUCE_DATA;
+    }
+
+private:
+    const char* m_data;
+    size_t m_len;
+    int m_left;
+};
+
+/* 解析chunked编码的消息体，返回数据部分，格式错误时返回false */
+static bool dechunk(const string& body, string& data) {
+    size_t pos = 0;
+    data.clear();
+    while(true) {
+        size_t eol = body.find("\r\n", pos);
+        if(eol == string::npos) {
+            return false;
+        }
+        char* end;
+        long len = strtol(body.c_str() + pos, &end, 16);
+        if(end != body.c_str() + eol || len < 0) {
+            return false;
+        }
+        pos = eol + 2;
+        if(len == 0) {
+            return body.compare(pos, string::npos, "\r\n") == 0;
+        }
+        if(pos + len + 2 > body.size() || body.compare(pos + len, 2, "\r\n") != 0) {
+            return false;
+        }
+        data.append(body, pos, len);
+        pos += len + 2;
+    }
+}
+
+/* 处理request，经socketpair发送并读出完整的应答；producer不为空时以它生成的消息体应答 */
+static bool stream_response(const char* request, body_producer* producer, string& out) {
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        delete producer;
+        return false;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    bench_conn conn;
+    conn.load(request);
+    http_conn::HTTP_CODE ret = conn.process_read();
+    bool ok = producer ? conn.start_stream(fds[0], producer) : conn.start_response(fds[0], ret);
+    char buf[64 * 1024];
+    while(ok) {
+        http_conn::WRITE_STATUS status = conn.send_response();
+        ssize_t n;
+        while((n = recv(fds[1], buf, sizeof(buf), 0)) > 0) {
+            out.append(buf, n);
+        }
+        if(status != http_conn::WRITE_AGAIN) {
+            ok = (status == http_conn::WRITE_DONE);
+            break;
+        }
+    }
+    conn.unmap();
+    close(fds[0]);
+    close(fds[1]);
+    return ok;
+}
+
+/* 1MB的消息体按不同大小分块发送，HTTP/1.1按chunked编码，HTTP/1.0直接发送 */
+CHECK_CASE(chunked_response) {
+    doc_root_scope doc_root;
+    const size_t total = 1 << 20;
+    for(size_t chunk : {256, 4096, 64 * 1024}) {
+        string payload(chunk, 'x');
+        string out, data;
+        CHECK(stream_response("GET /stream HTTP/1.1\r\nHost: check\r\n\r\n",
+            new repeat_producer(payload.data(), chunk, total / chunk), out));
+        size_t header_end = out.find("\r\n\r\n");
+        CHECK(header_end != string::npos && out.find("Transfer-Encoding: chunked\r\n") < header_end);
+        CHECK(header_end != string::npos && dechunk(out.substr(header_end + 4), data));
+        CHECK(data.size() == total && data.find_first_not_of('x') == string::npos);
+    }
+    string out;
+    CHECK(stream_response("GET /stream HTTP/1.0\r\n\r\n", new repeat_producer("abc", 3, 4), out));
+    size_t header_end = out.find("\r\n\r\n");
+    CHECK(header_end != string::npos && out.find("Transfer-Encoding") > header_end);
+    CHECK(header_end != string::npos && out.substr(header_end + 4) == "abcabcabcabc");
+}
+
+/* RFC 7541 C.4中连续的两个请求（Huffman编码，第二个引用第一个加入动态表的字段），
+ * 以及一组典型应答头部的编码再解码
+ */
+CHECK_CASE(hpack_round_trip) {
+    static const uint8_t first[] = {0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a,
+        0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff};
+    static const uint8_t second[] = {0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf};
+    static const char* const response[][2] = {
+        {"server", "WangYusong's Server / v0.5.0(Linux)"},
+        {"content-length", "3"},
+        {"last-modified", "Mon, 19 Oct 2026 12:58:03 GMT"},
+        {"content-type", "text/html; charset=utf-8"},
+        {"x-custom", "value"},
+    };
+    string block;
+    hpack_encode_status(block, 200);
+    for(auto& h : response) {
+        hpack_encode_header(block, h[0], strlen(h[0]), h[1], strlen(h[1]));
+    }
+
+    hpack_decoder decoder;
+    std::vector<hpack_header> headers;
+    CHECK(decoder.decode(first, sizeof(first), headers));
+    CHECK(decoder.decode(second, sizeof(second), headers));
+    CHECK(decoder.decode(reinterpret_cast<const uint8_t*>(block.data()), block.size(), headers));
+    CHECK(headers.size() == 4 + 5 + 6);
+    if(headers.size() != 4 + 5 + 6) {
+        return;
+    }
+    CHECK(headers[3].value == "www.example.com");
+    CHECK(headers[7].value == "www.example.com");
+    CHECK(headers[8].name == "cache-control" && headers[8].value == "no-cache");
+    CHECK(headers[9].name == ":status" && headers[9].value == "200");
+    for(size_t i = 0; i < sizeof(response) / sizeof(response[0]); ++i) {
+        CHECK(headers[10 + i].name == response[i][0] && headers[10 + i].value == response[i][1]);
+    }
+}
+
+/* 代理转发chunked消息体时的边界解析：分块（带扩展）、trailer按7字节切分逐段解析，
+ * 在任意位置分割时都能准确找到结尾，之后的流水线请求不被消耗
+ */
+CHECK_CASE(chunk_framing) {
+    for(size_t chunk : {256, 4096}) {
+        string body;
+        char size_line[32];
+        for(int i = 0; i < 16; ++i) {
+            snprintf(size_line, sizeof(size_line), "%zx%s\r\n", chunk, (i == 3) ? ";ext=1" : "");
+            body.append(size_line).append(chunk, 'x').append("\r\n");
+        }
+        body.append("0\r\nX-Trailer: 1\r\n\r\n");
+        string input = body + "GET / HTTP/1.1\r\n";
+
+        body_framing framing;
+        framing.chunked();
+        size_t used = 0;
+        for(size_t pos = 0; pos < input.size() && ! framing.done() && ! framing.bad(); pos += 7) {
+            used += framing.consume(input.data() + pos, std::min<size_t>(7, input.size() - pos));
+        }
+        CHECK(framing.done());
+        CHECK(used == body.size());
+    }
+}
+
+/* 同时带有Transfer-Encoding: chunked与Content-Length的请求，转发到上游时去掉Content-Length，
+ * 消息体按chunked完整转发
+ */
+CHECK_CASE(proxy_chunked_length) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in upstream_addr = {};
+    upstream_addr.sin_family = AF_INET;
+    upstream_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(upstream_addr);
+    CHECK(bind(listener, (sockaddr*)&upstream_addr, addr_len) == 0 && listen(listener, 8) == 0);
+    getsockname(listener, (sockaddr*)&upstream_addr, &addr_len);
+    proxy p({"/app=127.0.0.1:" + std::to_string(ntohs(upstream_addr.sin_port))}, 4, "");
+    router r;
+    CHECK(p.install(r));
+    proxy_ = &p;
+    router_ = &r;
+
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    sockaddr_in client = {};
+    http_conn* conn = new http_conn;
+    conn->init(fds[0], client);
+    const char body[] = "5\r\nhello\r\n0\r\n\r\n";
+    string request = string("POST /app/x HTTP/1.1\r\nHost: check\r\nContent-Length: 4\r\n"
+        "Transfer-Encoding: chunked\r\n\r\n") + body;
+    CHECK(write(fds[1], request.data(), request.size()) == (ssize_t)request.size());
+    CHECK(conn->read());
+    conn->process();
+
+    /* 健康检查的连接只建立后关闭，读到请求的才是转发的连接 */
+    string forwarded;
+    for(int tries = 0; tries < 4 && forwarded.find(body) == string::npos; ++tries) {
+        int up = accept(listener, nullptr, nullptr);
+        conn->write();
+        forwarded.clear();
+        pollfd pfd = {up, POLLIN, 0};
+        char buf[4096];
+        ssize_t n = 1;
+        while(forwarded.find(body) == string::npos && poll(&pfd, 1, 2000) > 0
+                && (n = ::read(up, buf, sizeof(buf))) > 0) {
+            forwarded.append(buf, n);
+        }
+        close(up);
+    }
+    size_t head_end = forwarded.find("\r\n\r\n");
+    CHECK(head_end != string::npos && forwarded.compare(head_end + 4, string::npos, body) == 0);
+    string head = forwarded.substr(0, head_end + 2);
+    CHECK(head.find("\r\nTransfer-Encoding: chunked\r\n") != string::npos);
+    CHECK(head.find("Content-Length") == string::npos);
+
+    conn->close_conn();
+    delete conn;
+    close(fds[1]);
+    close(listener);
+    router_ = nullptr;
+    proxy_ = nullptr;
+}
+
+class check_handler : public route_handler{
+public:
+    http_conn::HTTP_CODE handle(http_conn& conn) override { return http_conn::NO_RESOURCE; }
+};
+
+/* count条PREFIX路由及同样数量的EXACT路由：最长匹配、按段匹配、405的allowed，查找时不申请内存 */
+CHECK_CASE(router_match) {
+    for(int count : {16, 4096}) {
+        router r;
+        std::vector<route_handler*> handlers;
+        for(int i = 0; i < count; ++i) {
+            string path = "/api/v1/svc" + std::to_string(i);
+            handlers.push_back(new check_handler);
+            CHECK(r.add(path + "/items", router::PREFIX, router::ALL_METHODS, handlers.back()));
+            handlers.push_back(new check_handler);
+            CHECK(r.add(path + "/status", router::EXACT, router::method_bit(http_conn::GET), handlers.back()));
+        }
+        string hit = "/api/v1/svc" + std::to_string(count / 2) + "/items/1234/detail";
+        string exact = "/api/v1/svc" + std::to_string(count - 1) + "/status";
+        string partial = hit.substr(0, hit.find("/items")) + "/itemsx";
+        uint32_t allowed = 0;
+        uint64_t before = alloc_count();
+        CHECK(r.match(http_conn::GET, hit.c_str(), allowed) == handlers[count / 2 * 2]);
+        CHECK(r.match(http_conn::GET, exact.c_str(), allowed) == handlers[count * 2 - 1]);
+        CHECK(! r.match(http_conn::POST, exact.c_str(), allowed));
+        CHECK(allowed == router::method_bit(http_conn::GET));
+        CHECK(! r.match(http_conn::GET, partial.c_str(), allowed));
+        CHECK(allowed == 0);
+        CHECK(alloc_count() == before);
+    }
+}
+
+/* 路由按'?'之前的路径匹配：带查询串的--status及代理路径同样命中，转发时保留查询串 */
+CHECK_CASE(route_query) {
+    doc_root_scope doc_root;
+    static proxy_route route;
+    router r;
+    CHECK(r.add("/status", router::EXACT, router::method_bit(http_conn::GET), new status_handler));
+    CHECK(r.add("/app", router::PREFIX, router::ALL_METHODS, new proxy_handler(&route)));
+    router_ = &r;
+    bench_conn conn;
+    conn.load("GET /status?x=1 HTTP/1.1\r\nHost: check\r\n\r\n");
+    CHECK(conn.process_read() == http_conn::CONTENT_REQUEST);
+    conn.load("GET /app?x=1 HTTP/1.1\r\nHost: check\r\n\r\n");
+    CHECK(conn.process_read() == http_conn::PROXY_REQUEST);
+    CHECK(strcmp(conn.url(), "/app") == 0 && strcmp(conn.query(), "x=1") == 0);
+    conn.load("GET /app/a%20b?q=%20 HTTP/1.1\r\nHost: check\r\n\r\n");
+    CHECK(conn.process_read() == http_conn::PROXY_REQUEST);
+    CHECK(strcmp(conn.url(), "/app/a b") == 0 && strcmp(conn.query(), "q=%20") == 0);
+    conn.load("GET /index.html?v=2 HTTP/1.1\r\nHost: check\r\n\r\n");
+    CHECK(conn.process_read() == http_conn::FILE_REQUEST);
+    router_ = nullptr;
+}
+
+/* 带消息体的请求之后紧跟流水线的下一个请求，消息体的结尾不能破坏下一个请求 */
+CHECK_CASE(pipelined_after_body) {
+    doc_root_scope doc_root;
+    bench_conn conn;
+    conn.load("GET /index.html HTTP/1.1\r\nHost: check\r\nContent-Length: 5\r\n\r\nhello"
+        "GET /images/logo.png HTTP/1.1\r\nHost: check\r\n\r\n");
+    CHECK(conn.process_read() == http_conn::FILE_REQUEST);
+    conn.finish_request();
+    CHECK(conn.process_read() == http_conn::FILE_REQUEST);
+    CHECK(conn.url() && strcmp(conn.url(), "/images/logo.png") == 0);
+    conn.unmap();
+}
+
+/* 不读取的chunked消息体（静态文件及处理器的请求）中夹带的请求不能被当作流水线的下一个请求处理，
+ * 应答后关闭连接；同时带有Content-Length时以chunked为准
+ */
+CHECK_CASE(chunked_body_not_pipelined) {
+    doc_root_scope doc_root;
+    const char* smuggled = "GET /images/logo.png HTTP/1.1\r\nHost: check\r\n\r\n";
+    string body = "2e\r\n" + string(smuggled) + "\r\n0\r\n\r\n";
+    bench_conn conn;
+    conn.load(("GET /index.html HTTP/1.1\r\nHost: check\r\nTransfer-Encoding: chunked\r\n\r\n" + body).c_str());
+    CHECK(conn.process_read() == http_conn::FILE_REQUEST);
+    CHECK(! conn.linger());
+    conn.unmap();
+    conn.load(("GET /index.html HTTP/1.1\r\nHost: check\r\nContent-Length: 4\r\n"
+        "Transfer-Encoding: chunked\r\n\r\n" + body).c_str());
+    CHECK(conn.process_read() == http_conn::FILE_REQUEST);
+    CHECK(! conn.linger());
+    conn.unmap();
+
+    router r;
+    CHECK(r.add("/status", router::EXACT, router::method_bit(http_conn::GET), new status_handler));
+    router_ = &r;
+    conn.load(("GET /status HTTP/1.1\r\nHost: check\r\nTransfer-Encoding: chunked\r\n\r\n" + body).c_str());
+    CHECK(conn.process_read() == http_conn::CONTENT_REQUEST);
+    CHECK(! conn.linger());
+    router_ = nullptr;
+}
+
+/* 持久连接：HTTP/1.1默认保持，HTTP/1.0需要Connection: keep-alive；Keep-Alive的max依次递减，
+ * 达到--keepalive-requests的最后一个应答带Connection: close
+ */
+CHECK_CASE(keep_alive) {
+    doc_root_scope doc_root;
+    int saved_requests = config_->keepalive_requests, saved_timeout = config_->keepalive_timeout;
+    config_->keepalive_requests = 3;
+    config_->keepalive_timeout = 15;
+    bench_conn conn;
+    auto connection = [&]() {
+        http_conn::HTTP_CODE ret = conn.process_read();
+        CHECK(ret == http_conn::FILE_REQUEST);
+        conn.reset_write();
+        conn.process_write(ret);
+        string r = conn.response();
+        size_t begin = r.find("Connection: ");
+        size_t end = r.find("\r\nContent-Type", begin);
+        conn.unmap();
+        return (begin == string::npos || end == string::npos) ? string() : r.substr(begin, end - begin);
+    };
+
+    /* 同一连接上以流水线发送的三个请求 */
+    const char* get = "GET /index.html HTTP/1.1\r\nHost: check\r\n\r\n";
+    conn.load((string(get) + get + get).c_str());
+    CHECK(connection() == "Connection: keep-alive\r\nKeep-Alive: timeout=15, max=2");
+    conn.finish_request();
+    CHECK(connection() == "Connection: keep-alive\r\nKeep-Alive: timeout=15, max=1");
+    conn.finish_request();
+    CHECK(connection() == "Connection: close");
+
+    conn.load("GET /index.html HTTP/1.0\r\n\r\n");
+    CHECK(connection() == "Connection: close");
+    conn.load("GET /index.html HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    CHECK(connection() == "Connection: keep-alive\r\nKeep-Alive: timeout=15, max=2");
+    conn.load("GET /index.html HTTP/1.1\r\nHost: check\r\nConnection: close\r\n\r\n");
+    CHECK(connection() == "Connection: close");
+
+    /* 不限请求数时没有max；不保持连接时总是关闭 */
+    config_->keepalive_requests = 0;
+    conn.load(get);
+    CHECK(connection() == "Connection: keep-alive\r\nKeep-Alive: timeout=15");
+    config_->keepalive_timeout = 0;
+    conn.load(get);
+    CHECK(connection() == "Connection: close");
+
+    config_->keepalive_requests = saved_requests;
+    config_->keepalive_timeout = saved_timeout;
+}
+
+/* 文件内容，不存在时为空 */
+static string read_file(const string& path) {
+    string data;
+    int fd = open(path.c_str(), O_RDONLY);
+    char buf[4096];
+    ssize_t n;
+    while(fd >= 0 && (n = ::read(fd, buf, sizeof(buf))) > 0) {
+        data.append(buf, n);
+    }
+    if(fd >= 0) {
+        close(fd);
+    }
+    return data;
+}
+
+/* 目录中上传用的临时文件（以'.'开头）的个数 */
+static int temp_files(const string& dir) {
+    int count = 0;
+    DIR* d = opendir(dir.c_str());
+    while(struct dirent* e = d ? readdir(d) : nullptr) {
+        count += e->d_name[0] == '.' && strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0;
+    }
+    if(d) {
+        closedir(d);
+    }
+    return count;
+}
+
+/* PUT/POST上传：消息体的开头在读缓冲中，其余经socket读取（splice或读缓冲中转），
+ * 分块编码、超过--upload-max的413、新建返回201、替换返回204，中途断开时不留下临时文件
+ */
+CHECK_CASE(upload) {
+    doc_root_scope doc_root;
+    const string& root = doc_root.path;
+    long saved_max = config_->upload_max;
+    config_->upload_max = 1;
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    bench_conn conn;
+    conn.attach(fds[0]);
+    auto status = [&](http_conn::HTTP_CODE ret) {
+        conn.reset_write();
+        conn.process_write(ret);
+        return conn.response().substr(0, 13);
+    };
+
+    /* Content-Length：读缓冲中的5字节加上之后分多次到达的消息体 */
+    string body(200000, 'x');
+    for(size_t i = 0; i < body.size(); ++i) {
+        body[i] = 'a' + i % 26;
+    }
+    string head = "PUT /up.txt HTTP/1.1\r\nHost: check\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+    conn.next_request((head + body.substr(0, 5)).c_str());
+    http_conn::HTTP_CODE ret = conn.process_read();
+    for(size_t sent = 5; ret == http_conn::NO_REQUEST && sent < body.size(); ) {
+        ssize_t n = send(fds[1], body.data() + sent, std::min(body.size() - sent, (size_t)30000), 0);
+        sent += (n > 0) ? n : 0;
+        ret = conn.process_read();
+    }
+    CHECK(ret == http_conn::CREATED && status(ret) == "HTTP/1.1 201 ");
+    CHECK(read_file(root + "/up.txt") == body);
+
+    /* 分块编码，替换已有的文件 */
+    conn.next_request("POST /up.txt HTTP/1.1\r\nHost: check\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhel");
+    const char* rest = "lo\r\n6;ext=1\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n";
+    CHECK(send(fds[1], rest, strlen(rest), 0) == (ssize_t)strlen(rest));
+    ret = conn.process_read();
+    CHECK(ret == http_conn::CREATED && status(ret) == "HTTP/1.1 204 ");
+    CHECK(read_file(root + "/up.txt") == "hello world");
+
+    /* 超过1MB：Content-Length在创建文件之前拒绝，分块编码在大小行上拒绝 */
+    conn.next_request("PUT /big.txt HTTP/1.1\r\nHost: check\r\nContent-Length: 1048577\r\n\r\n");
+    CHECK(conn.process_read() == http_conn::PAYLOAD_TOO_LARGE);
+    conn.next_request("PUT /big.txt HTTP/1.1\r\nHost: check\r\nTransfer-Encoding: chunked\r\n\r\n100001\r\n");
+    ret = conn.process_read();
+    CHECK(ret == http_conn::PAYLOAD_TOO_LARGE && status(ret) == "HTTP/1.1 413 ");
+    conn.close_upload();
+    CHECK(access((root + "/big.txt").c_str(), F_OK) != 0);
+    CHECK(temp_files(root) == 0);
+
+    /* 消息体未收完时客户端断开：关闭连接时删除临时文件，目标文件不变 */
+    conn.next_request("PUT /up.txt HTTP/1.1\r\nHost: check\r\nContent-Length: 100\r\n\r\npartial");
+    CHECK(conn.process_read() == http_conn::NO_REQUEST);
+    CHECK(temp_files(root) == 1);
+    close(fds[1]);
+    CHECK(conn.process_read() == http_conn::CLOSED_CONNECTION);
+    conn.close_conn();
+    CHECK(temp_files(root) == 0);
+    CHECK(read_file(root + "/up.txt") == "hello world");
+
+    unlink((root + "/up.txt").c_str());
+    config_->upload_max = saved_max;
+}
+
+/* 没有路由时HEAD按文件处理，只发送头部；其他方法返回405，Allow列出实际接受的方法 */
+CHECK_CASE(methods) {
+    doc_root_scope doc_root;
+    bench_conn conn;
+    auto request = [&](const char* text, http_conn::HTTP_CODE expect) {
+        conn.next_request(text);
+        http_conn::HTTP_CODE ret = conn.process_read();
+        CHECK(ret == expect);
+        conn.reset_write();
+        CHECK(conn.process_write(ret));
+        return conn.response();
+    };
+    string r = request("HEAD /index.html HTTP/1.1\r\nHost: check\r\n\r\n", http_conn::FILE_REQUEST);
+    CHECK(r.find("HTTP/1.1 200 ") == 0 && r.find("Content-Length: 1024\r\n") != string::npos);
+    CHECK(conn.body_size() == 0 && r.compare(r.size() - 4, 4, "\r\n\r\n") == 0);
+    r = request("HEAD /missing.html HTTP/1.1\r\nHost: check\r\n\r\n", http_conn::NO_RESOURCE);
+    CHECK(r.find("HTTP/1.1 404 ") == 0 && r.compare(r.size() - 4, 4, "\r\n\r\n") == 0);
+    r = request("DELETE /index.html HTTP/1.1\r\nHost: check\r\n\r\n", http_conn::METHOD_NOT_ALLOWED);
+    CHECK(r.find("HTTP/1.1 405 ") == 0 && r.find("Allow: GET, HEAD\r\n") != string::npos);
+    CHECK(r.find("Uploads") == string::npos);
+    config_->upload_max = 1;
+    r = request("OPTIONS /index.html HTTP/1.1\r\nHost: check\r\n\r\n", http_conn::METHOD_NOT_ALLOWED);
+    CHECK(r.find("Allow: GET, POST, HEAD, PUT\r\n") != string::npos);
+    config_->upload_max = 0;
+    r = request("PUT /index.html HTTP/1.1\r\nHost: check\r\nContent-Length: 0\r\n\r\n", http_conn::METHOD_NOT_ALLOWED);
+    CHECK(r.find("Allow: GET, HEAD\r\n") != string::npos);
+
+    router rt;
+    CHECK(rt.add("/status", router::EXACT, router::method_bit(http_conn::GET) | router::method_bit(http_conn::HEAD),
+        new status_handler));
+    router_ = &rt;
+    r = request("HEAD /status HTTP/1.1\r\nHost: check\r\n\r\n", http_conn::CONTENT_REQUEST);
+    CHECK(r.find("HTTP/1.1 200 ") == 0 && conn.body_size() == 0);
+    r = request("PATCH /status HTTP/1.1\r\nHost: check\r\n\r\n", http_conn::METHOD_NOT_ALLOWED);
+    CHECK(r.find("Allow: GET, HEAD\r\n") != string::npos);
+    r = request("HEAD /images/logo.png HTTP/1.1\r\nHost: check\r\n\r\n", http_conn::FILE_REQUEST);
+    CHECK(r.find("Content-Length: 4096\r\n") != string::npos && conn.body_size() == 0);
+    router_ = nullptr;
+    conn.unmap();
+}
+
+/* 目录项较多的目录列表分块生成，内容与整页生成的相同；目录项少时仍整页生成并缓存 */
+CHECK_CASE(streamed_listing) {
+    doc_root_scope doc_root;
+    const string& root = doc_root.path;
+    const string dir = root + "/many";
+    mkdir(dir.c_str(), 0755);
+    char name[32];
+    for(size_t i = 0; i <= dir_index::STREAM_ENTRIES; ++i) {
+        snprintf(name, sizeof(name), "/f%05zu<&>", i);
+        close(open((dir + name).c_str(), O_WRONLY | O_CREAT, 0644));
+    }
+    mkdir((dir + "/sub").c_str(), 0755);
+    dir_index* saved = dir_index_;
+    dir_index_ = new dir_index(config_->index_files, true);
+
+    string out, body;
+    CHECK(stream_response("GET /many/ HTTP/1.1\r\nHost: check\r\n\r\n", nullptr, out));
+    size_t header_end = out.find("\r\n\r\n");
+    CHECK(header_end != string::npos && out.find("Transfer-Encoding: chunked\r\n") < header_end);
+    CHECK(header_end != string::npos && out.find("Last-Modified: ") < header_end);
+    CHECK(header_end != string::npos && dechunk(out.substr(header_end + 4), body));
+    CHECK(body.find("<title>Index of /many/</title>") != string::npos);
+    CHECK(body.find("<a href=\"f00000%3C%26%3E\">f00000&lt;&amp;&gt;</a>\n") != string::npos);
+    snprintf(name, sizeof(name), "f%05zu%%3C", dir_index::STREAM_ENTRIES);
+    CHECK(body.find(name) != string::npos);
+    CHECK(body.find("<a href=\"sub/\">sub/</a>\n</pre><hr></body></html>\n") != string::npos);
+    CHECK(body.size() > body.rfind("</html>") && body.compare(body.size() - 8, 8, "</html>\n") == 0);
+
+    bench_conn conn;
+    conn.load("HEAD /many/ HTTP/1.1\r\nHost: check\r\n\r\n");
+    CHECK(conn.process_read() == http_conn::STREAM_REQUEST);
+    conn.reset_write();
+    CHECK(conn.process_write(http_conn::STREAM_REQUEST) && conn.body_size() == 0);
+    conn.load("GET /images/ HTTP/1.1\r\nHost: check\r\n\r\n");
+    CHECK(conn.process_read() == http_conn::FILE_REQUEST);
+    conn.unmap();
+    delete dir_index_;
+    dir_index_ = saved;
+}
+
+/* 2GB及以上的文件（稀疏文件，不占磁盘）的Content-Length不被截断；304没有Content-Length */
+CHECK_CASE(large_file_length) {
+    doc_root_scope doc_root;
+    const string path = doc_root.path + "/huge.bin";
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0 && ftruncate(fd, 3L << 30) == 0);
+    close(fd);
+    bench_conn conn;
+    conn.load("GET /huge.bin HTTP/1.1\r\nHost: check\r\n\r\n");
+    CHECK(conn.process_read() == http_conn::FILE_REQUEST);
+    conn.reset_write();
+    CHECK(conn.process_write(http_conn::FILE_REQUEST));
+    CHECK(conn.response().find("Content-Length: 3221225472\r\n") != string::npos);
+    CHECK(conn.body_size() == 3L << 30);
+    conn.unmap();
+
+    conn.reset_write();
+    CHECK(conn.process_write(http_conn::NOT_MODIFIED));
+    CHECK(conn.response().find("Content-Length") == string::npos);
+    unlink(path.c_str());
+}
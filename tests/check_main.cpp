@@ -0,0 +1,71 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-20 09:12:40
+ * @ Modified Time: 2026-10-20 09:12:40
+ * @ Description  : 正确性测试主程序，由ctest执行
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <ftw.h>
+#include <unistd.h>
+#include "check.h"
+
+/* 用例在其他文件的静态对象中注册，注册表必须在第一次使用时构造 */
+static std::vector<std::pair<const char*, check_fn>>& cases() {
+    static std::vector<std::pair<const char*, check_fn>> list;
+    return list;
+}
+
+static int failures = 0;
+
+check_case::check_case(const char* name, check_fn fn) {
+    cases().emplace_back(name, fn);
+}
+
+void check_failed(const char* file, int line, const char* expr) {
+    fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expr);
+    ++failures;
+}
+
+std::string make_temp_dir() {
+    char tmpl[] = "/tmp/webserver_check_XXXXXX";
+    if(! mkdtemp(tmpl)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    return tmpl;
+}
+
+static int remove_entry(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+}
+
+void remove_tree(const std::string& dir) {
+    nftw(dir.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/* usage: ./webserver_check [用例名...]，不指定时执行所有用例 */
+int main(int argc, char* argv[]) {
+    int failed_cases = 0;
+    for(auto& c : cases()) {
+        bool selected = (argc == 1);
+        for(int i = 1; i < argc; ++i) {
+            selected = selected || strcmp(argv[i], c.first) == 0;
+        }
+        if(! selected) {
+            continue;
+        }
+        int before = failures;
+        c.second();
+        bool ok = (failures == before);
+        printf("[%s] %s\n", ok ? "  OK  " : " FAIL ", c.first);
+        failed_cases += ! ok;
+    }
+    printf("%d case(s) failed\n", failed_cases);
+    return failed_cases ? 1 : 0;
+}
@@ -0,0 +1,240 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 14:05:12
+ * @ Modified Time: 2026-10-19 14:05:12
+ * @ Description  : 压测客户端公共部分：计时、延迟直方图、http应答解析
+ */
+
+#ifndef CLIENT_COMMON_H
+#define CLIENT_COMMON_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <strings.h>
+
+/* 单调时钟，单位ns */
+inline uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* 对数-线性分桶的延迟直方图（单位us），相对误差小于1%，
+ * 与HdrHistogram的思路相同，合并与求分位数都只需遍历桶数组
+ */
+class latency_histogram{
+public:
+    static const int SUB_BITS = 7;                      /* 每个2的幂区间再分为64个桶 */
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int BUCKETS = (SUB_COUNT / 2) * 40;
+
+private:
+    std::vector<uint64_t> m_counts;
+    uint64_t m_total;
+    uint64_t m_max;
+    double m_sum;
+
+public:
+    latency_histogram() : m_counts(BUCKETS, 0), m_total(0), m_max(0), m_sum(0) {}
+
+    static int index_of(uint64_t v) {
+        if(v < (uint64_t)SUB_COUNT) {
+            return (int)v;
+        }
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - (SUB_BITS - 1);
+        int idx = (SUB_COUNT / 2) * shift + (int)(v >> shift);
+        return idx < BUCKETS ? idx : BUCKETS - 1;
+    }
+
+    /* 桶的代表值取区间中点 */
+    static uint64_t value_of(int idx) {
+        if(idx < SUB_COUNT) {
+            return idx;
+        }
+        int shift = idx / (SUB_COUNT / 2) - 1;
+        uint64_t low = (uint64_t)(idx - (SUB_COUNT / 2) * shift) << shift;
+        return low + ((1ull << shift) >> 1);
+    }
+
+    void record(uint64_t us, uint64_t count = 1) {
+        m_counts[index_of(us)] += count;
+        m_total += count;
+        m_sum += (double)us * count;
+        if(us > m_max) {
+            m_max = us;
+        }
+    }
+
+    /* 协调遗漏（coordinated omission）修正：闭环压测中一个慢请求会推迟后续请求的发送，
+     * 按期望的请求间隔补记被推迟的那些请求本应观测到的延迟
+     */
+    latency_histogram corrected(uint64_t interval_us) const {
+        latency_histogram out;
+        for(int i = 0; i < BUCKETS; ++i) {
+            if(m_counts[i] == 0) {
+                continue;
+            }
+            uint64_t v = value_of(i);
+            out.record(v, m_counts[i]);
+            if(interval_us == 0) {
+                continue;
+            }
+            for(uint64_t missing = (v > interval_us) ? v - interval_us : 0;
+                    missing >= interval_us; missing -= interval_us) {
+                out.record(missing, m_counts[i]);
+            }
+        }
+        return out;
+    }
+
+    void merge(const latency_histogram& other) {
+        for(int i = 0; i < BUCKETS; ++i) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_total += other.m_total;
+        m_sum += other.m_sum;
+        if(other.m_max > m_max) {
+            m_max = other.m_max;
+        }
+    }
+
+    uint64_t percentile(double p) const {
+        if(m_total == 0) {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(p / 100.0 * m_total + 0.5);
+        if(rank == 0) {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for(int i = 0; i < BUCKETS; ++i) {
+            seen += m_counts[i];
+            if(seen >= rank) {
+                uint64_t v = value_of(i);
+                return v < m_max ? v : m_max;
+            }
+        }
+        return m_max;
+    }
+
+    uint64_t count() const { return m_total; }
+    uint64_t max() const { return m_max; }
+    double mean() const { return m_total ? m_sum / m_total : 0; }
+
+    /* 以JSON对象输出常用分位数 */
+    std::string to_json() const {
+        static const double points[] = {50, 75, 90, 99, 99.9, 99.99};
+        static const char* names[] = {"p50", "p75", "p90", "p99", "p99_9", "p99_99"};
+        char buf[128];
+        std::string out = "{";
+        snprintf(buf, sizeof(buf), "\"count\": %llu, \"mean\": %.1f, \"max\": %llu",
+            (unsigned long long)m_total, mean(), (unsigned long long)m_max);
+        out += buf;
+        for(int i = 0; i < 6; ++i) {
+            snprintf(buf, sizeof(buf), ", \"%s\": %llu", names[i], (unsigned long long)percentile(points[i]));
+            out += buf;
+        }
+        return out + "}";
+    }
+};
+
+/* 增量解析http应答，只关心状态码、Content-Length和Connection字段 */
+class response_parser{
+public:
+    int status;                 /* 状态码 */
+    long content_length;        /* 消息体长度 */
+    bool close;                 /* 服务器是否会在应答后关闭连接 */
+    uint64_t bytes;             /* 本次应答的总字节数 */
+
+private:
+    std::string m_head;         /* 尚未解析完的头部 */
+    bool m_in_body;
+    long m_body_left;
+
+public:
+    response_parser() { reset(); }
+
+    void reset() {
+        status = 0;
+        content_length = 0;
+        close = false;
+        bytes = 0;
+        m_head.clear();
+        m_in_body = false;
+        m_body_left = 0;
+    }
+
+    /* 消费data中属于当前应答的字节，返回消费的字节数；
+     * 应答完整时done置为true，格式错误时返回-1
+     */
+    long parse(const char* data, size_t len, bool& done) {
+        done = false;
+        size_t used = 0;
+        if(! m_in_body) {
+            size_t old = m_head.size();
+            m_head.append(data, len);
+            size_t end = m_head.find("\r\n\r\n");
+            if(end == std::string::npos) {
+                if(m_head.size() > 64 * 1024) {
+                    return -1;
+                }
+                bytes += len;
+                return len;
+            }
+            used = end + 4 - old;
+            bytes += used;
+            m_head.resize(end + 2);
+            if(! parse_head()) {
+                return -1;
+            }
+            m_in_body = true;
+            m_body_left = content_length;
+        }
+        size_t take = len - used;
+        if((long)take > m_body_left) {
+            take = m_body_left;
+        }
+        m_body_left -= take;
+        used += take;
+        bytes += take;
+        if(m_body_left == 0) {
+            done = true;
+        }
+        return used;
+    }
+
+private:
+    bool parse_head() {
+        if(m_head.compare(0, 5, "HTTP/") != 0) {
+            return false;
+        }
+        size_t sp = m_head.find(' ');
+        if(sp == std::string::npos) {
+            return false;
+        }
+        status = atoi(m_head.c_str() + sp + 1);
+        size_t pos = m_head.find("\r\n") + 2;
+        while(pos < m_head.size()) {
+            size_t eol = m_head.find("\r\n", pos);
+            const char* line = m_head.c_str() + pos;
+            if(strncasecmp(line, "Content-Length:", 15) == 0) {
+                content_length = atol(line + 15);
+            }
+            else if(strncasecmp(line, "Connection:", 11) == 0) {
+                const char* v = line + 11;
+                v += strspn(v, " \t");
+                close = (strncasecmp(v, "close", 5) == 0);
+            }
+            pos = eol + 2;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,618 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 14:38:50
+ * @ Modified Time: 2026-10-19 14:38:50
+ * @ Description  : 基于EPOLL的http/1.1压测客户端，支持闭环/开环两种模式
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "client_common.h"
+
+using std::string;
+using std::vector;
+using std::deque;
+
+/* ---------------- 参数 ---------------- */
+struct options{
+    string host = "127.0.0.1";
+    int port = 0;
+    int connections = 16;       /* 并发连接数 */
+    int threads = 1;            /* 压测线程数，每个线程一个epoll */
+    double duration = 10;       /* 压测时长（秒） */
+    double warmup = 1;          /* 预热时长（秒），期间的结果不统计 */
+    double rate = 0;            /* 开环模式下的总请求速率（req/s），0表示闭环 */
+    double keepalive = 1.0;     /* 保持连接的请求比例，其余请求使用Connection: close */
+    int pipeline = 1;           /* 每个连接上同时未完成的请求数 */
+    int timeout_ms = 5000;      /* 请求超时 */
+    double zipf = 1.0;          /* url流行度的Zipf分布参数 */
+    string doc_root;            /* 从该目录生成url列表 */
+    vector<string> urls;        /* 直接指定的url */
+    string json;                /* 结果输出文件 */
+};
+
+static options opt;
+
+/* ---------------- url分布 ---------------- */
+class url_mix{
+private:
+    vector<string> m_urls;
+    vector<double> m_cdf;       /* 累积概率 */
+
+public:
+    void add(const string& url) { m_urls.push_back(url); }
+    size_t size() const { return m_urls.size(); }
+
+    /* 打乱顺序后按Zipf分布分配流行度，使热点与文件大小无关 */
+    void build(double s) {
+        uint64_t seed = 42;
+        for(size_t i = m_urls.size(); i > 1; --i) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            std::swap(m_urls[i - 1], m_urls[(seed >> 33) % i]);
+        }
+        double sum = 0;
+        m_cdf.clear();
+        for(size_t i = 0; i < m_urls.size(); ++i) {
+            sum += 1.0 / pow((double)(i + 1), s);
+            m_cdf.push_back(sum);
+        }
+        for(auto& c : m_cdf) {
+            c /= sum;
+        }
+    }
+
+    const string& pick(double r) const {
+        size_t i = std::lower_bound(m_cdf.begin(), m_cdf.end(), r) - m_cdf.begin();
+        return m_urls[i < m_urls.size() ? i : m_urls.size() - 1];
+    }
+};
+
+static url_mix mix;
+
+static void scan_dir(const string& root, const string& rel) {
+    DIR* dir = opendir((root + rel).c_str());
+    if(! dir) {
+        return;
+    }
+    struct dirent* ent;
+    while((ent = readdir(dir)) != nullptr) {
+        if(ent->d_name[0] == '.') {
+            continue;
+        }
+        string path = rel + "/" + ent->d_name;
+        struct stat st;
+        if(stat((root + path).c_str(), &st) < 0) {
+            continue;
+        }
+        if(S_ISDIR(st.st_mode)) {
+            scan_dir(root, path);
+        }
+        else if(S_ISREG(st.st_mode)) {
+            mix.add(path);
+        }
+    }
+    closedir(dir);
+}
+
+/* 生成测试用网站根目录：大量小文件、部分中等文件、少量大文件 */
+static int generate_doc_root(const string& root, int files) {
+    struct size_class{ const char* dir; const char* ext; int percent; long min; long max; };
+    static const size_class classes[] = {
+        {"small", ".html", 60, 512, 4 * 1024},
+        {"medium", ".png", 30, 8 * 1024, 64 * 1024},
+        {"large", ".pdf", 9, 128 * 1024, 1024 * 1024},
+        {"huge", ".zip", 1, 2 * 1024 * 1024, 8 * 1024 * 1024},
+    };
+    mkdir(root.c_str(), 0755);
+    uint64_t seed = 7;
+    string data(8 * 1024 * 1024, 'x');
+    for(int i = 0; i < (int)(data.size() / 64); ++i) {
+        data[i * 64 + 63] = '\n';
+    }
+    int made = 0;
+    for(const auto& c : classes) {
+        string dir = root + "/" + c.dir;
+        mkdir(dir.c_str(), 0755);
+        int n = std::max(1, files * c.percent / 100);
+        for(int i = 0; i < n; ++i) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            long size = c.min + (long)((seed >> 33) % (c.max - c.min + 1));
+            string path = dir + "/f" + std::to_string(i) + c.ext;
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if(fd < 0 || write(fd, data.data(), size) != size) {
+                perror(path.c_str());
+                return 1;
+            }
+            close(fd);
+            ++made;
+        }
+    }
+    printf("generated %d files under %s\n", made, root.c_str());
+    return 0;
+}
+
+/* ---------------- 连接 ---------------- */
+struct request{
+    uint64_t intended;      /* 计划发送时间（开环模式下用于修正协调遗漏） */
+    uint64_t sent;          /* 实际发送时间 */
+    bool close;             /* 是否为Connection: close请求 */
+};
+
+struct connection{
+    int fd = -1;
+    uint32_t gen = 0;           /* 每次重连加1，用于丢弃旧socket上残留的事件 */
+    bool connected = false;
+    bool closing = false;       /* 已发送close请求，不再发送新请求 */
+    string out;                 /* 待发送的数据 */
+    size_t out_off = 0;
+    deque<request> inflight;    /* 已发送但未收到应答的请求 */
+    response_parser parser;
+};
+
+struct thread_stats{
+    latency_histogram latency;          /* 开环模式：从计划发送时间起算 */
+    latency_histogram service;          /* 从实际发送时间起算 */
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    uint64_t timeouts = 0;
+    uint64_t connects = 0;
+    uint64_t status[6] = {0};           /* 按状态码首位统计 */
+};
+
+class worker{
+private:
+    int m_epollfd;
+    vector<connection> m_conns;
+    sockaddr_in m_addr;
+    uint64_t m_rng;
+    double m_rate;                      /* 本线程的请求速率 */
+    uint64_t m_start, m_measure, m_end;
+    uint64_t m_next_send;               /* 开环模式下一个请求的计划时间 */
+    deque<uint64_t> m_backlog;          /* 开环模式下已到时间但没有空闲连接的请求 */
+    char m_buf[64 * 1024];
+
+public:
+    thread_stats stats;
+
+    worker(int conns, double rate, uint64_t seed) : m_conns(conns), m_rng(seed), m_rate(rate) {
+        m_epollfd = epoll_create1(0);
+        memset(&m_addr, 0, sizeof(m_addr));
+        m_addr.sin_family = AF_INET;
+        m_addr.sin_port = htons(opt.port);
+        inet_pton(AF_INET, opt.host.c_str(), &m_addr.sin_addr);
+    }
+    ~worker() { close(m_epollfd); }
+
+    void run(uint64_t start) {
+        m_start = start;
+        m_measure = start + (uint64_t)(opt.warmup * 1e9);
+        m_end = m_measure + (uint64_t)(opt.duration * 1e9);
+        m_next_send = start;
+        for(size_t i = 0; i < m_conns.size(); ++i) {
+            open_conn(i);
+        }
+        epoll_event events[256];
+        while(true) {
+            uint64_t now = now_ns();
+            if(now >= m_end) {
+                break;
+            }
+            if(m_rate > 0) {
+                schedule(now);
+            }
+            check_timeouts(now);
+            int timeout = 100;
+            if(m_rate > 0) {
+                uint64_t wait = (m_next_send > now) ? (m_next_send - now) / 1000000 : 0;
+                timeout = (int)std::min<uint64_t>(wait, 100);
+            }
+            int n = epoll_wait(m_epollfd, events, 256, timeout);
+            for(int i = 0; i < n; ++i) {
+                size_t idx = events[i].data.u64 & 0xffffffff;
+                uint32_t gen = events[i].data.u64 >> 32;
+                if(m_conns[idx].fd < 0 || m_conns[idx].gen != gen) {
+                    continue;
+                }
+                if((events[i].events & EPOLLOUT) && !(events[i].events & EPOLLERR)) {
+                    on_writable(idx);
+                }
+                /* 出错或对端关闭时也先读完已到达的应答，由recv的结果决定如何处理 */
+                if(m_conns[idx].gen == gen && m_conns[idx].fd >= 0
+                        && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                    on_readable(idx);
+                }
+            }
+        }
+        for(auto& c : m_conns) {
+            if(c.fd >= 0) {
+                close(c.fd);
+            }
+        }
+    }
+
+private:
+    double rand01() {
+        m_rng ^= m_rng << 13;
+        m_rng ^= m_rng >> 7;
+        m_rng ^= m_rng << 17;
+        return (m_rng >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    void open_conn(size_t idx) {
+        connection& c = m_conns[idx];
+        c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        ++c.gen;
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        c.connected = false;
+        c.closing = false;
+        c.out.clear();
+        c.out_off = 0;
+        c.inflight.clear();
+        c.parser.reset();
+        int ret = connect(c.fd, (sockaddr*)&m_addr, sizeof(m_addr));
+        if(ret < 0 && errno != EINPROGRESS) {
+            perror("connect");
+            exit(1);
+        }
+        epoll_event ev;
+        ev.data.u64 = ((uint64_t)c.gen << 32) | idx;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        epoll_ctl(m_epollfd, EPOLL_CTL_ADD, c.fd, &ev);
+        ++stats.connects;
+    }
+
+    void close_conn(size_t idx, bool reopen) {
+        connection& c = m_conns[idx];
+        epoll_ctl(m_epollfd, EPOLL_CTL_DEL, c.fd, nullptr);
+        close(c.fd);
+        c.fd = -1;
+        if(reopen && now_ns() < m_end) {
+            open_conn(idx);
+        }
+    }
+
+    /* 连接异常：未完成的请求计为错误，然后重新建立连接 */
+    void fail(size_t idx, bool timeout) {
+        connection& c = m_conns[idx];
+        if(now_ns() >= m_measure) {
+            (timeout ? stats.timeouts : stats.errors) += c.inflight.size();
+        }
+        close_conn(idx, true);
+    }
+
+    void check_timeouts(uint64_t now) {
+        uint64_t limit = (uint64_t)opt.timeout_ms * 1000000ull;
+        for(size_t i = 0; i < m_conns.size(); ++i) {
+            connection& c = m_conns[i];
+            if(c.fd >= 0 && ! c.inflight.empty() && now > c.inflight.front().sent + limit) {
+                fail(i, true);
+            }
+        }
+    }
+
+    bool can_send(const connection& c) const {
+        return c.connected && ! c.closing && (int)c.inflight.size() < opt.pipeline;
+    }
+
+    void send_request(size_t idx, uint64_t intended) {
+        connection& c = m_conns[idx];
+        const string& url = mix.pick(rand01());
+        bool close_req = rand01() >= opt.keepalive;
+        c.out += "GET " + url + " HTTP/1.1\r\nHost: " + opt.host + ":" + std::to_string(opt.port)
+            + "\r\nUser-Agent: webserver_loadgen\r\nConnection: "
+            + (close_req ? "close" : "keep-alive") + "\r\n\r\n";
+        uint64_t now = now_ns();
+        c.inflight.push_back(request{intended ? intended : now, now, close_req});
+        if(close_req) {
+            c.closing = true;
+        }
+        flush(idx);
+    }
+
+    /* 闭环模式：连接空闲时立即发送下一请求 */
+    void fill(size_t idx) {
+        if(m_rate > 0) {
+            while(! m_backlog.empty() && can_send(m_conns[idx])) {
+                uint64_t t = m_backlog.front();
+                m_backlog.pop_front();
+                send_request(idx, t);
+            }
+            return;
+        }
+        while(m_conns[idx].fd >= 0 && can_send(m_conns[idx])) {
+            send_request(idx, 0);
+        }
+    }
+
+    /* 开环模式：按固定速率产生请求，分配给空闲连接 */
+    void schedule(uint64_t now) {
+        uint64_t interval = (uint64_t)(1e9 / m_rate);
+        while(m_next_send <= now) {
+            m_backlog.push_back(m_next_send);
+            m_next_send += interval;
+        }
+        for(size_t i = 0; i < m_conns.size() && ! m_backlog.empty(); ++i) {
+            fill(i);
+        }
+    }
+
+    void flush(size_t idx) {
+        connection& c = m_conns[idx];
+        while(c.out_off < c.out.size()) {
+            ssize_t n = send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off, MSG_NOSIGNAL);
+            if(n < 0) {
+                if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                    fail(idx, false);
+                }
+                return;
+            }
+            c.out_off += n;
+        }
+        c.out.clear();
+        c.out_off = 0;
+    }
+
+    void on_writable(size_t idx) {
+        connection& c = m_conns[idx];
+        if(! c.connected) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if(err != 0) {
+                fail(idx, false);
+                return;
+            }
+            c.connected = true;
+            fill(idx);
+            return;
+        }
+        flush(idx);
+    }
+
+    void on_readable(size_t idx) {
+        uint32_t gen = m_conns[idx].gen;
+        while(m_conns[idx].gen == gen && m_conns[idx].fd >= 0) {
+            connection& c = m_conns[idx];
+            ssize_t n = recv(c.fd, m_buf, sizeof(m_buf), 0);
+            if(n < 0) {
+                if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                    fail(idx, false);
+                }
+                return;
+            }
+            if(n == 0) {
+                /* 服务器关闭连接：若最后的请求是close请求则属正常 */
+                if(c.inflight.empty()) {
+                    close_conn(idx, true);
+                }
+                else {
+                    fail(idx, false);
+                }
+                return;
+            }
+            size_t off = 0;
+            while(off < (size_t)n) {
+                bool done = false;
+                long used = c.parser.parse(m_buf + off, n - off, done);
+                if(used < 0 || c.inflight.empty()) {
+                    fail(idx, false);
+                    return;
+                }
+                off += used;
+                if(done && ! complete(idx)) {
+                    return;
+                }
+            }
+            fill(idx);
+        }
+    }
+
+    /* 记录一个完整的应答，连接被关闭时返回false */
+    bool complete(size_t idx) {
+        connection& c = m_conns[idx];
+        request r = c.inflight.front();
+        c.inflight.pop_front();
+        uint64_t now = now_ns();
+        if(now >= m_measure && r.intended >= m_measure) {
+            stats.latency.record((now - r.intended) / 1000);
+            stats.service.record((now - r.sent) / 1000);
+            ++stats.requests;
+            stats.bytes += c.parser.bytes;
+            int cls = c.parser.status / 100;
+            ++stats.status[(cls >= 1 && cls <= 5) ? cls : 0];
+        }
+        bool server_close = c.parser.close;
+        c.parser.reset();
+        if(r.close || server_close) {
+            close_conn(idx, true);
+            return false;
+        }
+        return true;
+    }
+};
+
+static void print_usage(const char* prog) {
+    printf("usage: %s [options] -p port\n", prog);
+    printf("       %s --gen DIR [--files N]      generate a doc root of mixed file sizes\n", prog);
+    printf("  -H, --host=ADDR         server address (default: 127.0.0.1)\n");
+    printf("  -p, --port=PORT         server port\n");
+    printf("  -c, --connections=N     concurrent connections (default: 16)\n");
+    printf("  -t, --threads=N         client threads (default: 1)\n");
+    printf("  -d, --duration=SEC      measured duration (default: 10)\n");
+    printf("  -w, --warmup=SEC        warm-up before measuring (default: 1)\n");
+    printf("  -R, --rate=N            open loop at N req/s in total; 0 = closed loop (default)\n");
+    printf("  -k, --keepalive=F       fraction of keep-alive requests, the rest use\n");
+    printf("                          Connection: close (default: 1.0)\n");
+    printf("  -P, --pipeline=N        outstanding requests per connection (default: 1)\n");
+    printf("  -r, --doc-root=DIR      draw urls from the files under DIR\n");
+    printf("  -u, --url=PATH          request PATH (may be repeated)\n");
+    printf("  -z, --zipf=S            zipf exponent of url popularity (default: 1.0)\n");
+    printf("      --timeout=MS        request timeout (default: 5000)\n");
+    printf("      --json=FILE         write the results to FILE as JSON\n");
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option long_options[] = {
+        {"host", required_argument, nullptr, 'H'},
+        {"port", required_argument, nullptr, 'p'},
+        {"connections", required_argument, nullptr, 'c'},
+        {"threads", required_argument, nullptr, 't'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"warmup", required_argument, nullptr, 'w'},
+        {"rate", required_argument, nullptr, 'R'},
+        {"keepalive", required_argument, nullptr, 'k'},
+        {"pipeline", required_argument, nullptr, 'P'},
+        {"doc-root", required_argument, nullptr, 'r'},
+        {"url", required_argument, nullptr, 'u'},
+        {"zipf", required_argument, nullptr, 'z'},
+        {"timeout", required_argument, nullptr, 1},
+        {"json", required_argument, nullptr, 2},
+        {"gen", required_argument, nullptr, 3},
+        {"files", required_argument, nullptr, 4},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    string gen_dir;
+    int gen_files = 200;
+    int o = 0;
+    while((o = getopt_long(argc, argv, "H:p:c:t:d:w:R:k:P:r:u:z:h", long_options, nullptr)) != -1) {
+        switch(o) {
+            case 'H': opt.host = optarg; break;
+            case 'p': opt.port = atoi(optarg); break;
+            case 'c': opt.connections = atoi(optarg); break;
+            case 't': opt.threads = atoi(optarg); break;
+            case 'd': opt.duration = atof(optarg); break;
+            case 'w': opt.warmup = atof(optarg); break;
+            case 'R': opt.rate = atof(optarg); break;
+            case 'k': opt.keepalive = atof(optarg); break;
+            case 'P': opt.pipeline = atoi(optarg); break;
+            case 'r': opt.doc_root = optarg; break;
+            case 'u': opt.urls.push_back(optarg); break;
+            case 'z': opt.zipf = atof(optarg); break;
+            case 1: opt.timeout_ms = atoi(optarg); break;
+            case 2: opt.json = optarg; break;
+            case 3: gen_dir = optarg; break;
+            case 4: gen_files = atoi(optarg); break;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if(! gen_dir.empty()) {
+        return generate_doc_root(gen_dir, gen_files);
+    }
+    if(opt.port <= 0 || opt.connections <= 0 || opt.threads <= 0 || opt.pipeline <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if(! opt.doc_root.empty()) {
+        scan_dir(opt.doc_root, "");
+    }
+    for(const auto& u : opt.urls) {
+        mix.add(u);
+    }
+    if(mix.size() == 0) {
+        mix.add("/");
+    }
+    mix.build(opt.zipf);
+    opt.threads = std::min(opt.threads, opt.connections);
+
+    vector<worker*> workers;
+    for(int i = 0; i < opt.threads; ++i) {
+        int conns = opt.connections / opt.threads + (i < opt.connections % opt.threads ? 1 : 0);
+        workers.push_back(new worker(conns, opt.rate / opt.threads, 0x9e3779b97f4a7c15ull * (i + 1)));
+    }
+    uint64_t start = now_ns();
+    vector<std::thread> threads;
+    for(auto w : workers) {
+        threads.emplace_back([w, start]() { w->run(start); });
+    }
+    for(auto& t : threads) {
+        t.join();
+    }
+
+    thread_stats total;
+    for(auto w : workers) {
+        total.latency.merge(w->stats.latency);
+        total.service.merge(w->stats.service);
+        total.requests += w->stats.requests;
+        total.bytes += w->stats.bytes;
+        total.errors += w->stats.errors;
+        total.timeouts += w->stats.timeouts;
+        total.connects += w->stats.connects;
+        for(int i = 0; i < 6; ++i) {
+            total.status[i] += w->stats.status[i];
+        }
+        delete w;
+    }
+
+    /* 开环模式的延迟从计划发送时间起算，本身已不受协调遗漏影响；
+     * 闭环模式按平均服务时间作为期望请求间隔进行修正
+     */
+    latency_histogram corrected = (opt.rate > 0)
+        ? total.latency : total.service.corrected((uint64_t)total.service.mean());
+    double rps = total.requests / opt.duration;
+    double mbps = total.bytes / opt.duration / (1024.0 * 1024.0);
+
+    printf("%s loop, %d connections, %d threads, pipeline %d, keep-alive %.2f, %zu urls\n",
+        opt.rate > 0 ? "open" : "closed", opt.connections, opt.threads, opt.pipeline, opt.keepalive, mix.size());
+    printf("  requests   %llu in %.1fs, %.1f req/s, %.2f MB/s\n",
+        (unsigned long long)total.requests, opt.duration, rps, mbps);
+    printf("  status     2xx %llu, 3xx %llu, 4xx %llu, 5xx %llu\n",
+        (unsigned long long)total.status[2], (unsigned long long)total.status[3],
+        (unsigned long long)total.status[4], (unsigned long long)total.status[5]);
+    printf("  errors     %llu, timeouts %llu, connects %llu\n",
+        (unsigned long long)total.errors, (unsigned long long)total.timeouts, (unsigned long long)total.connects);
+    printf("  latency(us, corrected)  p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+        (unsigned long long)corrected.percentile(50), (unsigned long long)corrected.percentile(90),
+        (unsigned long long)corrected.percentile(99), (unsigned long long)corrected.percentile(99.9),
+        (unsigned long long)corrected.max());
+    printf("  latency(us, service)    p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+        (unsigned long long)total.service.percentile(50), (unsigned long long)total.service.percentile(90),
+        (unsigned long long)total.service.percentile(99), (unsigned long long)total.service.percentile(99.9),
+        (unsigned long long)total.service.max());
+
+    if(! opt.json.empty()) {
+        FILE* fp = fopen(opt.json.c_str(), "w");
+        if(! fp) {
+            perror(opt.json.c_str());
+            return 1;
+        }
+        fprintf(fp, "{\n  \"mode\": \"%s\",\n  \"connections\": %d,\n  \"threads\": %d,\n"
+            "  \"pipeline\": %d,\n  \"keepalive\": %.3f,\n  \"rate\": %.1f,\n  \"duration\": %.1f,\n"
+            "  \"urls\": %zu,\n  \"requests\": %llu,\n  \"throughput_rps\": %.1f,\n  \"throughput_mbps\": %.3f,\n"
+            "  \"errors\": %llu,\n  \"timeouts\": %llu,\n  \"connects\": %llu,\n"
+            "  \"status\": {\"2xx\": %llu, \"3xx\": %llu, \"4xx\": %llu, \"5xx\": %llu},\n"
+            "  \"latency_us\": %s,\n  \"service_us\": %s\n}\n",
+            opt.rate > 0 ? "open" : "closed", opt.connections, opt.threads, opt.pipeline, opt.keepalive,
+            opt.rate, opt.duration, mix.size(), (unsigned long long)total.requests, rps, mbps,
+            (unsigned long long)total.errors, (unsigned long long)total.timeouts,
+            (unsigned long long)total.connects, (unsigned long long)total.status[2],
+            (unsigned long long)total.status[3], (unsigned long long)total.status[4],
+            (unsigned long long)total.status[5], corrected.to_json().c_str(), total.service.to_json().c_str());
+        fclose(fp);
+    }
+    return (total.requests > 0) ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+#!/bin/bash
+# 端到端压测：在临时网站根目录上以前台方式启动WebServer，
+# 用webserver_loadgen跑几组典型负载，结果以JSON保存到输出目录
+#
+# usage: tools/loadtest.sh <WebServer> <webserver_loadgen> [output dir]
+# 环境变量 DURATION（秒，默认10）、CONNECTIONS（默认32）可调整压测规模
+
+set -e
+
+SERVER=$(realpath "$1")
+LOADGEN=$(realpath "$2")
+OUT=$(realpath -m "${3:-./loadtest}")
+DURATION=${DURATION:-10}
+CONNECTIONS=${CONNECTIONS:-32}
+
+if [ ! -x "$SERVER" ] || [ ! -x "$LOADGEN" ]; then
+    echo "usage: $0 <WebServer> <webserver_loadgen> [output dir]"
+    exit 1
+fi
+
+WORK=$(mktemp -d /tmp/webserver_loadtest_XXXXXX)
+SERVER_PID=
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+    fi
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+"$LOADGEN" --gen "$WORK/www" --files 200
+
+# 随机选择一个空闲端口
+PORT=$(python3 -c 'import socket; s=socket.socket(); s.bind(("127.0.0.1", 0)); print(s.getsockname()[1])')
+
+# 日志文件写在当前目录，因此在临时目录中启动服务器
+(cd "$WORK" && exec "$SERVER" -f -r "$WORK/www" "$PORT") &
+SERVER_PID=$!
+
+for i in $(seq 50); do
+    if (exec 3<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null; then
+        break
+    fi
+    sleep 0.1
+done
+
+mkdir -p "$OUT"
+STAMP=$(date +%Y%m%d-%H%M%S)
+COMMON="-p $PORT -r $WORK/www -d $DURATION -w 1"
+
+run() {
+    local name=$1
+    shift
+    echo "---- $name ----"
+    "$LOADGEN" $COMMON "$@" --json "$OUT/$STAMP-$name.json"
+}
+
+# 长连接闭环：最大吞吐
+run keepalive -c "$CONNECTIONS"
+# 一半请求使用短连接：握手与accept的开销
+run mixed -c "$CONNECTIONS" -k 0.5
+# 开环固定速率：不受协调遗漏影响的延迟分布
+run openloop -c "$CONNECTIONS" -R 2000
+
+kill -0 "$SERVER_PID"
+echo "results written to $OUT/$STAMP-*.json"
@@ -0,0 +1,388 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 21:52:13
+ * @ Modified Time: 2026-10-19 21:52:13
+ * @ Description  : 将网站根目录打包为静态资源归档，供WebServer --bundle使用
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#ifdef WEBSERVER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "../include/bundle.h"
+#include "../include/http_content_type.h"
+
+using std::string;
+using std::vector;
+
+/* 一个待打包的url */
+struct pack_file{
+    string path;            /* url路径 */
+    string file;            /* 磁盘上的文件，目录的别名指向其index.html */
+    struct stat st;
+    uint64_t hash;          /* 文件内容的哈希，用作ETag */
+    string gzip;            /* 压缩后的内容，为空表示不压缩 */
+    bundle_entry entry;
+};
+
+static bool use_gzip = true;
+
+static uint64_t content_hash(const string& data) {
+    return bundle_hash(data.data(), data.size(), 0);
+}
+
+static bool read_file(const string& file, string& data) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if(fd < 0) {
+        perror(file.c_str());
+        return false;
+    }
+    data.clear();
+    char buf[64 * 1024];
+    ssize_t n;
+    while((n = read(fd, buf, sizeof(buf))) > 0) {
+        data.append(buf, n);
+    }
+    close(fd);
+    if(n < 0) {
+        perror(file.c_str());
+        return false;
+    }
+    return true;
+}
+
+/* 递归收集dir下的普通文件，url为相对于根目录的路径；
+ * 含有index.html的目录额外生成一个以'/'结尾的别名
+ */
+static bool walk(const string& root, const string& rel, vector<pack_file>& files) {
+    string dir = root + rel;
+    DIR* d = opendir(dir.c_str());
+    if(! d) {
+        perror(dir.c_str());
+        return false;
+    }
+    vector<string> names;
+    while(struct dirent* e = readdir(d)) {
+        if(strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+            names.push_back(e->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    bool ok = true;
+    for(const string& name : names) {
+        string path = rel + "/" + name;
+        pack_file f;
+        if(stat((root + path).c_str(), &f.st) < 0) {
+            perror((root + path).c_str());
+            continue;
+        }
+        if(S_ISDIR(f.st.st_mode)) {
+            ok = walk(root, path, files) && ok;
+        }
+        else if(S_ISREG(f.st.st_mode) && (f.st.st_mode & S_IROTH)) {
+            /* 与服务器一致，只打包其他用户可读的文件 */
+            f.path = path;
+            f.file = root + path;
+            files.push_back(f);
+            if(name == "index.html") {
+                f.path = rel + "/";
+                files.push_back(f);
+            }
+        }
+    }
+    return ok;
+}
+
+/* 只压缩文本类的内容，图片、压缩包等已经压缩过 */
+static bool compressible(const char* type) {
+    return strncmp(type, "text/", 5) == 0 || strstr(type, "javascript") || strstr(type, "json")
+        || strstr(type, "xml");
+}
+
+static bool gzip_compress(const string& in, string& out) {
+#ifdef WEBSERVER_HAVE_ZLIB
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    /* windowBits加16输出gzip格式 */
+    if(deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&zs, in.size()));
+    zs.next_in = (Bytef*)in.data();
+    zs.avail_in = in.size();
+    zs.next_out = (Bytef*)&out[0];
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+#else
+    (void)in;
+    (void)out;
+    return false;
+#endif
+}
+
+/* 与http_conn::get_file_type()一致，取url中最后一个'.'之后的部分 */
+static const char* content_type(const pack_file& f) {
+    const string& name = (f.path.back() == '/') ? f.file : f.path;
+    size_t dot = name.rfind('.');
+    return get_content_type(dot == string::npos ? "default" : name.c_str() + dot);
+}
+
+static string make_headers(const pack_file& f, uint64_t size, const char* etag, bool gzip) {
+    char buf[512];
+    char date[64];
+    struct tm tm_buf;
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", gmtime_r(&f.st.st_mtime, &tm_buf));
+    int len = snprintf(buf, sizeof(buf),
+        "Content-Length: %llu\r\n"
+        "Content-Type: %s; charset=utf-8\r\n"
+        "ETag: %s\r\n"
+        "Last-Modified: %s\r\n"
+        "%s%s",
+        (unsigned long long)size, content_type(f), etag, date,
+        f.gzip.empty() ? "" : "Vary: Accept-Encoding\r\n",
+        gzip ? "Content-Encoding: gzip\r\n" : "");
+    return string(buf, len);
+}
+
+/* 构造完美哈希：按桶从大到小为每个桶寻找一个位移，使桶内所有路径落到互不相同的空槽位；
+ * 槽位数为路径数的1.25倍，每个桶平均4个路径，通常很快就能找到
+ */
+static bool build_index(const vector<pack_file>& files, vector<uint32_t>& disp, vector<uint32_t>& slots) {
+    uint32_t n = files.size();
+    uint32_t bucket_count = n / 4 + 1;
+    uint32_t slot_count = n + n / 4 + 1;
+    vector<vector<uint32_t>> buckets(bucket_count);
+    for(uint32_t i = 0; i < n; ++i) {
+        const string& p = files[i].path;
+        buckets[bundle_hash(p.data(), p.size(), 0) % bucket_count].push_back(i);
+    }
+    vector<uint32_t> order(bucket_count);
+    for(uint32_t i = 0; i < bucket_count; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    disp.assign(bucket_count, 0);
+    slots.assign(slot_count, BUNDLE_EMPTY);
+    vector<uint32_t> taken;
+    for(uint32_t b : order) {
+        if(buckets[b].empty()) {
+            break;
+        }
+        uint32_t d = 1;
+        for(; d < (1u << 24); ++d) {
+            taken.clear();
+            bool ok = true;
+            for(uint32_t i : buckets[b]) {
+                const string& p = files[i].path;
+                uint32_t s = bundle_hash(p.data(), p.size(), d) % slot_count;
+                if(slots[s] != BUNDLE_EMPTY || std::find(taken.begin(), taken.end(), s) != taken.end()) {
+                    ok = false;
+                    break;
+                }
+                taken.push_back(s);
+            }
+            if(ok) {
+                break;
+            }
+        }
+        if(d == (1u << 24)) {
+            return false;
+        }
+        disp[b] = d;
+        for(size_t k = 0; k < taken.size(); ++k) {
+            slots[taken[k]] = buckets[b][k];
+        }
+    }
+    return true;
+}
+
+static uint64_t align_up(uint64_t v, uint64_t a) {
+    return (v + a - 1) / a * a;
+}
+
+static bool write_at(int fd, const void* data, size_t len, uint64_t offset) {
+    const char* p = (const char*)data;
+    while(len > 0) {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static void print_usage(const char* prog) {
+    printf("usage: %s [options] dir\n", prog);
+    printf("  -o, --output=FILE       archive to write (default: site.bundle)\n");
+    printf("      --no-gzip           do not store precompressed variants\n");
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option long_options[] = {
+        {"output", required_argument, nullptr, 'o'},
+        {"no-gzip", no_argument, nullptr, 1},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    string output = "site.bundle";
+    int o = 0;
+    while((o = getopt_long(argc, argv, "o:h", long_options, nullptr)) != -1) {
+        switch(o) {
+            case 'o': output = optarg; break;
+            case 1: use_gzip = false; break;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if(optind >= argc) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    string root = argv[optind];
+    while(root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+
+    vector<pack_file> files;
+    if(! walk(root, "", files)) {
+        return 1;
+    }
+
+    /* 计算ETag，压缩文本内容 */
+    string data;
+    size_t gzip_count = 0;
+    for(pack_file& f : files) {
+        if(! read_file(f.file, data)) {
+            return 1;
+        }
+        f.st.st_size = data.size();
+        f.hash = content_hash(data);
+        if(use_gzip && data.size() >= 256 && compressible(content_type(f))
+                && gzip_compress(data, f.gzip) && f.gzip.size() * 10 > data.size() * 9) {
+            f.gzip.clear();     /* 压缩后减小不到10%，不值得 */
+        }
+        gzip_count += ! f.gzip.empty();
+    }
+
+    vector<uint32_t> disp, slots;
+    if(! build_index(files, disp, slots)) {
+        fprintf(stderr, "failed to build the path index\n");
+        return 1;
+    }
+
+    /* 布局：头部、位移表、槽位表、entry数组、路径及应答头部，最后是页对齐的文件内容 */
+    bundle_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.entry_count = files.size();
+    header.bucket_count = disp.size();
+    header.slot_count = slots.size();
+    header.disp_offset = align_up(sizeof(header), 8);
+    header.slot_offset = align_up(header.disp_offset + disp.size() * sizeof(uint32_t), 8);
+    header.entry_offset = align_up(header.slot_offset + slots.size() * sizeof(uint32_t), 8);
+
+    string strings;
+    uint64_t strings_offset = header.entry_offset + files.size() * sizeof(bundle_entry);
+    for(pack_file& f : files) {
+        bundle_entry& e = f.entry;
+        memset(&e, 0, sizeof(e));
+        e.path_offset = strings_offset + strings.size();
+        e.path_len = f.path.size();
+        strings += f.path;
+
+        snprintf(e.identity.etag, sizeof(e.identity.etag), "\"%016llx\"", (unsigned long long)f.hash);
+        string h = make_headers(f, f.st.st_size, e.identity.etag, false);
+        e.identity.header_offset = strings_offset + strings.size();
+        e.identity.header_len = h.size();
+        e.identity.body_size = f.st.st_size;
+        strings += h;
+        if(! f.gzip.empty()) {
+            e.flags |= BUNDLE_GZIP;
+            snprintf(e.gzip.etag, sizeof(e.gzip.etag), "\"%016llx-gz\"", (unsigned long long)f.hash);
+            h = make_headers(f, f.gzip.size(), e.gzip.etag, true);
+            e.gzip.header_offset = strings_offset + strings.size();
+            e.gzip.header_len = h.size();
+            e.gzip.body_size = f.gzip.size();
+            strings += h;
+        }
+    }
+
+    /* 目录的别名与其index.html共用文件内容 */
+    uint64_t offset = align_up(strings_offset + strings.size(), BUNDLE_ALIGN);
+    for(size_t i = 0; i < files.size(); ++i) {
+        pack_file& f = files[i];
+        if(i > 0 && files[i - 1].file == f.file) {
+            f.entry.identity.body_offset = files[i - 1].entry.identity.body_offset;
+            f.entry.gzip.body_offset = files[i - 1].entry.gzip.body_offset;
+            continue;
+        }
+        f.entry.identity.body_offset = offset;
+        offset = align_up(offset + f.st.st_size, BUNDLE_ALIGN);
+        if(! f.gzip.empty()) {
+            f.entry.gzip.body_offset = offset;
+            offset = align_up(offset + f.gzip.size(), BUNDLE_ALIGN);
+        }
+    }
+    header.file_size = offset;
+
+    /* 先写入临时文件再rename，正在运行的服务器映射的旧归档不受影响 */
+    string tmp = output + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        perror(tmp.c_str());
+        return 1;
+    }
+    bool ok = ftruncate(fd, header.file_size) == 0
+        && write_at(fd, &header, sizeof(header), 0)
+        && write_at(fd, disp.data(), disp.size() * sizeof(uint32_t), header.disp_offset)
+        && write_at(fd, slots.data(), slots.size() * sizeof(uint32_t), header.slot_offset)
+        && write_at(fd, strings.data(), strings.size(), strings_offset);
+    for(size_t i = 0; ok && i < files.size(); ++i) {
+        pack_file& f = files[i];
+        ok = write_at(fd, &f.entry, sizeof(f.entry), header.entry_offset + i * sizeof(bundle_entry));
+        if(i > 0 && files[i - 1].file == f.file) {
+            continue;
+        }
+        ok = ok && read_file(f.file, data) && (off_t)data.size() == f.st.st_size
+            && write_at(fd, data.data(), data.size(), f.entry.identity.body_offset)
+            && write_at(fd, f.gzip.data(), f.gzip.size(), f.entry.gzip.body_offset);
+    }
+    ok = (fsync(fd) == 0) && ok;
+    close(fd);
+    if(! ok || rename(tmp.c_str(), output.c_str()) < 0) {
+        fprintf(stderr, "failed to write %s: %s\n", output.c_str(), ok ? strerror(errno) : "write error or file changed while packing");
+        unlink(tmp.c_str());
+        return 1;
+    }
+    printf("packed %zu paths (%zu gzip) into %s, %.1f MB\n", files.size(), gzip_count, output.c_str(),
+        header.file_size / 1048576.0);
+    return 0;
+}
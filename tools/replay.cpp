@@ -0,0 +1,556 @@
+/**
+ * @ Author: WangYusong
+ * @ E-Mail: admin@wangyusong.cn
+ * @ Create Time  : 2026-10-19 16:48:03
+ * @ Modified Time: 2026-10-19 16:48:03
+ * @ Description  : 回放WebServer --capture录制的流量，按原始时间间隔（可缩放）重新发送请求
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "client_common.h"
+#include "capture.h"
+
+using std::string;
+using std::vector;
+
+/* 录制数据中的一次recv */
+struct chunk{
+    uint64_t time;          /* 相对录制开始的时间（us） */
+    size_t off;             /* 在连接数据流中的偏移 */
+    size_t len;
+};
+
+/* 录制数据中的一个完整请求 */
+struct replay_request{
+    size_t end;             /* 请求最后一个字节之后在数据流中的偏移 */
+    string line;            /* 请求行，用于输出 */
+    uint64_t sent;          /* 回放时最后一个字节发出的时间（ns） */
+    uint64_t latency;       /* 回放得到的延迟（us） */
+    int status;             /* 应答状态码，0表示没有收到应答 */
+};
+
+struct replay_conn{
+    uint32_t id;
+    uint64_t open_time = UINT64_MAX;
+    uint64_t close_time = UINT64_MAX;
+    string stream;                  /* 该连接上客户端发送的全部数据 */
+    vector<chunk> chunks;
+    vector<replay_request> requests;
+
+    /* 回放状态 */
+    int fd = -1;
+    bool connected = false;
+    bool done = false;
+    size_t next_chunk = 0;
+    size_t sent = 0;                /* 已写入socket的字节数 */
+    size_t stamped = 0;             /* 已记录发送时间的请求数 */
+    size_t answered = 0;            /* 已收到应答的请求数 */
+    response_parser parser;
+};
+
+static vector<replay_conn> conns;
+
+/* 在数据流中划分请求：头部以空行结束，消息体由Content-Length或chunked编码决定 */
+static void split_requests(replay_conn& c) {
+    const string& s = c.stream;
+    size_t pos = 0;
+    while(pos < s.size()) {
+        size_t head_end = s.find("\r\n\r\n", pos);
+        if(head_end == string::npos) {
+            break;
+        }
+        size_t eol = s.find("\r\n", pos);
+        string line = s.substr(pos, eol - pos);
+        long content_length = 0;
+        bool chunked = false;
+        for(size_t p = eol + 2; p < head_end; ) {
+            size_t e = s.find("\r\n", p);
+            const char* h = s.c_str() + p;
+            if(strncasecmp(h, "Content-Length:", 15) == 0) {
+                content_length = atol(h + 15);
+            }
+            else if(strncasecmp(h, "Transfer-Encoding:", 18) == 0) {
+                chunked = (strstr(s.substr(p, e - p).c_str(), "chunked") != nullptr);
+            }
+            p = e + 2;
+        }
+        size_t end = head_end + 4;
+        if(chunked) {
+            /* 逐块跳过，最后一个大小为0的块之后是可选的trailer和空行 */
+            while(true) {
+                size_t e = s.find("\r\n", end);
+                if(e == string::npos) {
+                    return;
+                }
+                long size = strtol(s.c_str() + end, nullptr, 16);
+                end = e + 2;
+                if(size == 0) {
+                    size_t t = s.find("\r\n\r\n", end - 2);
+                    if(t == string::npos) {
+                        return;
+                    }
+                    end = t + 4;
+                    break;
+                }
+                end += size + 2;
+            }
+        }
+        else {
+            end += content_length;
+        }
+        if(end > s.size()) {
+            break;
+        }
+        c.requests.push_back(replay_request{end, line, 0, 0, 0});
+        pos = end;
+    }
+}
+
+static bool load_trace(const char* file) {
+    int fd = open(file, O_RDONLY);
+    if(fd < 0) {
+        perror(file);
+        return false;
+    }
+    string data;
+    char buf[64 * 1024];
+    ssize_t n;
+    while((n = read(fd, buf, sizeof(buf))) > 0) {
+        data.append(buf, n);
+    }
+    close(fd);
+    if(data.size() < sizeof(capture_header) || memcmp(data.data(), CAPTURE_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s: not a capture file\n", file);
+        return false;
+    }
+
+    std::map<uint32_t, size_t> index;
+    size_t pos = sizeof(capture_header);
+    while(pos + sizeof(capture_record) <= data.size()) {
+        capture_record rec;
+        memcpy(&rec, data.data() + pos, sizeof(rec));
+        pos += sizeof(rec);
+        if(pos + rec.len > data.size()) {
+            break;      /* 录制被中断，最后一条记录不完整 */
+        }
+        auto it = index.find(rec.conn_id);
+        if(it == index.end()) {
+            it = index.emplace(rec.conn_id, conns.size()).first;
+            conns.emplace_back();
+            conns.back().id = rec.conn_id;
+        }
+        replay_conn& c = conns[it->second];
+        if(rec.type == capture::OPEN || c.open_time == UINT64_MAX) {
+            c.open_time = std::min(c.open_time, rec.time);
+        }
+        if(rec.type == capture::DATA) {
+            c.chunks.push_back(chunk{rec.time, c.stream.size(), rec.len});
+            c.stream.append(data.data() + pos, rec.len);
+        }
+        else if(rec.type == capture::CLOSE) {
+            c.close_time = rec.time;
+        }
+        pos += rec.len;
+    }
+    for(auto& c : conns) {
+        split_requests(c);
+    }
+    return true;
+}
+
+/* ---------------- 回放 ---------------- */
+static string host = "127.0.0.1";
+static int port = 0;
+static double speed = 1.0;          /* 回放速度倍数，0表示忽略时间间隔尽快发送 */
+static int timeout_ms = 10000;
+static int epollfd = -1;
+static sockaddr_in server_addr;
+static uint64_t replay_start;
+static uint64_t errors = 0;
+
+/* 录制时间（us）对应的回放时间（ns） */
+static uint64_t due(uint64_t t) {
+    return (speed > 0) ? replay_start + (uint64_t)(t * 1000 / speed) : replay_start;
+}
+
+typedef std::pair<uint64_t, size_t> wakeup;
+static std::priority_queue<wakeup, vector<wakeup>, std::greater<wakeup>> timers;
+
+static void finish(size_t idx) {
+    replay_conn& c = conns[idx];
+    if(c.fd >= 0) {
+        epoll_ctl(epollfd, EPOLL_CTL_DEL, c.fd, nullptr);
+        close(c.fd);
+        c.fd = -1;
+    }
+    if(! c.done) {
+        errors += c.requests.size() - c.answered;
+        c.done = true;
+    }
+}
+
+static void flush(size_t idx) {
+    replay_conn& c = conns[idx];
+    size_t limit = (c.next_chunk < c.chunks.size()) ? c.chunks[c.next_chunk].off : c.stream.size();
+    while(c.sent < limit) {
+        ssize_t n = send(c.fd, c.stream.data() + c.sent, limit - c.sent, MSG_NOSIGNAL);
+        if(n < 0) {
+            if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                finish(idx);
+            }
+            return;
+        }
+        c.sent += n;
+    }
+    uint64_t now = now_ns();
+    while(c.stamped < c.requests.size() && c.requests[c.stamped].end <= c.sent) {
+        c.requests[c.stamped++].sent = now;
+    }
+}
+
+/* 推进连接的回放进度：建立连接、发送到期的数据、在结束时关闭连接 */
+static void advance(size_t idx) {
+    replay_conn& c = conns[idx];
+    uint64_t now = now_ns();
+    if(c.done) {
+        return;
+    }
+    if(c.fd < 0) {
+        if(now < due(c.open_time)) {
+            timers.push(wakeup(due(c.open_time), idx));
+            return;
+        }
+        c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if(connect(c.fd, (sockaddr*)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS) {
+            finish(idx);
+            return;
+        }
+        epoll_event ev;
+        ev.data.u64 = idx;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        epoll_ctl(epollfd, EPOLL_CTL_ADD, c.fd, &ev);
+        return;
+    }
+    if(! c.connected) {
+        return;
+    }
+    while(c.next_chunk < c.chunks.size()) {
+        const chunk& ch = c.chunks[c.next_chunk];
+        if(now < due(ch.time)) {
+            timers.push(wakeup(due(ch.time), idx));
+            break;
+        }
+        /* 客户端录制时是收到应答后才发送下一请求的，回放时保持这一依赖关系 */
+        size_t before = 0;
+        while(before < c.requests.size() && c.requests[before].end <= ch.off) {
+            ++before;
+        }
+        if(c.answered < before) {
+            break;
+        }
+        ++c.next_chunk;
+        flush(idx);
+        if(c.fd < 0) {
+            return;
+        }
+    }
+    if(c.next_chunk == c.chunks.size() && c.answered == c.requests.size()) {
+        if(c.close_time == UINT64_MAX || now >= due(c.close_time)) {
+            c.done = true;
+            finish(idx);
+        }
+        else {
+            timers.push(wakeup(due(c.close_time), idx));
+        }
+    }
+}
+
+static void on_event(size_t idx, uint32_t events) {
+    replay_conn& c = conns[idx];
+    if(c.fd < 0) {
+        return;
+    }
+    if(! c.connected && (events & (EPOLLOUT | EPOLLERR))) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if(err != 0) {
+            finish(idx);
+            return;
+        }
+        c.connected = true;
+    }
+    if(events & EPOLLOUT) {
+        flush(idx);
+    }
+    char buf[64 * 1024];
+    while(c.fd >= 0 && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if(n < 0) {
+            if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                finish(idx);
+            }
+            break;
+        }
+        if(n == 0) {
+            if(c.answered == c.requests.size() && c.next_chunk == c.chunks.size()) {
+                c.done = true;
+            }
+            finish(idx);
+            return;
+        }
+        size_t off = 0;
+        while(off < (size_t)n) {
+            bool complete = false;
+            long used = c.parser.parse(buf + off, n - off, complete);
+            if(used < 0 || c.answered >= c.stamped) {
+                finish(idx);
+                return;
+            }
+            off += used;
+            if(complete) {
+                replay_request& r = c.requests[c.answered++];
+                r.latency = (now_ns() - r.sent) / 1000;
+                r.status = c.parser.status;
+                c.parser.reset();
+            }
+        }
+    }
+    advance(idx);
+}
+
+static void check_timeouts() {
+    uint64_t now = now_ns();
+    uint64_t limit = (uint64_t)timeout_ms * 1000000ull;
+    for(size_t i = 0; i < conns.size(); ++i) {
+        replay_conn& c = conns[i];
+        if(c.fd >= 0 && c.answered < c.stamped && now > c.requests[c.answered].sent + limit) {
+            finish(i);
+        }
+    }
+}
+
+static void replay() {
+    epollfd = epoll_create1(0);
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &server_addr.sin_addr);
+
+    replay_start = now_ns();
+    for(size_t i = 0; i < conns.size(); ++i) {
+        timers.push(wakeup(due(conns[i].open_time), i));
+    }
+    size_t finished = 0;
+    uint64_t last_check = replay_start;
+    epoll_event events[256];
+    while(true) {
+        uint64_t now = now_ns();
+        while(! timers.empty() && timers.top().first <= now) {
+            size_t idx = timers.top().second;
+            timers.pop();
+            advance(idx);
+        }
+        if(now - last_check > 100000000ull) {
+            check_timeouts();
+            last_check = now;
+            finished = std::count_if(conns.begin(), conns.end(),
+                [](const replay_conn& c) { return c.done; });
+            if(finished == conns.size()) {
+                break;
+            }
+        }
+        int timeout = 100;
+        if(! timers.empty()) {
+            uint64_t next = timers.top().first;
+            timeout = (next > now) ? (int)std::min<uint64_t>((next - now) / 1000000, 100) : 0;
+        }
+        int n = epoll_wait(epollfd, events, 256, timeout);
+        for(int i = 0; i < n; ++i) {
+            on_event(events[i].data.u64, events[i].events);
+        }
+    }
+    close(epollfd);
+}
+
+/* ---------------- 结果 ---------------- */
+typedef std::map<std::pair<uint32_t, size_t>, uint64_t> baseline_map;
+
+static bool load_baseline(const char* file, baseline_map& out) {
+    FILE* fp = fopen(file, "r");
+    if(! fp) {
+        perror(file);
+        return false;
+    }
+    char line[4096];
+    if(! fgets(line, sizeof(line), fp)) {
+        fclose(fp);
+        return false;
+    }
+    unsigned conn_id;
+    size_t seq;
+    unsigned long long time, latency;
+    int status;
+    while(fgets(line, sizeof(line), fp)) {
+        if(sscanf(line, "%u,%zu,%llu,%llu,%d", &conn_id, &seq, &time, &latency, &status) == 5 && status) {
+            out[std::make_pair(conn_id, seq)] = latency;
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+static void print_usage(const char* prog) {
+    printf("usage: %s [options] -p port trace\n", prog);
+    printf("  -H, --host=ADDR         server address (default: 127.0.0.1)\n");
+    printf("  -p, --port=PORT         server port\n");
+    printf("  -s, --speed=X           replay X times faster than recorded, 0 = as fast as\n");
+    printf("                          possible (default: 1)\n");
+    printf("      --timeout=MS        request timeout (default: 10000)\n");
+    printf("      --csv=FILE          write per-request latencies to FILE\n");
+    printf("      --baseline=FILE     compare per-request latencies with an earlier --csv\n");
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option long_options[] = {
+        {"host", required_argument, nullptr, 'H'},
+        {"port", required_argument, nullptr, 'p'},
+        {"speed", required_argument, nullptr, 's'},
+        {"timeout", required_argument, nullptr, 1},
+        {"csv", required_argument, nullptr, 2},
+        {"baseline", required_argument, nullptr, 3},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    string csv, baseline;
+    int o = 0;
+    while((o = getopt_long(argc, argv, "H:p:s:h", long_options, nullptr)) != -1) {
+        switch(o) {
+            case 'H': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 's': speed = atof(optarg); break;
+            case 1: timeout_ms = atoi(optarg); break;
+            case 2: csv = optarg; break;
+            case 3: baseline = optarg; break;
+            default: print_usage(argv[0]); return 1;
+        }
+    }
+    if(port <= 0 || optind >= argc || speed < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if(! load_trace(argv[optind])) {
+        return 1;
+    }
+    size_t total = 0;
+    for(const auto& c : conns) {
+        total += c.requests.size();
+    }
+    if(speed > 0) {
+        printf("replaying %zu connections, %zu requests at %.2fx\n", conns.size(), total, speed);
+    }
+    else {
+        printf("replaying %zu connections, %zu requests at full speed\n", conns.size(), total);
+    }
+
+    uint64_t start = now_ns();
+    replay();
+    double elapsed = (now_ns() - start) / 1e9;
+
+    latency_histogram hist;
+    for(const auto& c : conns) {
+        for(const auto& r : c.requests) {
+            if(r.status) {
+                hist.record(r.latency);
+            }
+        }
+    }
+    printf("  requests   %llu answered in %.2fs, errors %llu\n",
+        (unsigned long long)hist.count(), elapsed, (unsigned long long)errors);
+    printf("  latency(us)  p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+        (unsigned long long)hist.percentile(50), (unsigned long long)hist.percentile(90),
+        (unsigned long long)hist.percentile(99), (unsigned long long)hist.percentile(99.9),
+        (unsigned long long)hist.max());
+
+    if(! csv.empty()) {
+        FILE* fp = fopen(csv.c_str(), "w");
+        if(! fp) {
+            perror(csv.c_str());
+            return 1;
+        }
+        fprintf(fp, "conn_id,seq,time_us,latency_us,status,request\n");
+        for(const auto& c : conns) {
+            for(size_t i = 0; i < c.requests.size(); ++i) {
+                const replay_request& r = c.requests[i];
+                size_t first = std::lower_bound(c.chunks.begin(), c.chunks.end(), i ? c.requests[i - 1].end : 0,
+                    [](const chunk& ch, size_t off) { return ch.off + ch.len <= off; }) - c.chunks.begin();
+                uint64_t t = first < c.chunks.size() ? c.chunks[first].time : 0;
+                fprintf(fp, "%u,%zu,%llu,%llu,%d,\"%s\"\n", c.id, i, (unsigned long long)t,
+                    (unsigned long long)r.latency, r.status, r.line.c_str());
+            }
+        }
+        fclose(fp);
+    }
+
+    if(! baseline.empty()) {
+        baseline_map old;
+        if(! load_baseline(baseline.c_str(), old)) {
+            return 1;
+        }
+        /* 同一份录制的请求按(连接编号,序号)一一对应，逐个比较延迟 */
+        struct delta{ long long diff; const replay_conn* c; size_t seq; };
+        vector<delta> deltas;
+        for(const auto& c : conns) {
+            for(size_t i = 0; i < c.requests.size(); ++i) {
+                auto it = old.find(std::make_pair(c.id, i));
+                if(it != old.end() && c.requests[i].status) {
+                    deltas.push_back(delta{(long long)c.requests[i].latency - (long long)it->second, &c, i});
+                }
+            }
+        }
+        if(deltas.empty()) {
+            printf("  no requests in common with %s\n", baseline.c_str());
+            return 0;
+        }
+        std::sort(deltas.begin(), deltas.end(), [](const delta& a, const delta& b) { return a.diff < b.diff; });
+        auto pct = [&deltas](double p) { return deltas[std::min(deltas.size() - 1, (size_t)(p / 100 * deltas.size()))].diff; };
+        long long sum = 0;
+        for(const auto& d : deltas) {
+            sum += d.diff;
+        }
+        printf("  delta vs baseline (us, new - old) over %zu requests:\n", deltas.size());
+        printf("    mean %.1f  p10 %lld  p50 %lld  p90 %lld  p99 %lld\n",
+            (double)sum / deltas.size(), pct(10), pct(50), pct(90), pct(99));
+        printf("  largest regressions:\n");
+        for(size_t i = 0; i < 10 && i < deltas.size(); ++i) {
+            const delta& d = deltas[deltas.size() - 1 - i];
+            if(d.diff <= 0) {
+                break;
+            }
+            printf("    +%lldus  conn %u #%zu  %s\n", d.diff, d.c->id, d.seq, d.c->requests[d.seq].line.c_str());
+        }
+    }
+    return errors ? 2 : 0;
+}